@@ -3,6 +3,9 @@ set CC=gcc
 set CFLAGS=-Wall -Wextra -pedantic -Iinclude
 set OBJDIR=build
 set EXEC=SNASM.exe
+set LINKER=snld.exe
+set VM=snvm.exe
+set DISASM=sndis.exe
 
 echo Creating output directory...
 if not exist %OBJDIR% mkdir %OBJDIR%
@@ -15,4 +18,22 @@ for %%f in (src\*.c) do (
 echo Linking...
 %CC% %CFLAGS% %OBJDIR%\*.o -o %EXEC%
 
-echo Done. Output: %EXEC%
+echo Linking linker...
+if not exist %OBJDIR%\tools mkdir %OBJDIR%\tools
+%CC% %CFLAGS% -c tools\snld.c -o %OBJDIR%\tools\snld.o
+del %OBJDIR%\assembler.o
+%CC% %CFLAGS% %OBJDIR%\tools\snld.o %OBJDIR%\*.o -o %LINKER%
+
+echo Linking virtual machine...
+if not exist %OBJDIR%\vm mkdir %OBJDIR%\vm
+for %%f in (src\vm\*.c) do (
+    %CC% %CFLAGS% -O2 -c %%f -o %OBJDIR%\vm\%%~nf.o
+)
+%CC% %CFLAGS% -c tools\snvm.c -o %OBJDIR%\tools\snvm.o
+%CC% %CFLAGS% %OBJDIR%\tools\snvm.o %OBJDIR%\vm\*.o %OBJDIR%\*.o -o %VM% -pthread
+
+echo Linking disassembler...
+%CC% %CFLAGS% -c tools\sndis.c -o %OBJDIR%\tools\sndis.o
+%CC% %CFLAGS% %OBJDIR%\tools\sndis.o %OBJDIR%\*.o -o %DISASM%
+
+echo Done. Output: %EXEC% %LINKER% %VM% %DISASM%
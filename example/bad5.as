@@ -0,0 +1,6 @@
+.entry START
+START:      lod #VAR, r6                ; VAR is an address, an immediate can't hold it
+            mov #(END-START)*100000000, r2  ; doesn't fit in an immediate, and labels keep it out of the literal pool
+END:        stop
+
+VAR:        .data 5
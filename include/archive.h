@@ -0,0 +1,57 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "definitions.h"
+#include "linker.h"
+#include "symindex.h"
+
+#define MAX_ARCHIVE_LINE (MAX_FILENAME_LENGTH + 64)
+
+/// STATIC LIBRARY ARCHIVES ///
+// A `.sna` archive bundles `.snl` objects behind an index of their entries:
+//
+//   SNA|<width>|<members>|<symbols>
+//   M|<name>|<offset>|<length>     One per member, offset from the end of the index
+//   S|<entry>|<member>             One per exported entry
+//   ---
+//   <member objects, back to back>
+//
+// Only the index is read when an archive is added to a link, a member is
+// read once one of its entries resolves an outstanding extern.
+
+typedef struct s_archive_member {
+    char   *name;
+    long    offset;
+    size_t  length;
+    bool    loaded;
+} ArchiveMember;
+
+typedef struct s_archive {
+    char          *path;
+    FILE          *file;
+    long           data_start;     // File offset of the first member
+    int            width;
+    ArchiveMember *members;
+    size_t         member_count;
+    char         **symbols;        // Index keys
+    size_t         symbol_count;
+    SymbolIndex    index;          // Entry name to its ArchiveMember
+} Archive;
+
+// Bundles the objects into an archive. Returns 0 upon success, else STATUS_ERROR
+int WriteArchive(const char *path, char **objects, size_t count);
+
+// Reads an archive's index and adds it to the link. Returns 0 upon success, else STATUS_ERROR
+int AddArchive(Link *link, const char *path);
+
+// Appends the members defining the link's outstanding externs, and the members
+// those need in turn. Returns the number of members pulled in, or STATUS_ERROR
+int PullArchiveMembers(Link *link);
+
+void CleanUpArchive(Archive *archive);
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <pthread.h>
+
+#include "vm.h"
+
+#define BATCH_RESULTS_EXTENSION  ".results"
+#define BATCH_MAX_THREADS        256
+
+/// BATCH RUNS ///
+// A manifest lists one image per line as `path [budget] [rN=value ...]`,
+// relative paths are taken from the manifest's directory and `;` starts a
+// comment. Every line is a job, and identical images share one decoded Program.
+// Jobs are dealt out to per-thread deques: a thread pops its own from the back
+// and, once those are gone, steals from the front of the others'.
+//
+// A program that makes the checkpoint syscall has its start-up run once: the
+// first job of the image runs up to the checkpoint and snapshots the machine,
+// and the other jobs fork from the snapshot. A job's register settings apply
+// at the checkpoint, or at the entry of a program that has none.
+
+// A register set by a job before it runs on
+typedef struct s_batch_setting {
+    int      reg;
+    int32_t  value;
+} BatchSetting;
+
+// One distinct image, decoded by the first job that needs it
+typedef struct s_batch_image {
+    char            *contents;    // Text of the .sno file, the key of the image
+    const char      *path;        // Of the first job naming it
+    Program          program;
+    int              state;       // 0 not loaded yet, 1 loaded, STATUS_ERROR if it failed to
+    VmSnapshot      *checkpoint;  // At the program's first checkpoint, NULL until a job got there
+    bool             no_checkpoint;  // A job ran the program to its end without reaching one
+    pthread_mutex_t  lock;
+} BatchImage;
+
+typedef struct s_batch_job {
+    char       *path;
+    uint64_t    budget;          // 0 for no limit
+    BatchSetting *settings;
+    size_t      setting_count;
+    BatchImage *image;           // NULL if the file could not be read
+    bool        loaded;          // The image decoded and the job ran
+    bool        forked;          // Ran on from the image's checkpoint
+    VmStatus    status;
+    int32_t     exit_code;
+    uint64_t    executed;
+    char       *output;          // What the program printed, NULL if nothing
+    size_t      output_length;
+    char        fault[128];
+} BatchJob;
+
+// A thread's deque of job indices, jobs[head..tail)
+typedef struct s_batch_queue {
+    size_t          *jobs;
+    size_t           head;
+    size_t           tail;
+    pthread_mutex_t  lock;
+} BatchQueue;
+
+typedef struct s_batch {
+    BatchJob    *jobs;
+    size_t       job_count;
+    BatchImage **images;
+    size_t       image_count;
+    size_t       image_capacity;
+    int          width;           // Passed to LoadProgram
+    bool         use_jit;
+    BatchQueue  *queues;
+    size_t       thread_count;
+    size_t       steals;
+    size_t       forks;           // Jobs that skipped the start-up
+    double       seconds;         // Wall time of the whole run
+} Batch;
+
+// Reads the manifest and every image it names. budget applies to the lines
+// that give none. Returns 0 upon success, else STATUS_ERROR
+int LoadBatch(const char *manifest, int width, uint64_t budget, Batch *batch);
+
+// Runs every job on threads threads (0 for one per CPU). Returns 0 upon success, else STATUS_ERROR
+int RunBatch(Batch *batch, size_t threads);
+
+// Writes one line per job in manifest order. Returns 0 upon success, else STATUS_ERROR
+int WriteBatchResults(const Batch *batch, const char *path);
+
+// Returns the number of jobs that did not halt with exit code 0
+size_t CountBatchFailures(const Batch *batch);
+
+void CleanUpBatch(Batch *batch);
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef BLOCKS_H
+#define BLOCKS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "definitions.h"
+#include "command.h"
+#include "repeat.h"
+#include "io.h"
+
+#define NO_BLOCK ((size_t)-1)
+
+typedef enum e_block_kind {
+    BLOCK_CODE,
+    BLOCK_DATA,
+} BlockKind;
+
+/*
+ * A labeled run of code or data in the expanded source. Code and data are
+ * laid out in separate segments, so a data label in between doesn't end a
+ * code block (and vice versa); unlabeled lines join the current block of their kind.
+ */
+typedef struct s_block {
+    char       *label;          // NULL for lines before the first label of their kind
+    BlockKind   kind;
+    size_t      file;           // Index of the file the block is defined in
+    bool        falls_through;  // Execution may continue into the next code block
+    char      **refs;           // Names used in the block's operands
+    size_t      ref_count;
+    size_t      ref_capacity;
+    bool        live;
+    uint64_t    heat;           // Instructions run in the block, from a layout profile
+} Block;
+
+// An expanded file, split into lines
+typedef struct s_block_file {
+    char         *path;
+    char         *source;
+    const char  **lines;        // line_count + 1 entries, the last one points past the end
+    size_t        line_count;
+    size_t       *owner;        // Block of each line, NO_BLOCK for directives and comments
+} BlockFile;
+
+typedef struct s_block_graph {
+    Block      *blocks;         // Code blocks appear in program order
+    size_t      count;
+    size_t      capacity;
+    BlockFile  *files;
+    size_t      file_count;
+    char      **entries;        // `.entry` names
+    size_t      entry_count;
+} BlockGraph;
+
+// Reads and splits the expanded files. Returns 0 upon success, else STATUS_ERROR
+int LoadBlocks(char **paths, size_t path_count, BlockGraph *graph);
+
+// Returns the block with the given label, or NULL
+Block *FindBlock(BlockGraph *graph, const char *label, size_t label_length);
+
+/*
+ * Marks every block reachable from the roots: START, `.entry` labels, the
+ * first code block of the program and unlabeled data. A live block keeps the
+ * blocks it names and the code block it falls through to alive.
+ * Returns the number of live blocks.
+ */
+size_t MarkLiveBlocks(BlockGraph *graph);
+
+// Rewrites every file, keeping the lines of live blocks and all other lines.
+// Returns 0 upon success, else STATUS_ERROR
+int WriteLiveBlocks(BlockGraph *graph);
+
+// Sets the heat of each labeled code block from a flat profile written by `snvm -p`.
+// Returns the number of blocks found in the profile, STATUS_ERROR if it can't be read
+int LoadBlockHeat(BlockGraph *graph, const char *profile_path);
+
+/*
+ * Rewrites every file with its code ordered hottest first, keeping blocks that
+ * fall through to each other together, and cold code last. A conditional
+ * branch over a colder fall-through block is inverted, when the branch target
+ * can follow it instead and a value_bits wide operand reaches either way.
+ * Stores the number of inverted branches in flipped.
+ * Returns 0 upon success, else STATUS_ERROR
+ */
+int WriteHotLayout(BlockGraph *graph, int value_bits, size_t *flipped);
+
+void CleanUpBlocks(BlockGraph *graph);
+
+#endif
@@ -7,6 +7,7 @@
 
 #include "definitions.h"
 #include "label.h"
+#include "pool.h"
 
 typedef struct s_command {
     const char *name;
@@ -81,6 +82,27 @@ static const Command commands[COMMAND_COUNT] = {
 
 const Command *FindCommand(char *com_name);
 
+/// DECODING ///
+// The VM and the disassembler read command words back the same way
+
+// The fields of a command word
+typedef struct s_command_word {
+    uint32_t opcode;
+    uint32_t funct;
+    uint32_t mode[2];  // Source, then destination
+    uint32_t reg[2];
+} CommandWord;
+
+// Splits a command word of an image assembled for width bits into its fields
+void DecodeCommandWord(int width, uint32_t word, CommandWord *fields);
+
+// Whether comm accepts the word's addressing modes, and the fields of the
+// operands it doesn't take are clear, as the assembler leaves them
+bool ValidOperandModes(const Command *comm, const CommandWord *fields);
+
+// Sign-extends the value field of an operand word of an image assembled for width bits
+int32_t OperandValue(int width, uint32_t word);
+
 // Does not conform to status codes, change?
 // Returns number of words the command will take, -1 if error
 int ValidateCommand(char *com_line, const Command *comm);
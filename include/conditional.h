@@ -0,0 +1,62 @@
+#ifndef CONDITIONAL_H
+#define CONDITIONAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include "definitions.h"
+
+#define MAX_DEFINES      64
+#define MAX_COND_DEPTH   32
+
+// A symbol defined on the command line with `-D NAME[=value]`
+typedef struct s_define
+{
+    char *name;
+    int64_t value;
+} Define;
+
+// One open `.if`/`.ifdef`/`.ifndef` block
+typedef struct s_cond_frame
+{
+    bool active;    // Lines of the current branch are assembled
+    bool taken;     // A branch of this block was (or can no longer be) chosen
+    bool in_else;   // `.else` was seen
+} CondFrame;
+
+// Open conditional blocks of one source file
+typedef struct s_cond_stack
+{
+    CondFrame frames[MAX_COND_DEPTH];
+    size_t depth;
+} CondStack;
+
+// Parses `NAME[=value]`, the value defaults to 1.
+// Returns 0 upon success, else STATUS_ERROR
+int AddDefine(const char *spec);
+
+// Returns the define with the given name, or NULL if it isn't defined
+const Define *FindDefine(const char *name, size_t name_length);
+
+// Evaluates the condition of an `.if`: a constant expression of numbers and
+// defined symbols, optionally compared to another with == != < <= > >=.
+// Returns 0 upon success, else STATUS_ERROR
+int EvaluateCondition(const char *expr, int64_t *value);
+
+// True if the line is a conditional directive
+bool IsConditional(const char *line);
+
+// Applies a conditional directive to the stack.
+// Returns 0 upon success, else STATUS_ERROR
+int HandleConditional(const char *line, CondStack *stack);
+
+// True if lines at the current position are assembled
+bool IsAssembled(const CondStack *stack);
+
+void CleanUpDefines(void);
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef DEBUGMAP_H
+#define DEBUGMAP_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "definitions.h"
+
+#define DEBUG_MAP_EXTENSION  ".snd"
+#define DEBUG_MARKER         ";@"
+#define DEBUG_MAP_MAGIC      "SNDM"
+#define DEBUG_MAP_VERSION    1
+#define DEBUG_MAP_BLOCK      64  // Entries per block of the lookup index
+
+/// SOURCE-LINE DEBUG MAP ///
+// With -g the preassembler ends every line it writes to the .snm with a
+// `;@file:line[:call]` comment, naming the file and line its text came from
+// and, for a macro body, the call that expanded it. Later stages keep
+// comments, so the second pass reads each statement's origin back where it
+// emits words and records an entry whenever the origin changes. An entry
+// covers the addresses up to the next one.
+//
+// The .snd file, all numbers little-endian:
+//   header   "SNDM", then u32 version, entries, blocks, files, calls, string bytes, entry bytes
+//   files    u32 name offset per source file
+//   calls    u32 macro name offset, u32 file, u32 line per macro call
+//   index    u32 first address, u32 offset into the entries, per block of DEBUG_MAP_BLOCK entries
+//   strings  NUL-terminated names
+//   entries  LEB128: address delta << 1 | origin changed, [file, call,] zigzag line delta
+// Files and calls count from 1 in entries, 0 is an unknown file or no macro.
+// Every block starts over from its first address and line 0 with the origin
+// spelled out, so a lookup binary searches the index and decodes one block.
+
+// Where a statement of the .snm came from
+typedef struct s_debug_origin {
+    uint32_t file;   // 0 if unknown
+    uint32_t line;
+    uint32_t call;   // 0 outside of macro bodies
+} DebugOrigin;
+
+// What FindDebugLine reports for an address
+typedef struct s_debug_line {
+    uint32_t    address;    // Where the entry covering the address starts
+    const char *file;       // NULL if unknown
+    uint32_t    line;
+    const char *macro;      // Expanded macro, NULL outside of macro bodies
+    const char *call_file;  // Where the macro was called
+    uint32_t    call_line;
+} DebugLine;
+
+// A loaded .snd file
+typedef struct s_debug_map {
+    uint8_t       *data;
+    size_t         size;
+    uint32_t       entry_count;
+    uint32_t       block_count;
+    uint32_t       file_count;
+    uint32_t       call_count;
+    uint32_t       strings_size;
+    uint32_t       entries_size;
+    const uint8_t *files;
+    const uint8_t *calls;
+    const uint8_t *index;
+    const char    *strings;
+    const uint8_t *entries;
+} DebugMap;
+
+// Preassembler: returns the number of a source file, the same for the same path, or 0 upon failure
+uint32_t DebugAddFile(const char *path);
+
+// Preassembler: records a call of macro on the given line. Returns its number, or 0 upon failure
+uint32_t DebugAddCall(const char *macro, uint32_t file, uint32_t line);
+
+// Preassembler: writes the marker that ends a line of the .snm
+void DebugWriteMarker(FILE *output_fd, uint32_t file, uint32_t line, uint32_t call);
+
+// Returns where a line's marker starts, NULL if it has none
+const char *DebugFindMarker(const char *line);
+
+// Returns the origin a line's marker names, unknown if it has none
+DebugOrigin DebugParseMarker(const char *line);
+
+// Second pass: takes the origin of the statements that follow from a line's marker, unknown if it has none
+void DebugReadMarker(const char *line);
+
+// The path of a recorded source file, NULL if there is none by that number
+const char *DebugFileName(uint32_t file);
+
+// The macro a recorded call expanded, and where it was called from. NULL if there is no such call
+const char *DebugCallInfo(uint32_t call, uint32_t *file, uint32_t *line);
+
+DebugOrigin DebugGetOrigin(void);
+void DebugSetOrigin(DebugOrigin origin);
+
+// Second pass: the word at a code address, or at data_segment[index], comes from the current origin
+void DebugMarkCode(uint32_t address);
+void DebugMarkData(uint32_t index);
+
+// Writes the unit's map, data indices are placed from data_base on. Returns 0 upon success, else STATUS_ERROR
+int DebugWrite(const char *path, uint32_t data_base);
+
+void DebugCleanUp(void);
+
+// Reads a .snd file. Returns 0 upon success, else STATUS_ERROR
+int LoadDebugMap(const char *path, DebugMap *map);
+
+// Finds the source of the word at address. Returns 0 upon success, STATUS_NO_RESULT if no
+// entry covers it, else STATUS_ERROR
+int FindDebugLine(const DebugMap *map, uint32_t address, DebugLine *line);
+
+void CleanUpDebugMap(DebugMap *map);
+
+#endif
@@ -20,9 +20,12 @@
 #define INPUT_FILE_EXTENSION       ".as"
 #define INPUT_FILE_EXTENSION_ALT   ".snasm"
 #define OBJECT_FILE_EXTENSION      ".sno"
+#define LINK_OBJECT_EXTENSION      ".snl"
+#define LINK_ARCHIVE_EXTENSION     ".sna"
 #define EXTENDED_FILE_EXTENSION    ".snm"
 #define EXTERNALS_FILE_EXTENSION   ".snext"
 #define ENTRIES_FILE_EXTENSION     ".snent"
+#define SYMBOL_FILE_EXTENSION      ".sns"
 
 #define MAX_FILENAME_LENGTH        128
 #define MAX_EXTENSION_LENGTH       3
@@ -39,7 +42,10 @@
 #endif
 
 /// STANDARD INPUT DEFINITIONS ///
-#define MAX_LINE_LENGTH   128
+#define LINE_READER_CHUNK     65536  // Initial line buffer size, grows for longer lines
+#define WRITER_BUFFER         65536  // Bytes a BufferedWriter gathers before writing them out
+#define WRITER_MAX_FORMAT     512    // Longest text a single WriteFormat produces
+#define MAX_MNEMONIC_LENGTH   8
 
 // /// OPCODES ///
 // #define OPCODE_MOV     0
@@ -64,6 +70,16 @@
 #define ISTRING        ".string"
 #define IENTRY         ".entry"
 #define IEXTERN        ".extern"
+#define IREPT          ".rept"
+#define IIRP           ".irp"
+#define IENDR          ".endr"
+#define IINCLUDE       ".include"
+#define IIF            ".if"
+#define IIFDEF         ".ifdef"
+#define IIFNDEF        ".ifndef"
+#define IELSE          ".else"
+#define IENDIF         ".endif"
+#define IEQU           ".equ"
 
 /// ERROR CODES ///
 #define STATUS_ERROR          -1  // Catasrophic error
@@ -80,6 +96,18 @@
 #define WORD_SIZE             32
 #define WORD(x) (ASSEMBLER_FLAGS.legacy_24_bit ? ((x) & 0xFFFFFF) : ((x) & 0xFFFFFFFF))
 
+/// VALUE RANGES ///
+#define VALUE_BITS_LEGACY     21
+#define VALUE_BITS            28
+#define VALUE_WIDTH (ASSEMBLER_FLAGS.legacy_24_bit ? VALUE_BITS_LEGACY : VALUE_BITS)
+#define VALUE_MAX   ((1LL << (VALUE_WIDTH - 1)) - 1)
+#define VALUE_MIN   (-(1LL << (VALUE_WIDTH - 1)))
+#define VALUE_FITS(v) ((v) >= VALUE_MIN && (v) <= VALUE_MAX)
+
+// Anything a whole data word can hold, signed or unsigned
+#define WORD_WIDTH  (ASSEMBLER_FLAGS.legacy_24_bit ? WORD_SIZE_LEGACY : WORD_SIZE)
+#define WORD_FITS(v) ((v) >= -(1LL << (WORD_WIDTH - 1)) && (v) < (1LL << WORD_WIDTH))
+
 /// SPECIAL CHARACTERS ///
 #define COMMENT_DELIM  ';'        // For skipping comments
 #define LABEL_DELIM    ':'        // For labels
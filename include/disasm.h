@@ -0,0 +1,60 @@
+#ifndef DISASM_H
+#define DISASM_H
+
+#include "definitions.h"
+#include "command.h"
+#include "io.h"
+#include "debugmap.h"
+
+#define DISASM_CODE_START        100       // Images are assembled from IC = 100
+#define DISASM_MAX_WORDS         (1u << 24)
+
+/// DISASSEMBLY ///
+// An image is read once into an array of words, then decoded front to back
+// straight into a BufferedWriter, so the listing never sits in memory whole.
+// Commands are looked up in a table indexed by S_OF(opcode, funct) that is
+// built from commands[]. A 32-bit word with the M bit set has another operand
+// word after it, which is how instructions are told apart there; legacy 24-bit
+// words have no M bit, so the operand modes give their size instead.
+//
+// Labels come from the image's `E|` records and, if one is given, the unit's
+// symbol file, while the `X|` records name the extern behind an operand word.
+// With the unit's debug map, a comment names the source line each run of
+// words came from.
+
+// A name the image or its symbol file gives to an address
+typedef struct s_dis_name {
+    char     *name;
+    uint32_t  address;
+    char      kind;   // 'E' entry, 'X' extern usage, 'S' from the symbol file
+} DisName;
+
+typedef struct s_disassembly {
+    char         *path;
+    int           width;      // 24 or 32
+    uint32_t      code_size;
+    uint32_t      data_size;
+    uint32_t     *words;      // Code then data, from DISASM_CODE_START on
+    const char  **labels;     // Label at each word, NULL where there is none
+    const char  **externs;    // Extern each operand word refers to, NULL where there is none
+    const DebugMap *debug;    // Source lines of the words, NULL without a map
+    DisName      *names;
+    size_t        name_count;
+    size_t        name_capacity;
+    const Command *table[64 * 64];  // By S_OF(opcode, funct)
+} Disassembly;
+
+// Reads a `.sno` image. width is 0 to detect it from the image.
+// Returns 0 upon success, else STATUS_ERROR
+int LoadDisassembly(const char *path, int width, Disassembly *dis);
+
+// Adds the labels of a `.sns` symbol file, which take the place of the image's own.
+// Returns 0 upon success, else STATUS_ERROR
+int LoadDisassemblySymbols(Disassembly *dis, const char *path);
+
+// Writes the whole listing. Returns 0 upon success, else STATUS_ERROR
+int WriteDisassembly(const Disassembly *dis, BufferedWriter *out);
+
+void CleanUpDisassembly(Disassembly *dis);
+
+#endif
@@ -15,9 +15,11 @@
 
 int EncodeCommand(char *ops, const Command *comm, uint8_t modes, uint32_t *out);
 
-uint32_t EncodeImm(char *op, bool is_last);
-uint32_t EncodeDir(char *op, Label labels[MAX_LABELS], size_t *label_count, uint32_t curr_address, bool is_last);
-uint32_t EncodeRel(char *op, Label labels[MAX_LABELS], size_t *label_count, uint32_t curr_address, bool is_last);
+// Operand encoders return the operand word. An operand that can't be encoded
+// is reported, sets *status to STATUS_ERROR and encodes as 0
+uint32_t EncodeImm(char *op, Label labels[MAX_LABELS], size_t *label_count, bool is_last, int *status);
+uint32_t EncodeDir(char *op, Label labels[MAX_LABELS], size_t *label_count, uint32_t curr_address, bool is_last, int *status);
+uint32_t EncodeRel(char *op, Label labels[MAX_LABELS], size_t *label_count, uint32_t curr_address, bool is_last, int *status);
 
 void WordToHex(FILE *file, uint32_t num);
 void LogU32AsBin(uint32_t num);
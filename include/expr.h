@@ -0,0 +1,55 @@
+#ifndef EXPR_H
+#define EXPR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "definitions.h"
+
+#define MAX_CONSTANTS 256
+
+struct s_symbol;
+
+// Labels an expression may refer to
+typedef struct s_expr_scope
+{
+    struct s_symbol *labels;    // NULL while label addresses are not final (first pass)
+    size_t *label_count;
+} ExprScope;
+
+typedef struct s_expr_value
+{
+    int64_t value;
+    int relocatable;                  // Net count of label terms: 0 absolute, 1 an address
+    struct s_symbol *external;        // Extern label the value is an offset from, if any
+    bool unresolved;                  // Refers to a label, but the scope has none yet
+} ExprValue;
+
+/*
+ * Evaluates an integer constant expression:
+ *  - Numbers (decimal or 0x hex), `.equ` constants, `-D` symbols and labels
+ *  - Operators, loosest first: | ^ & (<< >>) (+ -) (* / %), unary - + ~, parentheses
+ *  - Labels only take part in + and -, so `TABLE+4` is an address, `END-START` a number
+ * Stops at the first character that can't continue the expression and sets *end there.
+ * Returns 0 upon success, else STATUS_ERROR
+ */
+int EvalExpression(const char *text, const char **end, const ExprScope *scope, ExprValue *result);
+
+// Evaluates a whole operand that may only use constants.
+// Returns 0 upon success, STATUS_NO_RESULT if it refers to a label, else STATUS_ERROR
+int EvalConstant(const char *text, int64_t *value);
+
+// Returns 0 upon success, STATUS_WRONG on redefinition, else STATUS_ERROR
+int DefineConstant(const char *name, size_t name_length, int64_t value);
+
+// Returns true and sets *value if a `.equ` constant with the given name exists
+bool FindConstant(const char *name, size_t name_length, int64_t *value);
+
+void CleanUpConstants(void);
+
+#endif
@@ -5,6 +5,9 @@
 #include "command.h"
 #include "parser.h"
 #include "label.h"
+#include "io.h"
+#include "pool.h"
+#include "repeat.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -14,6 +17,14 @@ extern uint32_t DC;
 extern uint32_t ICF;
 extern uint32_t DCF;
 
+// Per-file `.entry`/`.extern` bookkeeping of the first pass
+typedef struct s_symbol_state {
+    char   *entries[MAX_LABELS];
+    char   *externals[MAX_LABELS];
+    size_t  entry_count;
+    size_t  extern_count;
+} SymbolState;
+
 int BuildSymbolTable(char *file_path, Label labels[MAX_LABELS], size_t *label_count);
 
 int ValidateSymbolTable(Label labels[MAX_LABELS], size_t *label_count);
@@ -7,11 +7,12 @@
 #include <stdlib.h>
 
 #include "definitions.h"
+#include "conditional.h"
 
 typedef struct flags_s {
     bool start_exists;
     bool show_symbols;
-    // bool gen_entries;
+    bool gen_entries;
     bool gen_externals;
     const char *output_file;
     bool entry_point_exists;
@@ -19,6 +20,14 @@ typedef struct flags_s {
     // bool append_to_ent;
     // bool append_to_ext;
     bool legacy_24_bit;
+    bool pool_data;
+    bool optimize;
+    bool gc_sections;
+    const char *layout_profile;
+    bool compile_only;
+    bool debug_map;
+    bool listing;
+    int stats;  // STATS_OFF, STATS_TEXT or STATS_JSON
 } Flags;
 
 extern Flags ASSEMBLER_FLAGS;
@@ -0,0 +1,65 @@
+#ifndef INCLUDE_H
+#define INCLUDE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include "definitions.h"
+#include "macro.h"
+#include "io.h"
+
+#define MAX_INCLUDE_DEPTH 16
+#define MAX_INCLUDE_PATH  512
+
+struct s_include_file;
+
+// Included files visible to a source, in `.include` order
+typedef struct s_include_list
+{
+    struct s_include_file **items;
+    size_t count;
+    size_t capacity;
+} IncludeList;
+
+// A preassembled `.include` file, shared read-only by every file that includes it
+typedef struct s_include_file
+{
+    char *path;               // Path as resolved from the including file
+    char *source;             // File contents, macro bodies are slices of it
+    size_t length;
+    MacroTable macros;        // Macros defined by the file itself
+    IncludeList includes;     // Files it includes in turn
+    char *expansion;          // The file's expanded text, emitted at every `.include`
+    size_t expansion_length;
+    bool loading;             // Being preassembled, guards against include cycles
+} IncludeFile;
+
+// Parses `.include "file"` into dst. Returns 0 upon success, else STATUS_ERROR
+int GetIncludePath(const char *line, char *dst, size_t dst_size);
+
+// Resolves a relative include path against the directory of the including file.
+// Returns 0 upon success, STATUS_ERROR if the result doesn't fit in dst
+int ResolveIncludePath(const char *includer, const char *path, char *dst, size_t dst_size);
+
+// Returns the cached include read from path, or NULL
+IncludeFile *FindInclude(const char *path);
+
+// Creates a cache entry that takes ownership of source. Returns NULL upon failure
+IncludeFile *AddInclude(const char *path, char *source, size_t length);
+
+// Appends the include to the list unless it is already on it.
+// Returns 0 upon success, else STATUS_ERROR
+int AppendInclude(IncludeList *list, IncludeFile *include);
+
+// Searches the included macro tables, depth-first in `.include` order
+Macro *FindIncludedMacro(const char *name, size_t name_length, const IncludeList *list);
+
+void CleanUpIncludeList(IncludeList *list);
+
+// Frees every cached include
+void CleanUpIncludes(void);
+
+#endif
@@ -1,11 +1,62 @@
 #ifndef IO_H
 #define IO_H
 
+#include <stdarg.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include "definitions.h"
 
+// Streams lines of any length out of one reusable, growable buffer
+typedef struct s_line_reader {
+    FILE   *file;
+    char   *buf;
+    size_t  cap;      // Allocated bytes
+    size_t  len;      // Valid bytes in buf
+    size_t  pos;      // Start of the next line
+    char    held;     // Byte displaced by the last line's terminator
+    size_t  line_no;  // Number of the last line returned (1-based)
+    bool    eof;
+    bool    failed;   // Out of memory growing buf, the rest of the file is unread
+} LineReader;
 
+// Returns 0 upon success, STATUS_ERROR if the file can't be opened
+int LineReaderOpen(LineReader *reader, const char *path);
 
-#endif
\ No newline at end of file
+// Returns the next line (including its '\n', if any), or NULL at end of file.
+// NULL with reader->failed set means the line didn't fit in memory, not the end.
+// The line is writable and stays valid until the next call.
+char *ReadLine(LineReader *reader);
+
+void LineReaderClose(LineReader *reader);
+
+// Reads a whole file into one NUL-terminated buffer owned by the caller.
+// Returns NULL upon failure.
+char *ReadFile(const char *path, size_t *length);
+
+// Builds the path of a file next to path, with its extension replaced
+void SiblingPath(const char *path, const char *extension, char *dst, size_t dst_size);
+
+// Gathers many small writes into one buffer and hands it to the file a block at a time
+typedef struct s_buffered_writer {
+    FILE   *file;
+    char   *buf;
+    size_t  len;     // Pending bytes in buf
+    bool    failed;  // A write to the file fell short, later writes are dropped
+} BufferedWriter;
+
+// Returns 0 upon success, else STATUS_ERROR. The file stays the caller's
+int WriterOpen(BufferedWriter *writer, FILE *file);
+
+void WriteBytes(BufferedWriter *writer, const char *bytes, size_t length);
+void WriteText(BufferedWriter *writer, const char *text);
+void WriteFormat(BufferedWriter *writer, const char *fmt, ...);
+
+// Hands the pending bytes to the file. Returns 0 upon success, else STATUS_ERROR
+int WriterFlush(BufferedWriter *writer);
+
+// Flushes and frees the buffer, without closing the file. Returns 0 if every write made it, else STATUS_ERROR
+int WriterClose(BufferedWriter *writer);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "vm.h"
+
+// The translator targets x86-64 hosts with mmap, elsewhere JitCreate fails and snvm interprets
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__))
+#define JIT_AVAILABLE
+#endif
+
+#define JIT_HOT_THRESHOLD  8                 // Entries into a block before it is translated
+#define JIT_MAX_BLOCK      64                // Instructions per translated block
+#define JIT_BUFFER_SIZE    (4u << 20)        // Native code, flushed as a whole once full
+#define JIT_BLOCK_RESERVE  (JIT_MAX_BLOCK * 160)  // Room one block may need
+
+// Runs the block's native code: returns the address to continue at and
+// takes the instructions it ran off *fuel
+typedef uint32_t (*NativeBlock)(Machine *machine, uint64_t *fuel);
+
+typedef struct s_jit_block {
+    NativeBlock native;    // NULL until translated
+    uint32_t    end;       // First address past the translated instructions
+    uint32_t    length;    // Instructions along the longest path through the block
+    uint32_t    heat;      // Entries while interpreted
+    bool        cold;      // Starts with an instruction that is never translated
+} JitBlock;
+
+// Translations for one Machine, which may have rewritten its code
+typedef struct s_jit {
+    Machine  *machine;
+    uint8_t  *buffer;          // mmap'd, writable while translating and executable otherwise
+    size_t    used;
+    JitBlock *blocks;          // One per code address, by index from VM_CODE_START
+    uint32_t  code_size;
+    size_t    translated;      // Blocks translated, including those since invalidated
+    size_t    invalidated;
+    size_t    flushes;
+} Jit;
+
+// Returns a translator for the machine, or NULL when the host cannot run one
+Jit *JitCreate(Machine *machine);
+
+// Like VmRun, translating hot blocks and interpreting the rest
+VmStatus JitRun(Jit *jit, uint64_t budget);
+
+void JitDestroy(Jit *jit);
+
+#endif
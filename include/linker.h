@@ -0,0 +1,76 @@
+#ifndef LINKER_H
+#define LINKER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "definitions.h"
+#include "encoder.h"
+#include "parser.h"
+#include "io.h"
+#include "symindex.h"
+
+#define LINK_BASE_ADDRESS 100   // Objects and programs both start at 100
+
+// A named address of an object: an entry, or the word that uses an extern
+typedef struct s_object_symbol {
+    char     *name;
+    uint32_t  address;
+} ObjectSymbol;
+
+// A relocatable `.snl` object written by `SNASM -c`
+typedef struct s_object {
+    char         *path;
+    int           width;          // Word size the object was assembled for
+    uint32_t      code_size;
+    uint32_t      data_size;
+    uint32_t     *words;          // Code words, then data words
+    uint32_t     *relocs;         // Words holding one of the object's own addresses
+    size_t        reloc_count;
+    ObjectSymbol *externs;        // Extern usages
+    size_t        extern_count;
+    ObjectSymbol *entries;        // `.entry` labels
+    size_t        entry_count;
+    uint32_t      code_base;      // Linked address of the first code word
+    uint32_t      data_base;      // Linked address of the first data word
+} Object;
+
+struct s_archive;
+
+// Objects in link order, all code is placed before all data
+typedef struct s_link {
+    Object            *objects;
+    size_t             count;
+    SymbolIndex        entries;        // Entry name to its ObjectSymbol, across all objects
+    struct s_archive  *archives;       // Members are pulled in on demand
+    size_t             archive_count;
+    uint32_t           code_size;
+    uint32_t           data_size;
+} Link;
+
+// Parses the text of a `.snl` object, modifying it. Returns 0 upon success, else
+// STATUS_ERROR, the object must be cleaned up either way
+int ParseObject(const char *name, char *text, Object *object);
+
+void CleanUpObject(Object *object);
+
+// Parses an object's text and appends it to the link. Returns 0 upon success, else STATUS_ERROR
+int AddObjectText(Link *link, const char *name, char *text);
+
+// Reads an object and appends it to the link. Returns 0 upon success, else STATUS_ERROR
+int AddObject(Link *link, const char *path);
+
+// Pulls in the archive members that define outstanding externs, then places
+// every object, relocates their addresses and resolves externs against
+// the entries of the other objects. Returns the number of unresolved extern
+// usages, or STATUS_ERROR
+int LinkObjects(Link *link);
+
+// Writes the linked program in the `.sno` format. Unresolved extern usages
+// are listed when gen_externals is set. Returns 0 upon success, else STATUS_ERROR
+int WriteProgram(const Link *link, const char *path, bool gen_externals);
+
+void CleanUpLink(Link *link);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef LISTING_H
+#define LISTING_H
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "definitions.h"
+#include "debugmap.h"
+#include "io.h"
+
+#define LISTING_FILE_EXTENSION  ".lst"
+#define LISTING_WORD_COLUMNS    3   // Words a row shows, the longest instruction
+
+/// ASSEMBLY LISTING ///
+// With --listing the second pass reports every statement of the .snm as it
+// reads it, and every word as it emits it, and the listing is written out
+// row by row through a BufferedWriter. A statement waits only for its first
+// row of words; longer data runs on in rows of their own.
+//
+// A row shows the address, up to LISTING_WORD_COLUMNS words with their M, A,
+// R and E bits (data words have none), the source line and the statement.
+// The preassembler's `;@` markers, written for the listing as for -g, give
+// the source line and which macro call a statement was expanded from.
+
+// Starts the unit's listing. Returns 0 upon success, else STATUS_ERROR
+int ListingOpen(const char *path, const char *object_path);
+
+// A statement of the .snm begins, the words that follow belong to it
+void ListingStatement(const char *line, DebugOrigin from);
+
+// A word of the current statement, at a code address or in the data
+void ListingCode(uint32_t address, uint32_t word);
+void ListingData(uint32_t address, uint32_t word);
+
+// Words that follow belong to no statement, they're listed under a heading
+void ListingSection(const char *title);
+
+// Writes what is pending and closes the listing. Returns 0 if all of it was written, else STATUS_ERROR
+int ListingClose(void);
+
+#endif
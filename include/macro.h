@@ -3,9 +3,9 @@
 
 #include <stddef.h>
 
-#define MAX_MACROS        16
 #define MAX_MACRO_NAME    32
-#define MAX_MACRO_LINES   128
+#define MACRO_TABLE_SIZE  64   // Initial bucket count, must be a power of two
+#define MAX_MACRO_PARAMS  16
 
 #include <stddef.h>
 #include <stdio.h>
@@ -14,25 +14,65 @@
 #include <stdlib.h>
 #include "definitions.h"
 #include "command.h"
+#include "io.h"
+#include "debugmap.h"
 
 
+// A run of literal body text, or a parameter reference
+typedef struct s_macro_segment
+{
+    const char *text;     // Slice of the body, NULL for a parameter
+    size_t length;
+    int param;            // Parameter index, -1 for literal text
+} MacroSegment;
+
 typedef struct s_macro
 {
     char *name;
-    char **body;
+    const char *body;     // Contiguous body lines, a slice of the source buffer
+    size_t body_length;   // Length of the slice in bytes
     size_t line_count;
+    uint32_t file;        // Debug map number of the defining file, 0 without -g
+    uint32_t line;        // Line of the first body line
+    char *params[MAX_MACRO_PARAMS];
+    size_t param_count;
+    MacroSegment *segments;  // Body split on parameter tokens, built once at definition
+    size_t segment_count;
 } Macro;
 
+// Open-addressed hash table of macros, keyed by name
+typedef struct s_macro_table
+{
+    Macro *macros;
+    size_t capacity;
+    size_t count;
+} MacroTable;
+
+// Returns 0 upon success, STATUS_ERROR upon failure
+int InitMacroTable(MacroTable *table);
+
 // Returns a pointer to the macro with the given name, or NULL if it doesn't exist
-Macro *FindMacro(char *name, Macro macros[MAX_MACROS], size_t *macro_count);
+Macro *FindMacro(const char *name, size_t name_length, MacroTable *table);
+
+// Takes ownership of the macro's name and parameters, tokenizes its body.
+// Returns 0 upon success, STATUS_WRONG on duplicates, else STATUS_ERROR
+int AddMacro(MacroTable *table, Macro *macro);
+
+// Parses the `a, b, ...` parameter list after the macro name on a `mcro` line.
+// Returns 0 upon success, else STATUS_ERROR
+int GetMacroParams(const char *line, Macro *macro);
+
+// Writes the macro body with args[i] (args_len[i] bytes) substituted for parameter i.
+// With a debug map call number, every body line ends with its marker
+void EmitMacro(FILE *output_fd, const Macro *macro, const char **args, const size_t *args_len, uint32_t call);
 
-// Returns 0 upon success, ERRORCODE upon failure
-int AddMacro(FILE *file_fd, Macro *macro);
+// Frees the macro's name, parameters and segments
+void CleanUpMacro(Macro *macro);
 
-// Returns 0 upon success, -1 upon failure
-int CleanUpMacro(Macro *macro);
+// Frees all macro names and the table itself
+void CleanUpMacros(MacroTable *table);
 
 // Returns a pointer to the name
-char *GetMacroName(char *line);
+char *GetMacroName(const char *line);
 
-#endif
\ No newline at end of file
+#endif
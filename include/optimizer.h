@@ -0,0 +1,28 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "definitions.h"
+#include "command.h"
+#include "parser.h"
+#include "repeat.h"
+#include "io.h"
+
+/*
+ * Peephole pass over an expanded (.snm) file, run before the first pass so
+ * every label is assigned its address from the rewritten code:
+ *  - `mov #0, X`          -> `clr X`
+ *  - `add #1, X` / `sub #-1, X` -> `inc X`
+ *  - `sub #1, X` / `add #-1, X` -> `dec X`
+ *  - `jmp L` / `jmp &L` right before the instruction labeled L is removed
+ * Only `cmp` sets the condition codes, so none of these changes behavior.
+ * Rewrites the file in place and adds the number of words saved to *words_saved.
+ * Returns 0 upon success, else STATUS_ERROR
+ */
+int OptimizeFile(const char *path, size_t *words_saved);
+
+#endif
@@ -7,11 +7,24 @@
 #include <stdlib.h>
 
 #include "definitions.h"
+#include "expr.h"
+#include "reloc.h"
 
 char *TrimWhitespace(char *str);
 
-int HandleDSDirective(char *token, uint32_t *data);
+// Sizes (data == NULL) or writes a `.data`/`.string` directive. Expressions in
+// `.data` may refer to the labels in scope. Returns the word count, else STATUS_ERROR
+int HandleDSDirective(char *token, uint32_t *data, const ExprScope *scope);
 
 void TrimNewline(char *line);
 
+// Parses an immediate operand (`#expr`) whose value fits a data word.
+// Returns 0 upon success and sets *end past the expression, STATUS_NO_RESULT
+// (with *end set) if the value depends on labels, else STATUS_ERROR.
+int ParseImmediate(const char *op, int64_t *value, const char **end);
+
+// Copies the first whitespace-delimited token of src into dst.
+// Returns its length, or STATUS_ERROR (with dst emptied) if it doesn't fit.
+int CopyToken(const char *src, char *dst, size_t dst_size);
+
 #endif
\ No newline at end of file
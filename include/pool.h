@@ -0,0 +1,58 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "definitions.h"
+#include "parser.h"
+#include "label.h"
+
+// A labeled `.data`/`.string` line with the unlabeled data lines that follow it
+typedef struct s_data_block {
+    uint32_t *values;
+    size_t    length;
+    size_t    capacity;  // Words allocated
+    uint32_t  hash;
+    bool      is_string;
+    size_t    host;      // Block whose words this block shares (itself if not merged)
+    size_t    offset;    // Final offset inside the data segment
+} DataBlock;
+
+// Adds a data directive to the pool. A labeled one starts a new block, an
+// unlabeled one continues the last block. Returns its block id or STATUS_ERROR
+int PoolAddBlock(char *directive, bool labeled);
+
+// Words added to the pool so far, a mark for PoolRepeat()
+size_t PoolWords(void);
+
+// Adds the words added since mark count - 1 more times, for a `.rept` body
+// sized once. The copies continue the last block. Returns 0 upon success, else STATUS_ERROR
+int PoolRepeat(size_t mark, size_t count);
+
+// Lays out the pool, tail-merging strings, and rewrites data label addresses
+// from block ids to data offsets. Returns the pooled data size in words.
+int PoolFinalize(Label labels[MAX_LABELS], size_t *label_count);
+
+// Appends the pooled words to the data segment
+void PoolEmit(uint32_t *data_segment);
+
+void PoolCleanUp(void);
+
+/// LITERAL POOL ///
+// Immediates beyond the encodable value range live in the data segment,
+// after all other data, and are referenced with direct addressing.
+
+// Interns a literal value, returns its index or STATUS_ERROR
+int LiteralAdd(int64_t value);
+
+// Sets the absolute address of the first literal, returns the literal count
+size_t LiteralPlace(uint32_t base_address);
+
+// Returns the absolute address of a placed literal, or STATUS_ERROR
+int LiteralAddress(int64_t value);
+
+// Appends the literals to the data segment
+void LiteralEmit(uint32_t *data_segment);
+
+#endif
@@ -8,11 +8,15 @@
 
 #include "macro.h"
 #include "parser.h"
+#include "io.h"
+#include "include.h"
+#include "conditional.h"
 
+// Reads input_path once, collecting macro definitions and expanding their
+// invocations in the same sweep. `.include` files are preassembled once per run
+// and shared by every file that includes them (see CleanUpIncludes()).
+// Sets *macro_count to the number of macros defined.
 // Returns 0 upon success, else ERRORCODE
-int ParseMacros(char *file_path, Macro macros[MAX_MACROS], size_t *macro_count);
+int ExpandMacros(char *input_path, char *output_path, size_t *macro_count);
 
-// Returns 0 upon success, else ERRORCODE
-int ExpandMacros(char *input_path, char *output_path, Macro macros[MAX_MACROS], size_t *macro_count);
-
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,101 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "vm.h"
+
+#define PROFILE_FLAT_EXTENSION    ".prof"
+#define PROFILE_FOLDED_EXTENSION  ".folded"
+#define PROFILE_MAX_DEPTH         256    // Deeper calls are charged to the deepest frame kept
+
+/// EXECUTION PROFILE ///
+// The interpreter only reports control transfers: a taken jump counts at its
+// instruction, and jsr/rts move a shadow call stack. Straight-line code runs
+// untouched, and the instruction counts are rebuilt once the run is over.
+// Each jsr remembers the frame it last entered, so a call only looks its
+// frame up in the call tree when it's made from a different frame.
+
+// A code label of the program, from its .sns symbol file or its entries
+typedef struct s_profile_label {
+    char     *name;
+    uint32_t  address;
+} ProfileLabel;
+
+// A frame of the call tree: a function called from its parent frame
+typedef struct s_call_node {
+    uint32_t  function;      // Label the call went to
+    uint32_t  parent;        // Node index, UINT32_MAX for the entry
+    uint64_t  self;          // Instructions run in this frame and not in its callees
+} CallNode;
+
+typedef struct s_profile {
+    const Program *program;
+    ProfileLabel  *labels;        // Sorted by address
+    size_t         label_count;
+    uint32_t      *owner;         // Code index to its enclosing label
+    uint64_t      *taken;         // Code index to times the transfer there was taken
+    uint64_t      *returns;       // Code index to times an rts returned there
+    uint32_t      *site_parent;   // Code index of a jsr to the frame it last called from
+    uint32_t      *site_node;     // and the frame that call went to
+    CallNode      *nodes;
+    size_t         node_count;
+    size_t         node_capacity;
+    uint32_t      *node_table;    // Hashed (parent, function) to node index + 1
+    size_t         table_capacity;
+    uint32_t       stack[PROFILE_MAX_DEPTH];
+    size_t         depth;
+    uint64_t       overflow;      // Calls past PROFILE_MAX_DEPTH not yet returned
+    uint64_t       mark;          // Instructions run when the frame last changed
+    uint64_t       unmatched;     // Returns with no call to return from
+} Profile;
+
+// Sets up a profile of the program, labelled from symbol_path when it can be read.
+// Returns NULL upon failure
+Profile *ProfileCreate(const Program *program, const char *symbol_path);
+
+// Looks up the frame a call from the current frame at the code index site
+// enters, and caches it for the site. Returns UINT32_MAX when out of memory
+uint32_t ProfileEnter(Profile *profile, uint32_t site, uint32_t target);
+
+// Charges the instructions run since the last frame change to the current frame
+static inline void ProfileCharge(Profile *profile, uint64_t executed) {
+    profile->nodes[profile->stack[profile->depth - 1]].self += executed - profile->mark;
+    profile->mark = executed;
+}
+
+// A jsr at the code index site to the code index target, executed instructions into the run.
+// The interpreter calls it for every jsr, so the common case is kept inline
+static inline void ProfileCall(Profile *profile, uint64_t executed, uint32_t site, uint32_t target) {
+    ProfileCharge(profile, executed);
+    if (profile->depth == PROFILE_MAX_DEPTH || profile->overflow > 0) {
+        profile->overflow++;
+        return;
+    }
+
+    // A call site mostly calls from the same frame as last time, which saves the lookup
+    uint32_t node = profile->site_node[site];
+    if (profile->site_parent[site] != profile->stack[profile->depth - 1]) node = ProfileEnter(profile, site, target);
+    if (node == UINT32_MAX) {
+        profile->overflow++;  // Out of memory, stay in the caller's frame
+        return;
+    }
+    profile->stack[profile->depth++] = node;
+}
+
+// An rts, executed instructions into the run
+static inline void ProfileReturn(Profile *profile, uint64_t executed) {
+    ProfileCharge(profile, executed);
+    if (profile->overflow > 0) {
+        profile->overflow--;
+    } else if (profile->depth > 1) {
+        profile->depth--;
+    } else {
+        profile->unmatched++;
+    }
+}
+
+// Writes the flat and folded-stack profiles of a finished run. Returns 0 upon success, else STATUS_ERROR
+int ProfileWrite(Profile *profile, const Machine *machine, const char *flat_path, const char *folded_path);
+
+void ProfileDestroy(Profile *profile);
+
+#endif
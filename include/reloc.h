@@ -0,0 +1,29 @@
+#ifndef RELOC_H
+#define RELOC_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "definitions.h"
+
+/// RELOCATION RECORDS ///
+// A separately assembled object (`-c`) starts its code at 100 like any program.
+// Every word holding one of the object's own addresses gets a record, so the
+// linker can move it once the object is placed after others. Records are only
+// kept while assembling with `-c`.
+
+// A word at `address` in the code holds a relocatable address
+void RelocAddCode(uint32_t address);
+
+// data_segment[index] holds a relocatable address
+void RelocAddData(uint32_t index);
+
+// Number of data records, a `.rept` body that adds some can't be replayed
+size_t RelocDataCount(void);
+
+// Writes `R|address` records, data indices are placed from data_base on
+void RelocWrite(FILE *output_fd, uint32_t data_base);
+
+void RelocCleanUp(void);
+
+#endif
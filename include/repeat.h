@@ -0,0 +1,40 @@
+#ifndef REPEAT_H
+#define REPEAT_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "definitions.h"
+#include "label.h"
+#include "io.h"
+
+#define MAX_REPEAT_COUNT  (1 << 20)
+
+// A `.rept N` or `.irp SYM, a, b, ...` block, with its body read once
+typedef struct s_repeat_block {
+    char   *symbol;          // .irp symbol, NULL for .rept
+    char  **items;           // .irp values, one per iteration
+    size_t  count;           // Number of iterations
+    char  **lines;           // Body statements, without the closing `.endr`
+    size_t  line_count;
+    size_t  line_capacity;
+} RepeatBlock;
+
+// True if the statement opens a `.rept`/`.irp` block
+bool IsRepeatStart(const char *line);
+
+// True if the statement is a `.endr`
+bool IsRepeatEnd(const char *line);
+
+// Parses the block header and reads the body up to its `.endr`.
+// Returns 0 upon success, else STATUS_ERROR
+int ReadRepeatBlock(const char *header, LineReader *reader, RepeatBlock *block);
+
+// Returns a private copy of body line `index` for iteration `iter` (kept in *buf),
+// with the `.irp` symbol replaced by the iteration's value. NULL upon failure.
+char *RepeatLine(const RepeatBlock *block, size_t index, size_t iter, char **buf, size_t *buf_size);
+
+void CleanUpRepeat(RepeatBlock *block);
+
+#endif
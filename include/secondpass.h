@@ -5,6 +5,14 @@
 #include "encoder.h"
 #include "parser.h"
 #include "label.h"
+#include "io.h"
+#include "pool.h"
+#include "repeat.h"
+#include "reloc.h"
+#include "debugmap.h"
+#include "listing.h"
+
+extern uint32_t curr_address;
 
 int EncodeFile(char *input_path, char *output_path, Label *labels, size_t *label_count, uint32_t *data_segment, uint32_t icf, uint32_t dcf);
 
@@ -0,0 +1,59 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "definitions.h"
+#include "io.h"
+
+#define STATS_OFF             0
+#define STATS_TEXT            1
+#define STATS_JSON            2
+#define STATS_FILE_EXTENSION  ".stats.json"
+
+/// RUN STATISTICS ///
+// With --stats every stage is timed around its work on each file, and once
+// for the stage as a whole, in wall-clock and CPU time. Line and byte counts
+// are taken from the stage's input, and the time spent counting is left out
+// of every timer running meanwhile, so counting doesn't skew the rates. Peak
+// RSS is read after each measurement; it only grows, so a stage's figure is
+// the peak of the run up to its end.
+//
+// --stats prints a table once the run ends, --stats=json writes the same
+// figures to <output>.stats.json for tools to collect.
+
+// A start of a timed region
+typedef struct s_stats_timer {
+    double wall;  // Seconds
+    double cpu;
+    double counted_wall;  // Time spent counting before the start
+    double counted_cpu;
+} StatsTimer;
+
+// What a stage did with a file, or all of its files
+typedef struct s_stats_counts {
+    uint64_t lines;
+    uint64_t bytes;
+    uint64_t words;    // Words emitted
+    uint64_t symbols;  // Labels defined
+    uint64_t macros;   // Macros defined
+} StatsCounts;
+
+void StatsStart(StatsTimer *timer);
+
+// Records the time since the timer started under stage and file (NULL for the
+// stage as a whole). Recording the same stage and file again adds to it
+void StatsRecord(const StatsTimer *timer, const char *stage, const char *file, const StatsCounts *counts);
+
+// Adds a file's lines and bytes to counts. Returns 0 upon success, else STATUS_ERROR
+int StatsCountFile(const char *path, StatsCounts *counts);
+
+// Prints the table or writes the JSON file, timing the run from start. Returns 0 upon success, else STATUS_ERROR
+int StatsReport(int mode, const StatsTimer *start, const char *json_path);
+
+void StatsCleanUp(void);
+
+#endif
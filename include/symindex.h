@@ -0,0 +1,26 @@
+#ifndef SYMINDEX_H
+#define SYMINDEX_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "definitions.h"
+
+// Open-addressed hash index from a symbol name to a value.
+// Names aren't copied and must outlive the index.
+typedef struct s_symbol_index {
+    const char **names;     // NULL marks an empty slot
+    void       **values;
+    size_t       capacity;  // Power of two
+    size_t       count;
+} SymbolIndex;
+
+// Returns 0 upon success, STATUS_WRONG if the name is already indexed, else STATUS_ERROR
+int IndexInsert(SymbolIndex *index, const char *name, void *value);
+
+// Returns the value indexed under name, or NULL
+void *IndexFind(const SymbolIndex *index, const char *name);
+
+void CleanUpIndex(SymbolIndex *index);
+
+#endif
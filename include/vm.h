@@ -0,0 +1,215 @@
+#ifndef VM_H
+#define VM_H
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "definitions.h"
+#include "command.h"
+
+#define VM_CODE_START     100         // Programs are assembled from IC = 100
+#define VM_REGISTERS      64
+#define VM_MEMORY_WORDS   (1u << 20)  // Data, code and stack, one word per address
+#define VM_PAGE_BITS      10
+#define VM_PAGE_WORDS     (1u << VM_PAGE_BITS)  // 4 KiB pages
+#define VM_PAGE_MASK      (VM_PAGE_WORDS - 1)
+#define VM_PAGES          (VM_MEMORY_WORDS >> VM_PAGE_BITS)
+
+/// PRE-DECODED INSTRUCTIONS ///
+// Every code word is decoded once into an Insn whose handler is specialized by
+// instruction and operand kinds: I(mmediate), R(egister) or M(emory). Source
+// and destination hold the immediate, the register index or the address, so
+// the dispatch loop never looks at addressing modes again.
+
+#define VM_BINARY(X, OP)  X(OP##_IR) X(OP##_RR) X(OP##_MR) X(OP##_IM) X(OP##_RM) X(OP##_MM)
+#define VM_COMPARE(X, OP) X(OP##_II) X(OP##_RI) X(OP##_MI) X(OP##_IR) X(OP##_RR) X(OP##_MR) X(OP##_IM) X(OP##_RM) X(OP##_MM)
+#define VM_UNARY(X, OP)   X(OP##_R) X(OP##_M)
+
+#define VM_HANDLERS(X) \
+    X(ILLEGAL) \
+    VM_BINARY(X, MOV) VM_BINARY(X, ADD) VM_BINARY(X, SUB) VM_BINARY(X, AND) \
+    VM_BINARY(X, OR) VM_BINARY(X, XOR) VM_BINARY(X, MUL) VM_BINARY(X, DIV) \
+    VM_BINARY(X, MOD) VM_BINARY(X, LOD) VM_BINARY(X, STR) \
+    VM_COMPARE(X, CMP) \
+    VM_UNARY(X, CLR) VM_UNARY(X, NOT) VM_UNARY(X, INC) VM_UNARY(X, DEC) \
+    X(JMP) X(BNE) X(BEQ) X(JSR) X(RTS) X(STOP) X(NOP) X(INT) \
+    X(PUSH_I) X(PUSH_R) X(PUSH_M) VM_UNARY(X, POP)
+
+#define VM_ENUM(name) H_##name,
+typedef enum e_handler {
+    VM_HANDLERS(VM_ENUM)
+    H_COUNT
+} Handler;
+#undef VM_ENUM
+
+typedef struct s_insn {
+    uint16_t handler;
+    uint16_t size;       // Words, the command word and its operand words
+    int32_t  src;        // Immediate, register index or address
+    int32_t  dst;        // Register index or address, jumps hold the target's code index
+} Insn;
+
+// An `.entry` label of the image
+typedef struct s_vm_symbol {
+    char     *name;
+    uint32_t  address;
+} VmSymbol;
+
+// A loaded `.sno` image, never modified once decoded and shared by every Machine running it
+typedef struct s_program {
+    char      *path;
+    int        width;        // Word size the image was assembled for
+    uint32_t   code_size;
+    uint32_t   data_size;
+    uint32_t   entry;        // START if exported, else the first code word
+    int32_t   *pages;        // Initial memory as page_count pages from address 0
+    uint32_t   page_count;
+    int32_t   *image;        // Into pages, the words from VM_CODE_START on, code then data
+    Insn      *code;         // One decoded instruction per code address
+    VmSymbol  *symbols;
+    size_t     symbol_count;
+} Program;
+
+typedef enum e_vm_status {
+    VM_RUNNING,
+    VM_HALTED,     // `stop` or an exit syscall
+    VM_BUDGET,     // Ran out of its instruction budget
+    VM_FAULT,
+    VM_CHECKPOINT  // Reached a checkpoint `int` while stop_at_checkpoint is set, runs on when resumed
+} VmStatus;
+
+struct s_profile;
+
+/// SYSCALLS ///
+// `int` takes the syscall number in r0 and its arguments in r1..r3, and
+// returns its result in r0 (docs/syscalls.md). Guest files are buffered on
+// the host side: writes gather in the buffer until it fills up, the file is
+// closed or the run ends, and reads are served from a chunk read ahead.
+
+#define VM_MAX_FILES   16
+#define VM_IO_BUFFER   8192
+#define VM_MAX_PATH    256
+
+typedef struct s_vm_file {
+    FILE   *host;       // NULL when the descriptor is closed
+    bool    writable;
+    bool    owned;      // Opened by the program, closed with the machine
+    char   *buffer;     // VM_IO_BUFFER bytes, pending writes or read ahead
+    size_t  length;     // Bytes in buffer
+    size_t  position;   // Next byte to read from buffer
+} VmFile;
+
+/// PAGED MEMORY ///
+// A machine reads through pages[] and writes through owned[]. Pages start out
+// shared: the program's image, a snapshot's pages, or the zero page for memory
+// never written. The first store to a page copies it into one the machine
+// owns, so a machine costs the pages it writes, and a fork from a snapshot
+// shares everything it has not written yet.
+
+// A frozen machine state that any number of machines fork from
+typedef struct s_vm_snapshot {
+    const Program         *program;
+    struct s_vm_snapshot  *parent;      // Holds the pages this snapshot shares, NULL if the program does
+    atomic_size_t          refs;
+    int32_t               *pages[VM_PAGES];
+    uint64_t               owned[VM_PAGES / 64];  // Pages taken over from the machine, freed with the snapshot
+    Insn                  *code;        // Re-decoded code when the machine wrote to its code, else NULL
+    char                  *output;
+    size_t                 output_length;
+    int32_t                regs[VM_REGISTERS];
+    uint32_t               pc;
+    uint32_t               sp;
+    bool                   zero;
+    VmStatus               status;
+    int32_t                exit_code;
+    uint64_t               executed;
+} VmSnapshot;
+
+// The state of one run of a Program
+typedef struct s_machine {
+    const Program *program;
+    Insn          *code;          // The program's, or a private copy once it writes to its code
+    int32_t        regs[VM_REGISTERS];
+    int32_t       *pages[VM_PAGES];   // Read through, never NULL
+    int32_t       *owned[VM_PAGES];   // Written through, NULL until the machine owns the page
+    size_t         owned_count;
+    VmSnapshot    *origin;        // Last snapshot taken of or forked from this machine, holds the shared pages
+    uint32_t       pc;
+    uint32_t       sp;            // Grows down from the top of memory
+    bool           zero;          // Set by `cmp` when both operands are equal
+    VmStatus       status;
+    int32_t        exit_code;
+    uint64_t       executed;      // Instructions run so far
+    uint32_t       dirty_low;     // Code addresses written since last cleared, low > high when none
+    uint32_t       dirty_high;
+    struct s_profile *profile;    // Control transfers are reported to it when set
+    bool           stop_at_checkpoint;
+    bool           capture;       // Syscall output goes to output instead of stdout/stderr, stdin is empty
+    VmFile        *files;         // VM_MAX_FILES descriptors, NULL until the first I/O syscall
+    char          *output;
+    size_t         output_length;
+    size_t         output_capacity;
+    char           fault[128];
+} Machine;
+
+// Loads and decodes a `.sno` image. width is 0 to detect it from the image.
+// Returns 0 upon success, else STATUS_ERROR
+int LoadProgram(const char *path, int width, Program *program);
+
+// Decodes the instruction whose command word, at address, is words[0], with
+// available code words from there on. Malformed instructions decode as H_ILLEGAL
+void DecodeInsn(const Program *program, const int32_t *words, size_t available, uint32_t address, Insn *insn);
+
+// Returns the address of the `.entry` label named name, or STATUS_ERROR
+int64_t FindProgramSymbol(const Program *program, const char *name);
+
+void CleanUpProgram(Program *program);
+
+// Prepares a machine to run the program from its entry, sharing the program's
+// image until it writes to it. Returns 0 upon success, else STATUS_ERROR
+int VmInit(Machine *machine, const Program *program);
+
+// Reads the word at address, below VM_MEMORY_WORDS
+int32_t VmLoad(const Machine *machine, uint32_t address);
+
+// Writes the word at address, below VM_MEMORY_WORDS, re-decoding the code when it is in the code.
+// Returns 0 upon success, else STATUS_ERROR
+int VmStore(Machine *machine, uint32_t address, int32_t value);
+
+// Returns the page for writing, copying it first unless the machine owns it. NULL upon failure
+int32_t *VmOwnPage(Machine *machine, uint32_t page);
+
+// Freezes the machine's state. The machine keeps running from the snapshot and
+// copies the pages it writes from then on. Returns NULL upon failure
+VmSnapshot *VmTakeSnapshot(Machine *machine);
+
+// Prepares a machine to run on from a snapshot. Returns 0 upon success, else STATUS_ERROR
+int VmFork(Machine *machine, VmSnapshot *snapshot);
+
+// Drops a reference taken by VmTakeSnapshot, freeing the snapshot after the last machine forked from it
+void VmReleaseSnapshot(VmSnapshot *snapshot);
+
+// Runs until the program stops, faults or has run budget more instructions (0 for no limit)
+VmStatus VmRun(Machine *machine, uint64_t budget);
+
+// Records a store to the code and re-decodes the instructions that cover it.
+// Returns 0 upon success, else STATUS_ERROR
+int VmCodeWritten(Machine *machine, uint32_t address);
+
+// Handles `int`, the syscall number is in r0. Returns the status to continue with
+VmStatus VmInterrupt(Machine *machine);
+
+// Writes out what the program's files still hold in their buffers
+void VmFlushFiles(Machine *machine);
+
+// Flushes and closes the program's files
+void VmCloseFiles(Machine *machine);
+
+// Stops the machine with a fault message
+VmStatus VmFault(Machine *machine, const char *fmt, ...);
+
+void VmCleanUp(Machine *machine);
+
+#endif
@@ -0,0 +1,220 @@
+#include "../include/archive.h"
+
+// Returns the file name of a path
+static const char *BaseName(const char *path) {
+    const char *slash = strrchr(path, '/');
+    const char *backslash = strrchr(path, '\\');
+    if (backslash && (!slash || backslash > slash)) slash = backslash;
+    return slash ? slash + 1 : path;
+}
+
+int WriteArchive(const char *path, char **objects, size_t count) {
+    if (!path || !objects || count == 0) return STATUS_ERROR;
+
+    char **texts = calloc(count, sizeof(char *));
+    size_t *lengths = calloc(count, sizeof(size_t));
+    Object *parsed = calloc(count, sizeof(Object));
+    SymbolIndex exported = {0};
+    size_t symbol_count = 0;
+    int status = (texts && lengths && parsed) ? 0 : STATUS_ERROR;
+
+    // Every member must parse, share a word size and export distinct entries
+    for (size_t i = 0; i < count && status == 0; i++) {
+        texts[i] = ReadFile(objects[i], &lengths[i]);
+        char *copy = texts[i] ? strdup(texts[i]) : NULL;
+        if (!copy) {
+            printf("(-) Error: Failed to open object file: %s\n", objects[i]);
+            status = STATUS_ERROR;
+            break;
+        }
+
+        status = ParseObject(objects[i], copy, &parsed[i]);
+        free(copy);
+        if (status == 0 && parsed[i].width != parsed[0].width) {
+            printf("(-) Error: %s is a %d-bit object, %s is %d-bit\n", objects[i], parsed[i].width, objects[0], parsed[0].width);
+            status = STATUS_ERROR;
+        }
+
+        for (size_t j = 0; j < parsed[i].entry_count && status == 0; j++) {
+            status = IndexInsert(&exported, parsed[i].entries[j].name, &parsed[i]);
+            if (status == STATUS_WRONG) {
+                Object *owner = IndexFind(&exported, parsed[i].entries[j].name);
+                printf("(-) Error: Entry label %s is defined in both %s and %s\n", parsed[i].entries[j].name, owner->path, objects[i]);
+            }
+            symbol_count++;
+        }
+    }
+
+    FILE *output_fd = (status == 0) ? fopen(path, "wb") : NULL;
+    if (status == 0 && !output_fd) {
+        printf("(-) Error: Failed to open output file: %s\n", path);
+        status = STATUS_ERROR;
+    }
+
+    if (status == 0) {
+        fprintf(output_fd, "SNA|%d|%zu|%zu\n", parsed[0].width, count, symbol_count);
+
+        long offset = 0;
+        for (size_t i = 0; i < count; i++) {
+            fprintf(output_fd, "M|%s|%ld|%zu\n", BaseName(objects[i]), offset, lengths[i]);
+            offset += (long)lengths[i];
+        }
+        for (size_t i = 0; i < count; i++) {
+            for (size_t j = 0; j < parsed[i].entry_count; j++) {
+                fprintf(output_fd, "S|%s|%zu\n", parsed[i].entries[j].name, i);
+            }
+        }
+        fprintf(output_fd, "---\n");
+
+        for (size_t i = 0; i < count; i++) fwrite(texts[i], 1, lengths[i], output_fd);
+        fclose(output_fd);
+
+        LogInfo("(*) Archived %zu object(s) exporting %zu symbol(s) into %s\n", count, symbol_count, path);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (texts) free(texts[i]);
+        if (parsed) CleanUpObject(&parsed[i]);
+    }
+    CleanUpIndex(&exported);
+    free(texts);
+    free(lengths);
+    free(parsed);
+    return status;
+}
+
+// Reads the index of an archive. Returns 0 upon success, else STATUS_ERROR
+static int ReadArchiveIndex(Archive *archive) {
+    char line[MAX_ARCHIVE_LINE];
+    size_t members = 0, symbols = 0;
+
+    if (!fgets(line, sizeof(line), archive->file) ||
+        sscanf(line, "SNA|%d|%zu|%zu", &archive->width, &members, &symbols) != 3) {
+        printf("(-) Error: %s is not an archive\n", archive->path);
+        return STATUS_ERROR;
+    }
+
+    archive->members = calloc(members + 1, sizeof(ArchiveMember));
+    archive->symbols = calloc(symbols + 1, sizeof(char *));
+    if (!archive->members || !archive->symbols) return STATUS_ERROR;
+
+    while (fgets(line, sizeof(line), archive->file)) {
+        TrimNewline(line);
+        if (strcmp(line, "---") == 0) {
+            archive->data_start = ftell(archive->file);
+            return (archive->member_count == members && archive->symbol_count == symbols) ? 0 : STATUS_ERROR;
+        }
+
+        char *name = line + 2;
+        char *bar = strchr(name, '|');
+        if (strlen(line) < 3 || line[1] != '|' || !bar || bar == name) return STATUS_ERROR;
+        *bar = '\0';
+
+        if (line[0] == 'M' && archive->member_count < members) {
+            ArchiveMember *member = &archive->members[archive->member_count];
+            if (sscanf(bar + 1, "%ld|%zu", &member->offset, &member->length) != 2) return STATUS_ERROR;
+            member->name = strdup(name);
+            if (!member->name) return STATUS_ERROR;
+            archive->member_count++;
+        } else if (line[0] == 'S' && archive->symbol_count < symbols) {
+            size_t owner = 0;
+            if (sscanf(bar + 1, "%zu", &owner) != 1 || owner >= archive->member_count) return STATUS_ERROR;
+            char *symbol = strdup(name);
+            if (!symbol) return STATUS_ERROR;
+            archive->symbols[archive->symbol_count++] = symbol;
+            if (IndexInsert(&archive->index, symbol, &archive->members[owner]) != 0) return STATUS_ERROR;
+        } else {
+            return STATUS_ERROR;
+        }
+    }
+
+    return STATUS_ERROR;  // No end of index
+}
+
+int AddArchive(Link *link, const char *path) {
+    if (!link || !path) return STATUS_ERROR;
+
+    Archive archive = {0};
+    archive.path = strdup(path);
+    archive.file = fopen(path, "rb");
+    if (!archive.path || !archive.file) {
+        printf("(-) Error: Failed to open archive: %s\n", path);
+        CleanUpArchive(&archive);
+        return STATUS_ERROR;
+    }
+
+    if (ReadArchiveIndex(&archive) != 0) {
+        printf("(-) Error: Invalid archive index in %s\n", path);
+        CleanUpArchive(&archive);
+        return STATUS_ERROR;
+    }
+
+    Archive *temp = realloc(link->archives, (link->archive_count + 1) * sizeof(Archive));
+    if (!temp) {
+        CleanUpArchive(&archive);
+        return STATUS_ERROR;
+    }
+    link->archives = temp;
+    link->archives[link->archive_count++] = archive;
+
+    LogVerbose("Read archive %s: %zu member(s), %zu symbol(s)\n", path, archive.member_count, archive.symbol_count);
+    return 0;
+}
+
+// Reads a member out of its archive and appends it to the link
+static int LoadMember(Link *link, Archive *archive, ArchiveMember *member) {
+    char *text = malloc(member->length + 1);
+    if (!text) return STATUS_ERROR;
+
+    if (fseek(archive->file, archive->data_start + member->offset, SEEK_SET) != 0 ||
+        fread(text, 1, member->length, archive->file) != member->length) {
+        printf("(-) Error: Failed to read member %s of %s\n", member->name, archive->path);
+        free(text);
+        return STATUS_ERROR;
+    }
+    text[member->length] = '\0';
+
+    char name[2 * MAX_FILENAME_LENGTH + 3];
+    snprintf(name, sizeof(name), "%s(%s)", archive->path, member->name);
+
+    member->loaded = true;
+    int status = AddObjectText(link, name, text);
+    free(text);
+    return status;
+}
+
+int PullArchiveMembers(Link *link) {
+    if (!link) return STATUS_ERROR;
+
+    // Pulled members are appended, so their own externs are scanned in turn
+    int pulled = 0;
+    for (size_t scanned = 0; scanned < link->count; scanned++) {
+        for (size_t i = 0; i < link->objects[scanned].extern_count; i++) {
+            const char *name = link->objects[scanned].externs[i].name;
+            if (IndexFind(&link->entries, name)) continue;
+
+            for (size_t a = 0; a < link->archive_count; a++) {
+                ArchiveMember *member = IndexFind(&link->archives[a].index, name);
+                if (!member || member->loaded) continue;
+
+                if (LoadMember(link, &link->archives[a], member) != 0) return STATUS_ERROR;
+                LogVerbose("Pulled %s out of %s for %s\n", member->name, link->archives[a].path, name);
+                pulled++;
+                break;
+            }
+        }
+    }
+    return pulled;
+}
+
+void CleanUpArchive(Archive *archive) {
+    if (!archive) return;
+    for (size_t i = 0; i < archive->member_count; i++) free(archive->members[i].name);
+    for (size_t i = 0; i < archive->symbol_count; i++) free(archive->symbols[i]);
+    free(archive->members);
+    free(archive->symbols);
+    free(archive->path);
+    if (archive->file) fclose(archive->file);
+    CleanUpIndex(&archive->index);
+    memset(archive, 0, sizeof(Archive));
+}
@@ -2,9 +2,14 @@
 #include "../include/definitions.h"
 #include "../include/secondpass.h"
 #include "../include/firstpass.h"
+#include "../include/optimizer.h"
+#include "../include/blocks.h"
 #include "../include/encoder.h"
 #include "../include/parser.h"
 #include "../include/io.h"
+#include "../include/debugmap.h"
+#include "../include/listing.h"
+#include "../include/stats.h"
 
 #ifdef _WIN32
 #include <direct.h>   // For _mkdir
@@ -16,8 +21,18 @@
 // Function Prototypes
 void CleanAndExit(char **input_files, size_t files_size);
 int PreAssemble(char **input_files, size_t files_size);
+int Optimize(char **input_files, size_t files_size);
+int CollectGarbage(char **input_files, size_t files_size);
+int LayoutCode(char **input_files, size_t files_size);
 int FirstPass(char **input_files, size_t files_size, Label labels[MAX_LABELS], size_t *label_count);
 int SecondPass(char **input_files, size_t files_size, Label labels[MAX_LABELS], size_t *label_count);
+static int AssembleUnit(char **unit_files, size_t unit_size);
+static void CleanUpLabels(Label labels[MAX_LABELS], size_t label_count);
+static int WriteSymbolFile(Label labels[MAX_LABELS], size_t label_count);
+static int WriteDebugMap(uint32_t data_base);
+static void RemoveOutputs(const char *object_path, const char *listing_path);
+static void AddCounts(StatsCounts *total, const StatsCounts *counts);
+static int ReportStats(const StatsTimer *run_timer);
 
 // Constructs the output path with the given extension
 int GetOutputPath(const char *input_path, char *dst, size_t dst_size, const char *extension) {
@@ -82,30 +97,91 @@ int main(int argc, char **argv) {
         }
     }
 
+    StatsTimer run_timer;
+    if (ASSEMBLER_FLAGS.stats) StatsStart(&run_timer);
+
     LogInfo("--- PROGRAM START ---\n");\
     if (ASSEMBLER_FLAGS.legacy_24_bit) LogVerbose("(*) Using legacy 24-bit assembling process...\n");
     if (ASSEMBLER_FLAGS.show_symbols) LogVerbose("(*) Will print symbol table...\n");
     if (ASSEMBLER_FLAGS.gen_externals) LogVerbose("(*) Will append external usages...\n");
 
+    int status = 0;
+    if (ASSEMBLER_FLAGS.compile_only) {
+        if (ASSEMBLER_FLAGS.output_file && input_count > 1) {
+            printf("(-) Error: -o can't name the objects of several files, each is written to <file>%s\n", LINK_OBJECT_EXTENSION);
+            CleanAndExit(files, input_count);
+            return EXIT_FAILURE;
+        }
+
+        // Each file is its own unit, with its own symbols and addresses
+        for (int i = 0; i < input_count && status == 0; i++) {
+            if (!ASSEMBLER_FLAGS.output_file) output_path = files[i];
+            status = AssembleUnit(&files[i], 1);
+            if (status == 0) LogInfo("(*) Wrote relocatable object for %s\n", files[i]);
+        }
+    } else {
+        status = AssembleUnit(files, input_count);
+    }
+
+    if (ASSEMBLER_FLAGS.stats && ReportStats(&run_timer) != 0) status = STATUS_ERROR;
+
+    // Cleanup
+    CleanAndExit(files, input_count);
+    if (status != 0) return EXIT_FAILURE;
+    LogInfo("--- PROGRAM END ---\n");
+    return EXIT_SUCCESS;
+}
+
+// Assembles one unit: every input of a normal run, or a single file under -c
+static int AssembleUnit(char **unit_files, size_t unit_size) {
+    // Units share the global assembler state, start each from scratch
+    ASSEMBLER_FLAGS.append_to_out = false;
+    ASSEMBLER_FLAGS.start_exists = false;
+    ASSEMBLER_FLAGS.entry_point_exists = false;
+    CleanUpConstants();
+    DebugCleanUp();
+
     // Pre-Assembler Stage
-    if (PreAssemble(files, input_count) != 0) {
-        CleanAndExit(files, input_count);
-        return EXIT_FAILURE;
+    if (PreAssemble(unit_files, unit_size) != 0) {
+        return STATUS_ERROR;
+    }
+
+    StatsTimer timer;
+
+    // Peephole Stage
+    if (ASSEMBLER_FLAGS.stats) StatsStart(&timer);
+    if (ASSEMBLER_FLAGS.optimize && Optimize(unit_files, unit_size) != 0) {
+        return STATUS_ERROR;
     }
+    if (ASSEMBLER_FLAGS.stats && ASSEMBLER_FLAGS.optimize) StatsRecord(&timer, "Optimize", NULL, NULL);
+
+    // Dead Code Stage
+    if (ASSEMBLER_FLAGS.stats) StatsStart(&timer);
+    if (ASSEMBLER_FLAGS.gc_sections && CollectGarbage(unit_files, unit_size) != 0) {
+        return STATUS_ERROR;
+    }
+    if (ASSEMBLER_FLAGS.stats && ASSEMBLER_FLAGS.gc_sections) StatsRecord(&timer, "CollectGarbage", NULL, NULL);
+
+    // Code Layout Stage
+    if (ASSEMBLER_FLAGS.stats) StatsStart(&timer);
+    if (ASSEMBLER_FLAGS.layout_profile && LayoutCode(unit_files, unit_size) != 0) {
+        return STATUS_ERROR;
+    }
+    if (ASSEMBLER_FLAGS.stats && ASSEMBLER_FLAGS.layout_profile) StatsRecord(&timer, "LayoutCode", NULL, NULL);
 
     Label labels[MAX_LABELS] = {0};
     size_t label_count = 0;
 
     // First Pass Stage
-    if (FirstPass(files, input_count, labels, &label_count) != 0) {
-        CleanAndExit(files, input_count);
-        return EXIT_FAILURE;
+    if (FirstPass(unit_files, unit_size, labels, &label_count) != 0) {
+        CleanUpLabels(labels, label_count);
+        return STATUS_ERROR;
     }
 
     // Second Pass Stage
-    if (SecondPass(files, input_count, labels, &label_count) != 0) {
-        CleanAndExit(files, input_count);
-        return EXIT_FAILURE;
+    if (SecondPass(unit_files, unit_size, labels, &label_count) != 0) {
+        CleanUpLabels(labels, label_count);
+        return STATUS_ERROR;
     }
 
     // Display symbol table
@@ -121,12 +197,92 @@ int main(int argc, char **argv) {
                 (labels[i].type == E_CODE) ? "CODE" : "DATA");
             }
         printf("    -----------------------------------------------------------------------\n");
+
+        if (ASSEMBLER_FLAGS.stats) StatsStart(&timer);
+        if (WriteSymbolFile(labels, label_count) != 0) {
+            CleanUpLabels(labels, label_count);
+            return STATUS_ERROR;
+        }
+        if (ASSEMBLER_FLAGS.stats) StatsRecord(&timer, "Output", NULL, NULL);
     }
 
-    // Cleanup
-    CleanAndExit(files, input_count);
-    LogInfo("--- PROGRAM END ---\n");
-    return EXIT_SUCCESS;
+    CleanUpLabels(labels, label_count);
+    DebugCleanUp();
+    return 0;
+}
+
+// Writes the unit's defined labels to a .sns file, for tools that run the program
+static int WriteSymbolFile(Label labels[MAX_LABELS], size_t label_count) {
+    char symbol_path[MAX_FILENAME_LENGTH + MAX_EXTENSION_LENGTH] = {0};
+    if (GetOutputPath(output_path, symbol_path, sizeof(symbol_path), SYMBOL_FILE_EXTENSION) != 0) {
+        printf("(-) Error: could not build %s output path\n", SYMBOL_FILE_EXTENSION);
+        return STATUS_ERROR;
+    }
+
+    FILE *symbol_fd = fopen(symbol_path, "w");
+    if (!symbol_fd) {
+        printf("(-) Error: Failed to open output file: %s\n", symbol_path);
+        return STATUS_ERROR;
+    }
+
+    for (size_t i = 0; i < label_count; i++) {
+        if (labels[i].extr && !labels[i].entr) continue;  // Defined elsewhere
+        fprintf(symbol_fd, "%s|%08zu|%s\n", labels[i].name, labels[i].address, (labels[i].type == E_CODE) ? "CODE" : "DATA");
+    }
+
+    fclose(symbol_fd);
+    LogVerbose("Wrote symbol table to %s\n", symbol_path);
+    return 0;
+}
+
+// Writes the unit's .snd map from addresses to source lines, next to its object
+static int WriteDebugMap(uint32_t data_base) {
+    char map_path[MAX_FILENAME_LENGTH + MAX_EXTENSION_LENGTH + 1] = {0};
+    if (GetOutputPath(output_path, map_path, sizeof(map_path), DEBUG_MAP_EXTENSION) != 0) {
+        printf("(-) Error: could not build %s output path\n", DEBUG_MAP_EXTENSION);
+        return STATUS_ERROR;
+    }
+    if (DebugWrite(map_path, data_base) != 0) {
+        remove(map_path);  // A map cut short would name the wrong lines
+        return STATUS_ERROR;
+    }
+    return 0;
+}
+
+// Removes what a failed second pass has written, so no partial object is left to load or link
+static void RemoveOutputs(const char *object_path, const char *listing_path) {
+    if (object_path[0] && remove(object_path) == 0) LogVerbose("Removed partial output %s\n", object_path);
+    if (listing_path[0] && remove(listing_path) == 0) LogVerbose("Removed partial output %s\n", listing_path);
+}
+
+static void AddCounts(StatsCounts *total, const StatsCounts *counts) {
+    total->lines += counts->lines;
+    total->bytes += counts->bytes;
+    total->words += counts->words;
+    total->symbols += counts->symbols;
+    total->macros += counts->macros;
+}
+
+// Reports the run's statistics, the JSON file is named like the run's output
+static int ReportStats(const StatsTimer *run_timer) {
+    char stats_path[MAX_FILENAME_LENGTH + sizeof(STATS_FILE_EXTENSION)] = {0};
+    const char *prefix = ASSEMBLER_FLAGS.output_file ? ASSEMBLER_FLAGS.output_file : ASSEMBLER_FLAGS.compile_only ? files[0] : "out";
+    if (ASSEMBLER_FLAGS.stats == STATS_JSON && GetOutputPath(prefix, stats_path, sizeof(stats_path), STATS_FILE_EXTENSION) != 0) {
+        printf("(-) Error: could not build %s output path\n", STATS_FILE_EXTENSION);
+        StatsCleanUp();
+        return STATUS_ERROR;
+    }
+    int status = StatsReport(ASSEMBLER_FLAGS.stats, run_timer, stats_path);
+    StatsCleanUp();
+    return status;
+}
+
+// Frees the names of a unit's symbols
+static void CleanUpLabels(Label labels[MAX_LABELS], size_t label_count) {
+    for (size_t i = 0; i < label_count; i++) {
+        free(labels[i].name);
+        labels[i].name = NULL;
+    }
 }
 
 // Free allocated memory
@@ -136,22 +292,20 @@ void CleanAndExit(char **input_files, size_t files_size) {
         if (input_files[i]) free(input_files[i]);
     }
     free(input_files);
+    CleanUpDefines();
+    CleanUpConstants();
 }
 
-// Pre-Assemble: Expands macros and writes an intermediate .am file
+// Pre-Assemble: Expands macros and writes an intermediate .snm file
 int PreAssemble(char **input_files, size_t files_size) {
-    Macro macros[MAX_MACROS];
+    StatsTimer stage_timer, file_timer;
+    StatsCounts stage_counts = {0};
+    if (ASSEMBLER_FLAGS.stats) StatsStart(&stage_timer);
 
     for (size_t i = 0; i < files_size; i++) {
         int status = 0;
         size_t count = 0;
-        memset(macros, 0, sizeof(macros));
-
-        status = ParseMacros(input_files[i], macros, &count);
-        if (status != 0) {
-            printf("(*) Macro parsing for file '%s' failed, Exiting...\n", input_files[i]);
-            return status;
-        }
+        StatsCounts counts = {0};
 
         char write_path[MAX_FILENAME_LENGTH + MAX_EXTENSION_LENGTH] = {0};
         if (GetOutputPath(input_files[i], write_path, sizeof(write_path), EXTENDED_FILE_EXTENSION) != 0) {
@@ -161,22 +315,132 @@ int PreAssemble(char **input_files, size_t files_size) {
 
         LogVerbose("Successfully generated output path!\n");
 
-        status = ExpandMacros(input_files[i], write_path, macros, &count);
+        if (ASSEMBLER_FLAGS.stats) {
+            StatsCountFile(input_files[i], &counts);
+            StatsStart(&file_timer);
+        }
+        status = ExpandMacros(input_files[i], write_path, &count);
         if (status != 0) {
             printf("(*) Macro expanding for file '%s' failed, Exiting...\n", input_files[i]);
+            CleanUpIncludes();
             return status;
         }
+        if (ASSEMBLER_FLAGS.stats) {
+            counts.macros = count;
+            StatsRecord(&file_timer, "PreAssemble", input_files[i], &counts);
+            AddCounts(&stage_counts, &counts);
+        }
 
         LogVerbose("Successfully Pre-Assembled file: %s\n", input_files[i]);
     }
 
+    // Included files are shared between inputs, release them once all are expanded
+    CleanUpIncludes();
+    if (ASSEMBLER_FLAGS.stats) StatsRecord(&stage_timer, "PreAssemble", NULL, &stage_counts);
+
     LogInfo("--- PREASSEMBLE SUCCESS ---\n");
     return 0;
 }
 
+// Optimize: Rewrites the expanded .snm files before any address is assigned
+int Optimize(char **input_files, size_t files_size) {
+    size_t words_saved = 0;
+
+    for (size_t i = 0; i < files_size; i++) {
+        char expanded_path[MAX_FILENAME_LENGTH + MAX_EXTENSION_LENGTH] = {0};
+        if (GetOutputPath(input_files[i], expanded_path, sizeof(expanded_path), EXTENDED_FILE_EXTENSION) != 0) {
+            printf("(-) Error: Failed to get expanded path for %s\n", input_files[i]);
+            return STATUS_ERROR;
+        }
+        if (OptimizeFile(expanded_path, &words_saved) != 0) {
+            printf("(*) Optimizing file '%s' failed, Exiting...\n", input_files[i]);
+            return STATUS_ERROR;
+        }
+    }
+
+    LogInfo("(*) Optimizer saved %zu word(s)\n", words_saved);
+    LogInfo("--- OPTIMIZE SUCCESS ---\n");
+    return 0;
+}
+
+// Collect Garbage: Drops the code and data blocks no root can reach, before any address is assigned
+int CollectGarbage(char **input_files, size_t files_size) {
+    char **paths = calloc(files_size, sizeof(char *));
+    if (!paths) return STATUS_ERROR;
+
+    int status = 0;
+    for (size_t i = 0; i < files_size && status == 0; i++) {
+        paths[i] = malloc(MAX_FILENAME_LENGTH + MAX_EXTENSION_LENGTH);
+        if (!paths[i] || GetOutputPath(input_files[i], paths[i], MAX_FILENAME_LENGTH + MAX_EXTENSION_LENGTH, EXTENDED_FILE_EXTENSION) != 0) {
+            printf("(-) Error: Failed to get expanded path for %s\n", input_files[i]);
+            status = STATUS_ERROR;
+        }
+    }
+
+    BlockGraph graph = {0};
+    if (status == 0) status = LoadBlocks(paths, files_size, &graph);
+    if (status == 0) {
+        size_t live = MarkLiveBlocks(&graph);
+        status = WriteLiveBlocks(&graph);
+
+        LogInfo("(*) Removed %zu of %zu code/data block(s) nothing refers to\n", graph.count - live, graph.count);
+        for (size_t i = 0; i < graph.count; i++) {
+            if (!graph.blocks[i].live) LogVerbose("Removed unreferenced %s block %s\n",
+                (graph.blocks[i].kind == BLOCK_CODE) ? "code" : "data",
+                graph.blocks[i].label ? graph.blocks[i].label : "(unlabeled)");
+        }
+    }
+    CleanUpBlocks(&graph);
+
+    for (size_t i = 0; i < files_size; i++) free(paths[i]);
+    free(paths);
+
+    if (status == 0) LogInfo("--- GC SECTIONS SUCCESS ---\n");
+    return status;
+}
+
+// Layout Code: Orders the code blocks by a profile of earlier runs, before any address is assigned
+int LayoutCode(char **input_files, size_t files_size) {
+    char **paths = calloc(files_size, sizeof(char *));
+    if (!paths) return STATUS_ERROR;
+
+    int status = 0;
+    for (size_t i = 0; i < files_size && status == 0; i++) {
+        paths[i] = malloc(MAX_FILENAME_LENGTH + MAX_EXTENSION_LENGTH);
+        if (!paths[i] || GetOutputPath(input_files[i], paths[i], MAX_FILENAME_LENGTH + MAX_EXTENSION_LENGTH, EXTENDED_FILE_EXTENSION) != 0) {
+            printf("(-) Error: Failed to get expanded path for %s\n", input_files[i]);
+            status = STATUS_ERROR;
+        }
+    }
+
+    BlockGraph graph = {0};
+    if (status == 0) status = LoadBlocks(paths, files_size, &graph);
+    int found = (status == 0) ? LoadBlockHeat(&graph, ASSEMBLER_FLAGS.layout_profile) : STATUS_ERROR;
+    if (found < 0) status = STATUS_ERROR;
+
+    size_t flipped = 0;
+    if (status == 0) status = WriteHotLayout(&graph, VALUE_WIDTH, &flipped);
+    if (status == 0) {
+        LogInfo("(*) Laid out code by %s: %d profiled block(s), %zu branch(es) inverted\n", ASSEMBLER_FLAGS.layout_profile, found, flipped);
+        if (found == 0) printf("(*) Warning: No label of %s is in the code, layout unchanged\n", ASSEMBLER_FLAGS.layout_profile);
+    }
+    CleanUpBlocks(&graph);
+
+    for (size_t i = 0; i < files_size; i++) free(paths[i]);
+    free(paths);
+
+    if (status == 0) LogInfo("--- LAYOUT SUCCESS ---\n");
+    return status;
+}
+
 // First Pass: Builds symbol table and creates .ent file
 int FirstPass(char **input_files, size_t files_size, Label labels[MAX_LABELS], size_t *label_count) {
+    StatsTimer stage_timer, file_timer;
+    StatsCounts stage_counts = {0};
+    if (ASSEMBLER_FLAGS.stats) StatsStart(&stage_timer);
+
     IC = 100;
+    DC = 0;
     LogDebug("Starting address params: IC = %u | DC = %u\n", IC, DC);
 
     for (size_t i = 0; i < files_size; i++) {
@@ -185,15 +449,35 @@ int FirstPass(char **input_files, size_t files_size, Label labels[MAX_LABELS], s
             printf("(-) Error: Failed to get expanded path for %s\n", input_files[i]);
             return STATUS_ERROR;
         }
+        StatsCounts counts = {0};
+        size_t labels_before = *label_count;
+        if (ASSEMBLER_FLAGS.stats) {
+            StatsCountFile(expanded_path, &counts);
+            StatsStart(&file_timer);
+        }
         int status = BuildSymbolTable(expanded_path, labels, label_count);
         if (status != 0) {
             printf("(*) Symbol compilation for file '%s' failed, Exiting...\n", input_files[i]);
             return status;
         }
+        if (ASSEMBLER_FLAGS.stats) {
+            counts.symbols = *label_count - labels_before;
+            StatsRecord(&file_timer, "FirstPass", input_files[i], &counts);
+            AddCounts(&stage_counts, &counts);
+        }
         LogVerbose("Successfully Pre-Assembled file: %s\n", input_files[i]);
     }
 
     ICF = IC;
+    if (ASSEMBLER_FLAGS.pool_data) {
+        int pooled = PoolFinalize(labels, label_count);
+        if (pooled < 0) {
+            printf("(-) Error: Failed to lay out the data pool!\n");
+            return STATUS_ERROR;
+        }
+        DC = (uint32_t)pooled;
+    }
+    DC += LiteralPlace(ICF + DC);
     int symbol_status = ValidateSymbolTable(labels, label_count); 
     if (symbol_status > 0) {
         LogDebug("Warning: Found %u warnings in symbol validation, will re-check in second pass...\n", symbol_status);
@@ -205,12 +489,18 @@ int FirstPass(char **input_files, size_t files_size, Label labels[MAX_LABELS], s
         return STATUS_ERROR;
     }
 
+    if (ASSEMBLER_FLAGS.stats) StatsRecord(&stage_timer, "FirstPass", NULL, &stage_counts);
     LogInfo("--- FIRST PASS SUCCESS ---\n");
     LogVerbose("Current address params IC = %u , DC = %u\n", IC, DC);
     return 0;
 }
 
 int SecondPass(char **input_files, size_t files_size, Label labels[MAX_LABELS], size_t *label_count) {
+    StatsTimer stage_timer, file_timer;
+    StatsCounts stage_counts = {0};
+    if (ASSEMBLER_FLAGS.stats) StatsStart(&stage_timer);
+
+    curr_address = 100;
 
     // Data segment
     uint32_t *data_segment = calloc(DCF+1, sizeof(uint32_t));
@@ -220,9 +510,10 @@ int SecondPass(char **input_files, size_t files_size, Label labels[MAX_LABELS],
     char extern_path[MAX_FILENAME_LENGTH + MAX_EXTENSION_LENGTH] = {0};
     char entry_path[MAX_FILENAME_LENGTH + MAX_EXTENSION_LENGTH]  = {0};
 
-    // Create .sno output path
-    if (GetOutputPath(output_path, write_path, sizeof(write_path), OBJECT_FILE_EXTENSION) != 0) {
-        printf("(-) Error: could not build .sno output path\n");
+    // Create .sno output path, or the .snl object of a -c unit
+    const char *object_extension = ASSEMBLER_FLAGS.compile_only ? LINK_OBJECT_EXTENSION : OBJECT_FILE_EXTENSION;
+    if (GetOutputPath(output_path, write_path, sizeof(write_path), object_extension) != 0) {
+        printf("(-) Error: could not build %s output path\n", object_extension);
         return STATUS_ERROR;
     }
     // Create .snext output path
@@ -238,6 +529,15 @@ int SecondPass(char **input_files, size_t files_size, Label labels[MAX_LABELS],
 
     LogVerbose("Successfully generated output paths!\n");
 
+    char listing_path[MAX_FILENAME_LENGTH + MAX_EXTENSION_LENGTH + 1] = {0};
+    if (ASSEMBLER_FLAGS.listing) {
+        if (GetOutputPath(output_path, listing_path, sizeof(listing_path), LISTING_FILE_EXTENSION) != 0) {
+            printf("(-) Error: could not build %s output path\n", LISTING_FILE_EXTENSION);
+            return STATUS_ERROR;
+        }
+        if (ListingOpen(listing_path, write_path) != 0) return STATUS_ERROR;
+    }
+
     int data_addr = 0;
     for (size_t i = 0; i < files_size; i++) {
         char expanded_path[MAX_FILENAME_LENGTH + MAX_EXTENSION_LENGTH] = {0};
@@ -248,21 +548,69 @@ int SecondPass(char **input_files, size_t files_size, Label labels[MAX_LABELS],
             return STATUS_ERROR;
         }
 
+        StatsCounts counts = {0};
+        uint32_t words_before = (uint32_t)data_addr + data_segment[0];
+        if (ASSEMBLER_FLAGS.stats) {
+            StatsCountFile(expanded_path, &counts);
+            StatsStart(&file_timer);
+        }
         int status = EncodeFile(expanded_path, write_path, labels, label_count, data_segment, ICF, DCF);
         if (status < 0) {
             printf("(*) Object encoding for file '%s' failed, Exiting...\n", input_files[i]);
+            ListingClose();
+            RemoveOutputs(write_path, listing_path);
+            free(data_segment);
             return status;
         }
         data_addr = status;
+        if (ASSEMBLER_FLAGS.stats) {
+            counts.words = (uint32_t)data_addr + data_segment[0] - words_before;
+            StatsRecord(&file_timer, "SecondPass", input_files[i], &counts);
+            AddCounts(&stage_counts, &counts);
+        }
+    }
+    StatsTimer output_timer;
+    if (ASSEMBLER_FLAGS.stats) {
+        StatsRecord(&stage_timer, "SecondPass", NULL, &stage_counts);
+        StatsStart(&output_timer);
+    }
+
+    // Pooled data and literals have no single statement to come from
+    if (ASSEMBLER_FLAGS.debug_map) {
+        DebugSetOrigin((DebugOrigin){0});
+        DebugMarkData(data_segment[0]);
+    }
+    uint32_t pooled = data_segment[0];
+    if (ASSEMBLER_FLAGS.pool_data) PoolEmit(data_segment);
+    LiteralEmit(data_segment);
+    uint32_t pooled_words = data_segment[0] - pooled;
+    if (ASSEMBLER_FLAGS.listing && data_segment[0] > pooled) {
+        ListingSection("Pooled data and literals");
+        for (uint32_t i = pooled; i < data_segment[0]; i++) ListingData(ICF + i - 1, data_segment[i]);
+    }
+
+    if (ListingClose() != 0) {
+        printf("(-) Error: Failed to write the listing of %s\n", write_path);
+        RemoveOutputs(write_path, listing_path);
+        free(data_segment);
+        return STATUS_ERROR;
     }
 
     FILE *output_fd = fopen(write_path, "a");
     if (!output_fd) {
         printf("(-) Error: could not open output path!\n");
+        RemoveOutputs(write_path, listing_path);
+        free(data_segment);
         return STATUS_ERROR;
     }
 
     data_addr += 100;
+    if (ASSEMBLER_FLAGS.debug_map && WriteDebugMap((uint32_t)data_addr) != 0) {
+        fclose(output_fd);
+        RemoveOutputs(write_path, listing_path);
+        free(data_segment);
+        return STATUS_ERROR;
+    }
     for (uint32_t i = 1; i < data_segment[0]; i++) {
         fprintf(output_fd, "%08u : ", data_addr++);
         WordToHex(output_fd, data_segment[i]);
@@ -275,8 +623,9 @@ int SecondPass(char **input_files, size_t files_size, Label labels[MAX_LABELS],
     // Re-check symbol table
     for (size_t i = 0; i < *label_count; i++) {
         if (labels[i].extr && !labels[i].entr) {
-            printf("(*) Warning: Extern label %s was declared but never defined!\n", labels[i].name);
-            if (ASSEMBLER_FLAGS.gen_externals) {
+            // Objects leave their externs for the linker to resolve
+            if (!ASSEMBLER_FLAGS.compile_only) printf("(*) Warning: Extern label %s was declared but never defined!\n", labels[i].name);
+            if (ASSEMBLER_FLAGS.gen_externals || ASSEMBLER_FLAGS.compile_only) {
                 for (uint8_t j = 0; j < labels[i].use_count; j++) {
                     fprintf(output_fd, "X|%s|%08u\n", labels[i].name, labels[i].used_at[j]);
                     LogDebug("Appended external usage at %u to output!\n", labels[i].used_at[j]);
@@ -293,8 +642,19 @@ int SecondPass(char **input_files, size_t files_size, Label labels[MAX_LABELS],
         }
     }
     
+    if (ASSEMBLER_FLAGS.compile_only) RelocWrite(output_fd, ICF);
+
     LogInfo("--- SECOND PASS SUCCESS ---\n");
+    RelocCleanUp();
+    PoolCleanUp();
     free(data_segment);
     fclose(output_fd);
+
+    // Output counts what the object file ends up holding, and the pooled words it added
+    if (ASSEMBLER_FLAGS.stats) {
+        StatsCounts counts = { .words = pooled_words };
+        StatsCountFile(write_path, &counts);
+        StatsRecord(&output_timer, "Output", NULL, &counts);
+    }
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,623 @@
+#include "../include/blocks.h"
+
+#define IS_NAME_START(c) (isalpha((unsigned char)(c)) || (c) == '_')
+#define IS_NAME_CHAR(c)  (isalnum((unsigned char)(c)) || (c) == '_')
+
+// The statement of a line, past its label (if any)
+typedef struct s_line_info {
+    const char *label;
+    size_t      label_length;
+    const char *body;           // First word of the statement
+    size_t      body_length;    // Up to the comment
+} LineInfo;
+
+static void SplitLine(const char *line, const char *end, LineInfo *info) {
+    memset(info, 0, sizeof(*info));
+
+    const char *comment = memchr(line, COMMENT_DELIM, end - line);
+    if (comment) end = comment;
+    while (end > line && isspace((unsigned char)end[-1])) end--;
+
+    const char *p = line;
+    while (p < end && isspace((unsigned char)*p)) p++;
+
+    const char *colon = memchr(p, LABEL_DELIM, end - p);
+    if (colon) {
+        info->label = p;
+        info->label_length = colon - p;
+        p = colon + 1;
+        while (p < end && isspace((unsigned char)*p)) p++;
+    }
+
+    info->body = p;
+    info->body_length = end - p;
+}
+
+static bool StartsWithWord(const LineInfo *info, const char *word) {
+    size_t len = strlen(word);
+    return info->body_length >= len && strncmp(info->body, word, len) == 0
+        && (info->body_length == len || isspace((unsigned char)info->body[len]));
+}
+
+static bool IsDataLine(const LineInfo *info) {
+    return StartsWithWord(info, IDATA) || StartsWithWord(info, ISTRING);
+}
+
+// Returns the command of an instruction line, or NULL
+static const Command *LineCommand(const LineInfo *info) {
+    char mnemonic[MAX_MNEMONIC_LENGTH + 1] = {0};
+    size_t len = 0;
+    while (len < info->body_length && !isspace((unsigned char)info->body[len])) len++;
+    if (len == 0 || len > MAX_MNEMONIC_LENGTH) return NULL;
+
+    memcpy(mnemonic, info->body, len);
+    return FindCommand(mnemonic);
+}
+
+static int AddRef(Block *block, const char *name, size_t name_length) {
+    for (size_t i = 0; i < block->ref_count; i++) {
+        if (strlen(block->refs[i]) == name_length && strncmp(block->refs[i], name, name_length) == 0) return 0;
+    }
+
+    if (block->ref_count == block->ref_capacity) {
+        size_t new_capacity = (block->ref_capacity == 0) ? 4 : block->ref_capacity * 2;
+        char **temp = realloc(block->refs, new_capacity * sizeof(char *));
+        if (!temp) return STATUS_ERROR;
+        block->refs = temp;
+        block->ref_capacity = new_capacity;
+    }
+
+    block->refs[block->ref_count] = strndup(name, name_length);
+    if (!block->refs[block->ref_count]) return STATUS_ERROR;
+    block->ref_count++;
+    return 0;
+}
+
+// Records every name in the operands of a statement, numbers are skipped whole
+static int ScanRefs(Block *block, const LineInfo *info) {
+    if (StartsWithWord(info, ISTRING)) return 0;
+
+    const char *p = info->body;
+    const char *end = info->body + info->body_length;
+    while (p < end && !isspace((unsigned char)*p)) p++;  // Mnemonic or directive
+
+    while (p < end) {
+        if (IS_NAME_START(*p)) {
+            const char *name = p;
+            while (p < end && IS_NAME_CHAR(*p)) p++;
+            if (AddRef(block, name, p - name) != 0) return STATUS_ERROR;
+        } else if (isdigit((unsigned char)*p)) {
+            while (p < end && IS_NAME_CHAR(*p)) p++;
+        } else {
+            p++;
+        }
+    }
+    return 0;
+}
+
+static size_t NewBlock(BlockGraph *graph, const LineInfo *info, BlockKind kind, size_t file) {
+    if (graph->count == graph->capacity) {
+        size_t new_capacity = (graph->capacity == 0) ? 32 : graph->capacity * 2;
+        Block *temp = realloc(graph->blocks, new_capacity * sizeof(Block));
+        if (!temp) return NO_BLOCK;
+        graph->blocks = temp;
+        graph->capacity = new_capacity;
+    }
+
+    Block *block = &graph->blocks[graph->count];
+    memset(block, 0, sizeof(*block));
+    block->kind = kind;
+    block->file = file;
+    block->falls_through = true;
+    if (info && info->label) {
+        block->label = strndup(info->label, info->label_length);
+        if (!block->label) return NO_BLOCK;
+    }
+    return graph->count++;
+}
+
+static int AddEntry(BlockGraph *graph, const LineInfo *info) {
+    const char *name = info->body + strlen(IENTRY);
+    const char *end = info->body + info->body_length;
+    while (name < end && isspace((unsigned char)*name)) name++;
+    if (name == end) return 0;  // Reported by the first pass
+
+    char **temp = realloc(graph->entries, (graph->entry_count + 1) * sizeof(char *));
+    if (!temp) return STATUS_ERROR;
+    graph->entries = temp;
+    graph->entries[graph->entry_count] = strndup(name, end - name);
+    if (!graph->entries[graph->entry_count]) return STATUS_ERROR;
+    graph->entry_count++;
+    return 0;
+}
+
+// Splits one file into lines and assigns each line to a block
+static int SplitFile(BlockGraph *graph, size_t file_index, size_t *code) {
+    BlockFile *file = &graph->files[file_index];
+    size_t length = strlen(file->source);
+
+    size_t line_count = 0;
+    for (size_t i = 0; i < length; i++) line_count += (file->source[i] == '\n');
+    if (length > 0 && file->source[length - 1] != '\n') line_count++;
+
+    file->lines = malloc((line_count + 1) * sizeof(char *));
+    file->owner = malloc((line_count + 1) * sizeof(size_t));
+    if (!file->lines || !file->owner) return STATUS_ERROR;
+
+    for (const char *p = file->source; p < file->source + length; ) {
+        file->lines[file->line_count++] = p;
+        const char *newline = memchr(p, '\n', file->source + length - p);
+        p = newline ? newline + 1 : file->source + length;
+    }
+    file->lines[file->line_count] = file->source + length;
+
+    // Code continues across files, data of each file starts on its own
+    size_t data = NO_BLOCK;
+
+    for (size_t i = 0; i < file->line_count; i++) {
+        LineInfo info;
+        SplitLine(file->lines[i], file->lines[i + 1], &info);
+        file->owner[i] = NO_BLOCK;
+
+        if (StartsWithWord(&info, IENTRY)) {
+            if (AddEntry(graph, &info) != 0) return STATUS_ERROR;
+            continue;
+        }
+
+        // A repeated body goes to one block, by whether it holds any instruction
+        if (IsRepeatStart(file->lines[i])) {
+            size_t last = i + 1;
+            bool has_code = false;
+            while (last < file->line_count && !IsRepeatEnd(file->lines[last])) {
+                LineInfo body;
+                SplitLine(file->lines[last], file->lines[last + 1], &body);
+                if (LineCommand(&body)) has_code = true;
+                last++;
+            }
+
+            size_t *current = has_code ? code : &data;
+            if (*current == NO_BLOCK) *current = NewBlock(graph, NULL, has_code ? BLOCK_CODE : BLOCK_DATA, file_index);
+            if (*current == NO_BLOCK) return STATUS_ERROR;
+
+            for (size_t j = i; j <= last && j < file->line_count; j++) {
+                LineInfo body;
+                SplitLine(file->lines[j], file->lines[j + 1], &body);
+                file->owner[j] = *current;
+                if (ScanRefs(&graph->blocks[*current], &body) != 0) return STATUS_ERROR;
+
+                const Command *command = LineCommand(&body);
+                if (command) {
+                    graph->blocks[*current].falls_through = !(strcmp(command->name, "jmp") == 0
+                        || strcmp(command->name, "rts") == 0 || strcmp(command->name, "stop") == 0);
+                }
+            }
+            i = last;
+            continue;
+        }
+
+        const Command *command = LineCommand(&info);
+        bool is_data = IsDataLine(&info);
+        if (!command && !is_data) continue;  // Directives, comments, empty lines
+
+        size_t *current = is_data ? &data : code;
+        if (info.label || *current == NO_BLOCK) {
+            *current = NewBlock(graph, &info, is_data ? BLOCK_DATA : BLOCK_CODE, file_index);
+            if (*current == NO_BLOCK) return STATUS_ERROR;
+        }
+
+        Block *block = &graph->blocks[*current];
+        file->owner[i] = *current;
+        if (ScanRefs(block, &info) != 0) return STATUS_ERROR;
+
+        if (command) {
+            block->falls_through = !(strcmp(command->name, "jmp") == 0
+                || strcmp(command->name, "rts") == 0 || strcmp(command->name, "stop") == 0);
+        }
+    }
+    return 0;
+}
+
+int LoadBlocks(char **paths, size_t path_count, BlockGraph *graph) {
+    if (!paths || !graph) return STATUS_ERROR;
+    memset(graph, 0, sizeof(*graph));
+
+    graph->files = calloc(path_count, sizeof(BlockFile));
+    if (!graph->files) return STATUS_ERROR;
+
+    size_t code = NO_BLOCK;
+    for (size_t i = 0; i < path_count; i++) {
+        BlockFile *file = &graph->files[graph->file_count++];
+        file->path = strdup(paths[i]);
+        file->source = ReadFile(paths[i], NULL);
+        if (!file->path || !file->source) {
+            printf("(-) Error: Failed to read %s\n", paths[i]);
+            return STATUS_ERROR;
+        }
+        if (SplitFile(graph, i, &code) != 0) {
+            printf("(-) Error: Failed to split %s into blocks\n", paths[i]);
+            return STATUS_ERROR;
+        }
+    }
+    return 0;
+}
+
+Block *FindBlock(BlockGraph *graph, const char *label, size_t label_length) {
+    for (size_t i = 0; i < graph->count; i++) {
+        Block *block = &graph->blocks[i];
+        if (block->label && strlen(block->label) == label_length
+            && strncmp(block->label, label, label_length) == 0) return block;
+    }
+    return NULL;
+}
+
+size_t MarkLiveBlocks(BlockGraph *graph) {
+    size_t *stack = malloc((graph->count + 1) * sizeof(size_t));
+    if (!stack) {
+        // Without a work list keep everything
+        for (size_t i = 0; i < graph->count; i++) graph->blocks[i].live = true;
+        return graph->count;
+    }
+    size_t top = 0;
+    size_t live = 0;
+
+#define MARK(index) do { \
+        if (!graph->blocks[(index)].live) { \
+            graph->blocks[(index)].live = true; \
+            stack[top++] = (index); \
+            live++; \
+        } \
+    } while (0)
+
+    // Roots
+    bool first_code = true;
+    for (size_t i = 0; i < graph->count; i++) {
+        Block *block = &graph->blocks[i];
+        if (block->kind == BLOCK_CODE && first_code) {
+            first_code = false;
+            MARK(i);
+        } else if (block->kind == BLOCK_DATA && !block->label) {
+            MARK(i);
+        } else if (block->label && strcmp(block->label, "START") == 0) {
+            MARK(i);
+        }
+    }
+    for (size_t i = 0; i < graph->entry_count; i++) {
+        Block *block = FindBlock(graph, graph->entries[i], strlen(graph->entries[i]));
+        if (block) MARK((size_t)(block - graph->blocks));
+    }
+
+    while (top > 0) {
+        size_t index = stack[--top];
+        Block *block = &graph->blocks[index];
+
+        for (size_t r = 0; r < block->ref_count; r++) {
+            Block *target = FindBlock(graph, block->refs[r], strlen(block->refs[r]));
+            if (target) MARK((size_t)(target - graph->blocks));
+        }
+
+        // The next code block in program order
+        if (block->kind == BLOCK_CODE && block->falls_through) {
+            for (size_t next = index + 1; next < graph->count; next++) {
+                if (graph->blocks[next].kind != BLOCK_CODE) continue;
+                MARK(next);
+                break;
+            }
+        }
+    }
+
+#undef MARK
+
+    free(stack);
+    return live;
+}
+
+int WriteLiveBlocks(BlockGraph *graph) {
+    for (size_t f = 0; f < graph->file_count; f++) {
+        BlockFile *file = &graph->files[f];
+
+        FILE *output_fd = fopen(file->path, "w");
+        if (!output_fd) {
+            printf("(-) Error: Failed to rewrite %s\n", file->path);
+            return STATUS_ERROR;
+        }
+
+        for (size_t i = 0; i < file->line_count; i++) {
+            if (file->owner[i] != NO_BLOCK && !graph->blocks[file->owner[i]].live) continue;
+            fwrite(file->lines[i], 1, file->lines[i + 1] - file->lines[i], output_fd);
+        }
+        fclose(output_fd);
+    }
+    return 0;
+}
+
+int LoadBlockHeat(BlockGraph *graph, const char *profile_path) {
+    LineReader reader;
+    if (!graph || !profile_path || LineReaderOpen(&reader, profile_path) != 0) {
+        printf("(-) Error: Failed to open layout profile: %s\n", profile_path ? profile_path : "(none)");
+        return STATUS_ERROR;
+    }
+
+    int found = 0;
+    bool flat = false;
+    char *line = NULL;
+    while ((line = ReadLine(&reader)) != NULL) {
+        TrimNewline(line);
+        if (strncmp(line, "Flat profile of ", 16) == 0) {
+            flat = true;
+            continue;
+        }
+        if (strncmp(line, "Call graph", 10) == 0) break;
+
+        // %, instructions, cycles, branches, taken, calls, label
+        double percent = 0;
+        unsigned long long instructions = 0;
+        char name[MAX_LABEL_NAME + 1] = {0};
+        if (!flat || sscanf(line, "%lf%% %llu %*s %*s %*s %*s %31s", &percent, &instructions, name) != 3) continue;
+
+        Block *block = FindBlock(graph, name, strlen(name));
+        if (block && block->kind == BLOCK_CODE) {
+            block->heat += instructions;
+            found++;
+        }
+    }
+    LineReaderClose(&reader);
+
+    if (!flat) {
+        printf("(-) Error: %s is not a flat profile written by snvm -p\n", profile_path);
+        return STATUS_ERROR;
+    }
+    return found;
+}
+
+// The code blocks of one file, linked into chains of blocks falling through to each other
+typedef struct s_layout {
+    size_t   *blocks;       // Graph index of each of the file's code blocks, in program order
+    size_t    count;
+    size_t   *next;         // Block placed right after, NO_BLOCK if none has to be
+    size_t   *prev;
+    size_t   *first_line;   // First line of each block, lines of a block are linked by next_line
+    size_t   *next_line;
+    size_t   *last_line;
+    char    **rewritten;    // Replacement text of each line, NULL to keep it
+} Layout;
+
+static bool ChainReaches(const Layout *layout, size_t from, size_t to) {
+    for (size_t k = from; k != NO_BLOCK; k = layout->next[k]) {
+        if (k == to) return true;
+    }
+    return false;
+}
+
+static size_t ChainHead(const Layout *layout, size_t k) {
+    while (layout->prev[k] != NO_BLOCK) k = layout->prev[k];
+    return k;
+}
+
+/*
+ * Inverts the conditional branch ending block k, when its target is hotter
+ * than the block falling through after it and can take that place.
+ * Returns true if the branch was inverted
+ */
+static bool FlipBranch(BlockGraph *graph, BlockFile *file, Layout *layout, size_t k, bool relative_reach, bool pinned_last) {
+    size_t line = layout->last_line[k];
+    if (line == NO_BLOCK || layout->next[k] != k + 1) return false;
+
+    LineInfo info;
+    SplitLine(file->lines[line], file->lines[line + 1], &info);
+    const Command *command = LineCommand(&info);
+    if (!command || (strcmp(command->name, "bne") != 0 && strcmp(command->name, "beq") != 0)) return false;
+
+    // A single label operand, direct or relative
+    const char *p = info.body + strlen(command->name);
+    const char *end = info.body + info.body_length;
+    while (p < end && isspace((unsigned char)*p)) p++;
+    bool relative = (p < end && *p == '&');
+    if (relative) p++;
+    const char *name = p;
+    while (p < end && IS_NAME_CHAR(*p)) p++;
+    if (p == name || p != end || !IS_NAME_START(*name)) return false;
+    if (relative && !relative_reach) return false;
+
+    Block *target = FindBlock(graph, name, p - name);
+    Block *fall = &graph->blocks[layout->blocks[k + 1]];
+    if (!target || target->kind != BLOCK_CODE || !fall->label || target->heat <= fall->heat) return false;
+
+    size_t x = NO_BLOCK;
+    for (size_t i = 0; i < layout->count; i++) {
+        if (&graph->blocks[layout->blocks[i]] == target) x = i;
+    }
+
+    // The target must start a chain of this file that may follow k: not the first
+    // one, which stays first, nor one that would close a loop or join the first
+    // chain to the one that has to stay last
+    if (x == NO_BLOCK || x == 0 || x == k + 1 || layout->prev[x] != NO_BLOCK) return false;
+    if (ChainReaches(layout, x, k)) return false;
+    if (pinned_last && ChainHead(layout, k) == 0 && ChainReaches(layout, x, layout->count - 1)) return false;
+
+    // The comment is kept, it may carry the line's debug map marker
+    const char *inverted = (strcmp(command->name, "bne") == 0) ? "beq" : "bne";
+    size_t prefix = (size_t)(info.body - file->lines[line]);
+    const char *line_end = file->lines[line + 1];
+    while (line_end > file->lines[line] && (line_end[-1] == '\n' || line_end[-1] == '\r')) line_end--;
+    const char *comment = memchr(file->lines[line], COMMENT_DELIM, line_end - file->lines[line]);
+    size_t comment_length = comment ? (size_t)(line_end - comment) : 0;
+    size_t length = prefix + strlen(inverted) + strlen(fall->label) + comment_length + 5;
+    char *text = malloc(length);
+    if (!text) return false;
+    snprintf(text, length, "%.*s%s %s%s%s%.*s\n", (int)prefix, file->lines[line], inverted, relative ? "&" : "", fall->label,
+        comment ? " " : "", (int)comment_length, comment ? comment : "");
+
+    LogVerbose("Inverted %.*s to fall through to %s, %s is reached by the branch\n",
+        (int)info.body_length, info.body, target->label, fall->label);
+    free(layout->rewritten[line]);
+    layout->rewritten[line] = text;
+    layout->prev[k + 1] = NO_BLOCK;
+    layout->next[k] = x;
+    layout->prev[x] = k;
+    return true;
+}
+
+static uint64_t ChainHeat(const BlockGraph *graph, const Layout *layout, size_t head) {
+    uint64_t heat = 0;
+    for (size_t k = head; k != NO_BLOCK; k = layout->next[k]) heat += graph->blocks[layout->blocks[k]].heat;
+    return heat;
+}
+
+// Orders the code of one file and rewrites it
+static int LayoutFile(BlockGraph *graph, size_t f, bool relative_reach, size_t *flipped) {
+    BlockFile *file = &graph->files[f];
+    Layout layout = {0};
+    int status = 0;
+
+    for (size_t i = 0; i < graph->count; i++) {
+        if (graph->blocks[i].kind == BLOCK_CODE && graph->blocks[i].file == f) layout.count++;
+    }
+    if (layout.count < 2) return 0;
+
+    layout.blocks = malloc(layout.count * sizeof(size_t));
+    layout.next = malloc(layout.count * sizeof(size_t));
+    layout.prev = malloc(layout.count * sizeof(size_t));
+    layout.first_line = malloc(layout.count * sizeof(size_t));
+    layout.last_line = malloc(layout.count * sizeof(size_t));
+    layout.next_line = malloc((file->line_count + 1) * sizeof(size_t));
+    layout.rewritten = calloc(file->line_count + 1, sizeof(char *));
+    size_t *order = malloc(layout.count * sizeof(size_t));
+    size_t *local = malloc(graph->count * sizeof(size_t));
+    if (!layout.blocks || !layout.next || !layout.prev || !layout.first_line || !layout.last_line ||
+        !layout.next_line || !layout.rewritten || !order || !local) status = STATUS_ERROR;
+
+    for (size_t i = 0, k = 0; status == 0 && i < graph->count; i++) {
+        local[i] = NO_BLOCK;
+        if (graph->blocks[i].kind != BLOCK_CODE || graph->blocks[i].file != f) continue;
+        local[i] = k;
+        layout.blocks[k] = i;
+        layout.next[k] = layout.prev[k] = NO_BLOCK;
+        layout.first_line[k] = layout.last_line[k] = NO_BLOCK;
+        k++;
+    }
+
+    for (size_t i = 0; status == 0 && i < file->line_count; i++) {
+        layout.next_line[i] = NO_BLOCK;
+        size_t k = (file->owner[i] != NO_BLOCK) ? local[file->owner[i]] : NO_BLOCK;
+        if (k == NO_BLOCK) continue;
+        if (layout.first_line[k] == NO_BLOCK) layout.first_line[k] = i;
+        else layout.next_line[layout.last_line[k]] = i;
+        layout.last_line[k] = i;
+    }
+
+    // Code runs on into the next file, so the file's first block stays first and a
+    // last block falling through stays last
+    bool pinned_last = false;
+    for (size_t k = 0; status == 0 && k < layout.count; k++) {
+        if (!graph->blocks[layout.blocks[k]].falls_through) continue;
+        if (k + 1 < layout.count) {
+            layout.next[k] = k + 1;
+            layout.prev[k + 1] = k;
+        } else {
+            pinned_last = true;
+        }
+    }
+
+    for (size_t k = 0; status == 0 && k + 1 < layout.count; k++) {
+        if (FlipBranch(graph, file, &layout, k, relative_reach, pinned_last)) (*flipped)++;
+    }
+
+    // Chains by heat, hottest first and cold ones in their original order
+    size_t chains = 0;
+    size_t last = (status == 0 && pinned_last) ? ChainHead(&layout, layout.count - 1) : NO_BLOCK;
+    for (size_t k = 1; status == 0 && k < layout.count; k++) {
+        if (layout.prev[k] != NO_BLOCK || k == last) continue;
+        uint64_t heat = ChainHeat(graph, &layout, k);
+        size_t at = chains++;
+        while (at > 0 && ChainHeat(graph, &layout, order[at - 1]) < heat) {
+            order[at] = order[at - 1];
+            at--;
+        }
+        order[at] = k;
+    }
+
+    FILE *output_fd = (status == 0) ? fopen(file->path, "w") : NULL;
+    if (status == 0 && !output_fd) {
+        printf("(-) Error: Failed to rewrite %s\n", file->path);
+        status = STATUS_ERROR;
+    }
+
+    if (status == 0) {
+        // Directives and data keep their order, the code follows them chain by chain
+        for (size_t i = 0; i < file->line_count; i++) {
+            if (file->owner[i] != NO_BLOCK && local[file->owner[i]] != NO_BLOCK) continue;
+            fwrite(file->lines[i], 1, file->lines[i + 1] - file->lines[i], output_fd);
+        }
+
+        for (size_t c = 0; c < chains + 2; c++) {
+            size_t head = (c == 0) ? 0 : (c <= chains) ? order[c - 1] : last;
+            if (head == NO_BLOCK || (c > chains && head == 0)) continue;
+
+            for (size_t k = head; k != NO_BLOCK; k = layout.next[k]) {
+                if (c > 0 && k == head) {
+                    LogDebug("Placed code block %s (heat %llu)\n", graph->blocks[layout.blocks[k]].label ? graph->blocks[layout.blocks[k]].label : "(unlabeled)",
+                        (unsigned long long)graph->blocks[layout.blocks[k]].heat);
+                }
+                for (size_t i = layout.first_line[k]; i != NO_BLOCK; i = layout.next_line[i]) {
+                    if (layout.rewritten[i]) fputs(layout.rewritten[i], output_fd);
+                    else fwrite(file->lines[i], 1, file->lines[i + 1] - file->lines[i], output_fd);
+                }
+            }
+        }
+        fclose(output_fd);
+    }
+
+    for (size_t i = 0; layout.rewritten && i < file->line_count; i++) free(layout.rewritten[i]);
+    free(layout.rewritten);
+    free(layout.blocks);
+    free(layout.next);
+    free(layout.prev);
+    free(layout.first_line);
+    free(layout.last_line);
+    free(layout.next_line);
+    free(order);
+    free(local);
+    return status;
+}
+
+int WriteHotLayout(BlockGraph *graph, int value_bits, size_t *flipped) {
+    if (!graph || !flipped) return STATUS_ERROR;
+    *flipped = 0;
+
+    // A relative branch reaches anywhere if the largest program the lines could make does
+    size_t code_lines = 0;
+    for (size_t f = 0; f < graph->file_count; f++) {
+        for (size_t i = 0; i < graph->files[f].line_count; i++) code_lines += (graph->files[f].owner[i] != NO_BLOCK);
+    }
+    bool relative_reach = (uint64_t)code_lines * 3 < ((uint64_t)1 << (value_bits - 1));
+
+    for (size_t f = 0; f < graph->file_count; f++) {
+        if (LayoutFile(graph, f, relative_reach, flipped) != 0) return STATUS_ERROR;
+    }
+    return 0;
+}
+
+void CleanUpBlocks(BlockGraph *graph) {
+    if (!graph) return;
+
+    for (size_t i = 0; i < graph->count; i++) {
+        Block *block = &graph->blocks[i];
+        for (size_t r = 0; r < block->ref_count; r++) free(block->refs[r]);
+        free(block->refs);
+        free(block->label);
+    }
+    free(graph->blocks);
+
+    for (size_t f = 0; f < graph->file_count; f++) {
+        free(graph->files[f].path);
+        free(graph->files[f].source);
+        free(graph->files[f].lines);
+        free(graph->files[f].owner);
+    }
+    free(graph->files);
+
+    for (size_t i = 0; i < graph->entry_count; i++) free(graph->entries[i]);
+    free(graph->entries);
+
+    memset(graph, 0, sizeof(*graph));
+}
@@ -11,6 +11,41 @@ const Command *FindCommand(char *com_name) {
     return NULL;
 }
 
+void DecodeCommandWord(int width, uint32_t word, CommandWord *fields) {
+    if (width == WORD_SIZE_LEGACY) {
+        fields->opcode  = (word >> 18) & 0x3F;
+        fields->mode[0] = (word >> 16) & 0x3;
+        fields->reg[0]  = (word >> 13) & 0x7;
+        fields->mode[1] = (word >> 11) & 0x3;
+        fields->reg[1]  = (word >> 8)  & 0x7;
+        fields->funct   = (word >> 3)  & 0x1F;
+    } else {
+        fields->opcode  = (word >> 26) & 0x3F;
+        fields->mode[0] = (word >> 24) & 0x3;
+        fields->reg[0]  = (word >> 18) & 0x3F;
+        fields->mode[1] = (word >> 16) & 0x3;
+        fields->reg[1]  = (word >> 10) & 0x3F;
+        fields->funct   = (word >> 4)  & 0x3F;
+    }
+}
+
+bool ValidOperandModes(const Command *comm, const CommandWord *fields) {
+    uint8_t modes = 0;
+    if (comm->opcount == 2) modes |= (uint8_t)(SRC_IMM << fields->mode[0]);
+    else if (fields->mode[0] != 0 || fields->reg[0] != 0) return false;
+    if (comm->opcount >= 1) modes |= (uint8_t)(DST_IMM << fields->mode[1]);
+    else if (fields->mode[1] != 0 || fields->reg[1] != 0) return false;
+    return (comm->addmodes & modes) == modes;
+}
+
+int32_t OperandValue(int width, uint32_t word) {
+    uint32_t shift = (width == WORD_SIZE_LEGACY) ? 3 : 4;
+    uint32_t bits = (uint32_t)width - shift;
+    uint32_t value = (word >> shift) & ((1u << bits) - 1);
+    if (value & (1u << (bits - 1))) value |= ~((1u << bits) - 1);
+    return (int32_t)value;
+}
+
 int ValidateCommand(char *com_line, const Command *comm) {
     if (!com_line || !comm) return STATUS_ERROR;
 
@@ -39,12 +74,21 @@ int ValidateCommand(char *com_line, const Command *comm) {
     }
     if (comm->opcount != words - 1) return STATUS_ERROR; // Wrong opcount
 
-    bool has_reg = false;
-    if ((modes & SRC_REG) == SRC_REG) {
-        words--;
-        has_reg = true;
+    // Registers are encoded in the command word and take no word of their own,
+    // like EncodeCommand emits them
+    if ((modes & SRC_REG) == SRC_REG) words--;
+    if ((modes & DST_REG) == DST_REG) words--;
+
+    // Immediates that don't fit the value field take a word of the literal pool
+    char *op = com_line + strlen(comm->name);
+    while (op) {
+        int64_t value = 0;
+        if (ParseImmediate(op, &value, NULL) == 0 && !VALUE_FITS(value) && LiteralAdd(value) < 0) {
+            return STATUS_ERROR;
+        }
+        op = strchr(op, ',');
+        if (op) op++;
     }
-    if ((modes & DST_REG) == DST_REG && !has_reg) words--;
 
     LogDebug("Command validated successfully. %d words\n", words);
     return words; // 1 word for command + 1 for each non register operand
@@ -65,13 +109,14 @@ int DetermineAddressingModes(char *operand, uint8_t opCount) {
 
     // Immediate
     if (operand[offset] == '#') {
-        offset++;
-        if (operand[offset] == NEG_DELIM || operand[offset] == POS_DELIM) offset++;
-        if (isdigit(operand[offset])) {
-            while (isdigit(operand[offset])) offset++;
-        } else return STATUS_ERROR;
+        int64_t value = 0;
+        const char *end = NULL;
+        int status = ParseImmediate(operand + offset, &value, &end);
+        if (status == STATUS_ERROR) return STATUS_ERROR;
+        offset = end - operand;
         ops++;
-        ret |= SRC_IMM;
+        // Label dependent values are range checked when encoded
+        ret |= (status == STATUS_NO_RESULT || VALUE_FITS(value)) ? SRC_IMM : SRC_DIR; // Literal pool entry
     }
     // Relative
     else if (operand[offset] == '&') {
@@ -114,9 +159,9 @@ int DetermineAddressingModes(char *operand, uint8_t opCount) {
             }
         }
     }
-    // Direct
+    // Direct, a label or an address expression
     else {
-        while (operand[offset] && !isspace(operand[offset]) && operand[offset] != ',') offset++;
+        while (operand[offset] && operand[offset] != ',') offset++;
         ops++;
         ret |= SRC_DIR;
     }
@@ -129,13 +174,13 @@ int DetermineAddressingModes(char *operand, uint8_t opCount) {
         while (isspace(operand[offset])) offset++;
 
         if (operand[offset] == '#') {
-            offset++;
-            if (operand[offset] == NEG_DELIM || operand[offset] == POS_DELIM) offset++;
-            if (isdigit(operand[offset])) {
-                while (isdigit(operand[offset])) offset++;
-            } else return STATUS_ERROR;
+            int64_t value = 0;
+            const char *end = NULL;
+            int status = ParseImmediate(operand + offset, &value, &end);
+            if (status == STATUS_ERROR) return STATUS_ERROR;
+            offset = end - operand;
             ops++;
-            ret |= DST_IMM;
+            ret |= (status == STATUS_NO_RESULT || VALUE_FITS(value)) ? DST_IMM : DST_DIR; // Literal pool entry
         }
         else if (operand[offset] == '&') {
             offset++;
@@ -177,7 +222,7 @@ int DetermineAddressingModes(char *operand, uint8_t opCount) {
             }
         }
         else {
-            while (operand[offset] && !isspace(operand[offset]) && operand[offset] != ',') offset++;
+            while (operand[offset] && operand[offset] != ',') offset++;
             ops++;
             ret |= DST_DIR;
         }
@@ -0,0 +1,209 @@
+#include "../include/conditional.h"
+#include "../include/expr.h"
+
+static Define defines[MAX_DEFINES];
+static size_t define_count = 0;
+
+#define IS_NAME_START(c) (isalpha((unsigned char)(c)) || (c) == '_')
+#define IS_NAME_CHAR(c)  (isalnum((unsigned char)(c)) || (c) == '_')
+
+// True if the line starts (after blanks) with the given directive as a whole word
+static bool IsDirective(const char *line, const char *directive) {
+    while (isblank((unsigned char)*line)) line++;
+    size_t len = strlen(directive);
+    return strncmp(line, directive, len) == 0 && (line[len] == '\0' || isspace((unsigned char)line[len]));
+}
+
+// Parses a signed decimal number. Returns 0 upon success, else STATUS_ERROR
+static int ParseNumber(const char *p, const char **end, int64_t *value) {
+    bool negative = false;
+    if (*p == '+' || *p == '-') negative = (*p++ == '-');
+    if (!isdigit((unsigned char)*p)) return STATUS_ERROR;
+
+    int64_t result = 0;
+    while (isdigit((unsigned char)*p)) {
+        if (result > (INT64_MAX - 9) / 10) return STATUS_ERROR;
+        result = result * 10 + (*p++ - '0');
+    }
+
+    *value = negative ? -result : result;
+    *end = p;
+    return 0;
+}
+
+int AddDefine(const char *spec) {
+    if (!spec || !IS_NAME_START(*spec)) return STATUS_ERROR;
+
+    size_t name_length = 0;
+    while (IS_NAME_CHAR(spec[name_length])) name_length++;
+
+    int64_t value = 1;
+    const char *rest = spec + name_length;
+    if (*rest == '=') {
+        if (ParseNumber(rest + 1, &rest, &value) != 0 || *rest != '\0') return STATUS_ERROR;
+    } else if (*rest != '\0') {
+        return STATUS_ERROR;
+    }
+
+    // A later -D overrides an earlier one
+    for (size_t i = 0; i < define_count; i++) {
+        if (strlen(defines[i].name) == name_length && strncmp(defines[i].name, spec, name_length) == 0) {
+            defines[i].value = value;
+            return 0;
+        }
+    }
+
+    if (define_count == MAX_DEFINES) return STATUS_ERROR;
+
+    defines[define_count].name = strndup(spec, name_length);
+    if (!defines[define_count].name) return STATUS_ERROR;
+    defines[define_count].value = value;
+    define_count++;
+    return 0;
+}
+
+const Define *FindDefine(const char *name, size_t name_length) {
+    for (size_t i = 0; i < define_count; i++) {
+        if (strlen(defines[i].name) == name_length && strncmp(defines[i].name, name, name_length) == 0) {
+            return &defines[i];
+        }
+    }
+    return NULL;
+}
+
+// Evaluates one side of a condition, which may only use constants
+static int ParseTerm(const char **p, int64_t *value) {
+    ExprValue result;
+    if (EvalExpression(*p, p, NULL, &result) != 0) return STATUS_ERROR;
+    if (result.unresolved) {
+        printf("(-) Error: Conditions may only use numbers and -D symbols\n");
+        return STATUS_ERROR;
+    }
+    *value = result.value;
+    return 0;
+}
+
+int EvaluateCondition(const char *expr, int64_t *value) {
+    if (!expr || !value) return STATUS_ERROR;
+
+    const char *p = expr;
+    int64_t left = 0;
+    if (ParseTerm(&p, &left) != 0) return STATUS_ERROR;
+
+    // Comparison operator, if any
+    char op[3] = {0};
+    if (strncmp(p, "==", 2) == 0 || strncmp(p, "!=", 2) == 0
+        || strncmp(p, "<=", 2) == 0 || strncmp(p, ">=", 2) == 0) {
+        memcpy(op, p, 2);
+        p += 2;
+    } else if (*p == '<' || *p == '>') {
+        op[0] = *p++;
+    }
+
+    if (op[0]) {
+        int64_t right = 0;
+        if (ParseTerm(&p, &right) != 0) return STATUS_ERROR;
+
+        if (strcmp(op, "==") == 0) left = (left == right);
+        else if (strcmp(op, "!=") == 0) left = (left != right);
+        else if (strcmp(op, "<=") == 0) left = (left <= right);
+        else if (strcmp(op, ">=") == 0) left = (left >= right);
+        else if (op[0] == '<') left = (left < right);
+        else left = (left > right);
+    }
+
+    if (*p != '\0' && *p != '\n' && *p != '\r' && *p != COMMENT_DELIM) return STATUS_ERROR;
+
+    *value = left;
+    return 0;
+}
+
+bool IsConditional(const char *line) {
+    return IsDirective(line, IIF) || IsDirective(line, IIFDEF) || IsDirective(line, IIFNDEF)
+        || IsDirective(line, IELSE) || IsDirective(line, IENDIF);
+}
+
+bool IsAssembled(const CondStack *stack) {
+    return stack->depth == 0 || stack->frames[stack->depth - 1].active;
+}
+
+// Returns the operand of a directive line, past the directive itself
+static const char *DirectiveOperand(const char *line, const char *directive) {
+    while (isblank((unsigned char)*line)) line++;
+    line += strlen(directive);
+    while (isblank((unsigned char)*line)) line++;
+    return line;
+}
+
+int HandleConditional(const char *line, CondStack *stack) {
+    if (!line || !stack) return STATUS_ERROR;
+
+    bool parent_active = IsAssembled(stack);
+
+    if (IsDirective(line, IELSE) || IsDirective(line, IENDIF)) {
+        if (stack->depth == 0) {
+            printf("(-) Error: Conditional directive without a matching '%s' <-- %s", IIF, line);
+            return STATUS_ERROR;
+        }
+
+        CondFrame *frame = &stack->frames[stack->depth - 1];
+        if (IsDirective(line, IENDIF)) {
+            stack->depth--;
+            return 0;
+        }
+
+        if (frame->in_else) {
+            printf("(-) Error: Multiple '%s' in one conditional block <-- %s", IELSE, line);
+            return STATUS_ERROR;
+        }
+        frame->in_else = true;
+        frame->active = !frame->taken;
+        frame->taken = true;
+        return 0;
+    }
+
+    if (stack->depth == MAX_COND_DEPTH) {
+        printf("(-) Error: Conditional blocks are nested deeper than %d levels <-- %s", MAX_COND_DEPTH, line);
+        return STATUS_ERROR;
+    }
+
+    // Conditions inside a skipped region are not evaluated
+    bool condition = false;
+    if (parent_active) {
+        if (IsDirective(line, IIF)) {
+            int64_t value = 0;
+            if (EvaluateCondition(DirectiveOperand(line, IIF), &value) != 0) {
+                printf("(-) Error: Invalid condition <-- %s", line);
+                return STATUS_ERROR;
+            }
+            condition = (value != 0);
+        } else {
+            bool ifdef = IsDirective(line, IIFDEF);
+            const char *name = DirectiveOperand(line, ifdef ? IIFDEF : IIFNDEF);
+
+            size_t name_length = 0;
+            while (IS_NAME_CHAR(name[name_length])) name_length++;
+
+            const char *rest = name + name_length;
+            while (isspace((unsigned char)*rest)) rest++;
+            if (!IS_NAME_START(*name) || (*rest != '\0' && *rest != COMMENT_DELIM)) {
+                printf("(-) Error: Badly formatted conditional directive <-- %s", line);
+                return STATUS_ERROR;
+            }
+
+            bool defined = FindDefine(name, name_length) != NULL;
+            condition = ifdef ? defined : !defined;
+        }
+    }
+
+    CondFrame *frame = &stack->frames[stack->depth++];
+    frame->active = parent_active && condition;
+    frame->taken = !parent_active || condition;
+    frame->in_else = false;
+    return 0;
+}
+
+void CleanUpDefines(void) {
+    for (size_t i = 0; i < define_count; i++) free(defines[i].name);
+    define_count = 0;
+}
@@ -0,0 +1,422 @@
+#include "../include/debugmap.h"
+#include "../include/io.h"
+#include "../include/symindex.h"
+
+#define DEBUG_HEADER_SIZE  32  // Magic and seven u32 fields
+
+typedef struct s_debug_call {
+    char     *macro;
+    uint32_t  file;
+    uint32_t  line;
+} DebugCall;
+
+typedef struct s_debug_entry {
+    uint32_t     at;      // Code address or data segment index
+    bool         data;
+    DebugOrigin  origin;
+} DebugEntry;
+
+// Bytes of the file being put together
+typedef struct s_byte_buffer {
+    uint8_t *bytes;
+    size_t   length;
+    size_t   capacity;
+    bool     failed;
+} ByteBuffer;
+
+static char **files = NULL;
+static size_t file_count = 0;
+static size_t file_capacity = 0;
+
+static DebugCall *calls = NULL;
+static size_t call_count = 0;
+static size_t call_capacity = 0;
+
+static DebugEntry *entries = NULL;
+static size_t entry_count = 0;
+static size_t entry_capacity = 0;
+
+static DebugOrigin current = {0};
+
+/// RECORDING ///
+
+uint32_t DebugAddFile(const char *path) {
+    for (size_t i = 0; i < file_count; i++) {
+        if (strcmp(files[i], path) == 0) return (uint32_t)i + 1;
+    }
+
+    if (file_count == file_capacity) {
+        size_t new_capacity = (file_capacity == 0) ? 8 : file_capacity * 2;
+        char **temp = realloc(files, new_capacity * sizeof(char *));
+        if (!temp) return 0;
+        files = temp;
+        file_capacity = new_capacity;
+    }
+    files[file_count] = strdup(path);
+    if (!files[file_count]) return 0;
+    return (uint32_t)++file_count;
+}
+
+uint32_t DebugAddCall(const char *macro, uint32_t file, uint32_t line) {
+    if (call_count == call_capacity) {
+        size_t new_capacity = (call_capacity == 0) ? 64 : call_capacity * 2;
+        DebugCall *temp = realloc(calls, new_capacity * sizeof(DebugCall));
+        if (!temp) return 0;
+        calls = temp;
+        call_capacity = new_capacity;
+    }
+    calls[call_count].macro = strdup(macro);
+    if (!calls[call_count].macro) return 0;
+    calls[call_count].file = file;
+    calls[call_count].line = line;
+    return (uint32_t)++call_count;
+}
+
+void DebugWriteMarker(FILE *output_fd, uint32_t file, uint32_t line, uint32_t call) {
+    if (call) fprintf(output_fd, " %s%u:%u:%u", DEBUG_MARKER, file, line, call);
+    else fprintf(output_fd, " %s%u:%u", DEBUG_MARKER, file, line);
+}
+
+const char *DebugFindMarker(const char *line) {
+    // The marker is the line's last comment, a user's comment may come before it
+    const char *marker = NULL;
+    for (const char *p = strstr(line, DEBUG_MARKER); p; p = strstr(p + 1, DEBUG_MARKER)) marker = p;
+    return marker;
+}
+
+DebugOrigin DebugParseMarker(const char *line) {
+    const char *marker = DebugFindMarker(line);
+    DebugOrigin origin = {0};
+    if (marker && sscanf(marker + strlen(DEBUG_MARKER), "%u:%u:%u", &origin.file, &origin.line, &origin.call) < 2) {
+        memset(&origin, 0, sizeof(origin));
+    }
+    return origin;
+}
+
+void DebugReadMarker(const char *line) {
+    current = DebugParseMarker(line);
+}
+
+const char *DebugFileName(uint32_t file) {
+    return (file > 0 && file <= file_count) ? files[file - 1] : NULL;
+}
+
+const char *DebugCallInfo(uint32_t call, uint32_t *file, uint32_t *line) {
+    if (call == 0 || call > call_count) return NULL;
+    *file = calls[call - 1].file;
+    *line = calls[call - 1].line;
+    return calls[call - 1].macro;
+}
+
+DebugOrigin DebugGetOrigin(void) {
+    return current;
+}
+
+void DebugSetOrigin(DebugOrigin origin) {
+    current = origin;
+}
+
+static bool SameOrigin(const DebugOrigin *a, const DebugOrigin *b) {
+    return a->file == b->file && a->line == b->line && a->call == b->call;
+}
+
+static void DebugMark(uint32_t at, bool data) {
+    // Only changes are recorded, a word from the same statement extends the entry before it
+    for (size_t i = entry_count; i-- > 0;) {
+        if (entries[i].data != data) continue;
+        if (SameOrigin(&entries[i].origin, &current)) return;
+        if (entries[i].at == at) {
+            entries[i].origin = current;
+            return;
+        }
+        break;
+    }
+
+    if (entry_count == entry_capacity) {
+        size_t new_capacity = (entry_capacity == 0) ? 256 : entry_capacity * 2;
+        DebugEntry *temp = realloc(entries, new_capacity * sizeof(DebugEntry));
+        if (!temp) {
+            printf("(-) Error: Out of memory while recording the debug map!\n");
+            return;
+        }
+        entries = temp;
+        entry_capacity = new_capacity;
+    }
+    entries[entry_count++] = (DebugEntry){at, data, current};
+}
+
+void DebugMarkCode(uint32_t address) {
+    DebugMark(address, false);
+}
+
+void DebugMarkData(uint32_t index) {
+    DebugMark(index, true);
+}
+
+/// WRITING ///
+
+static void PutBytes(ByteBuffer *buffer, const void *bytes, size_t length) {
+    if (buffer->failed) return;
+    if (buffer->length + length > buffer->capacity) {
+        size_t new_capacity = (buffer->capacity == 0) ? 4096 : buffer->capacity;
+        while (new_capacity < buffer->length + length) new_capacity *= 2;
+        uint8_t *temp = realloc(buffer->bytes, new_capacity);
+        if (!temp) {
+            buffer->failed = true;
+            return;
+        }
+        buffer->bytes = temp;
+        buffer->capacity = new_capacity;
+    }
+    memcpy(buffer->bytes + buffer->length, bytes, length);
+    buffer->length += length;
+}
+
+static void PutU32(ByteBuffer *buffer, uint32_t value) {
+    uint8_t bytes[4] = {(uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24)};
+    PutBytes(buffer, bytes, sizeof(bytes));
+}
+
+static void PutVarint(ByteBuffer *buffer, uint64_t value) {
+    uint8_t bytes[10];
+    size_t n = 0;
+    do {
+        bytes[n] = (uint8_t)(value & 0x7F);
+        value >>= 7;
+        if (value) bytes[n] |= 0x80;
+        n++;
+    } while (value);
+    PutBytes(buffer, bytes, n);
+}
+
+// Adds name to the string table once. Returns its offset
+static uint32_t PutString(ByteBuffer *strings, SymbolIndex *offsets, const char *name) {
+    void *found = IndexFind(offsets, name);
+    if (found) return (uint32_t)((uintptr_t)found - 1);
+
+    uint32_t offset = (uint32_t)strings->length;
+    PutBytes(strings, name, strlen(name) + 1);
+    // Stored + 1 so offset 0 isn't taken for a missing name, a failed insert only costs a copy
+    IndexInsert(offsets, name, (void *)((uintptr_t)offset + 1));
+    return offset;
+}
+
+int DebugWrite(const char *path, uint32_t data_base) {
+    ByteBuffer strings = {0}, coded = {0}, tables = {0}, index = {0};
+    SymbolIndex offsets = {0};
+
+    for (size_t i = 0; i < file_count; i++) PutU32(&tables, PutString(&strings, &offsets, files[i]));
+    for (size_t i = 0; i < call_count; i++) {
+        PutU32(&tables, PutString(&strings, &offsets, calls[i].macro));
+        PutU32(&tables, calls[i].file);
+        PutU32(&tables, calls[i].line);
+    }
+
+    // Entries of each kind are recorded in address order, and the data follows the code
+    uint32_t address = 0, line = 0;
+    DebugOrigin last = {0};
+    size_t n = 0;
+    for (int data = 0; data < 2; data++) {
+        for (size_t i = 0; i < entry_count; i++) {
+            const DebugEntry *entry = &entries[i];
+            if (entry->data != (bool)data) continue;
+            uint32_t at = entry->data ? data_base + entry->at - 1 : entry->at;
+
+            bool first = (n++ % DEBUG_MAP_BLOCK == 0);
+            if (first) {
+                PutU32(&index, at);
+                PutU32(&index, (uint32_t)coded.length);
+                address = at;
+                line = 0;
+            }
+
+            bool changed = first || entry->origin.file != last.file || entry->origin.call != last.call;
+            PutVarint(&coded, ((uint64_t)(at - address) << 1) | changed);
+            if (changed) {
+                PutVarint(&coded, entry->origin.file);
+                PutVarint(&coded, entry->origin.call);
+            }
+            int64_t delta = (int64_t)entry->origin.line - line;
+            PutVarint(&coded, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+
+            address = at;
+            line = entry->origin.line;
+            last = entry->origin;
+        }
+    }
+    CleanUpIndex(&offsets);
+
+    ByteBuffer header = {0};
+    PutBytes(&header, DEBUG_MAP_MAGIC, 4);
+    PutU32(&header, DEBUG_MAP_VERSION);
+    PutU32(&header, (uint32_t)entry_count);
+    PutU32(&header, (uint32_t)((entry_count + DEBUG_MAP_BLOCK - 1) / DEBUG_MAP_BLOCK));
+    PutU32(&header, (uint32_t)file_count);
+    PutU32(&header, (uint32_t)call_count);
+    PutU32(&header, (uint32_t)strings.length);
+    PutU32(&header, (uint32_t)coded.length);
+
+    int status = (header.failed || tables.failed || index.failed || strings.failed || coded.failed) ? STATUS_ERROR : 0;
+    FILE *output_fd = (status == 0) ? fopen(path, "wb") : NULL;
+    if (!output_fd) {
+        printf("(-) Error: Failed to write the debug map %s\n", path);
+        status = STATUS_ERROR;
+    } else {
+        ByteBuffer *parts[] = {&header, &tables, &index, &strings, &coded};
+        for (size_t i = 0; i < sizeof(parts) / sizeof(parts[0]); i++) {
+            if (parts[i]->length && fwrite(parts[i]->bytes, 1, parts[i]->length, output_fd) != parts[i]->length) status = STATUS_ERROR;
+        }
+        if (fclose(output_fd) != 0) status = STATUS_ERROR;
+        if (status == 0) LogVerbose("Wrote debug map to %s: %zu entries, %zu bytes\n", path, entry_count,
+            header.length + tables.length + index.length + strings.length + coded.length);
+    }
+
+    free(header.bytes);
+    free(tables.bytes);
+    free(index.bytes);
+    free(strings.bytes);
+    free(coded.bytes);
+    return status;
+}
+
+void DebugCleanUp(void) {
+    for (size_t i = 0; i < file_count; i++) free(files[i]);
+    for (size_t i = 0; i < call_count; i++) free(calls[i].macro);
+    free(files);
+    free(calls);
+    free(entries);
+    files = NULL;
+    calls = NULL;
+    entries = NULL;
+    file_count = file_capacity = call_count = call_capacity = entry_count = entry_capacity = 0;
+    memset(&current, 0, sizeof(current));
+}
+
+/// READING ///
+
+static uint32_t GetU32(const uint8_t *bytes) {
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+// Decodes a varint at *p, short of end. Returns 0 upon success, else STATUS_ERROR
+static int GetVarint(const uint8_t **p, const uint8_t *end, uint64_t *value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (*p == end) return STATUS_ERROR;
+        uint8_t byte = *(*p)++;
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return 0;
+    }
+    return STATUS_ERROR;
+}
+
+int LoadDebugMap(const char *path, DebugMap *map) {
+    if (!path || !map) return STATUS_ERROR;
+    memset(map, 0, sizeof(DebugMap));
+
+    size_t size = 0;
+    uint8_t *data = (uint8_t *)ReadFile(path, &size);
+    if (!data) return STATUS_ERROR;
+    map->data = data;
+    map->size = size;
+
+    if (size < DEBUG_HEADER_SIZE || memcmp(data, DEBUG_MAP_MAGIC, 4) != 0 || GetU32(data + 4) != DEBUG_MAP_VERSION) {
+        printf("(-) Error: %s is not a debug map\n", path);
+        CleanUpDebugMap(map);
+        return STATUS_ERROR;
+    }
+    map->entry_count = GetU32(data + 8);
+    map->block_count = GetU32(data + 12);
+    map->file_count = GetU32(data + 16);
+    map->call_count = GetU32(data + 20);
+    map->strings_size = GetU32(data + 24);
+    map->entries_size = GetU32(data + 28);
+
+    // The parts must add up to the file exactly
+    uint64_t expected = DEBUG_HEADER_SIZE + 4ull * map->file_count + 12ull * map->call_count +
+        8ull * map->block_count + map->strings_size + map->entries_size;
+    uint64_t blocks = ((uint64_t)map->entry_count + DEBUG_MAP_BLOCK - 1) / DEBUG_MAP_BLOCK;
+    if (expected != size || blocks != map->block_count ||
+        (map->strings_size > 0 && data[size - map->entries_size - 1] != '\0')) {
+        printf("(-) Error: Debug map %s is damaged\n", path);
+        CleanUpDebugMap(map);
+        return STATUS_ERROR;
+    }
+
+    map->files = data + DEBUG_HEADER_SIZE;
+    map->calls = map->files + 4 * (size_t)map->file_count;
+    map->index = map->calls + 12 * (size_t)map->call_count;
+    map->strings = (const char *)(map->index + 8 * (size_t)map->block_count);
+    map->entries = (const uint8_t *)map->strings + map->strings_size;
+    LogVerbose("Loaded debug map %s: %u entries from %u file(s)\n", path, map->entry_count, map->file_count);
+    return 0;
+}
+
+// The string at offset, NULL if it's out of the table
+static const char *GetString(const DebugMap *map, uint32_t offset) {
+    return (offset < map->strings_size) ? map->strings + offset : NULL;
+}
+
+static const char *GetFile(const DebugMap *map, uint64_t file) {
+    if (file == 0 || file > map->file_count) return NULL;
+    return GetString(map, GetU32(map->files + 4 * (file - 1)));
+}
+
+int FindDebugLine(const DebugMap *map, uint32_t address, DebugLine *line) {
+    if (!map || !line || map->block_count == 0) return STATUS_NO_RESULT;
+
+    // The last block starting at or before the address
+    uint32_t low = 0, high = map->block_count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (GetU32(map->index + 8 * (size_t)mid) <= address) low = mid + 1;
+        else high = mid;
+    }
+    if (low == 0) return STATUS_NO_RESULT;
+    uint32_t block = low - 1;
+
+    uint32_t offset = GetU32(map->index + 8 * (size_t)block + 4);
+    if (offset > map->entries_size) return STATUS_ERROR;
+    const uint8_t *p = map->entries + offset;
+    const uint8_t *end = map->entries + map->entries_size;
+
+    uint64_t at = GetU32(map->index + 8 * (size_t)block);
+    uint64_t file = 0, call = 0, found_file = 0, found_call = 0;
+    int64_t source_line = 0, found_line = 0;
+    uint64_t found_at = at;
+
+    uint64_t first = (uint64_t)block * DEBUG_MAP_BLOCK;
+    uint64_t last = (first + DEBUG_MAP_BLOCK < map->entry_count) ? first + DEBUG_MAP_BLOCK : map->entry_count;
+    for (uint64_t i = first; i < last; i++) {
+        uint64_t head = 0, delta = 0;
+        if (GetVarint(&p, end, &head) != 0) return STATUS_ERROR;
+        if ((head & 1) && (GetVarint(&p, end, &file) != 0 || GetVarint(&p, end, &call) != 0)) return STATUS_ERROR;
+        if (GetVarint(&p, end, &delta) != 0) return STATUS_ERROR;
+
+        at += head >> 1;
+        source_line += (int64_t)(delta >> 1) ^ -(int64_t)(delta & 1);
+        if (at > address) break;
+        found_at = at;
+        found_file = file;
+        found_call = call;
+        found_line = source_line;
+    }
+
+    memset(line, 0, sizeof(DebugLine));
+    line->address = (uint32_t)found_at;
+    line->file = GetFile(map, found_file);
+    line->line = (uint32_t)found_line;
+    if (found_call > 0 && found_call <= map->call_count) {
+        const uint8_t *record = map->calls + 12 * (found_call - 1);
+        line->macro = GetString(map, GetU32(record));
+        line->call_file = GetFile(map, GetU32(record + 4));
+        line->call_line = GetU32(record + 8);
+    }
+    return 0;
+}
+
+void CleanUpDebugMap(DebugMap *map) {
+    if (!map) return;
+    free(map->data);
+    memset(map, 0, sizeof(DebugMap));
+}
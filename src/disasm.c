@@ -0,0 +1,354 @@
+#include "../include/disasm.h"
+#include "../include/encoder.h"
+#include "../include/logger.h"
+#include "../include/symindex.h"
+
+#define DISASM_HEX_COLUMN  3  // Words a line shows before the mnemonic, the longest instruction
+
+// Sign-extends a whole data word
+static int32_t DataValue(int width, uint32_t word) {
+    if (width == WORD_SIZE_LEGACY && (word & 0x800000)) word |= 0xFF000000u;
+    return (int32_t)word;
+}
+
+// Records a name for address. Returns 0 upon success, else STATUS_ERROR
+static int AddName(Disassembly *dis, const char *name, size_t length, uint32_t address, char kind) {
+    if (dis->name_count == dis->name_capacity) {
+        size_t new_capacity = (dis->name_capacity == 0) ? 64 : dis->name_capacity * 2;
+        DisName *temp = realloc(dis->names, new_capacity * sizeof(DisName));
+        if (!temp) return STATUS_ERROR;
+        dis->names = temp;
+        dis->name_capacity = new_capacity;
+    }
+
+    // Names are never longer than a label, which also bounds the lines they are written to
+    char *copy = strndup(name, (length < MAX_LABEL_NAME) ? length : MAX_LABEL_NAME);
+    if (!copy) return STATUS_ERROR;
+    dis->names[dis->name_count++] = (DisName){copy, address, kind};
+
+    uint32_t index = address - DISASM_CODE_START;
+    if (address < DISASM_CODE_START || index >= dis->code_size + dis->data_size) return 0;
+    if (kind == 'X') dis->externs[index] = copy;
+    else if (kind == 'S' || !dis->labels[index]) dis->labels[index] = copy;
+    return 0;
+}
+
+// Parses a `name|address...` record into its parts. Returns 0 upon success, else STATUS_ERROR
+static int ParseRecord(const char *record, size_t *length, uint32_t *address) {
+    const char *bar = strchr(record, '|');
+    if (!bar || bar == record || !isdigit((unsigned char)bar[1])) return STATUS_ERROR;
+    *length = (size_t)(bar - record);
+    *address = (uint32_t)strtoul(bar + 1, NULL, 10);
+    return 0;
+}
+
+// Fills the lookup table every command word is decoded through
+static void BuildTable(Disassembly *dis) {
+    for (size_t i = 0; i < COMMAND_COUNT; i++) dis->table[commands[i].ident] = &commands[i];
+}
+
+int LoadDisassembly(const char *path, int width, Disassembly *dis) {
+    if (!path || !dis) return STATUS_ERROR;
+    memset(dis, 0, sizeof(Disassembly));
+    BuildTable(dis);
+
+    LineReader reader;
+    if (LineReaderOpen(&reader, path) != 0) {
+        printf("(-) Error: Failed to open image: %s\n", path);
+        return STATUS_ERROR;
+    }
+
+    int status = 0;
+    char *line = ReadLine(&reader);
+    if (!line || sscanf(line, "%u|%u", &dis->code_size, &dis->data_size) != 2 ||
+        (uint64_t)dis->code_size + dis->data_size > DISASM_MAX_WORDS) {
+        printf("(-) Error: %s is not a program image\n", path);
+        status = STATUS_ERROR;
+    }
+
+    size_t words = (size_t)dis->code_size + dis->data_size;
+    dis->path = strdup(path);
+    if (status == 0) {
+        dis->words = calloc(words + 1, sizeof(uint32_t));
+        dis->labels = calloc(words + 1, sizeof(char *));
+        dis->externs = calloc(words + 1, sizeof(char *));
+        if (!dis->path || !dis->words || !dis->labels || !dis->externs) status = STATUS_ERROR;
+    }
+
+    while (status == 0 && (line = ReadLine(&reader)) != NULL) {
+        TrimNewline(line);
+        size_t length = 0;
+        uint32_t address = 0;
+
+        if (*line == '\0') continue;
+        if ((strncmp(line, "E|", 2) == 0 || strncmp(line, "X|", 2) == 0) &&
+            ParseRecord(line + 2, &length, &address) == 0) {
+            status = AddName(dis, line + 2, length, address, line[0]);
+            continue;
+        }
+
+        // `address : 0xWORD`, parsed by hand since large images have millions of them
+        char *end = NULL;
+        unsigned long word_address = strtoul(line, &end, 10);
+        if (end != line && strncmp(end, " : 0x", 5) == 0 &&
+            word_address >= DISASM_CODE_START && word_address - DISASM_CODE_START < words) {
+            char *hex = end + 5;
+            unsigned long word = strtoul(hex, &end, 16);
+            if (dis->width == 0) dis->width = width ? width : ((end - hex <= 6) ? WORD_SIZE_LEGACY : WORD_SIZE);
+            dis->words[word_address - DISASM_CODE_START] = (uint32_t)word;
+            continue;
+        }
+
+        printf("(-) Error: Invalid line in %s at %zu: %s\n", path, reader.line_no, line);
+        status = STATUS_ERROR;
+    }
+    LineReaderClose(&reader);
+    if (dis->width == 0) dis->width = width ? width : WORD_SIZE;
+
+    if (status != 0) CleanUpDisassembly(dis);
+    else LogVerbose("Loaded %s: %d-bit, %u code word(s), %u data word(s), %zu name(s)\n",
+        path, dis->width, dis->code_size, dis->data_size, dis->name_count);
+    return status;
+}
+
+int LoadDisassemblySymbols(Disassembly *dis, const char *path) {
+    LineReader reader;
+    if (LineReaderOpen(&reader, path) != 0) {
+        printf("(-) Error: Failed to open symbol file: %s\n", path);
+        return STATUS_ERROR;
+    }
+
+    int status = 0;
+    size_t before = dis->name_count;
+    char *line = NULL;
+    while (status == 0 && (line = ReadLine(&reader)) != NULL) {
+        TrimNewline(line);
+        size_t length = 0;
+        uint32_t address = 0;
+        if (*line == '\0') continue;
+
+        // `name|address|CODE` or `name|address|DATA`
+        if (ParseRecord(line, &length, &address) != 0) {
+            printf("(-) Error: Invalid line in %s at %zu: %s\n", path, reader.line_no, line);
+            status = STATUS_ERROR;
+        } else {
+            status = AddName(dis, line, length, address, 'S');
+        }
+    }
+    LineReaderClose(&reader);
+
+    if (status == 0) LogVerbose("Loaded %zu symbol(s) from %s\n", dis->name_count - before, path);
+    return status;
+}
+
+/// LINE FORMATTING ///
+// A listing line is put together in a local buffer with these, which is much
+// cheaper than a printf per line once images run to millions of words.
+
+static char *PutText(char *p, const char *text) {
+    while (*text) *p++ = *text++;
+    return p;
+}
+
+static char *PutHex(char *p, uint32_t value, int digits) {
+    static const char hex[] = "0123456789ABCDEF";
+    for (int i = digits - 1; i >= 0; i--) p[i] = hex[value & 0xF], value >>= 4;
+    return p + digits;
+}
+
+// Writes value in decimal, zero-padded to at least digits digits
+static char *PutUnsigned(char *p, uint32_t value, int digits) {
+    char temp[10];
+    int n = 0;
+    do temp[n++] = (char)('0' + value % 10), value /= 10; while (value);
+    while (digits-- > n) *p++ = '0';
+    while (n > 0) *p++ = temp[--n];
+    return p;
+}
+
+static char *PutSigned(char *p, int32_t value) {
+    if (value < 0) *p++ = '-';
+    return PutUnsigned(p, (value < 0) ? 0u - (uint32_t)value : (uint32_t)value, 1);
+}
+
+// Starts a line with the address and the hex words at it, padded to the mnemonic column
+static char *PutWords(const Disassembly *dis, char *p, uint32_t index, uint32_t count) {
+    int digits = dis->width / 4;
+    p = PutUnsigned(p, DISASM_CODE_START + index, 8);
+    *p++ = ' ';
+    for (uint32_t i = 0; i < DISASM_HEX_COLUMN; i++) {
+        *p++ = ' ';
+        if (i < count) p = PutHex(p, dis->words[index + i], digits);
+        else for (int j = 0; j < digits; j++) *p++ = ' ';
+    }
+    return PutText(p, "  ");
+}
+
+static void WriteLabel(const Disassembly *dis, BufferedWriter *out, uint32_t index) {
+    const char *label = dis->labels[index];
+    if (!label) return;
+    WriteText(out, label);
+    WriteBytes(out, ":\n", 2);
+}
+
+/*
+ * Writes one operand. Direct and relative operands show the label at their
+ * target, or the extern the word refers to, else the address itself; a
+ * direct operand into unlabelled data, like a literal pool entry, notes its value.
+ */
+static char *PutOperand(const Disassembly *dis, char *p, char *note, uint32_t index, uint32_t mode, uint32_t reg) {
+    if (mode == 3) {
+        *p++ = 'r';
+        return PutUnsigned(p, reg, 1);
+    }
+
+    uint32_t word = dis->words[index];
+    int32_t field = OperandValue(dis->width, word);
+    if (mode == 0) {
+        *p++ = '#';
+        return PutSigned(p, field);
+    }
+
+    if (mode == 2) *p++ = '&';
+    // An extern resolved by the time the image was written keeps its E bit but holds the address
+    if ((word & E) && (dis->externs[index] || field == 0)) {
+        return PutText(p, dis->externs[index] ? dis->externs[index] : "?");
+    }
+
+    // Relative operands count from the word after the command, like EncodeRel
+    int64_t target = (mode == 2) ? (int64_t)DISASM_CODE_START + index + field - 1 : field;
+    int64_t target_index = target - DISASM_CODE_START;
+    if (target_index >= 0 && target_index < (int64_t)(dis->code_size + dis->data_size)) {
+        if (dis->labels[target_index]) return PutText(p, dis->labels[target_index]);
+        if (mode == 1 && target_index >= dis->code_size && *note == '\0') {
+            note = PutText(note, "  ; = ");
+            *PutSigned(note, DataValue(dis->width, dis->words[target_index])) = '\0';
+        }
+    }
+    return PutSigned(p, (int32_t)target);
+}
+
+/*
+ * Decodes the instruction at index into the listing line. Returns the number
+ * of words it takes, or 0 if the word does not start a valid instruction.
+ */
+static uint32_t DecodeLine(const Disassembly *dis, uint32_t index, char *line, char **end) {
+    uint32_t word = dis->words[index];
+    CommandWord fields;
+    DecodeCommandWord(dis->width, word, &fields);
+    if (!(word & A)) return 0;  // Command words are always absolute
+
+    const Command *comm = dis->table[S_OF(fields.opcode, fields.funct)];
+    if (!comm || !ValidOperandModes(comm, &fields)) return 0;
+
+    uint32_t size = 1;
+    if (comm->opcount == 2 && fields.mode[0] != 3) size++;
+    if (comm->opcount >= 1 && fields.mode[1] != 3) size++;
+    if (index + size > dis->code_size) return 0;
+
+    // The M bits must chain exactly the operand words the modes call for
+    if (dis->width == WORD_SIZE) {
+        for (uint32_t i = 0; i < size; i++) {
+            if (!(dis->words[index + i] & M) != (i == size - 1)) return 0;
+        }
+    }
+
+    char note[48] = "";
+    char *p = PutWords(dis, line, index, size);
+    p = PutText(p, comm->name);
+    uint32_t next = index + 1;
+    for (int op = 2 - comm->opcount; op < 2; op++) {
+        p = PutText(p, (op == 2 - comm->opcount) ? " " : ", ");
+        p = PutOperand(dis, p, note, next, fields.mode[op], fields.reg[op]);
+        if (fields.mode[op] != 3) next++;
+    }
+    *end = PutText(p, note);
+    return size;
+}
+
+// Writes words the decoder could not make sense of as data
+static void WriteRaw(const Disassembly *dis, BufferedWriter *out, uint32_t index, const char *comment) {
+    char line[256];
+    char *p = PutWords(dis, line, index, 1);
+    p = PutText(p, ".data ");
+    p = PutSigned(p, DataValue(dis->width, dis->words[index]));
+    if (comment) p = PutText(PutText(p, "  ; "), comment);
+    *p++ = '\n';
+    WriteBytes(out, line, (size_t)(p - line));
+}
+
+// Writes `.entry` and `.extern` lines for the image's records, each name once
+static void WriteDeclarations(const Disassembly *dis, BufferedWriter *out) {
+    SymbolIndex seen = {0};
+    bool any = false;
+    for (size_t i = 0; i < dis->name_count; i++) {
+        const DisName *name = &dis->names[i];
+        if (name->kind == 'S') continue;
+        // An index failing to grow only costs a repeated line
+        if (IndexInsert(&seen, name->name, (void *)name) == STATUS_WRONG) continue;
+        WriteFormat(out, "%s %s\n", (name->kind == 'E') ? ".entry" : ".extern", name->name);
+        any = true;
+    }
+    if (any) WriteText(out, "\n");
+    CleanUpIndex(&seen);
+}
+
+// Names the source line of the word at index when an entry of the debug map starts there
+static void WriteSource(const Disassembly *dis, BufferedWriter *out, uint32_t index) {
+    DebugLine source;
+    if (!dis->debug || FindDebugLine(dis->debug, DISASM_CODE_START + index, &source) != 0) return;
+    if (source.address != DISASM_CODE_START + index) return;
+    if (!source.file) {
+        WriteText(out, "; (no source line)\n");
+        return;
+    }
+    WriteFormat(out, "; %s:%u", source.file, source.line);
+    if (source.macro) WriteFormat(out, " in %s from %s:%u", source.macro, source.call_file ? source.call_file : "?", source.call_line);
+    WriteText(out, "\n");
+}
+
+int WriteDisassembly(const Disassembly *dis, BufferedWriter *out) {
+    WriteFormat(out, "; %s: %d-bit, %u code word(s), %u data word(s)\n\n",
+        dis->path, dis->width, dis->code_size, dis->data_size);
+    WriteDeclarations(dis, out);
+
+    char line[256];
+    size_t invalid = 0;
+    for (uint32_t index = 0; index < dis->code_size;) {
+        WriteSource(dis, out, index);
+        WriteLabel(dis, out, index);
+
+        char *end = NULL;
+        uint32_t size = DecodeLine(dis, index, line, &end);
+        if (size == 0) {
+            WriteRaw(dis, out, index, "not an instruction");
+            invalid++;
+            index++;
+            continue;
+        }
+        *end++ = '\n';
+        WriteBytes(out, line, (size_t)(end - line));
+        index += size;
+    }
+
+    if (dis->data_size > 0) WriteText(out, "\n");
+    for (uint32_t index = dis->code_size; index < dis->code_size + dis->data_size; index++) {
+        WriteSource(dis, out, index);
+        WriteLabel(dis, out, index);
+        WriteRaw(dis, out, index, NULL);
+    }
+
+    LogVerbose("Disassembled %s: %zu code word(s) didn't decode as instructions\n", dis->path, invalid);
+    return WriterFlush(out);
+}
+
+void CleanUpDisassembly(Disassembly *dis) {
+    if (!dis) return;
+    for (size_t i = 0; i < dis->name_count; i++) free(dis->names[i].name);
+    free(dis->names);
+    free(dis->words);
+    free(dis->labels);
+    free(dis->externs);
+    free(dis->path);
+    memset(dis, 0, sizeof(Disassembly));
+}
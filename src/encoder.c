@@ -18,7 +18,7 @@ int EncodeCommand(char *ops, const Command *comm, uint8_t modes, uint32_t *out)
                 ret--;
                 char *reg = strchr(ops, 'r');
                 reg++;
-                *out |= ((*reg - '0') << 13);           // src_reg
+                *out |= ((uint32_t)strtoul(reg, NULL, 10) << 13);           // src_reg
                 *out |= (3 << 16);                      // src_add
             } else if ((modes & SRC_DIR) == SRC_DIR) {
                 *out |= (1 << 16);                      // src_add
@@ -37,7 +37,7 @@ int EncodeCommand(char *ops, const Command *comm, uint8_t modes, uint32_t *out)
             }
             char *reg = strchr(comma, 'r');
             reg++;
-            *out |= ((*reg - '0') << 8);                // dst_reg
+            *out |= ((uint32_t)strtoul(reg, NULL, 10) << 8);                // dst_reg
             *out |= (3 << 11);                          // dst_add
         } else if ((modes & DST_DIR) == DST_DIR) {
             *out |= (1 << 11);                          // dst_add
@@ -56,7 +56,7 @@ int EncodeCommand(char *ops, const Command *comm, uint8_t modes, uint32_t *out)
                 ret--;
                 char *reg = strchr(ops, 'r');
                 reg++;
-                *out |= ((*reg - '0') << 18);           // src_reg
+                *out |= ((uint32_t)strtoul(reg, NULL, 10) << 18);           // src_reg
                 *out |= (3 << 24);                      // src_add
             } else if ((modes & SRC_DIR) == SRC_DIR) {
                 *out |= (1 << 24);                      // src_add
@@ -75,7 +75,7 @@ int EncodeCommand(char *ops, const Command *comm, uint8_t modes, uint32_t *out)
             }
             char *reg = strchr(comma, 'r');
             reg++;
-            *out |= ((*reg - '0') << 10);               // dst_reg
+            *out |= ((uint32_t)strtoul(reg, NULL, 10) << 10);               // dst_reg
             *out |= (3 << 16);                          // dst_add
         } else if ((modes & DST_DIR) == DST_DIR) {
             *out |= (1 << 16);                          // dst_add
@@ -90,27 +90,58 @@ int EncodeCommand(char *ops, const Command *comm, uint8_t modes, uint32_t *out)
     return ret;
 }
 
-uint32_t EncodeImm(char *op, bool is_last) {
-    assert(op);
+uint32_t EncodeImm(char *op, Label labels[MAX_LABELS], size_t *label_count, bool is_last, int *status) {
+    assert(op && status);
     
-    // Skip spaces and '#'
-    while (isspace(*op)) op++;
-    op++;
+    int64_t value = 0;
+    int parsed = ParseImmediate(op, &value, NULL);
+    if (parsed == STATUS_NO_RESULT) {
+        // Label arithmetic, e.g. `#END-START`, sized as a plain immediate in the first pass
+        ExprScope scope = { labels, label_count };
+        ExprValue result;
+        const char *imm = strchr(op, '#');
+        if (EvalExpression(imm + 1, NULL, &scope, &result) != 0) {
+            printf("(-) Error: Invalid immediate operand: %s\n", op);
+            *status = STATUS_ERROR;
+            return 0;
+        }
+        if (result.relocatable || result.external) {
+            printf("(-) Error: Immediate %s is an address, use a direct operand instead\n", op);
+            *status = STATUS_ERROR;
+            return 0;
+        }
+        if (!VALUE_FITS(result.value)) {
+            printf("(-) Error: Immediate %s -> %lld doesn't fit in %d bits\n", op, (long long)result.value, VALUE_WIDTH);
+            *status = STATUS_ERROR;
+            return 0;
+        }
+        value = result.value;
+    } else if (parsed != 0) {
+        printf("(-) Error: Invalid immediate operand: %s\n", op);
+        *status = STATUS_ERROR;
+        return 0;
+    }
+
+    // Too wide for the value field, use the literal pool entry directly
+    if (!VALUE_FITS(value)) {
+        int address = LiteralAddress(value);
+        if (address < 0) {
+            printf("(-) Error: Missing literal pool entry for %s\n", op);
+            *status = STATUS_ERROR;
+            return 0;
+        }
+        uint32_t ret = ((uint32_t)address) << (ASSEMBLER_FLAGS.legacy_24_bit ? 3 : 4);
+        ret |= R;
+        if (!ASSEMBLER_FLAGS.legacy_24_bit && !is_last) ret |= M;
+        return WORD(ret);
+    }
 
-    int32_t val = atoi(op);
+    int32_t val = (int32_t)value;
     uint32_t ret = 0;
 
     if (ASSEMBLER_FLAGS.legacy_24_bit) {
-        if (val < -(1<<20) || val > (1<<20) - 1) {
-            printf("INVALID NUMBER: %s -> %d\n", op, val);
-            return 0;
-        }
         ret = ((val < 0) ? (uint32_t)(val + (1 << 21)) : (uint32_t)val) << 3;
     } else {
-        if (val < -(1<<27) || val > (1<<27) - 1) {
-            printf("INVALID NUMBER: %s -> %d\n", op, val);
-            return 0;
-        }
         ret = ((val < 0) ? (uint32_t)(val + (1 << 28)) : (uint32_t)val) << 4;
         if (!is_last) ret |= M;
     }
@@ -119,26 +150,37 @@ uint32_t EncodeImm(char *op, bool is_last) {
     return WORD(ret);
 }
 
-uint32_t EncodeDir(char *op, Label labels[MAX_LABELS], size_t *label_count, uint32_t curr_address, bool is_last) {
-    assert(op && label_count);
+uint32_t EncodeDir(char *op, Label labels[MAX_LABELS], size_t *label_count, uint32_t curr_address, bool is_last, int *status) {
+    assert(op && label_count && status);
 
-    Label *label = FindLabel(op, labels, label_count);
-    if (!label) { // Undefined label
-        printf("UNDEFINED LABEL: %s\n", op);
+    ExprScope scope = { labels, label_count };
+    ExprValue result;
+    const char *end = NULL;
+    if (EvalExpression(op, &end, &scope, &result) != 0 || (*end && !isspace((unsigned char)*end))) {
+        printf("(-) Error: Invalid direct operand: %s\n", op);
+        *status = STATUS_ERROR;
+        return 0;
+    }
+    if (result.value < 0 || result.value > VALUE_MAX) {
+        printf("(-) Error: Address %s -> %lld is out of range\n", op, (long long)result.value);
+        *status = STATUS_ERROR;
         return 0;
     }
 
     uint32_t ret = 0;
-    if (ASSEMBLER_FLAGS.legacy_24_bit) ret = ((uint32_t)(label->address)) << 3;
-    else ret = ((uint32_t)(label->address)) << 4;
-    if (label->extr > 0) {
+    if (ASSEMBLER_FLAGS.legacy_24_bit) ret = ((uint32_t)(result.value)) << 3;
+    else ret = ((uint32_t)(result.value)) << 4;
+    if (result.external) {
         ret |= E;
-    } else { 
+    } else if (result.relocatable) {
         ret |= R;
+    } else {
+        ret |= A;   // Constant address
     }
 
     // Check for extern
-    if (label->extr > 0) {
+    Label *label = result.external;
+    if (label) {
         label->extr_used = true;
         if (label->use_count < MAX_EXTERN_USAGE) {
             label->used_at[label->use_count] = curr_address;
@@ -147,27 +189,27 @@ uint32_t EncodeDir(char *op, Label labels[MAX_LABELS], size_t *label_count, uint
         } else {
             printf("(*) Too many references to extern label!\n");
         }
-        // fprintf(extern_fd, "%s: %08u\n", label->name, curr_address);
-        // if (!ASSEMBLER_FLAGS.append_to_ext) ASSEMBLER_FLAGS.append_to_ext = true;
     }
 
     if (!ASSEMBLER_FLAGS.legacy_24_bit && !is_last) ret |= M;
     return WORD(ret);
 }
 
-uint32_t EncodeRel(char *op, Label labels[MAX_LABELS], size_t *label_count, uint32_t curr_address, bool is_last) {
-    assert(op && label_count);
+uint32_t EncodeRel(char *op, Label labels[MAX_LABELS], size_t *label_count, uint32_t curr_address, bool is_last, int *status) {
+    assert(op && label_count && status);
 
     Label *label = FindLabel(op, labels, label_count);
     if (!label) { // Undefined label
-        printf("UNDEFINED LABEL: %s\n", op);
+        printf("(-) Error: Undefined label in relative operand: %s\n", op);
+        *status = STATUS_ERROR;
         return 0;
     }
 
     int32_t val = label->address + 1 - curr_address;
 
     if (val < -(1<<20) || val > (1<<20)) {
-        printf("INVALID NUMBER: %s -> %d\n", op, val);
+        printf("(-) Error: Relative operand %s -> %d is out of range\n", op, val);
+        *status = STATUS_ERROR;
         return 0;
     }
 
@@ -0,0 +1,327 @@
+#include "../include/expr.h"
+#include "../include/label.h"
+#include "../include/conditional.h"
+
+#define IS_NAME_START(c) (isalpha((unsigned char)(c)) || (c) == '_')
+#define IS_NAME_CHAR(c)  (isalnum((unsigned char)(c)) || (c) == '_')
+
+typedef struct s_constant {
+    char *name;
+    int64_t value;
+} Constant;
+
+static Constant constants[MAX_CONSTANTS];
+static size_t constant_count = 0;
+
+typedef struct s_expr_parser {
+    const char *p;
+    const ExprScope *scope;
+} ExprParser;
+
+static int ParseOr(ExprParser *parser, ExprValue *result);
+
+static void SkipBlanks(ExprParser *parser) {
+    while (isblank((unsigned char)*parser->p)) parser->p++;
+}
+
+int DefineConstant(const char *name, size_t name_length, int64_t value) {
+    int64_t existing = 0;
+    if (FindConstant(name, name_length, &existing)) return STATUS_WRONG;
+    if (constant_count == MAX_CONSTANTS) return STATUS_ERROR;
+
+    constants[constant_count].name = strndup(name, name_length);
+    if (!constants[constant_count].name) return STATUS_ERROR;
+    constants[constant_count].value = value;
+    constant_count++;
+    return 0;
+}
+
+bool FindConstant(const char *name, size_t name_length, int64_t *value) {
+    for (size_t i = 0; i < constant_count; i++) {
+        if (strlen(constants[i].name) == name_length && strncmp(constants[i].name, name, name_length) == 0) {
+            if (value) *value = constants[i].value;
+            return true;
+        }
+    }
+    return false;
+}
+
+void CleanUpConstants(void) {
+    for (size_t i = 0; i < constant_count; i++) free(constants[i].name);
+    constant_count = 0;
+}
+
+// Labels are matched on their whole name, unlike FindLabel()
+static Label *FindExactLabel(const ExprScope *scope, const char *name, size_t name_length) {
+    for (size_t i = 0; i < *scope->label_count; i++) {
+        Label *label = &scope->labels[i];
+        if (strlen(label->name) == name_length && strncmp(label->name, name, name_length) == 0) return label;
+    }
+    return NULL;
+}
+
+static int ParseName(ExprParser *parser, ExprValue *result) {
+    const char *name = parser->p;
+    while (IS_NAME_CHAR(*parser->p)) parser->p++;
+    size_t name_length = parser->p - name;
+
+    memset(result, 0, sizeof(*result));
+    if (FindConstant(name, name_length, &result->value)) return 0;
+
+    const Define *define = FindDefine(name, name_length);
+    if (define) {
+        result->value = define->value;
+        return 0;
+    }
+
+    // Labels only have their final address in the second pass
+    if (!parser->scope || !parser->scope->labels) {
+        result->unresolved = true;
+        return 0;
+    }
+
+    Label *label = FindExactLabel(parser->scope, name, name_length);
+    if (!label) {
+        printf("(-) Error: Undefined symbol %.*s in expression\n", (int)name_length, name);
+        return STATUS_ERROR;
+    }
+
+    result->relocatable = 1;
+    result->value = (int64_t)label->address;   // 0 unless also defined in this run
+    if (label->extr) result->external = label;
+    return 0;
+}
+
+static int ParseNumber(ExprParser *parser, ExprValue *result) {
+    memset(result, 0, sizeof(*result));
+
+    int base = 10;
+    if (parser->p[0] == '0' && (parser->p[1] == 'x' || parser->p[1] == 'X')) {
+        base = 16;
+        parser->p += 2;
+        if (!isxdigit((unsigned char)*parser->p)) return STATUS_ERROR;
+    }
+
+    uint64_t value = 0;
+    for (;;) {
+        char c = *parser->p;
+        int digit = 0;
+        if (isdigit((unsigned char)c)) digit = c - '0';
+        else if (base == 16 && isxdigit((unsigned char)c)) digit = tolower((unsigned char)c) - 'a' + 10;
+        else break;
+
+        if (value > (uint64_t)INT64_MAX / base) {
+            printf("(-) Error: Number too large in expression\n");
+            return STATUS_ERROR;
+        }
+        value = value * base + digit;
+        parser->p++;
+    }
+    if (value > (uint64_t)INT64_MAX) return STATUS_ERROR;
+
+    result->value = (int64_t)value;
+    return 0;
+}
+
+static int ParsePrimary(ExprParser *parser, ExprValue *result) {
+    SkipBlanks(parser);
+    char c = *parser->p;
+
+    if (c == '(') {
+        parser->p++;
+        if (ParseOr(parser, result) != 0) return STATUS_ERROR;
+        SkipBlanks(parser);
+        if (*parser->p != ')') {
+            printf("(-) Error: Missing ')' in expression\n");
+            return STATUS_ERROR;
+        }
+        parser->p++;
+        return 0;
+    }
+
+    if (c == '-' || c == '+' || c == '~') {
+        parser->p++;
+        if (ParsePrimary(parser, result) != 0) return STATUS_ERROR;
+        if (c == '+') return 0;
+
+        if (!result->unresolved && (result->relocatable || result->external)) {
+            printf("(-) Error: Labels can only be added or subtracted in expressions\n");
+            return STATUS_ERROR;
+        }
+        result->value = (c == '-') ? (int64_t)(0 - (uint64_t)result->value) : ~result->value;
+        return 0;
+    }
+
+    if (isdigit((unsigned char)c)) return ParseNumber(parser, result);
+    if (IS_NAME_START(c)) return ParseName(parser, result);
+
+    return STATUS_ERROR;
+}
+
+// Combines two operands, following labels through + and -
+static int Apply(char op, ExprValue *left, const ExprValue *right) {
+    if (left->unresolved || right->unresolved) {
+        left->unresolved = true;
+        left->relocatable = 0;
+        left->external = NULL;
+        left->value = 0;
+        return 0;
+    }
+
+    uint64_t a = (uint64_t)left->value;
+    uint64_t b = (uint64_t)right->value;
+
+    if (op == '+' || op == '-') {
+        if (right->external && (op == '-' || left->external)) {
+            printf("(-) Error: Invalid arithmetic on extern label %s\n", right->external->name);
+            return STATUS_ERROR;
+        }
+        if (right->external) left->external = right->external;
+
+        left->relocatable += (op == '+') ? right->relocatable : -right->relocatable;
+        left->value = (int64_t)((op == '+') ? a + b : a - b);
+        return 0;
+    }
+
+    if (left->relocatable || right->relocatable || left->external || right->external) {
+        printf("(-) Error: Labels can only be added or subtracted in expressions\n");
+        return STATUS_ERROR;
+    }
+
+    switch (op) {
+        case '*': left->value = (int64_t)(a * b); break;
+        case '&': left->value = (int64_t)(a & b); break;
+        case '|': left->value = (int64_t)(a | b); break;
+        case '^': left->value = (int64_t)(a ^ b); break;
+        case '/':
+        case '%':
+            if (right->value == 0) {
+                printf("(-) Error: Division by zero in expression\n");
+                return STATUS_ERROR;
+            }
+            if (left->value == INT64_MIN && right->value == -1) return STATUS_ERROR;
+            left->value = (op == '/') ? left->value / right->value : left->value % right->value;
+            break;
+        case '<':
+        case '>':
+            if (right->value < 0 || right->value > 63) {
+                printf("(-) Error: Shift count %lld out of range\n", (long long)right->value);
+                return STATUS_ERROR;
+            }
+            left->value = (op == '<') ? (int64_t)(a << right->value) : left->value >> right->value;
+            break;
+        default:
+            return STATUS_ERROR;
+    }
+    return 0;
+}
+
+static int ParseMul(ExprParser *parser, ExprValue *result) {
+    if (ParsePrimary(parser, result) != 0) return STATUS_ERROR;
+
+    for (;;) {
+        SkipBlanks(parser);
+        char op = *parser->p;
+        if (op != '*' && op != '/' && op != '%') return 0;
+        parser->p++;
+
+        ExprValue right;
+        if (ParsePrimary(parser, &right) != 0 || Apply(op, result, &right) != 0) return STATUS_ERROR;
+    }
+}
+
+static int ParseAdd(ExprParser *parser, ExprValue *result) {
+    if (ParseMul(parser, result) != 0) return STATUS_ERROR;
+
+    for (;;) {
+        SkipBlanks(parser);
+        char op = *parser->p;
+        if (op != '+' && op != '-') return 0;
+        parser->p++;
+
+        ExprValue right;
+        if (ParseMul(parser, &right) != 0 || Apply(op, result, &right) != 0) return STATUS_ERROR;
+    }
+}
+
+static int ParseShift(ExprParser *parser, ExprValue *result) {
+    if (ParseAdd(parser, result) != 0) return STATUS_ERROR;
+
+    for (;;) {
+        SkipBlanks(parser);
+        if (strncmp(parser->p, "<<", 2) != 0 && strncmp(parser->p, ">>", 2) != 0) return 0;
+        char op = *parser->p;
+        parser->p += 2;
+
+        ExprValue right;
+        if (ParseAdd(parser, &right) != 0 || Apply(op, result, &right) != 0) return STATUS_ERROR;
+    }
+}
+
+static int ParseAnd(ExprParser *parser, ExprValue *result) {
+    if (ParseShift(parser, result) != 0) return STATUS_ERROR;
+
+    for (;;) {
+        SkipBlanks(parser);
+        if (*parser->p != '&') return 0;
+        parser->p++;
+
+        ExprValue right;
+        if (ParseShift(parser, &right) != 0 || Apply('&', result, &right) != 0) return STATUS_ERROR;
+    }
+}
+
+static int ParseXor(ExprParser *parser, ExprValue *result) {
+    if (ParseAnd(parser, result) != 0) return STATUS_ERROR;
+
+    for (;;) {
+        SkipBlanks(parser);
+        if (*parser->p != '^') return 0;
+        parser->p++;
+
+        ExprValue right;
+        if (ParseAnd(parser, &right) != 0 || Apply('^', result, &right) != 0) return STATUS_ERROR;
+    }
+}
+
+static int ParseOr(ExprParser *parser, ExprValue *result) {
+    if (ParseXor(parser, result) != 0) return STATUS_ERROR;
+
+    for (;;) {
+        SkipBlanks(parser);
+        if (*parser->p != '|') return 0;
+        parser->p++;
+
+        ExprValue right;
+        if (ParseXor(parser, &right) != 0 || Apply('|', result, &right) != 0) return STATUS_ERROR;
+    }
+}
+
+int EvalExpression(const char *text, const char **end, const ExprScope *scope, ExprValue *result) {
+    if (!text || !result) return STATUS_ERROR;
+
+    ExprParser parser = { .p = text, .scope = scope };
+    if (ParseOr(&parser, result) != 0) return STATUS_ERROR;
+
+    if (result->relocatable < 0 || result->relocatable > 1 || (result->external && result->relocatable != 1)) {
+        printf("(-) Error: Expression is a sum of addresses, only differences of labels are numbers\n");
+        return STATUS_ERROR;
+    }
+
+    SkipBlanks(&parser);
+    if (end) *end = parser.p;
+    return 0;
+}
+
+int EvalConstant(const char *text, int64_t *value) {
+    ExprValue result;
+    const char *end = NULL;
+    if (EvalExpression(text, &end, NULL, &result) != 0) return STATUS_ERROR;
+
+    while (isspace((unsigned char)*end)) end++;
+    if (*end != '\0' && *end != COMMENT_DELIM) return STATUS_ERROR;
+    if (result.unresolved) return STATUS_NO_RESULT;
+
+    *value = result.value;
+    return 0;
+}
@@ -9,263 +9,400 @@ uint32_t DC  = 0;
 uint32_t ICF = 0;
 uint32_t DCF = 0;
 
-int BuildSymbolTable(char *file_path, Label labels[MAX_LABELS], size_t *label_count) {
-    if (!file_path || !labels || !label_count) return STATUS_ERROR;
+/*
+ * Sizes a `.data`/`.string` directive and reserves room for it.
+ * With --pool-data the words go to the pool instead, and the returned
+ * "address" is its pool block id until PoolFinalize() lays the pool out.
+ * Returns the address for a label on this line, or STATUS_ERROR.
+ */
+static int ReserveData(char *directive, bool labeled) {
+    if (ASSEMBLER_FLAGS.pool_data) return PoolAddBlock(directive, labeled);
+
+    int values = HandleDSDirective(directive, NULL, NULL);
+    if (values < 0) return STATUS_ERROR;
+
+    int address = (int)DC;
+    DC += values;
+    return address;
+}
 
-    int status = 0;
+/*
+ * Defines a `.equ NAME, expression` constant. The expression may only use
+ * numbers and constants defined before it, so its value is known right away.
+ * Returns 0 upon success, else STATUS_ERROR.
+ */
+static int DefineEqu(char *args, Label labels[MAX_LABELS], size_t *label_count) {
+    while (isspace((unsigned char)*args)) args++;
+
+    char *name = args;
+    size_t name_length = 0;
+    if (isalpha((unsigned char)*name) || *name == '_') {
+        while (isalnum((unsigned char)name[name_length]) || name[name_length] == '_') name_length++;
+    }
 
-    FILE *file_fd = fopen(file_path, "r");
-    if (!file_fd) return STATUS_ERROR;
+    char *rest = name + name_length;
+    while (isblank((unsigned char)*rest)) rest++;
+    if (name_length == 0 || *rest != ',') {
+        printf("(-) Error: Expected '%s NAME, value' <-- %s\n", IEQU, args);
+        return STATUS_ERROR;
+    }
 
-    char line[MAX_LINE_LENGTH] = {0};
-    char *entries[MAX_LABELS] = {0};
-    char *externals[MAX_LABELS] = {0};
-    size_t entry_count = 0;
-    size_t extern_count = 0;
+    int64_t value = 0;
+    int status = EvalConstant(rest + 1, &value);
+    if (status == STATUS_NO_RESULT) {
+        printf("(-) Error: %s values may only use numbers and constants <-- %s\n", IEQU, args);
+        return STATUS_ERROR;
+    } else if (status != 0) {
+        printf("(-) Error: Invalid constant expression <-- %s\n", args);
+        return STATUS_ERROR;
+    }
 
-    while (fgets(line, MAX_LINE_LENGTH, file_fd) != NULL) {
-        LogDebug("Curr: IC->%d/DC->%d\n", IC, DC);
+    for (size_t i = 0; i < *label_count; i++) {
+        if (strlen(labels[i].name) == name_length && strncmp(labels[i].name, name, name_length) == 0) {
+            printf("(-) Error: Constant %.*s is already defined as a label!\n", (int)name_length, name);
+            return STATUS_ERROR;
+        }
+    }
 
-        // Remove comment first
-        char *comment = strchr(line, COMMENT_DELIM);
-        if (comment) *comment = '\0';
+    status = DefineConstant(name, name_length, value);
+    if (status == STATUS_WRONG) {
+        printf("(-) Error: Multiple definitions of constant: %.*s!\n", (int)name_length, name);
+        return STATUS_ERROR;
+    } else if (status != 0) {
+        printf("(-) Error: Too many constants, at most %d are supported\n", MAX_CONSTANTS);
+        return STATUS_ERROR;
+    }
 
-        // Now trim whitespace on the cleaned line
-        char *ptr = TrimWhitespace(line);
-        if (*ptr == '\0') continue; // Line is empty or only spaces/comments
+    LogDebug("Defined constant %.*s = %lld\n", (int)name_length, name, (long long)value);
+    return 0;
+}
 
-        // Handle .entry and .extern directives
-        if (strncmp(ptr, IENTRY, strlen(IENTRY)) == 0) {
-            ptr += strlen(IENTRY);
-            while (isspace((unsigned char)*ptr)) ptr++;  // Skip spaces
+/*
+ * Sizes a single statement and records its label, `.entry` or `.extern`.
+ * Returns 0 upon success, STATUS_ERROR if the line is malformed.
+ */
+static int ProcessLine(char *line, SymbolState *state, Label labels[MAX_LABELS], size_t *label_count) {
+    int status = 0;
 
-            if (*ptr == '\0') {
-                LogInfo("Error: Missing label in .entry directive\n");
-                status = STATUS_ERROR;
-                continue;
-            }
+    LogDebug("Curr: IC->%d/DC->%d\n", IC, DC);
+
+    // Remove comment first
+    char *comment = strchr(line, COMMENT_DELIM);
+    if (comment) *comment = '\0';
+
+    // Now trim whitespace on the cleaned line
+    char *ptr = TrimWhitespace(line);
+    if (*ptr == '\0') return status; // Line is empty or only spaces/comments
+
+    if (strncmp(ptr, IEQU, strlen(IEQU)) == 0 && isspace((unsigned char)ptr[strlen(IEQU)])) {
+        return DefineEqu(ptr + strlen(IEQU), labels, label_count);
+    }
+
+    // Handle .entry and .extern directives
+    if (strncmp(ptr, IENTRY, strlen(IENTRY)) == 0) {
+        ptr += strlen(IENTRY);
+        while (isspace((unsigned char)*ptr)) ptr++;  // Skip spaces
 
-            char *entry_label = TrimWhitespace(ptr);
-            Label *existing = FindLabel(entry_label, labels, label_count);
-            if (existing) {
-                int isExternInFile = 0;
-                for (size_t i = 0; i < extern_count; i++) {
-                    if (strncmp(existing->name, externals[i], strlen(existing->name)) == 0) {
-                        printf("(-) Label %s cannot be defined as both extern and entry in the same file!\n"
-                            , existing->name);
-                        isExternInFile = 1;
-                        break;
-                    }
-                } 
-                
-                if (!isExternInFile) {
-                    entries[entry_count] = strdup(existing->name);
-                    entry_count++;
-                    existing->entr = true;
-                    LogDebug("Parsed entry directive\n");
-                    ASSEMBLER_FLAGS.entry_point_exists = true;
+        if (*ptr == '\0') {
+            LogInfo("Error: Missing label in .entry directive\n");
+            status = STATUS_ERROR;
+            return status;
+        }
+
+        char *entry_label = TrimWhitespace(ptr);
+        Label *existing = FindLabel(entry_label, labels, label_count);
+        if (existing) {
+            int isExternInFile = 0;
+            for (size_t i = 0; i < state->extern_count; i++) {
+                if (strncmp(existing->name, state->externals[i], strlen(existing->name)) == 0) {
+                    printf("(-) Label %s cannot be defined as both extern and entry in the same file!\n"
+                        , existing->name);
+                    isExternInFile = 1;
+                    break;
                 }
-            } else {
-                entries[entry_count] = strdup(entry_label);
-                entry_count++;
+            } 
+            
+            if (!isExternInFile) {
+                state->entries[state->entry_count] = strdup(existing->name);
+                state->entry_count++;
+                existing->entr = true;
                 LogDebug("Parsed entry directive\n");
                 ASSEMBLER_FLAGS.entry_point_exists = true;
             }
-            continue;
+        } else {
+            state->entries[state->entry_count] = strdup(entry_label);
+            state->entry_count++;
+            LogDebug("Parsed entry directive\n");
+            ASSEMBLER_FLAGS.entry_point_exists = true;
         }
+        return status;
+    }
 
-        if (strncmp(ptr, IEXTERN, strlen(IEXTERN)) == 0) {
-            ptr += strlen(IEXTERN);
-            while (isspace((unsigned char)*ptr)) ptr++;  // Skip spaces
+    if (strncmp(ptr, IEXTERN, strlen(IEXTERN)) == 0) {
+        ptr += strlen(IEXTERN);
+        while (isspace((unsigned char)*ptr)) ptr++;  // Skip spaces
 
-            if (*ptr == '\0') {
-                printf("Error: Missing label in .extern directive\n");
-                status = STATUS_ERROR;
-                continue;
-            }
+        if (*ptr == '\0') {
+            printf("Error: Missing label in .extern directive\n");
+            status = STATUS_ERROR;
+            return status;
+        }
 
-            char *extern_label = TrimWhitespace(ptr);
-            Label *existing = FindLabel(extern_label, labels, label_count);
-            if (existing) {
-                // If label is already marked as extern, that's fine
-                if (!existing->extr) {
-                    // Defined in this same file
-                    existing->extr = 1;
-                    LogDebug("Warning: %s declared extern but already defined; assuming multi-file linking.\n", extern_label);                    continue;
-                }
-                continue;
+        char *extern_label = TrimWhitespace(ptr);
+        Label *existing = FindLabel(extern_label, labels, label_count);
+        if (existing) {
+            // If label is already marked as extern, that's fine
+            if (!existing->extr) {
+                // Defined in this same file
+                existing->extr = 1;
+                LogDebug("Warning: %s declared extern but already defined; assuming multi-file linking.\n", extern_label);                    return status;
             }
+            return status;
+        }
 
-            memset(&labels[*label_count], 0, sizeof(Label));
-            labels[*label_count].name = strdup(extern_label);
-            labels[*label_count].address = 0;
-            labels[*label_count].extr = 1;
-            (*label_count)++;
+        memset(&labels[*label_count], 0, sizeof(Label));
+        labels[*label_count].name = strdup(extern_label);
+        labels[*label_count].address = 0;
+        labels[*label_count].extr = 1;
+        (*label_count)++;
 
-            externals[extern_count] = strdup(extern_label);
-            extern_count++;
+        state->externals[state->extern_count] = strdup(extern_label);
+        state->extern_count++;
 
-            LogDebug("Parsed extern directive\n");
+        LogDebug("Parsed extern directive\n");
 
-            continue;
-        }
+        return status;
+    }
 
-        // Handle Label Definitions
-        Label *curr = malloc(sizeof(Label));
-        if (!curr) {
-            fclose(file_fd);
-            return STATUS_ERROR;
+    // Handle Label Definitions
+    Label *curr = malloc(sizeof(Label));
+    if (!curr) return STATUS_ERROR;
+    memset(curr, 0, sizeof(Label));
+
+    int label_status = AddLabel(ptr, curr);
+    if (label_status == STATUS_NO_RESULT) {
+        // No label, either DS directives or instructions
+        free(curr);
+        
+        // Handle `.data` and `.string` directives
+        if (strncmp(ptr, ISTRING, strlen(ISTRING)) == 0
+        || strncmp(ptr, IDATA, strlen(IDATA)) == 0) {
+            if (ReserveData(ptr, false) < 0) {
+                printf("Error in size calculation in line: %s", line);
+                status = STATUS_ERROR;
+                return status;
+            }
         }
-        memset(curr, 0, sizeof(Label));
+        else { // Instruction or comment
+            int offset = 0;
+            while(isblank(ptr[offset])) offset++;
+            if (ptr[offset] == COMMENT_DELIM) return status;
 
-        int label_status = AddLabel(ptr, curr);
-        if (label_status == STATUS_NO_RESULT) {
-            // No label, either DS directives or instructions
-            free(curr);
-            
-            // Handle `.data` and `.string` directives
-            if (strncmp(ptr, ISTRING, strlen(ISTRING)) == 0
-            || strncmp(ptr, IDATA, strlen(IDATA)) == 0) {
-                int values = HandleDSDirective(ptr, NULL);
-                if (values < 0) {
-                    printf("Error in size calculation in line: %s", line);
-                    status = STATUS_ERROR;
-                    continue;
-                }
-                DC += values;
+            char *clean_line = ptr + offset;
+            char mnemonic[MAX_MNEMONIC_LENGTH + 1] = {0};
+
+            CopyToken(clean_line, mnemonic, sizeof(mnemonic));
+            const Command *com = FindCommand(mnemonic);
+            if (!com) {
+                printf("(-) Error: parsing instruction in line: %s\n", line);
+                status = STATUS_ERROR;
+                return status;
             }
-            else { // Instruction or comment
-                int offset = 0;
-                while(isblank(ptr[offset])) offset++;
-                if (ptr[offset] == COMMENT_DELIM) continue;
 
-                char *clean_line = ptr + offset;
-                char mnemonic[MAX_LINE_LENGTH] = {0};
+            int words = ValidateCommand(ptr + offset, com);
+            if (words < 0) {
+                printf("(-) Error in size calculation in line: %s\n", line);
+                status = STATUS_ERROR;
+                return status;
+            }
+            IC += words;
+        }
+        // Continue to next line
+        return status;
+    } else if (label_status == STATUS_ERROR) {
+        free(curr);
+        printf("(-) Error: AddLabel failed with status:{-1} in line: %s", line);
+        status = STATUS_ERROR;
+        return status;
+    }
 
-                sscanf(clean_line, "%s", mnemonic);
-                const Command *com = FindCommand(mnemonic);
-                if (!com) {
-                    printf("(-) Error: parsing instruction in line: %s\n", line);
-                    status = STATUS_ERROR;
-                    continue;
-                }
+    // Locate the colon (`:`) manually
+    char *rest = strchr(ptr, LABEL_DELIM);
+    if (!rest) {
+        printf("(-) Error: malformed label in line: %s\n", line);
+        free(curr);
+        status = STATUS_ERROR;
+        return status;
+    }
+    rest++;  // Move past the colon
 
-                int words = ValidateCommand(ptr + offset, com);
-                if (words < 0) {
-                    printf("(-) Error in size calculation in line: %s\n", line);
-                    status = STATUS_ERROR;
-                    continue;
+    while (isspace((unsigned char)*rest)) rest++;  // Skip spaces after colon
+
+    if (FindConstant(curr->name, strlen(curr->name), NULL)) {
+        printf("(-) Error: Label %s is already defined as a constant!\n", curr->name);
+        CleanUpLabel(curr);
+        return STATUS_ERROR;
+    }
+
+    Label *found = FindLabel(curr->name, labels, label_count);
+    if (found) {
+        if (found->extr) {
+            // Was previously extern
+            found->address = IC;
+            found->type = curr->type;
+            found->extr = 0; // No longer external
+            LogDebug("Updated previously extern label %s to local definition\n", curr->name);
+            // Adjust counters
+            if (curr->type == E_DATA) {
+                int address = ReserveData(rest, true);
+                if (address >= 0) found->address = address;
+            } else {
+                char mnemonic[MAX_MNEMONIC_LENGTH + 1] = {0};
+                CopyToken(rest, mnemonic, sizeof(mnemonic));
+                const Command *com = FindCommand(mnemonic);
+                if (com) {
+                    int words = ValidateCommand(rest, com);
+                    if (words > 0) IC += words;
                 }
-                IC += words;
             }
-            // Continue to next line
-            continue;
-        } else if (label_status == STATUS_ERROR) {
             free(curr);
-            printf("(-) Error: AddLabel failed with status:{-1} in line: %s", line);
-            status = STATUS_ERROR;
-            continue;
-        }
+            return status;
+    } else {
+        // Fully defined already
+        printf("(-) Error: Multiple definitions of label: %s!\n", curr->name);
+        free(curr);
+        status = STATUS_ERROR;
+        return status;
+    }
+}
 
-        // Locate the colon (`:`) manually
-        char *rest = strchr(ptr, LABEL_DELIM);
-        if (!rest) {
-            printf("(-) Error: malformed label in line: %s\n", line);
-            free(curr);
+    if (curr->type == E_DATA) {
+        int address = ReserveData(rest, true);
+        if (address < 0) {
+            printf("(-) Error: Failed to calculate data size for label %s!, %s\n", curr->name, rest);
             status = STATUS_ERROR;
-            continue;
         }
-        rest++;  // Move past the colon
-
-        while (isspace((unsigned char)*rest)) rest++;  // Skip spaces after colon
-
-        Label *found = FindLabel(curr->name, labels, label_count);
-        if (found) {
-            if (found->extr) {
-                // Was previously extern
-                found->address = (curr->type == E_DATA) ? DC : IC;
-                found->type = curr->type;
-                found->extr = 0; // No longer external
-                LogDebug("Updated previously extern label %s to local definition\n", curr->name);
-                // Adjust counters
-                if (curr->type == E_DATA) {
-                    int values = HandleDSDirective(rest, NULL);
-                    if (values >= 0) DC += values;
-                } else {
-                    const Command *com = FindCommand(rest);
-                    if (com) {
-                        int words = ValidateCommand(rest, com);
-                        if (words > 0) IC += words;
-                    }
-                }
-                free(curr);
-                continue;
+        else curr->address = address;
+    } else {
+        curr->address = IC;
+        
+        char mnemonic[MAX_MNEMONIC_LENGTH + 1] = {0};
+        CopyToken(rest, mnemonic, sizeof(mnemonic));
+
+        const Command *com = FindCommand(mnemonic);
+        if (com) {
+            int words = ValidateCommand(rest, com);
+            if (words > 0) {
+                IC += words;
+            } else {
+                printf("(-) Error: Illegal command parameters in label: %s: %s\n", curr->name, rest);
+                status = STATUS_ERROR;
+            }
         } else {
-            // Fully defined already
-            printf("(-) Error: Multiple definitions of label: %s!\n", curr->name);
-            free(curr);
+            printf("(-) Error: Illegal command in label: %s!, %s\n", curr->name, rest);
             status = STATUS_ERROR;
-            continue;
         }
     }
 
-        if (curr->type == E_DATA) {
-            curr->address = DC;
-            int values =  HandleDSDirective(rest, NULL);
-            if (values < 0) {
-                printf("(-) Error: Failed to calculate data size for label %s!, %s\n", curr->name, rest);
-                status = STATUS_ERROR;
-            }
-            else DC += values;
-        } else {
-            curr->address = IC;
-            
-            char mnemonic[MAX_LINE_LENGTH] = {0};
-            sscanf(rest, "%s", mnemonic);
+    // Store label
+    labels[*label_count] = *curr;
+    (*label_count)++;
 
-            const Command *com = FindCommand(mnemonic);
-            if (com) {
-                int words = ValidateCommand(rest, com);
-                if (words > 0) {
-                    IC += words;
-                } else {
-                    printf("(-) Error: Illegal command parameters in label: %s: %s\n", curr->name, rest);
-                    status = STATUS_ERROR;
-                }
-            } else {
-                printf("(-) Error: Illegal command in label: %s!, %s\n", curr->name, rest);
-                status = STATUS_ERROR;
-            }
+    free(curr);
+    return status;
+}
+
+/*
+ * Sizes a `.rept`/`.irp` block without unrolling it.
+ * A `.rept` body is sized once and scaled by its count; an `.irp` body is
+ * sized once per value, since the values may change its addressing modes.
+ */
+static int SizeRepeatBlock(char *header, LineReader *reader, SymbolState *state, Label labels[MAX_LABELS], size_t *label_count) {
+    RepeatBlock block;
+    if (ReadRepeatBlock(header, reader, &block) != 0) {
+        CleanUpRepeat(&block);
+        return STATUS_ERROR;
+    }
+
+    int status = 0;
+    char *buf = NULL;
+    size_t buf_size = 0;
+    uint32_t ic = IC;
+    uint32_t dc = DC;
+    size_t pooled = PoolWords();
+
+    size_t iterations = (block.symbol) ? block.count : 1;
+    for (size_t iter = 0; iter < iterations; iter++) {
+        for (size_t i = 0; i < block.line_count; i++) {
+            char *line = RepeatLine(&block, i, iter, &buf, &buf_size);
+            if (!line || ProcessLine(line, state, labels, label_count) != 0) status = STATUS_ERROR;
         }
+    }
 
-        // Store label
-        labels[*label_count] = *curr;
-        (*label_count)++;
+    if (!block.symbol) {
+        IC = ic + (IC - ic) * (uint32_t)block.count;
+        DC = dc + (DC - dc) * (uint32_t)block.count;
+        // Pooled data doesn't move DC, the pool repeats the body's words itself
+        if (ASSEMBLER_FLAGS.pool_data && PoolRepeat(pooled, block.count) != 0) status = STATUS_ERROR;
+    }
 
-        free(curr);
+    LogDebug("Sized repetition block: %zu iterations, %u code words, %u data words\n",
+        block.count, IC - ic, DC - dc);
+
+    free(buf);
+    CleanUpRepeat(&block);
+    return status;
+}
+
+int BuildSymbolTable(char *file_path, Label labels[MAX_LABELS], size_t *label_count) {
+    if (!file_path || !labels || !label_count) return STATUS_ERROR;
+
+    int status = 0;
+
+    LineReader reader;
+    if (LineReaderOpen(&reader, file_path) != 0) return STATUS_ERROR;
+
+    char *line = NULL;
+    SymbolState state = {0};
+
+    while ((line = ReadLine(&reader)) != NULL) {
+        if (IsRepeatStart(line)) {
+            if (SizeRepeatBlock(line, &reader, &state, labels, label_count) != 0) status = STATUS_ERROR;
+            continue;
+        }
+        if (IsRepeatEnd(line)) {
+            printf("(-) Error: '%s' without a matching '%s' or '%s'\n", IENDR, IREPT, IIRP);
+            status = STATUS_ERROR;
+            continue;
+        }
+        if (ProcessLine(line, &state, labels, label_count) != 0) status = STATUS_ERROR;
+    }
+    if (reader.failed) {
+        printf("(-) Error: Out of memory reading line %zu of %s\n", reader.line_no + 1, file_path);
+        status = STATUS_ERROR;
     }
 
     // Re-check entries
     LogDebug("Validating entry definitions...\n");
-    for (size_t i = 0; i < entry_count; i++) {
-        Label *entry = FindLabel(entries[i], labels, label_count);
+    for (size_t i = 0; i < state.entry_count; i++) {
+        Label *entry = FindLabel(state.entries[i], labels, label_count);
         if (!entry) {
-            printf("(-) Error: .entry label %s is not defined in this file!\n", entries[i]);
+            printf("(-) Error: .entry label %s is not defined in this file!\n", state.entries[i]);
             status = STATUS_ERROR;
         } else {
             entry->entr = 1;
         }
 
-        free(entries[i]);
+        free(state.entries[i]);
     }
 
     if (status == 0) {
         LogVerbose("Generated symbol table for file %s.\n", file_path);
-        LogVerbose("Found %zu entry point(s) and %zu external reference(s)\n", entry_count, extern_count);
+        LogVerbose("Found %zu entry point(s) and %zu external reference(s)\n", state.entry_count, state.extern_count);
         LogVerbose("Compiled %zu symbols in file %s\n", *label_count, file_path);
     }
 
-    fclose(file_fd);
+    LineReaderClose(&reader);
     return status;
 }
 
@@ -288,7 +425,7 @@ int ValidateSymbolTable(Label labels[MAX_LABELS], size_t *label_count) {
         if (labels[i].type == E_DATA) labels[i].address += ICF;
     }
 
-    if (!is_start) {
+    if (!is_start && !ASSEMBLER_FLAGS.compile_only) {  // An object needn't hold START, the linker checks
         LogInfo("(*) Warning: Could not find START in program!\n");
     }
 
@@ -1,4 +1,5 @@
 #include "../include/flags.h"
+#include "../include/stats.h"
 
 Flags ASSEMBLER_FLAGS = {0};
 
@@ -8,11 +9,21 @@ void PrintHelp() {
     printf("  -v, --verbose        Enable verbose logging\n");
     printf("  -d, --debug          Enable debug-level logging\n");
     printf("  -q, --quiet          Suppress all logging\n");
-    printf("  -s, --symbols        Output symbol table\n");
+    printf("  -s, --symbols        Output symbol table, and write it to a .sns file\n");
     printf("  -x, --externals      Generate external references\n");
     printf("  -e  --entries        Generate entry references");
     printf("  -o, --output <file>  Specify output file\n");
     printf("  -l  --legacy-24      Use Legacy encoding for a 24-bit architecture\n");
+    printf("  -O, --optimize       Rewrite instructions into shorter equivalents\n");
+    printf("      --gc-sections    Drop code and data blocks nothing refers to\n");
+    printf("      --layout-profile <file>  Order code blocks hottest first by a profile from snvm -p\n");
+    printf("  -c, --compile        Assemble each file into its own relocatable .snl object\n");
+    printf("  -g, --debug-map      Write a .snd map from addresses to source lines\n");
+    printf("      --listing        Write a .lst listing of every statement with its address and words\n");
+    printf("      --stats[=json]   Print the time, throughput and memory of each stage and file, or write them\n");
+    printf("                       to <output>.stats.json\n");
+    printf("  -D NAME[=value]      Define a symbol for conditional assembly (value defaults to 1)\n");
+    printf("      --pool-data      Share identical .data/.string blocks (data must be read-only)\n");
     printf("      --version        Show assembler version\n");
     printf("      --help           Show this help message\n");
 }
@@ -49,6 +60,32 @@ int ParseFlags(int argc, char **argv, char ***input_files, int *input_count) {
             ASSEMBLER_FLAGS.gen_entries = true;
         } else if (strcmp(arg, "-l") == 0 || strcmp(arg, "--legacy-24") == 0) {
             ASSEMBLER_FLAGS.legacy_24_bit = true;
+        } else if (strcmp(arg, "-O") == 0 || strcmp(arg, "--optimize") == 0) {
+            ASSEMBLER_FLAGS.optimize = true;
+        } else if (strcmp(arg, "--gc-sections") == 0) {
+            ASSEMBLER_FLAGS.gc_sections = true;
+        } else if (strcmp(arg, "--layout-profile") == 0 && (i + 1 < argc)) {
+            ASSEMBLER_FLAGS.layout_profile = argv[++i];
+        } else if (strcmp(arg, "-c") == 0 || strcmp(arg, "--compile") == 0) {
+            ASSEMBLER_FLAGS.compile_only = true;
+        } else if (strcmp(arg, "-g") == 0 || strcmp(arg, "--debug-map") == 0) {
+            ASSEMBLER_FLAGS.debug_map = true;
+        } else if (strcmp(arg, "--listing") == 0) {
+            ASSEMBLER_FLAGS.listing = true;
+        } else if (strcmp(arg, "--stats") == 0 || strcmp(arg, "--stats=text") == 0) {
+            ASSEMBLER_FLAGS.stats = STATS_TEXT;
+        } else if (strcmp(arg, "--stats=json") == 0) {
+            ASSEMBLER_FLAGS.stats = STATS_JSON;
+        } else if (strncmp(arg, "-D", 2) == 0) {
+            // Both `-D NAME=value` and `-DNAME=value`
+            const char *spec = (arg[2] != '\0') ? arg + 2 : (i + 1 < argc) ? argv[++i] : NULL;
+            if (AddDefine(spec) != 0) {
+                printf("(-) Invalid define: %s\n", spec ? spec : arg);
+                free(*input_files);
+                return STATUS_ERROR;
+            }
+        } else if (strcmp(arg, "--pool-data") == 0) {
+            ASSEMBLER_FLAGS.pool_data = true;
         } else if (strcmp(arg, "--help") == 0) {
             PrintHelp();
             exit(0);
@@ -0,0 +1,130 @@
+#include "../include/include.h"
+
+// Every include preassembled during this run
+static IncludeFile **cache = NULL;
+static size_t cache_count = 0;
+static size_t cache_capacity = 0;
+
+int GetIncludePath(const char *line, char *dst, size_t dst_size) {
+    if (!line || !dst || dst_size == 0) return STATUS_ERROR;
+    dst[0] = '\0';
+
+    while (isblank((unsigned char)*line)) line++;
+    if (strncmp(line, IINCLUDE, strlen(IINCLUDE)) != 0) return STATUS_ERROR;
+    line += strlen(IINCLUDE);
+
+    while (isblank((unsigned char)*line)) line++;
+    if (*line != '"') return STATUS_ERROR;
+    line++;
+
+    const char *close = strchr(line, '"');
+    if (!close || close == line || (size_t)(close - line) >= dst_size) return STATUS_ERROR;
+
+    // Only a comment may follow the path
+    const char *rest = close + 1;
+    while (isspace((unsigned char)*rest)) rest++;
+    if (*rest != '\0' && *rest != COMMENT_DELIM) return STATUS_ERROR;
+
+    memcpy(dst, line, close - line);
+    dst[close - line] = '\0';
+    return 0;
+}
+
+int ResolveIncludePath(const char *includer, const char *path, char *dst, size_t dst_size) {
+    if (!includer || !path || !dst) return STATUS_ERROR;
+
+    const char *slash = strrchr(includer, '/');
+    size_t dir_length = (path[0] == '/' || !slash) ? 0 : (size_t)(slash - includer + 1);
+
+    if ((size_t)snprintf(dst, dst_size, "%.*s%s", (int)dir_length, includer, path) >= dst_size) {
+        return STATUS_ERROR;
+    }
+    return 0;
+}
+
+IncludeFile *FindInclude(const char *path) {
+    for (size_t i = 0; i < cache_count; i++) {
+        if (strcmp(cache[i]->path, path) == 0) return cache[i];
+    }
+    return NULL;
+}
+
+IncludeFile *AddInclude(const char *path, char *source, size_t length) {
+    if (!path || !source) return NULL;
+
+    if (cache_count == cache_capacity) {
+        size_t new_capacity = (cache_capacity == 0) ? 8 : cache_capacity * 2;
+        IncludeFile **temp = realloc(cache, new_capacity * sizeof(IncludeFile *));
+        if (!temp) return NULL;
+        cache = temp;
+        cache_capacity = new_capacity;
+    }
+
+    IncludeFile *include = calloc(1, sizeof(IncludeFile));
+    if (!include) return NULL;
+
+    include->path = strdup(path);
+    if (!include->path || InitMacroTable(&include->macros) != 0) {
+        free(include->path);
+        free(include);
+        return NULL;
+    }
+    include->source = source;
+    include->length = length;
+
+    cache[cache_count++] = include;
+    return include;
+}
+
+int AppendInclude(IncludeList *list, IncludeFile *include) {
+    if (!list || !include) return STATUS_ERROR;
+
+    for (size_t i = 0; i < list->count; i++) {
+        if (list->items[i] == include) return 0;
+    }
+
+    if (list->count == list->capacity) {
+        size_t new_capacity = (list->capacity == 0) ? 4 : list->capacity * 2;
+        IncludeFile **temp = realloc(list->items, new_capacity * sizeof(IncludeFile *));
+        if (!temp) return STATUS_ERROR;
+        list->items = temp;
+        list->capacity = new_capacity;
+    }
+
+    list->items[list->count++] = include;
+    return 0;
+}
+
+Macro *FindIncludedMacro(const char *name, size_t name_length, const IncludeList *list) {
+    if (!list) return NULL;
+
+    for (size_t i = 0; i < list->count; i++) {
+        IncludeFile *include = list->items[i];
+
+        Macro *macro = FindMacro(name, name_length, &include->macros);
+        if (!macro) macro = FindIncludedMacro(name, name_length, &include->includes);
+        if (macro) return macro;
+    }
+    return NULL;
+}
+
+void CleanUpIncludeList(IncludeList *list) {
+    if (!list) return;
+    free(list->items);
+    memset(list, 0, sizeof(*list));
+}
+
+void CleanUpIncludes(void) {
+    for (size_t i = 0; i < cache_count; i++) {
+        IncludeFile *include = cache[i];
+        CleanUpMacros(&include->macros);
+        CleanUpIncludeList(&include->includes);
+        free(include->expansion);
+        free(include->source);
+        free(include->path);
+        free(include);
+    }
+    free(cache);
+    cache = NULL;
+    cache_count = cache_capacity = 0;
+}
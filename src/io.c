@@ -1,2 +1,191 @@
 #include "../include/io.h"
 
+int LineReaderOpen(LineReader *reader, const char *path) {
+    if (!reader || !path) return STATUS_ERROR;
+    memset(reader, 0, sizeof(*reader));
+
+    reader->file = fopen(path, "r");
+    if (!reader->file) return STATUS_ERROR;
+
+    reader->buf = malloc(LINE_READER_CHUNK + 1);
+    if (!reader->buf) {
+        fclose(reader->file);
+        reader->file = NULL;
+        return STATUS_ERROR;
+    }
+    reader->cap = LINE_READER_CHUNK + 1;
+    return 0;
+}
+
+/*
+ * Moves the unread tail to the front of the buffer, grows it if a single line
+ * fills it completely, and appends the next chunk of the file.
+ * Returns the number of bytes read, 0 with reader->failed set if it can't grow.
+ */
+static size_t Refill(LineReader *reader) {
+    size_t tail = reader->len - reader->pos;
+    memmove(reader->buf, reader->buf + reader->pos, tail);
+    reader->len = tail;
+    reader->pos = 0;
+
+    // Always keep one spare byte for the terminating NUL
+    if (reader->cap - reader->len <= LINE_READER_CHUNK / 2) {
+        char *temp = realloc(reader->buf, reader->cap * 2);
+        if (!temp) {
+            reader->failed = true;
+            return 0;
+        }
+        reader->buf = temp;
+        reader->cap *= 2;
+    }
+
+    size_t n = fread(reader->buf + reader->len, 1, reader->cap - reader->len - 1, reader->file);
+    if (n == 0) reader->eof = true;
+    reader->len += n;
+    return n;
+}
+
+char *ReadLine(LineReader *reader) {
+    if (!reader || !reader->buf) return NULL;
+
+    // Give back the byte we borrowed for the previous terminator
+    if (reader->held) {
+        reader->buf[reader->pos] = reader->held;
+        reader->held = 0;
+    }
+
+    size_t scanned = 0;
+    for (;;) {
+        char *start = reader->buf + reader->pos;
+        size_t avail = reader->len - reader->pos;
+        char *newline = memchr(start + scanned, '\n', avail - scanned);
+
+        if (newline) {
+            size_t line_len = (size_t)(newline - start) + 1;
+            reader->pos += line_len;
+            if (reader->pos < reader->len) reader->held = reader->buf[reader->pos];
+            reader->buf[reader->pos] = '\0';
+            reader->line_no++;
+            return start;
+        }
+
+        scanned = avail;
+        if (reader->eof || Refill(reader) == 0) break;
+    }
+
+    // A partial line would pass for the last one
+    if (reader->failed) return NULL;
+
+    // Last line without a trailing newline
+    if (reader->pos == reader->len) return NULL;
+    char *start = reader->buf + reader->pos;
+    reader->buf[reader->len] = '\0';
+    reader->pos = reader->len;
+    reader->line_no++;
+    return start;
+}
+
+void LineReaderClose(LineReader *reader) {
+    if (!reader) return;
+    if (reader->file) fclose(reader->file);
+    free(reader->buf);
+    memset(reader, 0, sizeof(*reader));
+}
+
+char *ReadFile(const char *path, size_t *length) {
+    if (!path) return NULL;
+
+    FILE *file = fopen(path, "rb");
+    if (!file) return NULL;
+
+    size_t cap = LINE_READER_CHUNK;
+    size_t len = 0;
+    char *buf = malloc(cap + 1);
+    if (!buf) {
+        fclose(file);
+        return NULL;
+    }
+
+    size_t n = 0;
+    while ((n = fread(buf + len, 1, cap - len, file)) > 0) {
+        len += n;
+        if (len < cap) continue;
+
+        char *temp = realloc(buf, cap * 2 + 1);
+        if (!temp) {
+            free(buf);
+            fclose(file);
+            return NULL;
+        }
+        buf = temp;
+        cap *= 2;
+    }
+
+    fclose(file);
+    buf[len] = '\0';
+    if (length) *length = len;
+    return buf;
+}
+
+void SiblingPath(const char *path, const char *extension, char *dst, size_t dst_size) {
+    snprintf(dst, dst_size, "%s", path);
+    char *dot = strrchr(dst, '.');
+    char *slash = strrchr(dst, '/');
+    if (dot && (!slash || dot > slash)) *dot = '\0';
+    size_t length = strlen(dst);
+    snprintf(dst + length, dst_size - length, "%s", extension);
+}
+
+int WriterOpen(BufferedWriter *writer, FILE *file) {
+    if (!writer || !file) return STATUS_ERROR;
+    memset(writer, 0, sizeof(*writer));
+
+    writer->buf = malloc(WRITER_BUFFER);
+    if (!writer->buf) return STATUS_ERROR;
+    writer->file = file;
+    return 0;
+}
+
+int WriterFlush(BufferedWriter *writer) {
+    if (writer->len > 0 && !writer->failed) {
+        if (fwrite(writer->buf, 1, writer->len, writer->file) != writer->len) writer->failed = true;
+    }
+    writer->len = 0;
+    return writer->failed ? STATUS_ERROR : 0;
+}
+
+void WriteBytes(BufferedWriter *writer, const char *bytes, size_t length) {
+    if (writer->len + length > WRITER_BUFFER) {
+        WriterFlush(writer);
+        // Too long to be worth gathering, hand it over as it is
+        if (length > WRITER_BUFFER / 2) {
+            if (!writer->failed && fwrite(bytes, 1, length, writer->file) != length) writer->failed = true;
+            return;
+        }
+    }
+    memcpy(writer->buf + writer->len, bytes, length);
+    writer->len += length;
+}
+
+void WriteText(BufferedWriter *writer, const char *text) {
+    WriteBytes(writer, text, strlen(text));
+}
+
+void WriteFormat(BufferedWriter *writer, const char *fmt, ...) {
+    if (WRITER_BUFFER - writer->len < WRITER_MAX_FORMAT) WriterFlush(writer);
+
+    // Formatted straight into the buffer, anything past WRITER_MAX_FORMAT is cut off
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(writer->buf + writer->len, WRITER_MAX_FORMAT, fmt, args);
+    va_end(args);
+    if (n > 0) writer->len += ((size_t)n < WRITER_MAX_FORMAT) ? (size_t)n : WRITER_MAX_FORMAT - 1;
+}
+
+int WriterClose(BufferedWriter *writer) {
+    if (!writer || !writer->buf) return STATUS_ERROR;
+    int status = WriterFlush(writer);
+    free(writer->buf);
+    writer->buf = NULL;
+    return status;
+}
@@ -1,6 +1,6 @@
 #include "../include/label.h"
 
-LType DetermineLabelType(char *token);
+LType DetermineLabelType(const char *token);
 int     ValidateLabelName(char *name);
 
 Label *FindLabel(char *name, Label labels[MAX_LABELS], size_t *label_count) {
@@ -17,24 +17,16 @@ Label *FindLabel(char *name, Label labels[MAX_LABELS], size_t *label_count) {
 int AddLabel(const char *line, Label *label) {
     if (!line || !label) return STATUS_ERROR;
 
-    // Make a local copy of the line to avoid modifying the original
-    char line_copy[MAX_LINE_LENGTH];
-    strncpy(line_copy, line, MAX_LINE_LENGTH);
-    line_copy[MAX_LINE_LENGTH - 1] = '\0';  // Ensure null termination
-
-    // Remove comments
-    char *comment_start = strchr(line_copy, COMMENT_DELIM);
-    if (comment_start) *comment_start = '\0';  // Truncate at comment
-
     // Skip leading whitespace manually
-    char *ptr = line_copy;
+    const char *ptr = line;
     while (isspace((unsigned char)*ptr)) ptr++;  
 
-    if (*ptr == '\0') return STATUS_NO_RESULT;  // Empty line
+    if (*ptr == '\0' || *ptr == COMMENT_DELIM) return STATUS_NO_RESULT;  // Empty line
 
-    // Locate colon (`:`) for label declaration
-    char *colon = strchr(ptr, LABEL_DELIM);
-    if (!colon) return STATUS_NO_RESULT;  // Not a label declaration
+    // Locate colon (`:`) for label declaration, ignoring comments
+    const char *colon = strchr(ptr, LABEL_DELIM);
+    const char *comment_start = strchr(ptr, COMMENT_DELIM);
+    if (!colon || (comment_start && comment_start < colon)) return STATUS_NO_RESULT;  // Not a label declaration
 
     // Find the label name length while ensuring it's valid
     size_t label_length = colon - ptr;
@@ -63,7 +55,7 @@ int AddLabel(const char *line, Label *label) {
 }
 
 
-LType DetermineLabelType(char *token) {
+LType DetermineLabelType(const char *token) {
     if (strncmp(token, ISTRING, strlen(ISTRING)) == 0 
     || strncmp(token, IDATA, strlen(IDATA)) == 0) {
         return E_DATA;
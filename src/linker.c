@@ -0,0 +1,370 @@
+#include "../include/linker.h"
+#include "../include/archive.h"
+
+// Appends a symbol to a growable array. Returns 0 upon success, else STATUS_ERROR
+static int AppendSymbol(ObjectSymbol **symbols, size_t *count, const char *name, size_t length, uint32_t address) {
+    ObjectSymbol *temp = realloc(*symbols, (*count + 1) * sizeof(ObjectSymbol));
+    if (!temp) return STATUS_ERROR;
+    *symbols = temp;
+
+    temp[*count].name = strndup(name, length);
+    if (!temp[*count].name) return STATUS_ERROR;
+    temp[*count].address = address;
+    (*count)++;
+    return 0;
+}
+
+// Parses a `K|NAME|address` record into the given array
+static int ReadSymbolRecord(const char *line, ObjectSymbol **symbols, size_t *count) {
+    const char *name = line + 2;
+    const char *bar = strchr(name, '|');
+    if (!bar || bar == name) return STATUS_ERROR;
+
+    char *end = NULL;
+    unsigned long address = strtoul(bar + 1, &end, 10);
+    if (end == bar + 1) return STATUS_ERROR;
+    return AppendSymbol(symbols, count, name, bar - name, (uint32_t)address);
+}
+
+// Splits off the next line of a text, or returns NULL at its end
+static char *NextLine(char **text) {
+    if (!*text || **text == '\0') return NULL;
+    char *line = *text;
+    char *newline = strchr(line, '\n');
+    if (newline) {
+        *newline = '\0';
+        *text = newline + 1;
+    } else {
+        *text = line + strlen(line);
+    }
+    return line;
+}
+
+int ParseObject(const char *name, char *text, Object *object) {
+    if (!name || !text || !object) return STATUS_ERROR;
+
+    memset(object, 0, sizeof(Object));
+    object->path = strdup(name);
+    if (!object->path) return STATUS_ERROR;
+
+    uint32_t word_count = 0;
+    size_t reloc_capacity = 0;
+    size_t line_no = 2;
+    char *line = NULL;
+
+    // Magic and word size
+    line = NextLine(&text);
+    if (!line || sscanf(line, "SNL|%d", &object->width) != 1 ||
+        (object->width != WORD_SIZE && object->width != WORD_SIZE_LEGACY)) {
+        printf("(-) Error: %s is not a relocatable object, assemble it with -c\n", name);
+        return STATUS_ERROR;
+    }
+
+    // Segment sizes
+    line = NextLine(&text);
+    if (!line || sscanf(line, "%u|%u", &object->code_size, &object->data_size) != 2) {
+        printf("(-) Error: Missing segment sizes in %s\n", name);
+        return STATUS_ERROR;
+    }
+    object->words = calloc((size_t)object->code_size + object->data_size + 1, sizeof(uint32_t));
+    if (!object->words) return STATUS_ERROR;
+
+    while ((line = NextLine(&text)) != NULL) {
+        line_no++;
+        TrimNewline(line);
+        if (*line == '\0') continue;
+
+        int status = 0;
+        unsigned int address = 0, word = 0;
+        if (strncmp(line, "X|", 2) == 0) {
+            status = ReadSymbolRecord(line, &object->externs, &object->extern_count);
+        } else if (strncmp(line, "E|", 2) == 0) {
+            status = ReadSymbolRecord(line, &object->entries, &object->entry_count);
+        } else if (sscanf(line, "R|%u", &address) == 1) {
+            if (object->reloc_count == reloc_capacity) {
+                reloc_capacity = (reloc_capacity == 0) ? 64 : reloc_capacity * 2;
+                uint32_t *temp = realloc(object->relocs, reloc_capacity * sizeof(uint32_t));
+                if (!temp) return STATUS_ERROR;
+                object->relocs = temp;
+            }
+            object->relocs[object->reloc_count++] = address;
+        } else if (sscanf(line, "%u : %x", &address, &word) == 2) {
+            if (word_count >= object->code_size + object->data_size) status = STATUS_ERROR;
+            else object->words[word_count++] = word;
+        } else {
+            status = STATUS_ERROR;
+        }
+
+        if (status != 0) {
+            printf("(-) Error: Invalid record in %s at line %zu: %s\n", name, line_no, line);
+            return STATUS_ERROR;
+        }
+    }
+
+    if (word_count != object->code_size + object->data_size) {
+        printf("(-) Error: %s holds %u words, its header says %u\n", name, word_count, object->code_size + object->data_size);
+        return STATUS_ERROR;
+    }
+    return 0;
+}
+
+void CleanUpObject(Object *object) {
+    for (size_t i = 0; i < object->extern_count; i++) free(object->externs[i].name);
+    for (size_t i = 0; i < object->entry_count; i++) free(object->entries[i].name);
+    free(object->externs);
+    free(object->entries);
+    free(object->relocs);
+    free(object->words);
+    free(object->path);
+    memset(object, 0, sizeof(Object));
+}
+
+int AddObjectText(Link *link, const char *name, char *text) {
+    if (!link || !name || !text) return STATUS_ERROR;
+
+    Object object;
+    int status = ParseObject(name, text, &object);
+
+    if (status == 0 && link->count > 0 && link->objects[0].width != object.width) {
+        printf("(-) Error: %s is a %d-bit object, %s is %d-bit\n", name, object.width, link->objects[0].path, link->objects[0].width);
+        status = STATUS_ERROR;
+    }
+
+    Object *temp = (status == 0) ? realloc(link->objects, (link->count + 1) * sizeof(Object)) : NULL;
+    if (!temp) {
+        CleanUpObject(&object);
+        return STATUS_ERROR;
+    }
+    link->objects = temp;
+    link->objects[link->count++] = object;
+
+    // Entries may only be defined once across the link
+    for (size_t i = 0; i < object.entry_count; i++) {
+        ObjectSymbol *entry = &object.entries[i];
+        status = IndexInsert(&link->entries, entry->name, entry);
+        if (status == STATUS_WRONG) {
+            const char *owner = NULL;
+            for (size_t j = 0; j + 1 < link->count && !owner; j++) {
+                for (size_t k = 0; k < link->objects[j].entry_count; k++) {
+                    if (strcmp(link->objects[j].entries[k].name, entry->name) == 0) owner = link->objects[j].path;
+                }
+            }
+            printf("(-) Error: Entry label %s is defined in both %s and %s\n", entry->name, owner ? owner : name, name);
+        }
+        if (status != 0) return STATUS_ERROR;
+    }
+
+    LogVerbose("Read object %s: %u code word(s), %u data word(s), %zu relocation(s)\n",
+        name, object.code_size, object.data_size, object.reloc_count);
+    return 0;
+}
+
+int AddObject(Link *link, const char *path) {
+    if (!link || !path) return STATUS_ERROR;
+
+    char *text = ReadFile(path, NULL);
+    if (!text) {
+        printf("(-) Error: Failed to open object file: %s\n", path);
+        return STATUS_ERROR;
+    }
+
+    int status = AddObjectText(link, path, text);
+    free(text);
+    return status;
+}
+
+// Converts an address of the object to its linked address
+static int PlaceAddress(const Object *object, uint32_t address, uint32_t *placed) {
+    uint32_t code_end = LINK_BASE_ADDRESS + object->code_size;
+    if (address >= LINK_BASE_ADDRESS && address < code_end) {
+        *placed = address - LINK_BASE_ADDRESS + object->code_base;
+    } else if (address >= code_end && address <= code_end + object->data_size) {
+        *placed = address - code_end + object->data_base;   // A label may sit right past the data
+    } else {
+        return STATUS_ERROR;
+    }
+    return 0;
+}
+
+// Returns the entry named name in any object of the link, or NULL
+static const ObjectSymbol *FindEntry(const Link *link, const char *name) {
+    return IndexFind(&link->entries, name);
+}
+
+// Returns the word at an object address, or NULL if it's outside the object
+static uint32_t *WordAt(Object *object, uint32_t address) {
+    if (address < LINK_BASE_ADDRESS || address - LINK_BASE_ADDRESS >= object->code_size + object->data_size) return NULL;
+    return &object->words[address - LINK_BASE_ADDRESS];
+}
+
+// Moves the addresses the object holds to their linked addresses
+static int RelocateObject(Object *object) {
+    const uint32_t shift = (object->width == WORD_SIZE_LEGACY) ? 3 : 4;
+    const uint32_t bits_mask = (1u << shift) - 1;
+
+    for (size_t i = 0; i < object->reloc_count; i++) {
+        uint32_t at = object->relocs[i];
+        uint32_t *word = WordAt(object, at);
+        bool is_code = (at < LINK_BASE_ADDRESS + object->code_size);
+        uint32_t address = 0;
+
+        // Code words carry their MARE bits below the address, data words are the address
+        if (!word || PlaceAddress(object, is_code ? (*word >> shift) : *word, &address) != 0) {
+            printf("(-) Error: Invalid relocation at %u in %s\n", at, object->path);
+            return STATUS_ERROR;
+        }
+        *word = WORD(is_code ? ((address << shift) | (*word & bits_mask)) : address);
+    }
+    return 0;
+}
+
+// Points the object's extern usages at the entries of the other objects.
+// Returns the number of usages left unresolved, or STATUS_ERROR
+static int ResolveExterns(const Link *link, Object *object) {
+    const uint32_t shift = (object->width == WORD_SIZE_LEGACY) ? 3 : 4;
+    const uint32_t bits_mask = (1u << shift) - 1;
+    const uint32_t value_mask = (1u << (object->width - shift)) - 1;
+    int unresolved = 0;
+
+    for (size_t i = 0; i < object->extern_count; i++) {
+        ObjectSymbol *usage = &object->externs[i];
+        uint32_t *word = WordAt(object, usage->address);
+        uint32_t placed = 0;
+        if (!word || PlaceAddress(object, usage->address, &placed) != 0) {
+            printf("(-) Error: Invalid extern usage of %s at %u in %s\n", usage->name, usage->address, object->path);
+            return STATUS_ERROR;
+        }
+
+        // Unresolved usages stay extern, at address 0 like the assembler leaves them
+        const ObjectSymbol *entry = FindEntry(link, usage->name);
+        uint32_t target = entry ? entry->address : 0;
+        if (!entry) unresolved++;
+
+        uint32_t bits = *word & bits_mask;
+        uint32_t value = 0;
+        if (bits & E) {
+            if (!entry) continue;
+            // Direct operand, the word holds the offset from the extern (`EXT+2`)
+            value = target + (*word >> shift);
+            bits = (bits & ~E) | R;
+        } else {
+            // Relative operand, measured from the word after the command
+            value = (uint32_t)((int64_t)target + 1 - placed);
+        }
+        *word = WORD(((value & value_mask) << shift) | bits);
+        if (entry) LogDebug("Resolved %s at %u to %u\n", usage->name, placed, target);
+    }
+    return unresolved;
+}
+
+int LinkObjects(Link *link) {
+    if (!link || link->count == 0) return STATUS_ERROR;
+
+    int pulled = PullArchiveMembers(link);
+    if (pulled < 0) return STATUS_ERROR;
+    if (link->archive_count > 0) LogVerbose("Pulled %d archive member(s) into the link\n", pulled);
+
+    // Words are written at the objects' size
+    ASSEMBLER_FLAGS.legacy_24_bit = (link->objects[0].width == WORD_SIZE_LEGACY);
+
+    // Code of every object first, then their data, in command line order
+    // followed by the pulled members
+    link->code_size = link->data_size = 0;
+    for (size_t i = 0; i < link->count; i++) {
+        link->objects[i].code_base = LINK_BASE_ADDRESS + link->code_size;
+        link->code_size += link->objects[i].code_size;
+    }
+    for (size_t i = 0; i < link->count; i++) {
+        Object *object = &link->objects[i];
+        object->data_base = LINK_BASE_ADDRESS + link->code_size + link->data_size;
+        link->data_size += object->data_size;
+        LogVerbose("Placed %s: code at %u, data at %u\n", object->path, object->code_base, object->data_base);
+    }
+
+    // Entries move with their object
+    for (size_t i = 0; i < link->count; i++) {
+        Object *object = &link->objects[i];
+        for (size_t j = 0; j < object->entry_count; j++) {
+            ObjectSymbol *entry = &object->entries[j];
+            if (PlaceAddress(object, entry->address, &entry->address) != 0) {
+                printf("(-) Error: Entry label %s is outside of %s\n", entry->name, object->path);
+                return STATUS_ERROR;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < link->count; i++) {
+        if (RelocateObject(&link->objects[i]) != 0) return STATUS_ERROR;
+    }
+
+    int unresolved = 0;
+    for (size_t i = 0; i < link->count; i++) {
+        int status = ResolveExterns(link, &link->objects[i]);
+        if (status < 0) return STATUS_ERROR;
+        unresolved += status;
+    }
+
+    if (!FindEntry(link, "START")) LogInfo("(*) Warning: Could not find START in program!\n");
+    return unresolved;
+}
+
+int WriteProgram(const Link *link, const char *path, bool gen_externals) {
+    if (!link || !path) return STATUS_ERROR;
+
+    FILE *output_fd = fopen(path, "w");
+    if (!output_fd) {
+        printf("(-) Error: Failed to open output file: %s\n", path);
+        return STATUS_ERROR;
+    }
+
+    fprintf(output_fd, "%u|%u\n", link->code_size, link->data_size);
+
+    // Code segments, then data segments
+    for (int segment = 0; segment < 2; segment++) {
+        for (size_t i = 0; i < link->count; i++) {
+            const Object *object = &link->objects[i];
+            uint32_t first = (segment == 0) ? 0 : object->code_size;
+            uint32_t count = (segment == 0) ? object->code_size : object->data_size;
+            uint32_t base = (segment == 0) ? object->code_base : object->data_base;
+            for (uint32_t w = 0; w < count; w++) {
+                fprintf(output_fd, "%08u : ", base + w);
+                WordToHex(output_fd, object->words[first + w]);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < link->count; i++) {
+        const Object *object = &link->objects[i];
+        for (size_t j = 0; j < object->extern_count; j++) {
+            const ObjectSymbol *usage = &object->externs[j];
+            if (FindEntry(link, usage->name)) continue;
+
+            uint32_t placed = 0;
+            PlaceAddress(object, usage->address, &placed);
+            printf("(*) Warning: Extern label %s used in %s was never defined!\n", usage->name, object->path);
+            if (gen_externals) fprintf(output_fd, "X|%s|%08u\n", usage->name, placed);
+        }
+    }
+
+    for (size_t i = 0; i < link->count; i++) {
+        for (size_t j = 0; j < link->objects[i].entry_count; j++) {
+            fprintf(output_fd, "E|%s|%08u\n", link->objects[i].entries[j].name, link->objects[i].entries[j].address);
+        }
+    }
+
+    fclose(output_fd);
+    return 0;
+}
+
+void CleanUpLink(Link *link) {
+    if (!link) return;
+    for (size_t i = 0; i < link->count; i++) CleanUpObject(&link->objects[i]);
+    free(link->objects);
+    link->objects = NULL;
+    link->count = 0;
+    CleanUpIndex(&link->entries);
+    for (size_t i = 0; i < link->archive_count; i++) CleanUpArchive(&link->archives[i]);
+    free(link->archives);
+    link->archives = NULL;
+    link->archive_count = 0;
+}
@@ -0,0 +1,185 @@
+#include "../include/listing.h"
+#include "../include/encoder.h"
+
+#define LISTING_ROW  160  // Bytes of a row before its statement
+
+static FILE *listing_fd = NULL;
+static BufferedWriter writer;
+
+// The statement being listed, kept until its first row is written
+static char *text = NULL;
+static size_t text_length = 0;
+static size_t text_capacity = 0;
+static DebugOrigin origin = {0};
+static bool text_pending = false;
+
+// Words of the row being filled
+static uint32_t row_words[LISTING_WORD_COLUMNS];
+static bool row_data[LISTING_WORD_COLUMNS];
+static uint32_t row_address = 0;
+static size_t row_count = 0;
+
+// What the last rows came from, to head a new file or macro expansion once
+static uint32_t listed_file = 0;
+static uint32_t listed_call = 0;
+
+static size_t code_words = 0;
+static size_t data_words = 0;
+
+static char *PutHex(char *p, uint32_t value, int digits) {
+    static const char hex[] = "0123456789ABCDEF";
+    for (int i = digits - 1; i >= 0; i--) *p++ = hex[(value >> (4 * i)) & 0xF];
+    return p;
+}
+
+// The M, A, R and E bits of a code word, '.' where clear. Legacy words have no M bit
+static char *PutFlags(char *p, uint32_t word) {
+    *p++ = (!ASSEMBLER_FLAGS.legacy_24_bit && (word & M)) ? 'M' : '.';
+    *p++ = (word & A) ? 'A' : '.';
+    *p++ = (word & R) ? 'R' : '.';
+    *p++ = (word & E) ? 'E' : '.';
+    return p;
+}
+
+// Writes the row of words gathered so far, with the statement if it hasn't been shown yet
+static void WriteRow(void) {
+    char row[LISTING_ROW];
+    int digits = WORD_WIDTH / 4;
+    char *p = row;
+
+    if (row_count > 0) p += snprintf(p, 9, "%08u", row_address);
+    else p += sprintf(p, "%8s", "");
+    for (size_t i = 0; i < LISTING_WORD_COLUMNS; i++) {
+        *p++ = ' ';
+        *p++ = ' ';
+        if (i < row_count) {
+            p = PutHex(p, WORD(row_words[i]), digits);
+            *p++ = ' ';
+            if (row_data[i]) p += sprintf(p, "    ");
+            else p = PutFlags(p, row_words[i]);
+        } else {
+            p += sprintf(p, "%*s", digits + 5, "");
+        }
+    }
+
+    if (text_pending) {
+        if (origin.file) p += snprintf(p, 16, "  %5u%c ", origin.line, origin.call ? '+' : ' ');
+        else p += sprintf(p, "  %7s", "");
+        WriteBytes(&writer, row, (size_t)(p - row));
+        WriteBytes(&writer, text, text_length);
+        text_pending = false;
+    } else {
+        // Rows after a statement's first have nothing past their words
+        while (p > row && p[-1] == ' ') p--;
+        WriteBytes(&writer, row, (size_t)(p - row));
+    }
+    WriteBytes(&writer, "\n", 1);
+    row_count = 0;
+}
+
+// Ends the current statement, a statement without words still gets its row
+static void FinishStatement(void) {
+    if (row_count > 0 || text_pending) WriteRow();
+}
+
+int ListingOpen(const char *path, const char *object_path) {
+    listing_fd = fopen(path, "w");
+    if (!listing_fd) {
+        printf("(-) Error: Failed to open output file: %s\n", path);
+        return STATUS_ERROR;
+    }
+    if (WriterOpen(&writer, listing_fd) != 0) {
+        fclose(listing_fd);
+        listing_fd = NULL;
+        return STATUS_ERROR;
+    }
+
+    text_pending = false;
+    row_count = 0;
+    listed_file = listed_call = 0;
+    code_words = data_words = 0;
+    WriteFormat(&writer, "; Listing of %s (%d-bit words, flags M A R E)\n", object_path, WORD_WIDTH);
+    return 0;
+}
+
+void ListingStatement(const char *line, DebugOrigin from) {
+    if (!listing_fd) return;
+    FinishStatement();
+
+    // The statement as the .snm has it, without its marker or line ending
+    const char *marker = DebugFindMarker(line);
+    size_t length = marker ? (size_t)(marker - line) : strlen(line);
+    while (length > 0 && isspace((unsigned char)line[length - 1])) length--;
+
+    if (length + 1 > text_capacity) {
+        size_t new_capacity = (text_capacity == 0) ? 256 : text_capacity;
+        while (new_capacity < length + 1) new_capacity *= 2;
+        char *temp = realloc(text, new_capacity);
+        if (!temp) {
+            length = text_capacity ? text_capacity - 1 : 0;  // Cut the text short rather than fail the listing
+        } else {
+            text = temp;
+            text_capacity = new_capacity;
+        }
+    }
+    if (text) memcpy(text, line, length);
+    text_length = length;
+
+    if (from.file && from.file != listed_file) {
+        const char *name = DebugFileName(from.file);
+        if (name) WriteFormat(&writer, "\n; %s\n", name);
+        listed_file = from.file;
+    }
+    if (from.call && from.call != listed_call) {
+        uint32_t call_file = 0, call_line = 0;
+        const char *macro = DebugCallInfo(from.call, &call_file, &call_line);
+        const char *name = DebugFileName(call_file);
+        if (macro) WriteFormat(&writer, "; macro %s, called at %s:%u\n", macro, name ? name : "?", call_line);
+    }
+    listed_call = from.call;
+
+    origin = from;
+    text_pending = true;
+}
+
+static void ListingWord(uint32_t address, uint32_t word, bool data) {
+    if (!listing_fd) return;
+    if (row_count == LISTING_WORD_COLUMNS || (row_count > 0 && row_address + row_count != address)) WriteRow();
+    if (row_count == 0) row_address = address;
+    row_words[row_count] = word;
+    row_data[row_count] = data;
+    row_count++;
+}
+
+void ListingCode(uint32_t address, uint32_t word) {
+    ListingWord(address, word, false);
+    code_words++;
+}
+
+void ListingData(uint32_t address, uint32_t word) {
+    ListingWord(address, word, true);
+    data_words++;
+}
+
+void ListingSection(const char *title) {
+    if (!listing_fd) return;
+    FinishStatement();
+    WriteFormat(&writer, "\n; %s\n", title);
+    listed_file = listed_call = 0;
+}
+
+int ListingClose(void) {
+    if (!listing_fd) return 0;
+    FinishStatement();
+    WriteFormat(&writer, "\n; %zu code word(s), %zu data word(s)\n", code_words, data_words);
+
+    int status = WriterClose(&writer);
+    if (fclose(listing_fd) != 0) status = STATUS_ERROR;
+    listing_fd = NULL;
+
+    free(text);
+    text = NULL;
+    text_length = text_capacity = 0;
+    text_pending = false;
+    return status;
+}
@@ -1,90 +1,274 @@
 #include "../include/macro.h"
 
-Macro *FindMacro(char *name, Macro macros[MAX_MACROS], size_t *macro_count) {
-    if (macro_count == NULL || macros == NULL || name == NULL) return NULL;
+// FNV-1a over the macro name
+static size_t HashName(const char *name, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+int InitMacroTable(MacroTable *table) {
+    if (table == NULL) return STATUS_ERROR;
 
-    for (size_t i = 0; i < *macro_count; i++) {
-        if (strncmp(macros[i].name, name, strlen(macros[i].name)) == 0) {
-            return &macros[i];
+    table->macros = calloc(MACRO_TABLE_SIZE, sizeof(Macro));
+    if (table->macros == NULL) return STATUS_ERROR;
+    table->capacity = MACRO_TABLE_SIZE;
+    table->count = 0;
+    return 0;
+}
+
+static Macro *FindSlot(Macro *macros, size_t capacity, const char *name, size_t name_length) {
+    size_t slot = HashName(name, name_length) & (capacity - 1);
+    while (macros[slot].name != NULL) {
+        if (strncmp(macros[slot].name, name, name_length) == 0 && macros[slot].name[name_length] == '\0') {
+            break;
         }
+        slot = (slot + 1) & (capacity - 1);
     }
+    return &macros[slot];
+}
 
-    return NULL;
+Macro *FindMacro(const char *name, size_t name_length, MacroTable *table) {
+    if (table == NULL || table->macros == NULL || name == NULL || name_length == 0) return NULL;
+
+    Macro *slot = FindSlot(table->macros, table->capacity, name, name_length);
+    return (slot->name != NULL) ? slot : NULL;
 }
 
-int AddMacro(FILE *file_fd, Macro *macro) {
-    if (file_fd == NULL || macro == NULL) return STATUS_ERROR;
-
-    char line[MAX_LINE_LENGTH] = {0};
-    size_t inMacro = 0;
-    size_t line_count = 0;
-
-    while (fgets(line, MAX_LINE_LENGTH, file_fd) != NULL) {
-        if (!inMacro) {
-            if (strncmp(line, MACRO_START, strlen(MACRO_START)) == 0) {
-                macro->name = GetMacroName(line);
-                if (macro->name == NULL) {
-                    printf("(-) Error: Badly formatted macro definition! <-- %s", line);
-                    return STATUS_ERROR;
-                }
-                if (FindCommand(macro->name) != NULL) {
-                    printf("(-) Error: macro name cannot be a command! <-- %s", line);
-                    return STATUS_ERROR;
-                }
-                inMacro = 1;  // We are now inside a macro
-            }
+static int GrowMacroTable(MacroTable *table) {
+    size_t new_capacity = table->capacity * 2;
+    Macro *new_macros = calloc(new_capacity, sizeof(Macro));
+    if (new_macros == NULL) return STATUS_ERROR;
+
+    for (size_t i = 0; i < table->capacity; i++) {
+        Macro *curr = &table->macros[i];
+        if (curr->name == NULL) continue;
+        *FindSlot(new_macros, new_capacity, curr->name, strlen(curr->name)) = *curr;
+    }
+
+    free(table->macros);
+    table->macros = new_macros;
+    table->capacity = new_capacity;
+    return 0;
+}
+
+#define IS_IDENT_START(c) (isalpha((unsigned char)(c)) || (c) == '_')
+#define IS_IDENT(c)       (isalnum((unsigned char)(c)) || (c) == '_')
+
+static int AppendSegment(Macro *macro, size_t *capacity, const char *text, size_t length, int param) {
+    if (param < 0 && length == 0) return 0;
+
+    // Merge adjacent literal text
+    if (param < 0 && macro->segment_count > 0) {
+        MacroSegment *last = &macro->segments[macro->segment_count - 1];
+        if (last->param < 0 && last->text + last->length == text) {
+            last->length += length;
+            return 0;
         }
-        else {
-            if (strncmp(line, MACRO_END, strlen(MACRO_END)) == 0) {
-                macro->line_count = line_count;  // Set the correct line count
-                return 0;  // Successfully parsed the macro
-            }
+    }
 
-            // We are inside the macro
-            if (line_count < MAX_MACRO_LINES) {
-                // Use strndup to copy line safely
-                char **temp = realloc(macro->body, sizeof(line_count + 1) * sizeof(char *));
-                if (temp == NULL) return STATUS_ERROR;
-                macro->body = temp;
-                macro->body[line_count] = strndup(line, strlen(line));
-                if (macro->body[line_count] == NULL) return STATUS_ERROR;
-                line_count++;
+    if (macro->segment_count == *capacity) {
+        size_t new_capacity = (*capacity == 0) ? 8 : *capacity * 2;
+        MacroSegment *temp = realloc(macro->segments, new_capacity * sizeof(MacroSegment));
+        if (temp == NULL) return STATUS_ERROR;
+        macro->segments = temp;
+        *capacity = new_capacity;
+    }
+
+    MacroSegment *seg = &macro->segments[macro->segment_count++];
+    seg->text = (param < 0) ? text : NULL;
+    seg->length = length;
+    seg->param = param;
+    return 0;
+}
+
+/*
+ * Splits the body into literal runs and parameter references, once.
+ * Only identifier tokens outside comments and string literals are matched.
+ */
+static int CompileMacroBody(Macro *macro) {
+    const char *p = macro->body;
+    const char *end = macro->body + macro->body_length;
+    const char *literal = p;
+    size_t capacity = 0;
+    bool in_comment = false;
+    bool in_string = false;
+
+    while (p < end) {
+        char c = *p;
+        if (c == '\n') {
+            in_comment = in_string = false;
+            p++;
+            continue;
+        }
+        if (in_comment) {
+            p++;
+            continue;
+        }
+        if (c == '"') in_string = !in_string;
+        if (c == COMMENT_DELIM && !in_string) in_comment = true;
+        if (in_string || !IS_IDENT_START(c)) {
+            p++;
+            continue;
+        }
+
+        const char *token = p;
+        while (p < end && IS_IDENT(*p)) p++;
+        size_t token_len = p - token;
+
+        for (size_t i = 0; i < macro->param_count; i++) {
+            if (strlen(macro->params[i]) == token_len && strncmp(macro->params[i], token, token_len) == 0) {
+                if (AppendSegment(macro, &capacity, literal, token - literal, -1) != 0) return STATUS_ERROR;
+                if (AppendSegment(macro, &capacity, NULL, 0, (int)i) != 0) return STATUS_ERROR;
+                literal = p;
+                break;
             }
         }
     }
 
-    return STATUS_NO_RESULT;
+    return AppendSegment(macro, &capacity, literal, end - literal, -1);
 }
 
-int CleanUpMacro(Macro *macro) {
-    LogDebug("Cleaning up macro...\n");
-    if (macro == NULL) return STATUS_ERROR;
-    if (macro->name) free(macro->name);  // Free macro name
-    for (size_t i = 0; i < macro->line_count; i++) {
-        if (macro->body[i]) free(macro->body[i]);  // Free each line of the body
+int AddMacro(MacroTable *table, Macro *macro) {
+    if (table == NULL || table->macros == NULL || macro == NULL || macro->name == NULL) return STATUS_ERROR;
+
+    if (FindMacro(macro->name, strlen(macro->name), table) != NULL) return STATUS_WRONG;
+
+    if (2 * (table->count + 1) > table->capacity && GrowMacroTable(table) != 0) {
+        return STATUS_ERROR;
     }
 
-    macro->body = NULL;
-    macro->name = NULL;
-    macro->line_count = 0;
+    if (macro->param_count > 0 && CompileMacroBody(macro) != 0) return STATUS_ERROR;
 
+    Macro *slot = FindSlot(table->macros, table->capacity, macro->name, strlen(macro->name));
+    *slot = *macro;
+    table->count++;
+
+    LogDebug("Added macro %s (%zu lines, %zu params)\n", macro->name, macro->line_count, macro->param_count);
     return 0;
 }
 
-char *GetMacroName(char *line) {
+int GetMacroParams(const char *line, Macro *macro) {
+    if (line == NULL || macro == NULL) return STATUS_ERROR;
+
+    // Skip `mcro NAME`
+    while (isblank((unsigned char)*line)) line++;
+    line += strlen(MACRO_START);
+    while (isblank((unsigned char)*line)) line++;
+    while (*line && !isspace((unsigned char)*line)) line++;
+
+    for (;;) {
+        while (isblank((unsigned char)*line)) line++;
+        if (*line == '\0' || *line == '\n' || *line == '\r' || *line == COMMENT_DELIM) break;
+
+        if (!IS_IDENT_START(*line)) return STATUS_ERROR;
+        size_t len = 0;
+        while (IS_IDENT(line[len])) len++;
+
+        if (macro->param_count == MAX_MACRO_PARAMS) return STATUS_ERROR;
+        for (size_t i = 0; i < macro->param_count; i++) {
+            if (strlen(macro->params[i]) == len && strncmp(macro->params[i], line, len) == 0) {
+                return STATUS_ERROR;  // Duplicate parameter
+            }
+        }
+        macro->params[macro->param_count] = strndup(line, len);
+        if (macro->params[macro->param_count] == NULL) return STATUS_ERROR;
+        macro->param_count++;
+        line += len;
+
+        while (isblank((unsigned char)*line)) line++;
+        if (*line == ',') {
+            line++;
+            while (isblank((unsigned char)*line)) line++;
+            if (!IS_IDENT_START(*line)) return STATUS_ERROR;  // Dangling comma
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Writes a run of body text. With a call number, each line the run finishes
+ * gets the marker of its body line, before its line terminator.
+ */
+static void EmitBodyText(FILE *output_fd, const Macro *macro, const char *text, size_t length, uint32_t call, uint32_t *body_line) {
+    if (call == 0) {
+        fwrite(text, 1, length, output_fd);
+        return;
+    }
+
+    const char *end = text + length;
+    while (text < end) {
+        const char *newline = memchr(text, '\n', end - text);
+        if (!newline) {
+            fwrite(text, 1, end - text, output_fd);
+            return;
+        }
+        const char *content_end = (newline > text && newline[-1] == '\r') ? newline - 1 : newline;
+        fwrite(text, 1, content_end - text, output_fd);
+        DebugWriteMarker(output_fd, macro->file, macro->line + (*body_line)++, call);
+        fwrite(content_end, 1, newline + 1 - content_end, output_fd);
+        text = newline + 1;
+    }
+}
+
+void EmitMacro(FILE *output_fd, const Macro *macro, const char **args, const size_t *args_len, uint32_t call) {
+    uint32_t body_line = 0;
+    if (macro->param_count == 0) {
+        EmitBodyText(output_fd, macro, macro->body, macro->body_length, call, &body_line);
+        return;
+    }
+
+    for (size_t i = 0; i < macro->segment_count; i++) {
+        const MacroSegment *seg = &macro->segments[i];
+        if (seg->param < 0) EmitBodyText(output_fd, macro, seg->text, seg->length, call, &body_line);
+        else fwrite(args[seg->param], 1, args_len[seg->param], output_fd);
+    }
+}
+
+void CleanUpMacro(Macro *macro) {
+    if (macro == NULL) return;
+    free(macro->name);
+    for (size_t i = 0; i < macro->param_count; i++) free(macro->params[i]);
+    free(macro->segments);
+    memset(macro, 0, sizeof(*macro));
+}
+
+void CleanUpMacros(MacroTable *table) {
+    LogDebug("Cleaning up macros...\n");
+    if (table == NULL || table->macros == NULL) return;
+
+    for (size_t i = 0; i < table->capacity; i++) {
+        if (table->macros[i].name) CleanUpMacro(&table->macros[i]);
+    }
+    free(table->macros);
+
+    table->macros = NULL;
+    table->capacity = 0;
+    table->count = 0;
+}
+
+char *GetMacroName(const char *line) {
     if (line == NULL) return NULL;
+    while (isblank((unsigned char)*line)) line++;
+
     size_t name_offset = strlen(MACRO_START);
     size_t name_length = 0;
 
     // Must separate with at least one space
-    if (!isblank(line[name_offset])) return NULL;
+    if (!isblank((unsigned char)line[name_offset])) return NULL;
     name_offset++;
-    while (isblank(line[name_offset])) name_offset++;
-    while (!isblank(line[name_offset + name_length]) && name_length < MAX_MACRO_NAME) name_length++;
+    while (isblank((unsigned char)line[name_offset])) name_offset++;
+    while (line[name_offset + name_length] && !isspace((unsigned char)line[name_offset + name_length])) name_length++;
+    if (name_length == 0) return NULL;
+
     // Copy the macro name into macro->name
     char *ret = strndup(line + name_offset, name_length);
     if (ret == NULL) return NULL;
 
-    LogDebug("Parsed macro name: %s --> %s\n", line, ret);
+    LogDebug("Parsed macro name --> %s\n", ret);
     return ret;
-}
\ No newline at end of file
+}
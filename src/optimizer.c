@@ -0,0 +1,209 @@
+#include "../include/optimizer.h"
+
+// One source line split into its parts, all slices of the line
+typedef struct s_statement {
+    const char *label;       // Label name, without ':'
+    size_t label_length;
+    const char *body;        // Statement after the label, blanks skipped
+    const char *mnemonic;
+    size_t mnemonic_length;
+    const char *operands;    // Up to the comment, trailing blanks trimmed
+    size_t operands_length;
+    const char *comment;     // From ';' to the end of the line, or NULL
+    size_t comment_length;
+} Statement;
+
+static void SplitStatement(const char *line, size_t length, Statement *st) {
+    memset(st, 0, sizeof(*st));
+    const char *end = line + length;
+    while (end > line && (end[-1] == '\n' || end[-1] == '\r')) end--;
+
+    st->comment = memchr(line, COMMENT_DELIM, end - line);
+    if (st->comment) st->comment_length = end - st->comment;
+    const char *stmt_end = st->comment ? st->comment : end;
+
+    const char *p = line;
+    while (p < stmt_end && isblank((unsigned char)*p)) p++;
+
+    const char *colon = memchr(p, LABEL_DELIM, stmt_end - p);
+    if (colon) {
+        st->label = p;
+        st->label_length = colon - p;
+        p = colon + 1;
+        while (p < stmt_end && isblank((unsigned char)*p)) p++;
+    }
+
+    st->body = p;
+    st->mnemonic = p;
+    while (p < stmt_end && !isspace((unsigned char)*p)) p++;
+    st->mnemonic_length = p - st->mnemonic;
+
+    while (p < stmt_end && isspace((unsigned char)*p)) p++;
+    const char *ops_end = stmt_end;
+    while (ops_end > p && isspace((unsigned char)ops_end[-1])) ops_end--;
+    st->operands = p;
+    st->operands_length = ops_end - p;
+}
+
+static bool IsMnemonic(const Statement *st, const char *name) {
+    return st->mnemonic_length == strlen(name) && strncmp(st->mnemonic, name, st->mnemonic_length) == 0;
+}
+
+// True if the statement is an instruction
+static bool IsInstruction(const Statement *st) {
+    char mnemonic[MAX_MNEMONIC_LENGTH + 1] = {0};
+    if (st->mnemonic_length == 0 || st->mnemonic_length > MAX_MNEMONIC_LENGTH) return false;
+    memcpy(mnemonic, st->mnemonic, st->mnemonic_length);
+    return FindCommand(mnemonic) != NULL;
+}
+
+// Lines that emit no code and may sit between a jump and its target
+static bool IsTransparent(const Statement *st) {
+    if (st->label) return false;
+    if (st->mnemonic_length == 0) return true;  // Empty or comment only
+    return IsMnemonic(st, IENTRY) || IsMnemonic(st, IEXTERN);
+}
+
+/*
+ * Splits `#imm, dst` and returns the immediate if it is a plain constant.
+ * Returns 0 upon success, else STATUS_NO_RESULT
+ */
+static int GetImmediateSource(const Statement *st, int64_t *value, const char **dst, size_t *dst_length) {
+    const char *comma = memchr(st->operands, ',', st->operands_length);
+    if (!comma || st->operands[0] != '#') return STATUS_NO_RESULT;
+
+    char *src = strndup(st->operands, comma - st->operands);
+    if (!src) return STATUS_NO_RESULT;
+
+    // Constants are only defined by the first pass, so only literals qualify here
+    const char *end = NULL;
+    int status = ParseImmediate(src, value, &end);
+    if (status == 0) {
+        while (isspace((unsigned char)*end)) end++;
+        if (*end != '\0') status = STATUS_NO_RESULT;
+    }
+    free(src);
+    if (status != 0) return STATUS_NO_RESULT;
+
+    const char *d = comma + 1;
+    while (isblank((unsigned char)*d)) d++;
+    *dst = d;
+    *dst_length = st->operands + st->operands_length - d;
+    return (*dst_length > 0 && !memchr(d, ',', *dst_length)) ? 0 : STATUS_NO_RESULT;
+}
+
+// Writes `[label:] mnemonic dst [comment]`
+static void WriteUnary(FILE *output_fd, const Statement *st, const char *mnemonic, const char *dst, size_t dst_length) {
+    if (st->label) fprintf(output_fd, "%.*s: ", (int)st->label_length, st->label);
+    else fputs("    ", output_fd);
+    fprintf(output_fd, "%s %.*s", mnemonic, (int)dst_length, dst);
+    if (st->comment) fprintf(output_fd, " %.*s", (int)st->comment_length, st->comment);
+    fputc('\n', output_fd);
+}
+
+int OptimizeFile(const char *path, size_t *words_saved) {
+    if (!path) return STATUS_ERROR;
+
+    size_t length = 0;
+    char *source = ReadFile(path, &length);
+    if (!source) {
+        printf("(-) Error: Failed to open %s for optimization\n", path);
+        return STATUS_ERROR;
+    }
+
+    // Line starts, so a jump can look at the statements after it
+    size_t line_count = 0;
+    for (size_t i = 0; i < length; i++) line_count += (source[i] == '\n');
+    if (length > 0 && source[length - 1] != '\n') line_count++;
+
+    const char **lines = malloc((line_count + 1) * sizeof(char *));
+    if (!lines) {
+        free(source);
+        return STATUS_ERROR;
+    }
+    size_t n = 0;
+    for (const char *p = source; p < source + length; ) {
+        lines[n++] = p;
+        const char *newline = memchr(p, '\n', source + length - p);
+        p = newline ? newline + 1 : source + length;
+    }
+    lines[n] = source + length;
+
+    FILE *output_fd = fopen(path, "w");
+    if (!output_fd) {
+        printf("(-) Error: Failed to rewrite %s\n", path);
+        free(lines);
+        free(source);
+        return STATUS_ERROR;
+    }
+
+    size_t saved = 0;
+    bool in_repeat = false;
+
+    for (size_t i = 0; i < n; i++) {
+        const char *line = lines[i];
+        size_t line_length = lines[i + 1] - line;
+
+        Statement st;
+        SplitStatement(line, line_length, &st);
+
+        // Repeated bodies are left alone, a jump there isn't to the next instruction every time
+        if (in_repeat || IsMnemonic(&st, IREPT) || IsMnemonic(&st, IIRP)) {
+            in_repeat = !IsMnemonic(&st, IENDR);
+            fwrite(line, 1, line_length, output_fd);
+            continue;
+        }
+
+        int64_t value = 0;
+        const char *dst = NULL;
+        size_t dst_length = 0;
+        const char *rewrite = NULL;
+
+        if (IsMnemonic(&st, "mov") && GetImmediateSource(&st, &value, &dst, &dst_length) == 0) {
+            if (value == 0) rewrite = "clr";
+        } else if ((IsMnemonic(&st, "add") || IsMnemonic(&st, "sub"))
+                   && GetImmediateSource(&st, &value, &dst, &dst_length) == 0) {
+            if (IsMnemonic(&st, "sub")) value = -value;
+            if (value == 1) rewrite = "inc";
+            else if (value == -1) rewrite = "dec";
+        }
+
+        if (rewrite) {
+            LogDebug("Peephole: '%.*s' -> %s\n", (int)st.operands_length + (int)(st.operands - st.body), st.body, rewrite);
+            WriteUnary(output_fd, &st, rewrite, dst, dst_length);
+            saved++;
+            continue;
+        }
+
+        // A jump to the very next instruction, and no label to keep on it
+        if (IsMnemonic(&st, "jmp") && !st.label && st.operands_length > 0) {
+            const char *target = st.operands + (st.operands[0] == '&');
+            size_t target_length = st.operands + st.operands_length - target;
+
+            size_t j = i + 1;
+            Statement next;
+            while (j < n) {
+                SplitStatement(lines[j], lines[j + 1] - lines[j], &next);
+                if (!IsTransparent(&next)) break;
+                j++;
+            }
+
+            if (j < n && next.label && next.label_length == target_length
+                && strncmp(next.label, target, target_length) == 0 && IsInstruction(&next)) {
+                LogDebug("Peephole: removed jump to the next instruction %.*s\n", (int)target_length, target);
+                saved += 2;
+                continue;
+            }
+        }
+
+        fwrite(line, 1, line_length, output_fd);
+    }
+
+    fclose(output_fd);
+    free(lines);
+    free(source);
+
+    if (words_saved) *words_saved += saved;
+    LogVerbose("Optimized %s, saved %zu words\n", path, saved);
+    return 0;
+}
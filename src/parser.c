@@ -13,7 +13,161 @@ char *TrimWhitespace(char *str) {
     return str;
 }
 
-int HandleDSDirective(char *token, uint32_t *data) {
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Branch-free classification helpers for the `.data` scanner
+#define IS_DIGIT(c) ((unsigned char)((c) - '0') < 10)
+#define IS_SPACE(c) ((c) == ' ' || (unsigned char)((c) - '\t') < 5)
+
+// Sizing for lists with expressions: one value per comma-separated, non-empty item
+static int CountDataItems(const char *list) {
+    int count = 1;
+    bool empty = true;
+    for (const char *p = list; *p; p++) {
+        if (*p == ',') {
+            if (empty) return STATUS_ERROR;
+            count++;
+            empty = true;
+        } else if (!IS_SPACE(*p)) {
+            empty = false;
+        }
+    }
+    return empty ? STATUS_ERROR : count;
+}
+
+/*
+ * Sizing mode for `.data`: validates the character set of the list and counts
+ * the separating commas, without converting a single number.
+ * Lists with anything but plain numbers (expressions) are counted per item.
+ * Structural errors (e.g. ",,") are caught by the strict parse in the second pass.
+ */
+static int CountDataValues(const char *list) {
+    size_t len = strlen(list);
+    size_t i = 0;
+    int commas = 0;
+    int digits = 0;
+
+#if defined(__SSE2__)
+    const __m128i comma  = _mm_set1_epi8(',');
+    const __m128i plus   = _mm_set1_epi8(POS_DELIM);
+    const __m128i minus  = _mm_set1_epi8(NEG_DELIM);
+    const __m128i blank  = _mm_set1_epi8(' ');
+    const __m128i dig_lo = _mm_set1_epi8('0' - 1);
+    const __m128i dig_hi = _mm_set1_epi8('9' + 1);
+    const __m128i ws_lo  = _mm_set1_epi8('\t' - 1);
+    const __m128i ws_hi  = _mm_set1_epi8('\r' + 1);
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(list + i));
+
+        __m128i is_digit = _mm_and_si128(_mm_cmpgt_epi8(block, dig_lo), _mm_cmplt_epi8(block, dig_hi));
+        __m128i is_comma = _mm_cmpeq_epi8(block, comma);
+        __m128i is_space = _mm_or_si128(_mm_cmpeq_epi8(block, blank),
+                           _mm_and_si128(_mm_cmpgt_epi8(block, ws_lo), _mm_cmplt_epi8(block, ws_hi)));
+        __m128i is_sign  = _mm_or_si128(_mm_cmpeq_epi8(block, plus), _mm_cmpeq_epi8(block, minus));
+
+        __m128i valid = _mm_or_si128(_mm_or_si128(is_digit, is_comma), _mm_or_si128(is_space, is_sign));
+        if (_mm_movemask_epi8(valid) != 0xFFFF) return CountDataItems(list);  // Expression
+
+        commas += __builtin_popcount((unsigned)_mm_movemask_epi8(is_comma));
+        digits |= _mm_movemask_epi8(is_digit);
+    }
+#endif
+
+    for (; i < len; i++) {
+        char c = list[i];
+        if (c == ',') commas++;
+        else if (IS_DIGIT(c)) digits = 1;
+        else if (!IS_SPACE(c) && c != POS_DELIM && c != NEG_DELIM) return CountDataItems(list);
+    }
+
+    if (!digits) return STATUS_ERROR;  // Empty list
+    return commas + 1;
+}
+
+// Evaluates one `.data` item that isn't a plain number. Returns 0 upon success, else STATUS_ERROR
+static int EvalDataValue(const char **p, const ExprScope *scope, int64_t *number, bool *relocatable) {
+    ExprValue result;
+    if (EvalExpression(*p, p, scope, &result) != 0) return STATUS_ERROR;
+
+    if (result.unresolved) {
+        printf("(-) Error: Labels in .data can't be resolved here (e.g. with --pool-data)\n");
+        return STATUS_ERROR;
+    }
+    if (result.external) {
+        printf("(-) Error: Extern labels can't be used in .data\n");
+        return STATUS_ERROR;
+    }
+
+    *number = result.value;
+    *relocatable = result.relocatable;
+    return 0;
+}
+
+/*
+ * Strict `.data` parser: converts every number with an overflow-safe digit loop
+ * and checks it against the signed value range of the current word size.
+ * Items that aren't plain numbers are evaluated as constant expressions.
+ * The write cursor is kept local and stored back to data[0] once.
+ */
+static int ParseDataValues(const char *list, uint32_t *data, const ExprScope *scope) {
+    const int64_t min = VALUE_MIN;
+    const uint64_t span = (uint64_t)(VALUE_MAX - VALUE_MIN);
+    uint32_t cursor = data[0];
+    const char *p = list;
+
+    for (;;) {
+        while (IS_SPACE(*p)) p++;
+        const char *item = p;
+
+        int negative = (*p == NEG_DELIM);
+        p += (*p == NEG_DELIM) | (*p == POS_DELIM);
+
+        while (*p == '0' && IS_DIGIT(p[1])) p++;  // Leading zeros don't count toward the digit limit
+
+        size_t len = 0;
+        uint64_t value = 0;
+        while (IS_DIGIT(p[len]) && len <= 10) {
+            value = value * 10 + (uint64_t)(p[len] - '0');
+            len++;
+        }
+        p += len;
+
+        int64_t number = negative ? -(int64_t)value : (int64_t)value;
+        bool relocatable = false;
+
+        // Not a plain number, evaluate the item as an expression
+        const char *after = p;
+        while (IS_SPACE(*after)) after++;
+        if (len == 0 || len > 10 || (*after != ',' && *after != '\0')) {
+            p = item;
+            if (EvalDataValue(&p, scope, &number, &relocatable) != 0) return STATUS_ERROR;
+        }
+        if ((uint64_t)(number - min) > span) {
+            printf("(-) Error: .data value %lld out of range [%lld, %lld]\n",
+                (long long)number, (long long)VALUE_MIN, (long long)VALUE_MAX);
+            return STATUS_ERROR;
+        }
+        if (relocatable) RelocAddData(cursor);
+        data[cursor++] = WORD((uint32_t)number);
+
+        while (IS_SPACE(*p)) p++;
+        if (*p == ',') {
+            p++;
+            continue;
+        }
+        if (*p == '\0') break;
+        return STATUS_ERROR;  // Unexpected char
+    }
+
+    int values = (int)(cursor - data[0]);
+    data[0] = cursor;
+    return values;
+}
+
+int HandleDSDirective(char *token, uint32_t *data, const ExprScope *scope) {
     if (!token) return STATUS_ERROR;
 
     // Skip leading spaces
@@ -28,40 +182,8 @@ int HandleDSDirective(char *token, uint32_t *data) {
         LogDebug("Directive is '.data'\n");
 
         token += strlen(IDATA);
-        while (isspace((unsigned char)*token)) token++;  // Skip spaces after ".data"
-
-        int values = 0;
-        int expect_number = 1;
-
-        while (*token != '\n' && *token != '\0') {
-            if (isdigit(*token) || (*token == POS_DELIM || *token == NEG_DELIM)) {
-                char *endptr;
-                int number = strtol(token, &endptr, 10);  // Parses sign and digits safely
-
-                if (token == endptr) return STATUS_ERROR;  // Invalid number
-
-                if (data) {
-                    data[data[0]] = WORD(number);  // Mask to 24-bit
-                    data[0]++;
-                }
-                values++;
-
-                token = endptr;
-                while (isspace((unsigned char)*token)) token++;
-                expect_number = 0;
-            }
-            else if (*token == ',') {
-                if (expect_number) return STATUS_ERROR;  // e.g., ",," or starting with ","
-                expect_number = 1;
-                token++;
-                while (isspace((unsigned char)*token)) token++;
-            }
-            else {
-                return STATUS_ERROR;  // Unexpected char
-            }
-        }
-
-        return expect_number ? STATUS_ERROR : values;
+        if (!data) return CountDataValues(token);
+        return ParseDataValues(token, data, scope);
     }
 
     // Handling .string directive
@@ -101,4 +223,40 @@ void TrimNewline(char *line) {
     if (len > 0 && line[len - 1] == '\n') {
         line[len - 1] = '\0';
     }
-}
\ No newline at end of file
+}
+int CopyToken(const char *src, char *dst, size_t dst_size) {
+    if (!src || !dst || dst_size == 0) return STATUS_ERROR;
+
+    while (isspace((unsigned char)*src)) src++;
+
+    size_t len = 0;
+    while (src[len] && !isspace((unsigned char)src[len])) len++;
+
+    if (len >= dst_size) {
+        dst[0] = '\0';
+        return STATUS_ERROR;
+    }
+
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+    return (int)len;
+}
+
+int ParseImmediate(const char *op, int64_t *value, const char **end) {
+    if (!op || !value) return STATUS_ERROR;
+
+    while (isspace((unsigned char)*op)) op++;
+    if (*op != '#') return STATUS_ERROR;
+    op++;
+
+    ExprValue result;
+    const char *expr_end = NULL;
+    if (EvalExpression(op, &expr_end, NULL, &result) != 0) return STATUS_ERROR;
+    if (end) *end = expr_end;
+    if (result.unresolved) return STATUS_NO_RESULT;
+
+    if (!WORD_FITS(result.value)) return STATUS_ERROR;
+
+    *value = result.value;
+    return 0;
+}
@@ -0,0 +1,369 @@
+#include "../include/pool.h"
+
+static DataBlock *blocks = NULL;
+static size_t block_count = 0;
+static size_t block_capacity = 0;
+
+// The last block takes the unlabeled data lines that follow it until it's closed
+static bool block_open = false;
+
+// Words added so far, in source order
+static size_t pool_words = 0;
+
+// Open-addressed index of block ids (+1, 0 marks an empty slot) by content hash
+static size_t *buckets = NULL;
+static size_t bucket_count = 0;
+
+// FNV-1a over the words of a block
+static uint32_t HashValues(const uint32_t *values, size_t length, bool is_string) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= values[i];
+        hash *= 16777619u;
+    }
+    return hash ^ (uint32_t)is_string;
+}
+
+// Indexes the distinct blocks before limit, all of them closed
+static int GrowBuckets(size_t limit) {
+    size_t new_count = (bucket_count == 0) ? 64 : bucket_count * 2;
+    size_t *new_buckets = calloc(new_count, sizeof(size_t));
+    if (!new_buckets) return STATUS_ERROR;
+
+    for (size_t i = 0; i < limit; i++) {
+        if (blocks[i].host != i) continue;
+        size_t slot = blocks[i].hash & (new_count - 1);
+        while (new_buckets[slot]) slot = (slot + 1) & (new_count - 1);
+        new_buckets[slot] = i + 1;
+    }
+
+    free(buckets);
+    buckets = new_buckets;
+    bucket_count = new_count;
+    return 0;
+}
+
+/*
+ * Closes the open block: it's complete now, so it can be shared with an
+ * identical block closed before it. Returns 0 upon success, else STATUS_ERROR.
+ */
+static int CloseBlock(void) {
+    if (!block_open) return 0;
+    block_open = false;
+
+    size_t id = block_count - 1;
+    DataBlock *block = &blocks[id];
+    block->hash = HashValues(block->values, block->length, block->is_string);
+
+    if (2 * (id + 1) > bucket_count && GrowBuckets(id) != 0) return STATUS_ERROR;
+
+    // Identical blocks share one copy
+    size_t slot = block->hash & (bucket_count - 1);
+    while (buckets[slot]) {
+        DataBlock *other = &blocks[buckets[slot] - 1];
+        if (other->hash == block->hash && other->length == block->length
+        && memcmp(other->values, block->values, block->length * sizeof(uint32_t)) == 0) {
+            LogDebug("Pooled duplicate data block %zu into block %zu\n", id, buckets[slot] - 1);
+            block->host = buckets[slot] - 1;
+            return 0;
+        }
+        slot = (slot + 1) & (bucket_count - 1);
+    }
+
+    buckets[slot] = id + 1;
+    return 0;
+}
+
+// Appends words to the open block
+static int AppendWords(const uint32_t *values, size_t length) {
+    DataBlock *block = &blocks[block_count - 1];
+    if (block->length + length > block->capacity) {
+        size_t new_capacity = (block->capacity == 0) ? 16 : block->capacity;
+        while (new_capacity < block->length + length) new_capacity *= 2;
+        uint32_t *temp = realloc(block->values, new_capacity * sizeof(uint32_t));
+        if (!temp) return STATUS_ERROR;
+        block->values = temp;
+        block->capacity = new_capacity;
+    }
+    memcpy(block->values + block->length, values, length * sizeof(uint32_t));
+    block->length += length;
+    return 0;
+}
+
+int PoolAddBlock(char *directive, bool labeled) {
+    if (!directive) return STATUS_ERROR;
+
+    while (isspace((unsigned char)*directive)) directive++;
+    bool is_string = (strncmp(directive, ISTRING, strlen(ISTRING)) == 0);
+
+    int size = HandleDSDirective(directive, NULL, NULL);
+    if (size < 0) return STATUS_ERROR;
+
+    uint32_t *values = malloc((size + 1) * sizeof(uint32_t));
+    if (!values) return STATUS_ERROR;
+    values[0] = 1; // Start from idx = 1, like the data segment
+
+    int length = HandleDSDirective(directive, values, NULL);
+    if (length < 0) {
+        free(values);
+        return STATUS_ERROR;
+    }
+
+    // An unlabeled line continues the open block, its words are read through the block's label
+    if (block_open && !labeled) {
+        int status = AppendWords(values + 1, length);
+        free(values);
+        if (status != 0) return STATUS_ERROR;
+        blocks[block_count - 1].is_string &= is_string;
+        pool_words += length;
+        return (int)(block_count - 1);
+    }
+
+    if (CloseBlock() != 0) {
+        free(values);
+        return STATUS_ERROR;
+    }
+
+    if (block_count == block_capacity) {
+        size_t new_capacity = (block_capacity == 0) ? 32 : block_capacity * 2;
+        DataBlock *temp = realloc(blocks, new_capacity * sizeof(DataBlock));
+        if (!temp) {
+            free(values);
+            return STATUS_ERROR;
+        }
+        blocks = temp;
+        block_capacity = new_capacity;
+    }
+
+    // Drop the cursor cell
+    memmove(values, values + 1, length * sizeof(uint32_t));
+
+    DataBlock *block = &blocks[block_count];
+    block->values = values;
+    block->length = length;
+    block->capacity = size + 1;
+    block->hash = 0;
+    block->is_string = is_string;
+    block->host = block_count;
+    block->offset = 0;
+
+    block_open = true;
+    pool_words += length;
+    return (int)(block_count++);
+}
+
+size_t PoolWords(void) {
+    return pool_words;
+}
+
+int PoolRepeat(size_t mark, size_t count) {
+    size_t length = pool_words - mark;
+    if (length == 0 || count <= 1) return 0;
+
+    // Gather the words added since the mark, they end at the open block
+    uint32_t *words = malloc(length * sizeof(uint32_t));
+    if (!words) return STATUS_ERROR;
+    size_t left = length;
+    for (size_t i = block_count; left > 0 && i-- > 0;) {
+        size_t take = (blocks[i].length < left) ? blocks[i].length : left;
+        left -= take;
+        memcpy(words + left, blocks[i].values + blocks[i].length - take, take * sizeof(uint32_t));
+    }
+
+    int status = 0;
+    for (size_t i = 1; i < count && status == 0; i++) status = AppendWords(words, length);
+    free(words);
+    if (status != 0) return STATUS_ERROR;
+
+    pool_words += length * (count - 1);
+    LogDebug("Repeated %zu pooled data words %zu times\n", length, count);
+    return 0;
+}
+
+// Orders strings by their reversed contents, so a suffix sorts right before its hosts
+static int CompareReversed(const void *a, const void *b) {
+    const DataBlock *x = &blocks[*(const size_t *)a];
+    const DataBlock *y = &blocks[*(const size_t *)b];
+
+    size_t n = (x->length < y->length) ? x->length : y->length;
+    for (size_t i = 1; i <= n; i++) {
+        uint32_t wx = x->values[x->length - i];
+        uint32_t wy = y->values[y->length - i];
+        if (wx != wy) return (wx < wy) ? -1 : 1;
+    }
+    return (x->length > y->length) - (x->length < y->length);
+}
+
+static bool IsSuffix(const DataBlock *suffix, const DataBlock *host) {
+    if (suffix->length > host->length) return false;
+    return memcmp(suffix->values, host->values + (host->length - suffix->length),
+        suffix->length * sizeof(uint32_t)) == 0;
+}
+
+int PoolFinalize(Label labels[MAX_LABELS], size_t *label_count) {
+    if (!labels || !label_count) return STATUS_ERROR;
+    if (CloseBlock() != 0) return STATUS_ERROR;
+
+    // Tail-merge strings that end another string
+    size_t *order = malloc((block_count + 1) * sizeof(size_t));
+    if (!order) return STATUS_ERROR;
+
+    size_t strings = 0;
+    for (size_t i = 0; i < block_count; i++) {
+        if (blocks[i].is_string && blocks[i].host == i) order[strings++] = i;
+    }
+    qsort(order, strings, sizeof(size_t), CompareReversed);
+
+    size_t merged = 0;
+    for (size_t i = strings; i-- > 1;) {
+        DataBlock *host = &blocks[order[i]];
+        DataBlock *curr = &blocks[order[i - 1]];
+        if (IsSuffix(curr, host)) {
+            // Keep the chain pointing at the outermost string
+            order[i - 1] = order[i];
+            curr->host = host->host;
+            merged++;
+        }
+    }
+    free(order);
+
+    // Duplicates follow their block wherever it was merged
+    for (size_t i = 0; i < block_count; i++) {
+        blocks[i].host = blocks[blocks[i].host].host;
+    }
+
+    // Lay out the remaining blocks in order of first appearance
+    size_t offset = 0;
+    for (size_t i = 0; i < block_count; i++) {
+        if (blocks[i].host != i) continue;
+        blocks[i].offset = offset;
+        offset += blocks[i].length;
+    }
+    for (size_t i = 0; i < block_count; i++) {
+        DataBlock *host = &blocks[blocks[i].host];
+        if (host != &blocks[i]) blocks[i].offset = host->offset + host->length - blocks[i].length;
+    }
+
+    // Data labels still hold block ids
+    for (size_t i = 0; i < *label_count; i++) {
+        if (labels[i].type != E_DATA) continue;
+        if (labels[i].address >= block_count) return STATUS_ERROR;
+        labels[i].address = blocks[labels[i].address].offset;
+    }
+
+    LogVerbose("Data pool: %zu distinct blocks, %zu tail-merged strings, %zu words\n",
+        block_count, merged, offset);
+    return (int)offset;
+}
+
+void PoolEmit(uint32_t *data_segment) {
+    if (!data_segment) return;
+
+    uint32_t cursor = data_segment[0];
+    for (size_t i = 0; i < block_count; i++) {
+        if (blocks[i].host != i) continue;
+        memcpy(&data_segment[cursor], blocks[i].values, blocks[i].length * sizeof(uint32_t));
+        cursor += blocks[i].length;
+    }
+    data_segment[0] = cursor;
+}
+
+static int64_t *literals = NULL;
+static size_t literal_count = 0;
+static size_t literal_capacity = 0;
+static uint32_t literal_base = 0;
+
+// Open-addressed index of literal indices (+1, 0 marks an empty slot)
+static size_t *literal_buckets = NULL;
+static size_t literal_bucket_count = 0;
+
+static size_t LiteralSlot(int64_t value) {
+    uint64_t hash = (uint64_t)value * 0x9E3779B97F4A7C15ull;
+    return (size_t)(hash >> 32) & (literal_bucket_count - 1);
+}
+
+static int FindLiteral(int64_t value) {
+    if (literal_bucket_count == 0) return STATUS_NO_RESULT;
+
+    size_t slot = LiteralSlot(value);
+    while (literal_buckets[slot]) {
+        if (literals[literal_buckets[slot] - 1] == value) return (int)(literal_buckets[slot] - 1);
+        slot = (slot + 1) & (literal_bucket_count - 1);
+    }
+    return STATUS_NO_RESULT;
+}
+
+static int GrowLiterals(void) {
+    size_t new_capacity = (literal_capacity == 0) ? 32 : literal_capacity * 2;
+    int64_t *temp = realloc(literals, new_capacity * sizeof(int64_t));
+    if (!temp) return STATUS_ERROR;
+    literals = temp;
+    literal_capacity = new_capacity;
+
+    size_t *new_buckets = calloc(new_capacity * 2, sizeof(size_t));
+    if (!new_buckets) return STATUS_ERROR;
+    free(literal_buckets);
+    literal_buckets = new_buckets;
+    literal_bucket_count = new_capacity * 2;
+
+    for (size_t i = 0; i < literal_count; i++) {
+        size_t slot = LiteralSlot(literals[i]);
+        while (literal_buckets[slot]) slot = (slot + 1) & (literal_bucket_count - 1);
+        literal_buckets[slot] = i + 1;
+    }
+    return 0;
+}
+
+int LiteralAdd(int64_t value) {
+    int found = FindLiteral(value);
+    if (found >= 0) return found;
+
+    if (literal_count == literal_capacity && GrowLiterals() != 0) return STATUS_ERROR;
+
+    size_t slot = LiteralSlot(value);
+    while (literal_buckets[slot]) slot = (slot + 1) & (literal_bucket_count - 1);
+    literal_buckets[slot] = literal_count + 1;
+    literals[literal_count] = value;
+
+    LogDebug("Added literal %lld to the literal pool\n", (long long)value);
+    return (int)(literal_count++);
+}
+
+size_t LiteralPlace(uint32_t base_address) {
+    literal_base = base_address;
+    if (literal_count > 0) {
+        LogVerbose("Literal pool: %zu values at %u\n", literal_count, base_address);
+    }
+    return literal_count;
+}
+
+int LiteralAddress(int64_t value) {
+    int index = FindLiteral(value);
+    if (index < 0) return STATUS_ERROR;
+    return (int)(literal_base + index);
+}
+
+void LiteralEmit(uint32_t *data_segment) {
+    if (!data_segment) return;
+
+    for (size_t i = 0; i < literal_count; i++) {
+        data_segment[data_segment[0]++] = WORD((uint32_t)literals[i]);
+    }
+}
+
+void PoolCleanUp(void) {
+    for (size_t i = 0; i < block_count; i++) free(blocks[i].values);
+    free(blocks);
+    free(buckets);
+    blocks = NULL;
+    buckets = NULL;
+    block_count = block_capacity = bucket_count = 0;
+    block_open = false;
+    pool_words = 0;
+
+    free(literals);
+    free(literal_buckets);
+    literals = NULL;
+    literal_buckets = NULL;
+    literal_count = literal_capacity = literal_bucket_count = 0;
+}
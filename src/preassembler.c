@@ -1,158 +1,360 @@
 #include "../include/preassembler.h"
 
-/* 
- * (-)
- *  - Opens the given file.
- *  - Reads macros one by one using AddMacro().
- *  - Validates macro names (ensuring they don’t conflict with commands).
- *  - Checks for duplicate macros.
- *  - Stores each found macro in the provided macros array.
+// True if the line starts (after blanks) with the given keyword as a whole word
+static bool IsKeyword(const char *line, const char *keyword) {
+    while (isblank((unsigned char)*line)) line++;
+    size_t len = strlen(keyword);
+    return strncmp(line, keyword, len) == 0 && (line[len] == '\0' || isspace((unsigned char)line[len]));
+}
+
+/*
+ * Splits the comma separated arguments of a macro call in [args_start, args_end).
+ * Returns the argument count, or STATUS_ERROR on an empty argument or too many.
  */
-int ParseMacros(char *file_path, Macro macros[MAX_MACROS], size_t *macro_count) {
-    if (file_path == NULL || macros == NULL || macro_count == NULL) {
-        printf("ParseMacros() received NULL input(s)\n");
-        return STATUS_ERROR;
+static int SplitMacroArgs(const char *args_start, const char *args_end, const char **args, size_t *args_len) {
+    const char *p = args_start;
+    while (p < args_end && isspace((unsigned char)*p)) p++;
+    if (p == args_end) return 0;
+
+    int count = 0;
+    for (;;) {
+        while (p < args_end && isblank((unsigned char)*p)) p++;
+        const char *arg = p;
+        while (p < args_end && *p != ',') p++;
+
+        const char *arg_end = p;
+        while (arg_end > arg && isspace((unsigned char)arg_end[-1])) arg_end--;
+        if (arg_end == arg || count == MAX_MACRO_PARAMS) return STATUS_ERROR;
+
+        args[count] = arg;
+        args_len[count] = arg_end - arg;
+        count++;
+
+        if (p == args_end) break;
+        p++;  // Skip ','
     }
+    return count;
+}
 
-    FILE *file_fd = fopen(file_path, "r");
-    if (file_fd == NULL) {
-        printf("ParseMacros() failed to open file %s\n", file_path);
-        return STATUS_ERROR;
+static int ExpandSource(const char *source, size_t length, const char *source_path,
+                        MacroTable *macros, IncludeList *includes, FILE *output_fd, int depth);
+
+// Copies a source line to the output, with its debug map marker when the file has a number
+static void WriteSourceLine(FILE *output_fd, const char *line, size_t length, uint32_t file, uint32_t line_no) {
+    if (file == 0) {
+        fwrite(line, 1, length, output_fd);
+        return;
     }
 
-    Macro *curr = malloc(sizeof(Macro));
-    if (curr == NULL) {
-        printf("ParseMacros() failed to allocate memory for Macro\n");
-        fclose(file_fd);
-        return STATUS_ERROR;
+    size_t content = length;
+    while (content > 0 && (line[content - 1] == '\n' || line[content - 1] == '\r')) content--;
+    fwrite(line, 1, content, output_fd);
+    DebugWriteMarker(output_fd, file, line_no, 0);
+    fwrite(line + content, 1, length - content, output_fd);
+}
+
+/*
+ * Returns the preassembled file named by an `.include` line, preassembling it
+ * on first use. Its macros and expanded text are cached for the whole run,
+ * by resolved path: its relative includes and source line markers depend on it.
+ */
+static IncludeFile *LoadInclude(const char *includer, const char *line, int depth) {
+    char path[MAX_INCLUDE_PATH] = {0};
+    char resolved[MAX_INCLUDE_PATH] = {0};
+
+    if (GetIncludePath(line, path, sizeof(path)) != 0) {
+        printf("(-) Error: Badly formatted include directive! <-- %s", line);
+        return NULL;
+    }
+    if (ResolveIncludePath(includer, path, resolved, sizeof(resolved)) != 0) {
+        printf("(-) Error: Include path is too long! <-- %s", line);
+        return NULL;
+    }
+    if (depth >= MAX_INCLUDE_DEPTH) {
+        printf("(-) Error: Includes are nested deeper than %d levels at %s\n", MAX_INCLUDE_DEPTH, resolved);
+        return NULL;
     }
 
-    /* Loop until we reach the maximum number of macros or no more macros are found */
-    while (*macro_count < MAX_MACROS) {
-        memset(curr, 0, sizeof(*curr));
-        int status = AddMacro(file_fd, curr);
-        if (status == STATUS_ERROR) {
-            printf("(-) Error: AddMacro() failed with status: %d\n", status);
-            free(curr);
-            fclose(file_fd);
-            return STATUS_ERROR;
+    IncludeFile *include = FindInclude(resolved);
+    if (!include) {
+        size_t include_length = 0;
+        char *include_source = ReadFile(resolved, &include_length);
+        if (!include_source) {
+            printf("(-) Error: Failed to open included file %s\n", resolved);
+            return NULL;
         }
-        if (status == STATUS_NO_RESULT) {
-            LogVerbose("Macro parsing complete. Found %zu macros in %s\n", *macro_count, file_path);
-            break;  // No more macros found in the file
+
+        include = AddInclude(resolved, include_source, include_length);
+        if (!include) {
+            free(include_source);
+            printf("(-) Error: Failed to allocate include %s\n", resolved);
+            return NULL;
+        }
+
+        LogVerbose("Preassembling included file %s\n", resolved);
+        include->loading = true;
+
+        FILE *expansion_fd = tmpfile();
+        int status = (expansion_fd) ? 0 : STATUS_ERROR;
+        if (status == 0) {
+            status = ExpandSource(include->source, include->length, include->path,
+                &include->macros, &include->includes, expansion_fd, depth + 1);
         }
 
-        /* Remove trailing newline if present */
-        TrimNewline(curr->name);
-        
-        /* Check for duplicate macros */
-        if (FindMacro(curr->name, macros, macro_count) != NULL) {
-            LogInfo("(-) Error: Found multiple definitions of %s!\n", curr->name);
-            CleanUpMacro(curr);
-            fclose(file_fd);
-            return STATUS_ERROR;
+        // Keep the expanded text in memory, every includer copies it
+        if (status == 0) {
+            long size = ftell(expansion_fd);
+            include->expansion = malloc((size > 0 ? (size_t)size : 0) + 1);
+            if (size < 0 || !include->expansion) status = STATUS_ERROR;
+            else {
+                rewind(expansion_fd);
+                include->expansion_length = fread(include->expansion, 1, (size_t)size, expansion_fd);
+                include->expansion[include->expansion_length] = '\0';
+            }
         }
-        
-        /* Copy the current macro into the macros array */
-        macros[*macro_count] = *curr;
-        (*macro_count)++;
+        if (expansion_fd) fclose(expansion_fd);
+
+        include->loading = false;
+        if (status != 0) {
+            free(include->expansion);
+            include->expansion = NULL;
+            printf("(-) Error: Failed to preassemble included file %s\n", resolved);
+            return NULL;
+        }
+        return include;
     }
+    LogDebug("Reusing preassembled include %s\n", resolved);
 
-    fclose(file_fd);
-    free(curr);
-    return 0;
+    if (include->loading) {
+        printf("(-) Error: %s is included recursively!\n", include->path);
+        return NULL;
+    }
+    // An include that failed earlier has already been reported
+    return (include->expansion) ? include : NULL;
 }
 
-/* 
- * ExpandMacros:
- *  - Opens the input file and output file.
- *  - Scans each line:
- *      - Skips lines within a macro declaration.
- *      - Checks the first word of each line to see if it is a macro call.
- *      - If a macro is found, its body is written to the output.
- *      - Otherwise, the line is copied as-is.
+/*
+ * Sweeps a source buffer line by line, recording macros into `macros`,
+ * expanding calls and `.include` lines, and writing the result to output_fd.
  */
-int ExpandMacros(char *input_path, char *output_path, Macro macros[MAX_MACROS], size_t *macro_count) {
-    if (!input_path || !output_path || !macros || !macro_count) {
-        printf("ExpandMacros() received NULL input(s)\n");
-        return STATUS_ERROR;
-    }
+static int ExpandSource(const char *source, size_t length, const char *source_path,
+                        MacroTable *macros, IncludeList *includes, FILE *output_fd, int depth) {
+    int status = 0;
+    const char *end = source + length;
+    const char *line = source;
+    const char *next = NULL;
 
-    FILE *input_fd = fopen(input_path, "r");
-    if (!input_fd) {
-        LogInfo("ExpandMacros() failed to open input file %s\n", input_path);
-        return STATUS_ERROR;
-    }
+    // Macro currently being declared
+    Macro decl = {0};
 
-    FILE *output_fd = fopen(output_path, "w");
-    if (!output_fd) {
-        LogInfo("ExpandMacros() failed to open output file %s\n", output_path);
-        fclose(input_fd);
-        return STATUS_ERROR;
-    }
+    // Open `.if` blocks, skipped regions never reach the output
+    CondStack conditions = {0};
+
+    // Under -g or --listing every line written out names where it came from
+    uint32_t file = (ASSEMBLER_FLAGS.debug_map || ASSEMBLER_FLAGS.listing) ? DebugAddFile(source_path) : 0;
+    uint32_t line_no = 0;
+
+    for (; line < end && status == 0; line = next) {
+        const char *newline = memchr(line, '\n', end - line);
+        next = newline ? newline + 1 : end;
+        line_no++;
+
+        // Macro declaration boundaries
+        if (decl.name) {
+            if (IsConditional(line)) {
+                printf("(-) Error: Conditional directives are not allowed inside macro %s <-- %.*s",
+                    decl.name, (int)(next - line), line);
+                status = STATUS_ERROR;
+                continue;
+            }
+            if (!IsKeyword(line, MACRO_END)) {
+                decl.line_count++;
+                continue;
+            }
 
-    char line[MAX_LINE_LENGTH] = {0};
-    int in_macro_declaration = 0;
+            decl.body_length = line - decl.body;
+            int added = (FindIncludedMacro(decl.name, strlen(decl.name), includes) != NULL)
+                ? STATUS_WRONG
+                : AddMacro(macros, &decl);
+            if (added == STATUS_WRONG) {
+                LogInfo("(-) Error: Found multiple definitions of %s!\n", decl.name);
+                CleanUpMacro(&decl);
+                status = STATUS_ERROR;
+            } else if (added != 0) {
+                printf("(-) Error: AddMacro() failed with status: %d\n", added);
+                CleanUpMacro(&decl);
+                status = STATUS_ERROR;
+            }
+            memset(&decl, 0, sizeof(decl));
+            continue;
+        }
+
+        if (IsConditional(line)) {
+            // HandleConditional() needs a terminated line
+            char *cond_line = strndup(line, next - line);
+            if (!cond_line || HandleConditional(cond_line, &conditions) != 0) status = STATUS_ERROR;
+            free(cond_line);
+            continue;
+        }
+        if (!IsAssembled(&conditions)) continue;
 
-    while (fgets(line, MAX_LINE_LENGTH, input_fd)) {
-        // Write empty lines directly
+        // Skip empty lines
         if (line[0] == '\n' || line[0] == '\r') {
-            //fprintf(output_fd, "%s", line);
             LogDebug("Skipping empty line...\n");
             continue;
         }
 
-        // Macro declaration boundaries
-        if (strncmp(line, MACRO_START, strlen(MACRO_START)) == 0 && isspace(line[strlen(MACRO_START)])) {
-            in_macro_declaration = 1;
+        if (IsKeyword(line, IINCLUDE)) {
+            // GetIncludePath() needs a terminated line
+            char *include_line = strndup(line, next - line);
+            IncludeFile *include = (include_line) ? LoadInclude(source_path, include_line, depth) : NULL;
+            free(include_line);
+
+            if (!include || AppendInclude(includes, include) != 0) {
+                status = STATUS_ERROR;
+                continue;
+            }
+            fwrite(include->expansion, 1, include->expansion_length, output_fd);
             continue;
         }
-        if (in_macro_declaration && strncmp(line, MACRO_END, strlen(MACRO_END)) == 0) {
-            in_macro_declaration = 0;
+
+        if (IsKeyword(line, MACRO_START)) {
+            decl.name = GetMacroName(line);
+            if (decl.name == NULL) {
+                printf("(-) Error: Badly formatted macro definition! <-- %.*s", (int)(next - line), line);
+                status = STATUS_ERROR;
+            } else if (strlen(decl.name) > MAX_MACRO_NAME) {
+                // Cutting it short could make it another macro's name
+                printf("(-) Error: Macro name is longer than %d characters! <-- %.*s", MAX_MACRO_NAME, (int)(next - line), line);
+                CleanUpMacro(&decl);
+                status = STATUS_ERROR;
+            } else if (FindCommand(decl.name) != NULL) {
+                printf("(-) Error: macro name cannot be a command! <-- %.*s", (int)(next - line), line);
+                CleanUpMacro(&decl);
+                status = STATUS_ERROR;
+            } else if (GetMacroParams(line, &decl) != 0) {
+                printf("(-) Error: Badly formatted macro parameters! <-- %.*s", (int)(next - line), line);
+                CleanUpMacro(&decl);
+                status = STATUS_ERROR;
+            }
+            decl.body = next;
+            decl.file = file;
+            decl.line = line_no + 1;
             continue;
         }
-        if (in_macro_declaration) continue;
 
         // Handle label + macro call (e.g. START: SETR1)
-        char *colon = strchr(line, ':');
-        char label_prefix[MAX_LINE_LENGTH] = {0};
-        char *macro_candidate = NULL;
+        const char *comment = memchr(line, COMMENT_DELIM, next - line);
+        const char *colon = memchr(line, LABEL_DELIM, (comment ? comment : next) - line);
+        size_t label_len = 0;
+        const char *macro_candidate = line;
 
         if (colon) {
-            size_t label_len = colon - line + 1; // include ':'
-            strncpy(label_prefix, line, label_len);
-            label_prefix[label_len] = '\0';
-
+            label_len = colon - line + 1; // include ':'
             macro_candidate = colon + 1;
-            while (isspace(*macro_candidate)) macro_candidate++; // skip spaces
-        } else {
-            macro_candidate = line;
         }
+        while (isblank((unsigned char)*macro_candidate)) macro_candidate++; // skip spaces
 
         // Extract macro name
-        char macro_name[MAX_LINE_LENGTH] = {0};
-        sscanf(macro_candidate, "%s", macro_name);
+        size_t name_len = 0;
+        while (macro_candidate + name_len < end && !isspace((unsigned char)macro_candidate[name_len])) name_len++;
 
-        Macro *curr = FindMacro(macro_name, macros, macro_count);
+        Macro *curr = NULL;
+        if (name_len <= MAX_MACRO_NAME) {
+            curr = FindMacro(macro_candidate, name_len, macros);
+            if (!curr) curr = FindIncludedMacro(macro_candidate, name_len, includes);
+        }
 
         if (curr) {
-            LogDebug("Found macro call for %s\n", macro_name);
-            for (size_t i = 0; i < curr->line_count; i++) {
-                if (i == 0 && label_prefix[0]) {
-                    fprintf(output_fd, "%s%s", label_prefix, curr->body[i]);
-                } else {
-                    fprintf(output_fd, "%s", curr->body[i]);
-                }
-                LogDebug("Expanded macro line: %s\n", curr->body[i]);
+            LogDebug("Found macro call for %s\n", curr->name);
+
+            const char *args[MAX_MACRO_PARAMS] = {0};
+            size_t args_len[MAX_MACRO_PARAMS] = {0};
+            int arg_count = SplitMacroArgs(macro_candidate + name_len, comment ? comment : next, args, args_len);
+            if (arg_count != (int)curr->param_count) {
+                printf("(-) Error: Macro %s expects %zu argument(s) <-- %.*s",
+                    curr->name, curr->param_count, (int)(next - line), line);
+                status = STATUS_ERROR;
+                continue;
             }
+
+            if (label_len && curr->body_length) fwrite(line, 1, label_len, output_fd);
+            uint32_t call = file ? DebugAddCall(curr->name, file, line_no) : 0;
+            EmitMacro(output_fd, curr, args, args_len, call);
         } else {
             // Not a macro, write line as-is
-            fprintf(output_fd, "%s", line);
+            WriteSourceLine(output_fd, line, next - line, file, line_no);
             LogDebug("Expanding line...\n");
         }
     }
 
-    fclose(input_fd);
+    if (status == 0 && decl.name) {
+        printf("(-) Error: Macro %s is missing its '%s'!\n", decl.name, MACRO_END);
+        status = STATUS_ERROR;
+    }
+    if (status == 0 && conditions.depth > 0) {
+        printf("(-) Error: %zu conditional block(s) are missing their '%s' in %s\n", conditions.depth, IENDIF, source_path);
+        status = STATUS_ERROR;
+    }
+    CleanUpMacro(&decl);
+
+    return status;
+}
+
+/* 
+ * ExpandMacros:
+ *  - Reads the whole input file into one buffer.
+ *  - Sweeps it line by line:
+ *      - `mcro NAME [a, b, ...]` ... `mcroend` blocks are recorded in a hashed
+ *        macro table. A macro body is a slice of the buffer, nothing is copied;
+ *        bodies with parameters are split on parameter tokens once, at definition.
+ *      - `.include "file"` writes the file's expanded text in place and makes
+ *        its macros visible. Each included file is preassembled once per run.
+ *      - Checks the first word of each line to see if it is a macro call.
+ *      - If a macro is found, its body is written to the output, with the
+ *        call's arguments written in place of the parameter tokens.
+ *      - Otherwise, the line is copied as-is.
+ *  - Macros must be defined (or included) before they are used.
+ */
+int ExpandMacros(char *input_path, char *output_path, size_t *macro_count) {
+    if (!input_path || !output_path) {
+        printf("ExpandMacros() received NULL input(s)\n");
+        return STATUS_ERROR;
+    }
+
+    size_t length = 0;
+    char *source = ReadFile(input_path, &length);
+    if (!source) {
+        LogInfo("ExpandMacros() failed to open input file %s\n", input_path);
+        return STATUS_ERROR;
+    }
+
+    FILE *output_fd = fopen(output_path, "w");
+    if (!output_fd) {
+        LogInfo("ExpandMacros() failed to open output file %s\n", output_path);
+        free(source);
+        return STATUS_ERROR;
+    }
+
+    MacroTable macros;
+    if (InitMacroTable(&macros) != 0) {
+        printf("ExpandMacros() failed to allocate the macro table\n");
+        fclose(output_fd);
+        free(source);
+        return STATUS_ERROR;
+    }
+
+    IncludeList includes = {0};
+    int status = ExpandSource(source, length, input_path, &macros, &includes, output_fd, 0);
+
+    if (status == 0) {
+        LogVerbose("Macro expansion complete. Found %zu macros in %s\n", macros.count, input_path);
+    }
+    if (macro_count) *macro_count = macros.count;
+
+    CleanUpIncludeList(&includes);
+    CleanUpMacros(&macros);
     fclose(output_fd);
-    return 0;
-}
\ No newline at end of file
+    free(source);
+    return status;
+}
@@ -0,0 +1,57 @@
+#include "../include/reloc.h"
+
+typedef struct s_reloc {
+    uint32_t at;      // Code address or data segment index
+    bool     data;
+} Reloc;
+
+static Reloc *relocs = NULL;
+static size_t reloc_count = 0;
+static size_t reloc_capacity = 0;
+static size_t data_count = 0;
+
+static void RelocAdd(uint32_t at, bool data) {
+    if (!ASSEMBLER_FLAGS.compile_only) return;
+
+    if (reloc_count == reloc_capacity) {
+        size_t new_capacity = (reloc_capacity == 0) ? 64 : reloc_capacity * 2;
+        Reloc *temp = realloc(relocs, new_capacity * sizeof(Reloc));
+        if (!temp) {
+            printf("(-) Error: Out of memory while recording relocations!\n");
+            return;
+        }
+        relocs = temp;
+        reloc_capacity = new_capacity;
+    }
+
+    relocs[reloc_count].at = at;
+    relocs[reloc_count].data = data;
+    reloc_count++;
+    if (data) data_count++;
+}
+
+void RelocAddCode(uint32_t address) {
+    RelocAdd(address, false);
+}
+
+void RelocAddData(uint32_t index) {
+    RelocAdd(index, true);
+}
+
+size_t RelocDataCount(void) {
+    return data_count;
+}
+
+void RelocWrite(FILE *output_fd, uint32_t data_base) {
+    for (size_t i = 0; i < reloc_count; i++) {
+        uint32_t address = relocs[i].data ? data_base + relocs[i].at - 1 : relocs[i].at;
+        fprintf(output_fd, "R|%08u\n", address);
+    }
+    LogDebug("Appended %zu relocation(s) to output\n", reloc_count);
+}
+
+void RelocCleanUp(void) {
+    free(relocs);
+    relocs = NULL;
+    reloc_count = reloc_capacity = data_count = 0;
+}
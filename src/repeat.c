@@ -0,0 +1,214 @@
+#include "../include/repeat.h"
+
+#define IS_IDENT_START(c) (isalpha((unsigned char)(c)) || (c) == '_')
+#define IS_IDENT(c)       (isalnum((unsigned char)(c)) || (c) == '_')
+
+// True if the statement (after blanks) starts with the keyword as a whole word
+static bool StartsWith(const char *line, const char *keyword) {
+    while (isspace((unsigned char)*line)) line++;
+    size_t len = strlen(keyword);
+    return strncmp(line, keyword, len) == 0
+        && (line[len] == '\0' || isspace((unsigned char)line[len]) || line[len] == COMMENT_DELIM);
+}
+
+bool IsRepeatStart(const char *line) {
+    return line && (StartsWith(line, IREPT) || StartsWith(line, IIRP));
+}
+
+bool IsRepeatEnd(const char *line) {
+    return line && StartsWith(line, IENDR);
+}
+
+static int ParseHeader(const char *header, RepeatBlock *block) {
+    while (isspace((unsigned char)*header)) header++;
+
+    // Only look at the statement itself
+    size_t len = strcspn(header, ";\r\n");
+    char *copy = strndup(header, len);
+    if (!copy) return STATUS_ERROR;
+
+    int status = 0;
+    if (StartsWith(copy, IREPT)) {
+        int64_t value = 0;
+        if (EvalConstant(copy + strlen(IREPT), &value) != 0 || value < 0 || value > MAX_REPEAT_COUNT) {
+            printf("(-) Error: Invalid %s count <-- %s\n", IREPT, copy);
+            status = STATUS_ERROR;
+        }
+        block->count = (size_t)value;
+    } else {
+        char *p = copy + strlen(IIRP);
+        while (isblank((unsigned char)*p)) p++;
+
+        size_t sym_len = 0;
+        if (IS_IDENT_START(*p)) while (IS_IDENT(p[sym_len])) sym_len++;
+        block->symbol = (sym_len > 0) ? strndup(p, sym_len) : NULL;
+        p += sym_len;
+        while (isblank((unsigned char)*p)) p++;
+
+        if (!block->symbol || (*p != ',' && *p != '\0')) {
+            printf("(-) Error: Expected '%s SYMBOL, values...' <-- %s\n", IIRP, copy);
+            status = STATUS_ERROR;
+        }
+
+        // Values, one iteration each
+        while (status == 0 && *p == ',') {
+            p++;
+            char *value = p;
+            while (*p && *p != ',') p++;
+
+            char saved = *p;
+            *p = '\0';
+            value = TrimWhitespace(value);
+            if (*value == '\0') {
+                printf("(-) Error: Empty value in %s list <-- %s\n", IIRP, header);
+                status = STATUS_ERROR;
+                break;
+            }
+
+            char **temp = realloc(block->items, (block->count + 1) * sizeof(char *));
+            if (!temp) {
+                status = STATUS_ERROR;
+                break;
+            }
+            block->items = temp;
+            block->items[block->count] = strdup(value);
+            if (!block->items[block->count]) {
+                status = STATUS_ERROR;
+                break;
+            }
+            block->count++;
+            *p = saved;
+        }
+    }
+
+    free(copy);
+    return status;
+}
+
+static int AddLine(RepeatBlock *block, const char *line) {
+    if (block->line_count == block->line_capacity) {
+        size_t new_capacity = (block->line_capacity == 0) ? 8 : block->line_capacity * 2;
+        char **temp = realloc(block->lines, new_capacity * sizeof(char *));
+        if (!temp) return STATUS_ERROR;
+        block->lines = temp;
+        block->line_capacity = new_capacity;
+    }
+
+    block->lines[block->line_count] = strdup(line);
+    if (!block->lines[block->line_count]) return STATUS_ERROR;
+    block->line_count++;
+    return 0;
+}
+
+int ReadRepeatBlock(const char *header, LineReader *reader, RepeatBlock *block) {
+    if (!header || !reader || !block) return STATUS_ERROR;
+    memset(block, 0, sizeof(*block));
+
+    // On error the rest of the block is still consumed, so its body and
+    // `.endr` are not reported again as stray lines
+    int status = ParseHeader(header, block);
+
+    char *line = NULL;
+    while ((line = ReadLine(reader)) != NULL) {
+        if (IsRepeatEnd(line)) return status;
+        if (status != 0) continue;
+
+        if (IsRepeatStart(line)) {
+            printf("(-) Error: Nested %s/%s blocks are not supported <-- %s", IREPT, IIRP, line);
+            status = STATUS_ERROR;
+            continue;
+        }
+
+        // Every iteration would define the label again
+        Label label = {0};
+        if (AddLabel(line, &label) != STATUS_NO_RESULT) {
+            free(label.name);
+            printf("(-) Error: Labels are not allowed inside %s/%s blocks <-- %s", IREPT, IIRP, line);
+            status = STATUS_ERROR;
+            continue;
+        }
+
+        if (AddLine(block, line) != 0) status = STATUS_ERROR;
+    }
+
+    printf("(-) Error: Missing '%s' for a repetition block\n", IENDR);
+    return STATUS_ERROR;
+}
+
+static int Reserve(char **buf, size_t *buf_size, size_t needed) {
+    if (needed <= *buf_size) return 0;
+
+    size_t new_size = (*buf_size == 0) ? 128 : *buf_size;
+    while (new_size < needed) new_size *= 2;
+    char *temp = realloc(*buf, new_size);
+    if (!temp) return STATUS_ERROR;
+    *buf = temp;
+    *buf_size = new_size;
+    return 0;
+}
+
+char *RepeatLine(const RepeatBlock *block, size_t index, size_t iter, char **buf, size_t *buf_size) {
+    if (!block || index >= block->line_count || !buf || !buf_size) return NULL;
+
+    const char *line = block->lines[index];
+    size_t line_len = strlen(line);
+
+    if (!block->symbol) {
+        if (Reserve(buf, buf_size, line_len + 1) != 0) return NULL;
+        memcpy(*buf, line, line_len + 1);
+        return *buf;
+    }
+
+    // Replace whole-word occurrences of the symbol outside comments and strings
+    const char *value = block->items[iter];
+    size_t value_len = strlen(value);
+    size_t sym_len = strlen(block->symbol);
+    size_t out = 0;
+    bool in_string = false;
+
+    for (const char *p = line; *p;) {
+        if (*p == '"') in_string = !in_string;
+
+        if (!in_string && *p == COMMENT_DELIM) {
+            size_t rest = strlen(p);
+            if (Reserve(buf, buf_size, out + rest + 1) != 0) return NULL;
+            memcpy(*buf + out, p, rest);
+            out += rest;
+            break;
+        }
+
+        if (!in_string && IS_IDENT_START(*p) && (p == line || !IS_IDENT(p[-1]))) {
+            size_t len = 0;
+            while (IS_IDENT(p[len])) len++;
+
+            bool match = (len == sym_len && strncmp(p, block->symbol, len) == 0);
+            const char *src = match ? value : p;
+            size_t src_len = match ? value_len : len;
+
+            if (Reserve(buf, buf_size, out + src_len + 1) != 0) return NULL;
+            memcpy(*buf + out, src, src_len);
+            out += src_len;
+            p += len;
+            continue;
+        }
+
+        if (Reserve(buf, buf_size, out + 2) != 0) return NULL;
+        (*buf)[out++] = *p++;
+    }
+
+    (*buf)[out] = '\0';
+    return *buf;
+}
+
+void CleanUpRepeat(RepeatBlock *block) {
+    if (!block) return;
+
+    if (block->symbol) {
+        for (size_t i = 0; i < block->count; i++) free(block->items[i]);
+    }
+    free(block->items);
+    free(block->symbol);
+    for (size_t i = 0; i < block->line_count; i++) free(block->lines[i]);
+    free(block->lines);
+    memset(block, 0, sizeof(*block));
+}
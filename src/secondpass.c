@@ -2,11 +2,334 @@
 
 uint32_t curr_address = 100;
 
+// A word recorded in the first iteration of a `.rept` block, and the statement it came from
+typedef struct s_captured {
+    uint32_t     word;
+    DebugOrigin  origin;
+} Captured;
+
+// Words emitted while recording the first iteration of a `.rept` block
+static Captured *capture = NULL;
+static size_t capture_count = 0;
+static size_t capture_capacity = 0;
+static bool capturing = false;
+static bool position_dependent = false;  // Recorded words depend on their own address
+
+// Address of the first data word, the data follows the code
+static uint32_t data_base = 0;
+
+// Writes one word at the current address
+static void EmitWord(FILE *output_fd, uint32_t word) {
+    if (capturing) {
+        if (capture_count == capture_capacity) {
+            size_t new_capacity = (capture_capacity == 0) ? 64 : capture_capacity * 2;
+            Captured *temp = realloc(capture, new_capacity * sizeof(Captured));
+            if (temp) {
+                capture = temp;
+                capture_capacity = new_capacity;
+            } else {
+                position_dependent = true;  // Can't replay, re-encode instead
+            }
+        }
+        if (capture_count < capture_capacity) capture[capture_count++] = (Captured){word, DebugGetOrigin()};
+    }
+
+    if (word & R) RelocAddCode(curr_address);
+    if (ASSEMBLER_FLAGS.debug_map) DebugMarkCode(curr_address);
+    if (ASSEMBLER_FLAGS.listing) ListingCode(curr_address, word);
+
+    fprintf(output_fd, "%08u : ", curr_address++);
+    WordToHex(output_fd, word);
+}
+
+/*
+ * Encodes a single statement: instruction words go to the output,
+ * `.data`/`.string` values to the data segment.
+ * Returns 0 upon success, STATUS_ERROR if the line can't be encoded.
+ */
+static int EncodeLine(char *line, FILE *output_fd, Label *labels, size_t *label_count, uint32_t *data_segment) {
+    int status = 0;
+
+    TrimNewline(line);
+    LogDebug("Processing line: %s\n", line);
+    if (ASSEMBLER_FLAGS.debug_map || ASSEMBLER_FLAGS.listing) DebugReadMarker(line);
+    if (ASSEMBLER_FLAGS.listing) ListingStatement(line, DebugGetOrigin());
+    // The reader hands out a private, writable line; no copy needed
+    char *line_copy = line;
+
+    char *comment_start = strchr(line_copy, COMMENT_DELIM);
+    if (comment_start) *comment_start = '\0'; // Truncate comments
+
+    // Skip label definition if needed
+    char *ptr = strchr(line_copy, LABEL_DELIM);
+    if (ptr) {
+        ptr++;
+    } else {
+        ptr = line_copy; // no label
+    }
+
+    while (isspace(*ptr)) ptr++;
+
+    // If is a .extern or directive, continue
+    if (strncmp(ptr, IEXTERN, strlen(IEXTERN)) == 0) {
+        LogDebug("Skipping '.extern' directive!\n");
+        return status;
+    }
+
+    // Constants were defined by the first pass
+    if (strncmp(ptr, IEQU, strlen(IEQU)) == 0) return status;
+
+    // If is a .entry directive, add to .ent
+    if (strncmp(ptr, IENTRY, strlen(IENTRY)) == 0) {
+        // if (ASSEMBLER_FLAGS.gen_entries) {
+            ptr += strlen(IENTRY);
+            while (isspace(*ptr)) ptr++;
+            
+            Label *found = FindLabel(ptr, labels, label_count);
+            if (!found) {
+                printf("(-) Error: Found .entry directive but couldn't find label definition! <-- %s\n", ptr);
+                return status;
+
+            // ASSEMBLER_FLAGS.append_to_ent = true;
+            // fprintf(entry_fd, "%s: %08zu\n", found->name, found->address);
+            // LogDebug("Wrote entry directive to entries file!\n");
+        }
+        // return status;
+        // }
+    }
+
+    // If it is a DS directive, add to data section
+    ExprScope scope = { labels, label_count };
+    if (strncmp(ptr, ISTRING, strlen(ISTRING)) == 0
+    || strncmp(ptr, IDATA, strlen(IDATA)) == 0) {
+        // Pooled data is emitted once the whole program has been encoded
+        uint32_t first = data_segment[0];
+        if (!ASSEMBLER_FLAGS.pool_data && HandleDSDirective(ptr, data_segment, &scope) < 0) {
+            printf("(-) Error: Invalid data directive <-- %s\n", line);
+            status = STATUS_ERROR;
+        }
+        if (ASSEMBLER_FLAGS.debug_map && data_segment[0] > first) DebugMarkData(first);
+        if (ASSEMBLER_FLAGS.listing) {
+            for (uint32_t i = first; i < data_segment[0]; i++) ListingData(data_base + i - 1, data_segment[i]);
+        }
+        return status;
+    }
+
+    while (isspace(*ptr)) ptr++;
+
+    // Handle instruction
+    char mnemonic[MAX_MNEMONIC_LENGTH + 1] = {0};
+    CopyToken(ptr, mnemonic, sizeof(mnemonic));
+
+    const Command *comm = FindCommand(mnemonic);
+    if (!comm) {
+        LogDebug("Skipping non-command line %s\n", ptr);
+        return status;
+    }
+    LogDebug("Found command: %s\n", comm->name);
+
+    ptr += strlen(comm->name); 
+
+    uint32_t word = 0;
+    uint8_t add_modes = (uint8_t)DetermineAddressingModes(ptr, comm->opcount); 
+    int non_reg = EncodeCommand(ptr, comm, add_modes, &word);
+    LogDebug("Encoded command word:\n");
+    
+    bool is_last_word = true;
+    if (non_reg > 0) is_last_word = false;
+
+    if (CURRENT_LOG_LEVEL >= LOG_DEBUG) {
+        LogDebug("Hex: 0x%08X | Bin: 0b", word);
+        LogU32AsBin(word);
+    }
+
+    // Emit first word
+    EmitWord(output_fd, word);
+    LogDebug("Wrote command word at %u to output.\n", curr_address-1);
+
+    // Tokenize the operands after command
+    char *src = NULL, *dst = NULL;
+    if (non_reg) {
+        src = strtok(ptr, ",");
+        dst = strtok(NULL, ",");
+    }
+
+    // Skip leading spaces
+    if (src) while (isspace(*src)) src++;
+    if (dst) while (isspace(*dst)) dst++;
+
+    // Now emit additional words
+    if (src) {
+        if (*src == '#') {
+            non_reg--;
+            is_last_word = (non_reg == 0);
+
+            uint32_t imm = EncodeImm(src, labels, label_count, is_last_word, &status);
+            EmitWord(output_fd, imm);
+
+            LogDebug("Encoded immediate operand at %u:\n", curr_address-1);
+            if (CURRENT_LOG_LEVEL >= LOG_DEBUG) {
+                LogDebug("Hex: 0x%08X | Bin: 0b", imm);
+                LogU32AsBin(imm);
+            }
+        } else if (*src == '&') {
+            non_reg--;
+            is_last_word = (non_reg == 0);
+
+            uint32_t rel = EncodeRel(src + 1, labels, label_count, curr_address, is_last_word, &status); // Skip '&'
+            position_dependent = true;
+            EmitWord(output_fd, rel);
+
+            LogDebug("Encoded relative operand at %u:\n", curr_address-1);
+            if (CURRENT_LOG_LEVEL >= LOG_DEBUG) {
+                LogDebug("Hex: 0x%08X | Bin: 0b", rel);
+                LogU32AsBin(rel);
+            }
+        } else if (*src != 'r') {
+            non_reg--;
+            is_last_word = (non_reg == 0);
+
+            uint32_t dir = EncodeDir(src, labels, label_count, curr_address, is_last_word, &status);
+            if (dir & E) position_dependent = true;  // Extern usages are recorded per address
+            EmitWord(output_fd, dir);
+
+            LogDebug("Encoded direct operand at %u:\n", curr_address-1);
+            if (CURRENT_LOG_LEVEL >= LOG_DEBUG) {
+                LogDebug("Hex: 0x%08X | Bin: 0b", dir);
+                LogU32AsBin(dir);
+            }
+        }
+    }
+
+    if (dst && (non_reg >= 1)) {
+        if (*dst == '#') {
+            non_reg--;
+            is_last_word = (non_reg == 0);
+
+            uint32_t imm = EncodeImm(dst, labels, label_count, is_last_word, &status);
+            EmitWord(output_fd, imm);
+            
+            LogDebug("Encoded immediate operand at %u:\n", curr_address-1);
+            if (CURRENT_LOG_LEVEL >= LOG_DEBUG) {
+                LogDebug("Hex: 0x%08X | Bin: 0b", imm);
+                LogU32AsBin(imm);
+            }
+        } else if (*dst == '&') {
+            non_reg--;
+            is_last_word = (non_reg == 0);
+
+            uint32_t rel = EncodeRel(dst + 1, labels, label_count, curr_address, is_last_word, &status); // skip &
+            position_dependent = true;
+            EmitWord(output_fd, rel);
+
+            LogDebug("Encoded relative operand at %u:\n", curr_address-1);
+            if (CURRENT_LOG_LEVEL >= LOG_DEBUG) {
+                LogDebug("Hex: 0x%08X | Bin: 0b", rel);
+                LogU32AsBin(rel);
+            }
+        } else if (*dst != 'r') {
+            non_reg--;
+            is_last_word = (non_reg == 0);
+            
+            uint32_t dir = EncodeDir(dst, labels, label_count, curr_address, is_last_word, &status);
+            if (dir & E) position_dependent = true;  // Extern usages are recorded per address
+            EmitWord(output_fd, dir);
+
+            LogDebug("Encoded direct operand at %u:\n", curr_address-1);
+            if (CURRENT_LOG_LEVEL >= LOG_DEBUG) {
+                LogDebug("Hex: 0x%08X | Bin: 0b", dir);
+                LogU32AsBin(dir);
+            }
+        }
+    }
+    return status;
+}
+
+/*
+ * Encodes a `.rept`/`.irp` block from its body, read once.
+ * An `.irp` body is encoded per value. A `.rept` body is encoded once while
+ * its words are recorded, and the recorded words and data are replayed for
+ * the remaining iterations, unless they depend on their own address
+ * (relative operands, extern usages), in which case each iteration is encoded.
+ */
+static int EncodeRepeatBlock(char *header, LineReader *reader, FILE *output_fd, Label *labels, size_t *label_count, uint32_t *data_segment) {
+    if (ASSEMBLER_FLAGS.listing) ListingStatement(header, DebugParseMarker(header));
+
+    RepeatBlock block;
+    if (ReadRepeatBlock(header, reader, &block) != 0) {
+        CleanUpRepeat(&block);
+        return STATUS_ERROR;
+    }
+
+    int status = 0;
+    char *buf = NULL;
+    size_t buf_size = 0;
+    size_t iter = 0;
+
+    if (!block.symbol && block.count > 0) {
+        uint32_t data_start = data_segment[0];
+        size_t data_relocs = RelocDataCount();
+        capture_count = 0;
+        capturing = true;
+        position_dependent = false;
+
+        // Where each body line's words and data end, so a replay can be listed line by line
+        size_t *word_ends = malloc(block.line_count * sizeof(size_t));
+        uint32_t *data_ends = malloc(block.line_count * sizeof(uint32_t));
+        if (block.line_count > 0 && (!word_ends || !data_ends)) position_dependent = true;
+
+        for (size_t i = 0; i < block.line_count; i++) {
+            char *line = RepeatLine(&block, i, 0, &buf, &buf_size);
+            if (!line || EncodeLine(line, output_fd, labels, label_count, data_segment) != 0) status = STATUS_ERROR;
+            if (word_ends && data_ends) {
+                word_ends[i] = capture_count;
+                data_ends[i] = data_segment[0];
+            }
+        }
+        capturing = false;
+        iter = 1;
+        if (RelocDataCount() != data_relocs) position_dependent = true;  // Data addresses can't be copied
+
+        if (!position_dependent && status == 0) {
+            for (; iter < block.count; iter++) {
+                size_t w = 0;
+                uint32_t d = data_start;
+                for (size_t i = 0; i < block.line_count; i++) {
+                    if (ASSEMBLER_FLAGS.listing) ListingStatement(block.lines[i], DebugParseMarker(block.lines[i]));
+                    for (; w < word_ends[i]; w++) {
+                        DebugSetOrigin(capture[w].origin);
+                        EmitWord(output_fd, capture[w].word);
+                    }
+                    for (; d < data_ends[i]; d++) {
+                        uint32_t at = data_segment[0]++;
+                        data_segment[at] = data_segment[d];
+                        if (ASSEMBLER_FLAGS.listing) ListingData(data_base + at - 1, data_segment[at]);
+                    }
+                }
+            }
+            LogDebug("Replayed %zu recorded words %zu times\n", capture_count, block.count - 1);
+        }
+        free(word_ends);
+        free(data_ends);
+    }
+
+    for (; iter < block.count; iter++) {
+        for (size_t i = 0; i < block.line_count; i++) {
+            char *line = RepeatLine(&block, i, iter, &buf, &buf_size);
+            if (!line || EncodeLine(line, output_fd, labels, label_count, data_segment) != 0) status = STATUS_ERROR;
+        }
+    }
+
+    free(buf);
+    CleanUpRepeat(&block);
+    return status;
+}
+
 int EncodeFile(char *input_path, char *output_path, Label *labels, size_t *label_count, uint32_t *data_segment, uint32_t icf, uint32_t dcf) {
     if (!input_path || !output_path || !labels || !label_count) return STATUS_ERROR;
 
-    FILE *input_fd = fopen(input_path, "r");
-    if (!input_fd) {
+    LineReader reader;
+    if (LineReaderOpen(&reader, input_path) != 0) {
         printf("(-) Failed to open input file: %s\n", input_path);
         return STATUS_ERROR;
     }
@@ -16,7 +339,7 @@ int EncodeFile(char *input_path, char *output_path, Label *labels, size_t *label
     else output_fd = fopen(output_path, "w");
     if (!output_fd) {
         printf("(-) Failed to open output file: %s\n", input_path);
-        fclose(input_fd);
+        LineReaderClose(&reader);
         return STATUS_ERROR;
     }
 
@@ -44,197 +367,25 @@ int EncodeFile(char *input_path, char *output_path, Label *labels, size_t *label
     // }
 
     if (!ASSEMBLER_FLAGS.append_to_out) {
+        if (ASSEMBLER_FLAGS.compile_only) fprintf(output_fd, "SNL|%d\n", WORD_WIDTH);
         fprintf(output_fd, "%u|%u\n", icf-100, dcf);
         LogDebug("Wrote header to output: %u | %u\n", icf, dcf);
     }
 
-    char line[MAX_LINE_LENGTH] = {0};
-    while (fgets(line, MAX_LINE_LENGTH, input_fd) != NULL) {
-        TrimNewline(line);
-        LogDebug("Processing line: %s\n", line);
-        // Make a local copy of the line to avoid modifying the original
-        char line_copy[MAX_LINE_LENGTH];
-        strncpy(line_copy, line, MAX_LINE_LENGTH);
-        line_copy[MAX_LINE_LENGTH - 1] = '\0';  // Ensure null termination
-
-        char *comment_start = strchr(line_copy, COMMENT_DELIM);
-        if (comment_start) *comment_start = '\0'; // Truncate comments
-
-        // Skip label definition if needed
-        char *ptr = strchr(line_copy, LABEL_DELIM);
-        if (ptr) {
-            ptr++;
-        } else {
-            ptr = line_copy; // no label
-        }
-
-        while (isspace(*ptr)) ptr++;
+    data_base = icf;
 
-        // If is a .extern or directive, continue
-        if (strncmp(ptr, IEXTERN, strlen(IEXTERN)) == 0) {
-            LogDebug("Skipping '.extern' directive!\n");
+    int status = 0;
+    char *line = NULL;
+    while ((line = ReadLine(&reader)) != NULL) {
+        if (IsRepeatStart(line)) {
+            if (EncodeRepeatBlock(line, &reader, output_fd, labels, label_count, data_segment) != 0) status = STATUS_ERROR;
             continue;
         }
-
-        // If is a .entry directive, add to .ent
-        if (strncmp(ptr, IENTRY, strlen(IENTRY)) == 0) {
-            // if (ASSEMBLER_FLAGS.gen_entries) {
-                ptr += strlen(IENTRY);
-                while (isspace(*ptr)) ptr++;
-                
-                Label *found = FindLabel(ptr, labels, label_count);
-                if (!found) {
-                    printf("(-) Error: Found .entry directive but couldn't find label definition! <-- %s\n", ptr);
-                    continue;
-
-                // ASSEMBLER_FLAGS.append_to_ent = true;
-                // fprintf(entry_fd, "%s: %08zu\n", found->name, found->address);
-                // LogDebug("Wrote entry directive to entries file!\n");
-            }
-            // continue;
-            // }
-        }
-
-        // If it is a DS directive, add to data section
-        if (strncmp(ptr, ISTRING, strlen(ISTRING)) == 0
-        || strncmp(ptr, IDATA, strlen(IDATA)) == 0) {
-            HandleDSDirective(ptr, data_segment);
-        }
-
-        while (isspace(*ptr)) ptr++;
-
-        // Handle instruction
-        char mnemonic[MAX_LINE_LENGTH] = {0};
-        sscanf(ptr, "%s", mnemonic);
-
-        const Command *comm = FindCommand(mnemonic);
-        if (!comm) {
-            LogDebug("Skipping non-command line %s\n", ptr);
-            continue;
-        }
-        LogDebug("Found command: %s\n", comm->name);
-
-        ptr += strlen(comm->name); 
-
-        uint32_t word = 0;
-        uint8_t add_modes = (uint8_t)DetermineAddressingModes(ptr, comm->opcount); 
-        int non_reg = EncodeCommand(ptr, comm, add_modes, &word);
-        LogDebug("Encoded command word:\n");
-        
-        bool is_last_word = true;
-        if (non_reg > 0) is_last_word = false;
-
-        if (CURRENT_LOG_LEVEL >= LOG_DEBUG) {
-            LogDebug("Hex: 0x%08X | Bin: 0b", word);
-            LogU32AsBin(word);
-        }
-
-        // Emit first word
-        fprintf(output_fd, "%08u : ", curr_address++);
-        WordToHex(output_fd, word);
-        LogDebug("Wrote command word at %u to output.\n", curr_address-1);
-
-        // Tokenize the operands after command
-        char *src = NULL, *dst = NULL;
-        if (non_reg) {
-            char op_copy[MAX_LINE_LENGTH];
-            strncpy(op_copy, ptr, MAX_LINE_LENGTH);
-            op_copy[MAX_LINE_LENGTH - 1] = '\0';
-        
-            src = strtok(op_copy, ",");
-            dst = strtok(NULL, ",");
-        }
-
-        // Skip leading spaces
-        if (src) while (isspace(*src)) src++;
-        if (dst) while (isspace(*dst)) dst++;
-
-        // Now emit additional words
-        if (src) {
-            if (*src == '#') {
-                non_reg--;
-                is_last_word = (non_reg == 0);
-
-                uint32_t imm = EncodeImm(src, is_last_word);
-                fprintf(output_fd, "%08u : ", curr_address++);
-                WordToHex(output_fd, imm);
-
-                LogDebug("Encoded immediate operand at %u:\n", curr_address-1);
-                if (CURRENT_LOG_LEVEL >= LOG_DEBUG) {
-                    LogDebug("Hex: 0x%08X | Bin: 0b", imm);
-                    LogU32AsBin(imm);
-                }
-            } else if (*src == '&') {
-                non_reg--;
-                is_last_word = (non_reg == 0);
-
-                uint32_t rel = EncodeRel(src + 1, labels, label_count, curr_address, is_last_word); // Skip '&'
-                fprintf(output_fd, "%08u : ", curr_address++);
-                WordToHex(output_fd, rel);
-
-                LogDebug("Encoded relative operand at %u:\n", curr_address-1);
-                if (CURRENT_LOG_LEVEL >= LOG_DEBUG) {
-                    LogDebug("Hex: 0x%08X | Bin: 0b", rel);
-                    LogU32AsBin(rel);
-                }
-            } else if (*src != 'r') {
-                non_reg--;
-                is_last_word = (non_reg == 0);
-
-                uint32_t dir = EncodeDir(src, labels, label_count, curr_address, is_last_word);
-                fprintf(output_fd, "%08u : ", curr_address++);
-                WordToHex(output_fd, dir);
-
-                LogDebug("Encoded direct operand at %u:\n", curr_address-1);
-                if (CURRENT_LOG_LEVEL >= LOG_DEBUG) {
-                    LogDebug("Hex: 0x%08X | Bin: 0b", dir);
-                    LogU32AsBin(dir);
-                }
-            }
-        }
-
-        if (dst && (non_reg >= 1)) {
-            if (*dst == '#') {
-                non_reg--;
-                is_last_word = (non_reg == 0);
-
-                uint32_t imm = EncodeImm(dst, is_last_word);
-                fprintf(output_fd, "%08u : ", curr_address++);
-                WordToHex(output_fd, imm);
-                
-                LogDebug("Encoded immediate operand at %u:\n", curr_address-1);
-                if (CURRENT_LOG_LEVEL >= LOG_DEBUG) {
-                    LogDebug("Hex: 0x%08X | Bin: 0b", imm);
-                    LogU32AsBin(imm);
-                }
-            } else if (*dst == '&') {
-                non_reg--;
-                is_last_word = (non_reg == 0);
-
-                uint32_t rel = EncodeRel(dst + 1, labels, label_count, curr_address, is_last_word); // skip &
-                fprintf(output_fd, "%08u : ", curr_address++);
-                WordToHex(output_fd, rel);
-
-                LogDebug("Encoded relative operand at %u:\n", curr_address-1);
-                if (CURRENT_LOG_LEVEL >= LOG_DEBUG) {
-                    LogDebug("Hex: 0x%08X | Bin: 0b", rel);
-                    LogU32AsBin(rel);
-                }
-            } else if (*dst != 'r') {
-                non_reg--;
-                is_last_word = (non_reg == 0);
-                
-                uint32_t dir = EncodeDir(dst, labels, label_count, curr_address, is_last_word);
-                fprintf(output_fd, "%08u : ", curr_address++);
-                WordToHex(output_fd, dir);
-
-                LogDebug("Encoded direct operand at %u:\n", curr_address-1);
-                if (CURRENT_LOG_LEVEL >= LOG_DEBUG) {
-                    LogDebug("Hex: 0x%08X | Bin: 0b", dir);
-                    LogU32AsBin(dir);
-                }
-            }
-        }
+        if (EncodeLine(line, output_fd, labels, label_count, data_segment) != 0) status = STATUS_ERROR;
+    }
+    if (reader.failed) {
+        printf("(-) Error: Out of memory reading line %zu of %s\n", reader.line_no + 1, input_path);
+        status = STATUS_ERROR;
     }
 
     LogVerbose("Successfully encoded %s - Wrote %u words to output\n", input_path,curr_address-100);
@@ -243,10 +394,15 @@ int EncodeFile(char *input_path, char *output_path, Label *labels, size_t *label
     if (!ASSEMBLER_FLAGS.append_to_out) ASSEMBLER_FLAGS.append_to_out = true;
 
     // Cleanup
-    fclose(input_fd);
+    free(capture);
+    capture = NULL;
+    capture_count = capture_capacity = 0;
+
+    LineReaderClose(&reader);
     fclose(output_fd);
     // if (extern_fd) fclose(extern_fd);
     // if (entry_fd)  fclose(entry_fd);
 
+    if (status != 0) return status;
     return curr_address-100;
 }
\ No newline at end of file
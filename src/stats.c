@@ -0,0 +1,273 @@
+#include "../include/stats.h"
+
+#if defined(_WIN32) || defined(_WIN64)
+#define STATS_NO_RUSAGE
+#else
+#include <sys/resource.h>
+#endif
+
+#define STATS_COUNT_CHUNK  65536
+
+typedef struct s_stats_entry {
+    const char  *stage;   // Stage names are string literals
+    char        *file;    // NULL for the stage as a whole
+    double       wall;
+    double       cpu;
+    StatsCounts  counts;
+    long         peak_rss;  // KiB
+} StatsEntry;
+
+static StatsEntry *records = NULL;
+static size_t record_count = 0;
+static size_t record_capacity = 0;
+
+// Time StatsCountFile has taken, which timers leave out
+static double counted_wall = 0;
+static double counted_cpu = 0;
+
+static double WallSeconds(void) {
+    struct timespec now;
+#ifdef STATS_NO_RUSAGE
+    timespec_get(&now, TIME_UTC);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &now);
+#endif
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+static double CpuSeconds(void) {
+#ifdef STATS_NO_RUSAGE
+    return (double)clock() / CLOCKS_PER_SEC;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+#endif
+}
+
+// Peak resident set size of the run so far in KiB, 0 where it can't be read
+static long PeakRss(void) {
+#ifdef STATS_NO_RUSAGE
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return usage.ru_maxrss;  // KiB on Linux
+#endif
+}
+
+void StatsStart(StatsTimer *timer) {
+    timer->wall = WallSeconds();
+    timer->cpu = CpuSeconds();
+    timer->counted_wall = counted_wall;
+    timer->counted_cpu = counted_cpu;
+}
+
+static StatsEntry *FindRecord(const char *stage, const char *file) {
+    for (size_t i = 0; i < record_count; i++) {
+        if (strcmp(records[i].stage, stage) != 0) continue;
+        if (!file && !records[i].file) return &records[i];
+        if (file && records[i].file && strcmp(records[i].file, file) == 0) return &records[i];
+    }
+    return NULL;
+}
+
+void StatsRecord(const StatsTimer *timer, const char *stage, const char *file, const StatsCounts *counts) {
+    double wall = WallSeconds() - timer->wall - (counted_wall - timer->counted_wall);
+    double cpu = CpuSeconds() - timer->cpu - (counted_cpu - timer->counted_cpu);
+
+    StatsEntry *record = FindRecord(stage, file);
+    if (!record) {
+        if (record_count == record_capacity) {
+            size_t new_capacity = (record_capacity == 0) ? 32 : record_capacity * 2;
+            StatsEntry *temp = realloc(records, new_capacity * sizeof(StatsEntry));
+            if (!temp) return;  // Statistics are best effort, the run goes on without them
+            records = temp;
+            record_capacity = new_capacity;
+        }
+        char *name = file ? strdup(file) : NULL;
+        if (file && !name) return;
+        record = &records[record_count++];
+        memset(record, 0, sizeof(StatsEntry));
+        record->stage = stage;
+        record->file = name;
+    }
+
+    record->wall += wall;
+    record->cpu += cpu;
+    if (counts) {
+        record->counts.lines += counts->lines;
+        record->counts.bytes += counts->bytes;
+        record->counts.words += counts->words;
+        record->counts.symbols += counts->symbols;
+        record->counts.macros += counts->macros;
+    }
+    record->peak_rss = PeakRss();
+}
+
+int StatsCountFile(const char *path, StatsCounts *counts) {
+    StatsTimer timer;
+    StatsStart(&timer);
+    FILE *file = fopen(path, "rb");
+    if (!file) return STATUS_ERROR;
+
+    char chunk[STATS_COUNT_CHUNK];
+    size_t read = 0;
+    char last = '\n';
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        counts->bytes += read;
+        for (const char *p = chunk; (p = memchr(p, '\n', (size_t)(chunk + read - p))) != NULL; p++) counts->lines++;
+        last = chunk[read - 1];
+    }
+    if (last != '\n') counts->lines++;  // A last line without its newline
+
+    int status = ferror(file) ? STATUS_ERROR : 0;
+    fclose(file);
+    counted_wall += WallSeconds() - timer.wall;
+    counted_cpu += CpuSeconds() - timer.cpu;
+    return status;
+}
+
+/// REPORTING ///
+
+static double PerSecond(uint64_t count, double seconds) {
+    return (seconds > 0) ? (double)count / seconds : 0.0;
+}
+
+static void PrintRow(const char *name, int indent, const StatsEntry *record) {
+    printf("    %*s%-*s %10.3f %10.3f %10llu %12llu %12.0f %9llu %8llu %7llu %10ld\n", indent, "", 26 - indent, name,
+        record->wall * 1e3, record->cpu * 1e3,
+        (unsigned long long)record->counts.lines, (unsigned long long)record->counts.bytes,
+        PerSecond(record->counts.lines, record->wall),
+        (unsigned long long)record->counts.words, (unsigned long long)record->counts.symbols,
+        (unsigned long long)record->counts.macros, record->peak_rss);
+}
+
+// Each stage once, in the order the run first reached it
+static bool FirstOfStage(size_t index) {
+    for (size_t i = 0; i < index; i++) {
+        if (strcmp(records[i].stage, records[index].stage) == 0) return false;
+    }
+    return true;
+}
+
+static void PrintTable(const StatsEntry *total) {
+    printf("(*) Statistics:\n");
+    printf("    %-26s %10s %10s %10s %12s %12s %9s %8s %7s %10s\n",
+        "Stage / file", "Wall ms", "CPU ms", "Lines", "Bytes", "Lines/s", "Words", "Symbols", "Macros", "Peak KiB");
+    for (size_t i = 0; i < record_count; i++) {
+        if (!FirstOfStage(i)) continue;
+        const StatsEntry *stage = FindRecord(records[i].stage, NULL);
+        if (stage) PrintRow(stage->stage, 0, stage);
+        for (size_t j = i; j < record_count; j++) {
+            if (records[j].file && strcmp(records[j].stage, records[i].stage) == 0) PrintRow(records[j].file, 2, &records[j]);
+        }
+    }
+    PrintRow("Total", 0, total);
+}
+
+static void WriteJsonString(BufferedWriter *out, const char *text) {
+    WriteBytes(out, "\"", 1);
+    for (const unsigned char *p = (const unsigned char *)text; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            char escaped[2] = {'\\', (char)*p};
+            WriteBytes(out, escaped, 2);
+        } else if (*p < 0x20) {
+            WriteFormat(out, "\\u%04x", *p);
+        } else {
+            WriteBytes(out, (const char *)p, 1);
+        }
+    }
+    WriteBytes(out, "\"", 1);
+}
+
+static void WriteJsonFigures(BufferedWriter *out, const StatsEntry *record) {
+    WriteFormat(out, "\"wall_ms\": %.3f, \"cpu_ms\": %.3f, \"lines\": %llu, \"bytes\": %llu, \"lines_per_second\": %.0f, "
+        "\"words\": %llu, \"symbols\": %llu, \"macros\": %llu, \"peak_rss_kib\": %ld",
+        record->wall * 1e3, record->cpu * 1e3,
+        (unsigned long long)record->counts.lines, (unsigned long long)record->counts.bytes,
+        PerSecond(record->counts.lines, record->wall),
+        (unsigned long long)record->counts.words, (unsigned long long)record->counts.symbols,
+        (unsigned long long)record->counts.macros, record->peak_rss);
+}
+
+static int WriteJson(const char *path, const StatsEntry *total) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        printf("(-) Error: Failed to open output file: %s\n", path);
+        return STATUS_ERROR;
+    }
+    BufferedWriter out;
+    if (WriterOpen(&out, file) != 0) {
+        fclose(file);
+        return STATUS_ERROR;
+    }
+
+    WriteText(&out, "{\n  \"total\": {");
+    WriteJsonFigures(&out, total);
+    WriteText(&out, "},\n  \"stages\": [");
+    bool first_stage = true;
+    for (size_t i = 0; i < record_count; i++) {
+        if (!FirstOfStage(i)) continue;
+        const StatsEntry *stage = FindRecord(records[i].stage, NULL);
+        WriteText(&out, first_stage ? "\n    {\"stage\": " : ",\n    {\"stage\": ");
+        WriteJsonString(&out, records[i].stage);
+        if (stage) {
+            WriteText(&out, ", ");
+            WriteJsonFigures(&out, stage);
+        }
+        WriteText(&out, ", \"files\": [");
+        bool first_file = true;
+        for (size_t j = i; j < record_count; j++) {
+            if (!records[j].file || strcmp(records[j].stage, records[i].stage) != 0) continue;
+            WriteText(&out, first_file ? "\n      {\"file\": " : ",\n      {\"file\": ");
+            WriteJsonString(&out, records[j].file);
+            WriteText(&out, ", ");
+            WriteJsonFigures(&out, &records[j]);
+            WriteText(&out, "}");
+            first_file = false;
+        }
+        WriteText(&out, first_file ? "]}" : "\n    ]}");
+        first_stage = false;
+    }
+    WriteText(&out, "\n  ]\n}\n");
+
+    int status = WriterClose(&out);
+    if (fclose(file) != 0) status = STATUS_ERROR;
+    if (status != 0) printf("(-) Error: Failed to write statistics to %s\n", path);
+    else LogVerbose("Wrote statistics to %s\n", path);
+    return status;
+}
+
+int StatsReport(int mode, const StatsTimer *start, const char *json_path) {
+    // The run as a whole, its counts are the stages' that handle each line once
+    StatsEntry total = {0};
+    total.stage = "Total";
+    total.wall = WallSeconds() - start->wall;
+    total.cpu = CpuSeconds() - start->cpu;
+    total.peak_rss = PeakRss();
+    const StatsEntry *pre = FindRecord("PreAssemble", NULL);
+    const StatsEntry *second = FindRecord("SecondPass", NULL);
+    const StatsEntry *first = FindRecord("FirstPass", NULL);
+    const StatsEntry *output = FindRecord("Output", NULL);
+    if (pre) {
+        total.counts.lines = pre->counts.lines;
+        total.counts.bytes = pre->counts.bytes;
+        total.counts.macros = pre->counts.macros;
+    }
+    if (first) total.counts.symbols = first->counts.symbols;
+    if (second) total.counts.words += second->counts.words;
+    if (output) total.counts.words += output->counts.words;
+
+    if (mode == STATS_JSON) return WriteJson(json_path, &total);
+    PrintTable(&total);
+    return 0;
+}
+
+void StatsCleanUp(void) {
+    for (size_t i = 0; i < record_count; i++) free(records[i].file);
+    free(records);
+    records = NULL;
+    record_count = record_capacity = 0;
+    counted_wall = counted_cpu = 0;
+}
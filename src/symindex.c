@@ -0,0 +1,71 @@
+#include "../include/symindex.h"
+
+// FNV-1a over the name
+static uint32_t HashName(const char *name) {
+    uint32_t hash = 2166136261u;
+    for (; *name; name++) {
+        hash ^= (unsigned char)*name;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static int GrowIndex(SymbolIndex *index) {
+    size_t new_capacity = (index->capacity == 0) ? 64 : index->capacity * 2;
+    const char **names = calloc(new_capacity, sizeof(char *));
+    void **values = calloc(new_capacity, sizeof(void *));
+    if (!names || !values) {
+        free(names);
+        free(values);
+        return STATUS_ERROR;
+    }
+
+    for (size_t i = 0; i < index->capacity; i++) {
+        if (!index->names[i]) continue;
+        size_t slot = HashName(index->names[i]) & (new_capacity - 1);
+        while (names[slot]) slot = (slot + 1) & (new_capacity - 1);
+        names[slot] = index->names[i];
+        values[slot] = index->values[i];
+    }
+
+    free(index->names);
+    free(index->values);
+    index->names = names;
+    index->values = values;
+    index->capacity = new_capacity;
+    return 0;
+}
+
+int IndexInsert(SymbolIndex *index, const char *name, void *value) {
+    if (!index || !name) return STATUS_ERROR;
+    if (2 * (index->count + 1) > index->capacity && GrowIndex(index) != 0) return STATUS_ERROR;
+
+    size_t slot = HashName(name) & (index->capacity - 1);
+    while (index->names[slot]) {
+        if (strcmp(index->names[slot], name) == 0) return STATUS_WRONG;
+        slot = (slot + 1) & (index->capacity - 1);
+    }
+
+    index->names[slot] = name;
+    index->values[slot] = value;
+    index->count++;
+    return 0;
+}
+
+void *IndexFind(const SymbolIndex *index, const char *name) {
+    if (!index || !name || index->capacity == 0) return NULL;
+
+    size_t slot = HashName(name) & (index->capacity - 1);
+    while (index->names[slot]) {
+        if (strcmp(index->names[slot], name) == 0) return index->values[slot];
+        slot = (slot + 1) & (index->capacity - 1);
+    }
+    return NULL;
+}
+
+void CleanUpIndex(SymbolIndex *index) {
+    if (!index) return;
+    free(index->names);
+    free(index->values);
+    memset(index, 0, sizeof(SymbolIndex));
+}
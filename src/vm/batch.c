@@ -0,0 +1,444 @@
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../include/batch.h"
+#include "../../include/io.h"
+#include "../../include/jit.h"
+#include "../../include/symindex.h"
+
+static const char *status_names[] = { "RUNNING", "HALTED", "BUDGET", "FAULT", "CHECKPOINT" };
+
+typedef struct s_worker {
+    Batch     *batch;
+    size_t     index;
+    size_t     steals;
+    pthread_t  thread;
+} Worker;
+
+static double Now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+static size_t CpuCount(void) {
+#ifdef _SC_NPROCESSORS_ONLN
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (count > 0) return (size_t)count;
+#endif
+    return 1;
+}
+
+// Returns the image with these contents, adding it if it is new. NULL upon failure
+static BatchImage *InternImage(Batch *batch, SymbolIndex *index, char *contents, const char *path) {
+    BatchImage *image = IndexFind(index, contents);
+    if (image) {
+        free(contents);
+        return image;
+    }
+
+    if (batch->image_count == batch->image_capacity) {
+        size_t new_capacity = (batch->image_capacity == 0) ? 16 : batch->image_capacity * 2;
+        BatchImage **images = realloc(batch->images, new_capacity * sizeof(BatchImage *));
+        if (!images) return NULL;
+        batch->images = images;
+        batch->image_capacity = new_capacity;
+    }
+
+    image = calloc(1, sizeof(BatchImage));
+    if (!image) return NULL;
+    image->contents = contents;
+    image->path = path;
+    pthread_mutex_init(&image->lock, NULL);
+    batch->images[batch->image_count++] = image;
+
+    if (IndexInsert(index, image->contents, image) != 0) return NULL;
+    return image;
+}
+
+// Adds a `rN=value` register setting to the job. Returns 0 upon success, else STATUS_ERROR
+static int AddSetting(BatchJob *job, const char *token) {
+    char *end = NULL;
+    long reg = strtol(token + 1, &end, 10);
+    if (end == token + 1 || *end != '=' || reg < 0 || reg >= VM_REGISTERS) return STATUS_ERROR;
+
+    const char *text = end + 1;
+    long long value = strtoll(text, &end, 0);
+    if (end == text || *end != '\0' || value < INT32_MIN || value > (long long)UINT32_MAX) return STATUS_ERROR;
+
+    BatchSetting *settings = realloc(job->settings, (job->setting_count + 1) * sizeof(BatchSetting));
+    if (!settings) return STATUS_ERROR;
+    job->settings = settings;
+    settings[job->setting_count].reg = (int)reg;
+    settings[job->setting_count].value = (int32_t)(uint32_t)value;
+    job->setting_count++;
+    return 0;
+}
+
+// Parses `path [budget] [rN=value ...]` into a new job. Returns 0 upon success,
+// STATUS_NO_RESULT for a blank line, else STATUS_ERROR
+static int ParseManifestLine(char *line, const char *directory, uint64_t budget, BatchJob *job) {
+    char *comment = strchr(line, ';');
+    if (comment) *comment = '\0';
+
+    char *path = strtok(line, " \t\r\n");
+    if (!path) return STATUS_NO_RESULT;
+
+    job->budget = budget;
+    bool has_budget = false;
+    for (char *token = strtok(NULL, " \t\r\n"); token; token = strtok(NULL, " \t\r\n")) {
+        if (token[0] == 'r' && strchr(token, '=')) {
+            if (AddSetting(job, token) != 0) return STATUS_ERROR;
+            continue;
+        }
+
+        char *end = NULL;
+        job->budget = strtoull(token, &end, 10);
+        if (has_budget || *end != '\0' || !isdigit((unsigned char)token[0])) return STATUS_ERROR;
+        has_budget = true;
+    }
+
+    size_t length = strlen(directory) + strlen(path) + 2;
+    job->path = malloc(length);
+    if (!job->path) return STATUS_ERROR;
+    if (path[0] == '/' || directory[0] == '\0') snprintf(job->path, length, "%s", path);
+    else snprintf(job->path, length, "%s/%s", directory, path);
+    return 0;
+}
+
+int LoadBatch(const char *manifest, int width, uint64_t budget, Batch *batch) {
+    memset(batch, 0, sizeof(Batch));
+    batch->width = width;
+
+    LineReader reader;
+    if (LineReaderOpen(&reader, manifest) != 0) {
+        printf("(-) Error: Failed to open the manifest %s\n", manifest);
+        return STATUS_ERROR;
+    }
+
+    char directory[MAX_FILENAME_LENGTH + 1];
+    snprintf(directory, sizeof(directory), "%s", manifest);
+    char *slash = strrchr(directory, '/');
+    if (slash) *slash = '\0';
+    else directory[0] = '\0';
+
+    SymbolIndex index = {0};
+    size_t capacity = 0;
+    int status = 0;
+    char *line = NULL;
+
+    while (status == 0 && (line = ReadLine(&reader)) != NULL) {
+        if (batch->job_count == capacity) {
+            size_t new_capacity = (capacity == 0) ? 64 : capacity * 2;
+            BatchJob *jobs = realloc(batch->jobs, new_capacity * sizeof(BatchJob));
+            if (!jobs) {
+                status = STATUS_ERROR;
+                break;
+            }
+            batch->jobs = jobs;
+            capacity = new_capacity;
+        }
+
+        BatchJob *job = &batch->jobs[batch->job_count];
+        memset(job, 0, sizeof(BatchJob));
+
+        int parsed = ParseManifestLine(line, directory, budget, job);
+        if (parsed == STATUS_NO_RESULT) continue;
+        if (parsed != 0) {
+            printf("(-) Error: Invalid job in %s at line %zu, expected `path [budget] [rN=value ...]`\n",
+                manifest, reader.line_no);
+            free(job->path);
+            free(job->settings);
+            status = STATUS_ERROR;
+            break;
+        }
+        batch->job_count++;
+
+        // An unreadable image fails its own job, not the batch
+        char *contents = ReadFile(job->path, NULL);
+        if (!contents) continue;
+        job->image = InternImage(batch, &index, contents, job->path);
+        if (!job->image) status = STATUS_ERROR;
+    }
+
+    LineReaderClose(&reader);
+    CleanUpIndex(&index);
+
+    if (status == 0 && batch->job_count == 0) {
+        printf("(-) Error: No jobs in the manifest %s\n", manifest);
+        status = STATUS_ERROR;
+    }
+    if (status != 0) {
+        CleanUpBatch(batch);
+        return status;
+    }
+
+    LogVerbose("Loaded %zu job(s) with %zu distinct image(s) from %s\n", batch->job_count, batch->image_count, manifest);
+    return 0;
+}
+
+// Pops the worker's newest job, or steals the oldest job of another worker
+static bool TakeJob(Worker *worker, size_t *job) {
+    Batch *batch = worker->batch;
+
+    for (size_t i = 0; i < batch->thread_count; i++) {
+        BatchQueue *queue = &batch->queues[(worker->index + i) % batch->thread_count];
+        bool found = false;
+
+        pthread_mutex_lock(&queue->lock);
+        if (queue->head < queue->tail) {
+            *job = (i == 0) ? queue->jobs[--queue->tail] : queue->jobs[queue->head++];
+            found = true;
+        }
+        pthread_mutex_unlock(&queue->lock);
+
+        if (found) {
+            if (i != 0) worker->steals++;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void ApplySettings(const BatchJob *job, Machine *machine) {
+    for (size_t i = 0; i < job->setting_count; i++) machine->regs[job->settings[i].reg] = job->settings[i].value;
+}
+
+// Runs the machine on for what is left of the job's budget
+static VmStatus RunMachine(const Batch *batch, const BatchJob *job, Machine *machine) {
+    if (job->budget && machine->executed >= job->budget) {
+        machine->status = VM_BUDGET;
+        return VM_BUDGET;
+    }
+
+    Jit *jit = batch->use_jit ? JitCreate(machine) : NULL;
+    uint64_t budget = job->budget ? job->budget - machine->executed : 0;
+    VmStatus status = jit ? JitRun(jit, budget) : VmRun(machine, budget);
+    JitDestroy(jit);
+    return status;
+}
+
+// Runs the program from its entry up to its first checkpoint with the image locked,
+// so the other jobs of the image wait for the snapshot. Returns 0 upon success, else STATUS_ERROR
+static int RunStartUp(const Batch *batch, BatchJob *job, BatchImage *image, Machine *machine) {
+    if (VmInit(machine, &image->program) != 0) return STATUS_ERROR;
+    machine->capture = true;
+    machine->stop_at_checkpoint = true;
+
+    VmStatus status = RunMachine(batch, job, machine);
+    if (status == VM_CHECKPOINT) {
+        image->checkpoint = VmTakeSnapshot(machine);
+        if (!image->checkpoint) return STATUS_ERROR;
+        machine->stop_at_checkpoint = false;
+    } else if (status != VM_BUDGET) {
+        image->no_checkpoint = true;
+    }
+    return 0;
+}
+
+// Runs the job on the machine, from the image's checkpoint when it has one. Returns 0 upon success, else STATUS_ERROR
+static int RunOnMachine(const Batch *batch, BatchJob *job, BatchImage *image, Machine *machine) {
+    pthread_mutex_lock(&image->lock);
+    if (image->state == 0) image->state = (LoadProgram(image->path, batch->width, &image->program) == 0) ? 1 : STATUS_ERROR;
+    if (image->state != 1) {
+        pthread_mutex_unlock(&image->lock);
+        snprintf(job->fault, sizeof(job->fault), "Failed to load %s", job->path);
+        return STATUS_NO_RESULT;
+    }
+
+    if (!image->checkpoint && !image->no_checkpoint) {
+        int status = RunStartUp(batch, job, image, machine);
+        pthread_mutex_unlock(&image->lock);
+        if (status != 0) return status;
+
+        if (machine->status == VM_CHECKPOINT) {
+            ApplySettings(job, machine);
+            RunMachine(batch, job, machine);
+        } else if (machine->status != VM_BUDGET && job->setting_count > 0) {
+            // No checkpoint, the program runs again with the settings at its entry
+            VmCleanUp(machine);
+            if (VmInit(machine, &image->program) != 0) return STATUS_ERROR;
+            machine->capture = true;
+            ApplySettings(job, machine);
+            RunMachine(batch, job, machine);
+        }
+        return 0;
+    }
+
+    VmSnapshot *checkpoint = image->checkpoint;
+    bool no_checkpoint = image->no_checkpoint;
+    pthread_mutex_unlock(&image->lock);
+
+    // A budget that runs out before the checkpoint stops the job as it would from the entry
+    if (checkpoint && (job->budget == 0 || job->budget > checkpoint->executed)) {
+        if (VmFork(machine, checkpoint) != 0) return STATUS_ERROR;
+        job->forked = true;
+    } else if (VmInit(machine, &image->program) != 0) {
+        return STATUS_ERROR;
+    }
+    machine->capture = true;
+
+    if (job->forked || no_checkpoint) ApplySettings(job, machine);
+    RunMachine(batch, job, machine);
+    return 0;
+}
+
+static void RunJob(const Batch *batch, BatchJob *job) {
+    if (!job->image) {
+        snprintf(job->fault, sizeof(job->fault), "Failed to read %s", job->path);
+        return;
+    }
+
+    Machine machine;
+    memset(&machine, 0, sizeof(Machine));
+    int status = RunOnMachine(batch, job, job->image, &machine);
+    if (status == STATUS_ERROR) snprintf(job->fault, sizeof(job->fault), "Out of memory for the machine");
+
+    if (status == 0) {
+        job->loaded = true;
+        job->status = machine.status;
+        job->exit_code = machine.exit_code;
+        job->executed = machine.executed;
+        job->output = machine.output;
+        job->output_length = machine.output_length;
+        machine.output = NULL;
+        memcpy(job->fault, machine.fault, sizeof(job->fault));
+    }
+    VmCleanUp(&machine);
+}
+
+static void *WorkerMain(void *arg) {
+    Worker *worker = arg;
+    size_t job = 0;
+    while (TakeJob(worker, &job)) RunJob(worker->batch, &worker->batch->jobs[job]);
+    return NULL;
+}
+
+int RunBatch(Batch *batch, size_t threads) {
+    if (threads == 0) threads = CpuCount();
+    if (threads > BATCH_MAX_THREADS) threads = BATCH_MAX_THREADS;
+    if (threads > batch->job_count) threads = batch->job_count;
+
+    batch->queues = calloc(threads, sizeof(BatchQueue));
+    Worker *workers = calloc(threads, sizeof(Worker));
+    size_t *slots = malloc(batch->job_count * sizeof(size_t));
+    if (!batch->queues || !workers || !slots) {
+        printf("(-) Error: Out of memory for the batch\n");
+        free(batch->queues);
+        batch->queues = NULL;
+        free(workers);
+        free(slots);
+        return STATUS_ERROR;
+    }
+    batch->thread_count = threads;
+
+    // Deal contiguous runs of the manifest, so a worker starts on its own part
+    size_t dealt = 0;
+    for (size_t i = 0; i < threads; i++) {
+        size_t share = batch->job_count / threads + (i < batch->job_count % threads);
+        BatchQueue *queue = &batch->queues[i];
+        queue->jobs = &slots[dealt];
+        queue->head = 0;
+        queue->tail = share;
+        for (size_t j = 0; j < share; j++) queue->jobs[j] = dealt + share - 1 - j;
+        dealt += share;
+        pthread_mutex_init(&queue->lock, NULL);
+    }
+
+    double begin = Now();
+    size_t started = 0;
+    for (; started < threads; started++) {
+        workers[started].batch = batch;
+        workers[started].index = started;
+        if (started > 0 && pthread_create(&workers[started].thread, NULL, WorkerMain, &workers[started]) != 0) {
+            printf("(*) Warning: Started only %zu of %zu thread(s)\n", started, threads);
+            break;
+        }
+    }
+    // The calling thread works as the first worker
+    WorkerMain(&workers[0]);
+
+    for (size_t i = 1; i < started; i++) pthread_join(workers[i].thread, NULL);
+    batch->seconds = Now() - begin;
+
+    for (size_t i = 0; i < started; i++) batch->steals += workers[i].steals;
+    for (size_t i = 0; i < batch->job_count; i++) batch->forks += batch->jobs[i].forked;
+    for (size_t i = 0; i < threads; i++) pthread_mutex_destroy(&batch->queues[i].lock);
+
+    free(slots);
+    free(workers);
+    free(batch->queues);
+    batch->queues = NULL;
+    return 0;
+}
+
+// Writes the output escaped onto one line
+static void WriteEscaped(FILE *file, const char *text, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)text[i];
+        switch (c) {
+            case '\n': fputs("\\n", file); break;
+            case '\t': fputs("\\t", file); break;
+            case '\r': fputs("\\r", file); break;
+            case '\\': fputs("\\\\", file); break;
+            case '|':  fputs("\\x7c", file); break;
+            default:
+                if (c < 0x20 || c >= 0x7F) fprintf(file, "\\x%02x", c);
+                else fputc(c, file);
+        }
+    }
+}
+
+int WriteBatchResults(const Batch *batch, const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        printf("(-) Error: Failed to open %s for writing\n", path);
+        return STATUS_ERROR;
+    }
+
+    fprintf(file, "; %zu job(s), %zu failed\n", batch->job_count, CountBatchFailures(batch));
+    fprintf(file, "; path|status|exit code|instructions|fault|output\n");
+    for (size_t i = 0; i < batch->job_count; i++) {
+        const BatchJob *job = &batch->jobs[i];
+        fprintf(file, "%s|%s|%d|%llu|", job->path, job->loaded ? status_names[job->status] : "ERROR",
+            job->exit_code, (unsigned long long)job->executed);
+        WriteEscaped(file, job->fault, strlen(job->fault));
+        fputc('|', file);
+        WriteEscaped(file, job->output, job->output_length);
+        fputc('\n', file);
+    }
+
+    int status = (fclose(file) == 0) ? 0 : STATUS_ERROR;
+    if (status != 0) printf("(-) Error: Failed to write %s\n", path);
+    return status;
+}
+
+size_t CountBatchFailures(const Batch *batch) {
+    size_t failures = 0;
+    for (size_t i = 0; i < batch->job_count; i++) {
+        const BatchJob *job = &batch->jobs[i];
+        if (!job->loaded || job->status != VM_HALTED || job->exit_code != 0) failures++;
+    }
+    return failures;
+}
+
+void CleanUpBatch(Batch *batch) {
+    if (!batch) return;
+    for (size_t i = 0; i < batch->job_count; i++) {
+        free(batch->jobs[i].path);
+        free(batch->jobs[i].settings);
+        free(batch->jobs[i].output);
+    }
+    for (size_t i = 0; i < batch->image_count; i++) {
+        BatchImage *image = batch->images[i];
+        VmReleaseSnapshot(image->checkpoint);
+        if (image->state == 1) CleanUpProgram(&image->program);
+        pthread_mutex_destroy(&image->lock);
+        free(image->contents);
+        free(image);
+    }
+    free(batch->jobs);
+    free(batch->images);
+    memset(batch, 0, sizeof(Batch));
+}
@@ -0,0 +1,602 @@
+#include "../../include/jit.h"
+
+#ifdef JIT_AVAILABLE
+
+#include <stddef.h>
+#include <sys/mman.h>
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+/// NATIVE CODE CONVENTIONS ///
+// rdi holds the Machine, whose regs[] is the register file and whose page
+// tables map memory, and r8 the fuel counter. eax, ecx, edx and r9 are scratch.
+// Every exit takes the instructions run so far off the fuel and returns the
+// address to continue at in eax. Checks that could fault exit *before* their
+// instruction, so the interpreter runs it again and reports the fault itself.
+// So does a store to a page the machine does not own yet, which the
+// interpreter copies before storing.
+
+#define REG_EAX 0
+#define REG_ECX 1
+
+#define JCC_B   0x72
+#define JCC_AE  0x73
+#define JCC_E   0x74
+#define JCC_NE  0x75
+#define JCC_BE  0x76
+
+// Operand kinds, in the order the specialized handlers are laid out
+typedef enum e_jit_kind {
+    JIT_I,
+    JIT_R,
+    JIT_M
+} JitKind;
+
+typedef struct s_emitter {
+    uint8_t  *at;
+    uint32_t  start;         // Index of the block's first instruction
+    uint8_t  *body;          // Where a block jumping to its own start loops to
+} Emitter;
+
+// Outcome of translating one instruction
+typedef enum e_emitted {
+    EMIT_NEXT,               // Translated, the block goes on
+    EMIT_END,                // Translated, and the block ends with it
+    EMIT_STOP                // Left to the interpreter, the block ends before it
+} Emitted;
+
+static void Emit8(Emitter *e, uint8_t byte) {
+    *e->at++ = byte;
+}
+
+static void Emit32(Emitter *e, uint32_t value) {
+    memcpy(e->at, &value, sizeof(value));
+    e->at += sizeof(value);
+}
+
+static void EmitBytes(Emitter *e, const uint8_t *bytes, size_t count) {
+    memcpy(e->at, bytes, count);
+    e->at += count;
+}
+
+// Offset of the page of address in a page table of the Machine
+static uint32_t PageSlot(size_t table, uint32_t address) {
+    return (uint32_t)(table + (address >> VM_PAGE_BITS) * sizeof(int32_t *));
+}
+
+// mov rdx, [rdi + slot]: the page of a fixed address
+static void EmitPageOf(Emitter *e, size_t table, uint32_t address) {
+    const uint8_t load[] = {0x48, 0x8B, 0x97};
+    EmitBytes(e, load, sizeof(load));
+    Emit32(e, PageSlot(table, address));
+}
+
+// The page of the address in ecx into rdx and its offset in the page into r9d, ecx is kept
+static void EmitPageOfEcx(Emitter *e, size_t table) {
+    const uint8_t page[] = {
+        0x89, 0xCA,                 // mov edx, ecx
+        0xC1, 0xEA, VM_PAGE_BITS,   // shr edx, VM_PAGE_BITS
+        0x48, 0x8B, 0x94, 0xD7,     // mov rdx, [rdi + rdx * 8 + table]
+    };
+    EmitBytes(e, page, sizeof(page));
+    Emit32(e, (uint32_t)table);
+    const uint8_t offset[] = {0x41, 0x89, 0xC9, 0x41, 0x81, 0xE1};  // mov r9d, ecx; and r9d, VM_PAGE_MASK
+    EmitBytes(e, offset, sizeof(offset));
+    Emit32(e, VM_PAGE_MASK);
+}
+
+// op reg, [rdi + disp32] for a register, or [rdx + disp32] in the page of an address
+static void EmitModRm(Emitter *e, uint8_t opcode, int reg, JitKind kind, int32_t value, size_t table) {
+    if (kind == JIT_M) EmitPageOf(e, table, (uint32_t)value);
+    Emit8(e, opcode);
+    if (kind == JIT_R) {
+        Emit8(e, (uint8_t)(0x87 | (reg << 3)));
+        Emit32(e, (uint32_t)(offsetof(Machine, regs) + (size_t)value * sizeof(int32_t)));
+    } else {
+        Emit8(e, (uint8_t)(0x82 | (reg << 3)));
+        Emit32(e, ((uint32_t)value & VM_PAGE_MASK) * sizeof(int32_t));
+    }
+}
+
+// mov reg, operand
+static void EmitLoad(Emitter *e, int reg, JitKind kind, int32_t value) {
+    if (kind == JIT_I) {
+        Emit8(e, (uint8_t)(0xB8 + reg));
+        Emit32(e, (uint32_t)value);
+    } else {
+        EmitModRm(e, 0x8B, reg, kind, value, offsetof(Machine, pages));
+    }
+}
+
+// mov operand, eax. Memory operands need an EmitWritable first
+static void EmitStore(Emitter *e, JitKind kind, int32_t value) {
+    EmitModRm(e, 0x89, REG_EAX, kind, value, offsetof(Machine, owned));
+}
+
+// mov ecx, [rdi + sp] / mov [rdi + sp], ecx
+static void EmitLoadSp(Emitter *e) {
+    Emit8(e, 0x8B);
+    Emit8(e, 0x8F);
+    Emit32(e, (uint32_t)offsetof(Machine, sp));
+}
+
+static void EmitStoreSp(Emitter *e) {
+    Emit8(e, 0x89);
+    Emit8(e, 0x8F);
+    Emit32(e, (uint32_t)offsetof(Machine, sp));
+}
+
+// cmp reg, imm32
+static void EmitCompare(Emitter *e, int reg, uint32_t value) {
+    Emit8(e, 0x81);
+    Emit8(e, (uint8_t)(0xF8 | reg));
+    Emit32(e, value);
+}
+
+// sub qword [r8], count
+static void EmitBurn(Emitter *e, uint32_t count) {
+    if (count == 0) return;
+    const uint8_t sub[] = {0x49, 0x83, 0x28};
+    EmitBytes(e, sub, sizeof(sub));
+    Emit8(e, (uint8_t)count);
+}
+
+// Returns to the dispatcher, to continue at address
+static void EmitExit(Emitter *e, uint32_t count, uint32_t address) {
+    EmitBurn(e, count);
+    Emit8(e, 0xB8);
+    Emit32(e, address);
+    Emit8(e, 0xC3);
+}
+
+// Exits when the condition of the last comparison holds
+static void EmitSideExit(Emitter *e, uint8_t jcc, uint32_t count, uint32_t address) {
+    Emit8(e, jcc ^ 1);
+    uint8_t *skip = e->at++;
+    EmitExit(e, count, address);
+    *skip = (uint8_t)(e->at - skip - 1);
+}
+
+// Goes on at a code index. A block jumping back to its own start loops
+// natively, as long as the fuel covers another pass
+static void EmitJump(Emitter *e, uint32_t count, uint32_t target) {
+    if (target != e->start) {
+        EmitExit(e, count, target + VM_CODE_START);
+        return;
+    }
+
+    EmitBurn(e, count);
+    const uint8_t compare[] = {0x49, 0x83, 0x38};  // cmp qword [r8], count
+    EmitBytes(e, compare, sizeof(compare));
+    Emit8(e, (uint8_t)count);
+    Emit8(e, JCC_B);
+    Emit8(e, 5);
+    Emit8(e, 0xE9);
+    Emit32(e, (uint32_t)(e->body - (e->at + 4)));
+    EmitExit(e, 0, target + VM_CODE_START);
+}
+
+// Exits unless the machine owns the page of a fixed destination, so the store needs no check
+static void EmitWritable(Emitter *e, JitKind kind, int32_t value, uint32_t count, uint32_t address) {
+    if (kind != JIT_M) return;
+    const uint8_t compare[] = {0x48, 0x83, 0xBF};  // cmp qword [rdi + slot], 0
+    EmitBytes(e, compare, sizeof(compare));
+    Emit32(e, PageSlot(offsetof(Machine, owned), (uint32_t)value));
+    Emit8(e, 0);
+    EmitSideExit(e, JCC_E, count, address);
+}
+
+// Exits unless the machine owns the page EmitPageOfEcx looked up
+static void EmitOwned(Emitter *e, uint32_t count, uint32_t address) {
+    const uint8_t test[] = {0x48, 0x85, 0xD2};  // test rdx, rdx
+    EmitBytes(e, test, sizeof(test));
+    EmitSideExit(e, JCC_E, count, address);
+}
+
+// Conditional jump taken when the condition of the last comparison holds
+static void EmitBranch(Emitter *e, uint8_t jcc, uint32_t count, uint32_t target) {
+    Emit8(e, jcc ^ 1);
+    uint8_t *skip = e->at++;
+    EmitJump(e, count, target);
+    *skip = (uint8_t)(e->at - skip - 1);
+}
+
+// Whether a store to a fixed address would modify the code
+static bool WritesCode(const Jit *jit, JitKind kind, int32_t address) {
+    return kind == JIT_M && (uint32_t)address - VM_CODE_START < jit->code_size;
+}
+
+// d OP= s, with d in eax and s in ecx
+static const struct {
+    Handler base;
+    uint8_t bytes[3];
+    size_t  length;
+} arithmetic[] = {
+    {H_ADD_IR, {0x01, 0xC8}, 2},        // add eax, ecx
+    {H_SUB_IR, {0x29, 0xC8}, 2},        // sub eax, ecx
+    {H_AND_IR, {0x21, 0xC8}, 2},        // and eax, ecx
+    {H_OR_IR,  {0x09, 0xC8}, 2},        // or eax, ecx
+    {H_XOR_IR, {0x31, 0xC8}, 2},        // xor eax, ecx
+    {H_MUL_IR, {0x0F, 0xAF, 0xC1}, 3},  // imul eax, ecx
+};
+
+static Emitted EmitBinary(Emitter *e, const Jit *jit, const Insn *insn, Handler base, uint32_t count, uint32_t address) {
+    int offset = insn->handler - base;
+    JitKind src = (JitKind)(offset % 3);
+    JitKind dst = (JitKind)(offset / 3 + 1);
+
+    if (base != H_STR_IR && WritesCode(jit, dst, insn->dst)) return EMIT_STOP;
+    if (base != H_STR_IR) EmitWritable(e, dst, insn->dst, count, address);
+
+    if (base == H_MOV_IR) {
+        EmitLoad(e, REG_EAX, src, insn->src);
+    } else if (base == H_LOD_IR) {
+        EmitLoad(e, REG_ECX, src, insn->src);
+        EmitCompare(e, REG_ECX, VM_MEMORY_WORDS);
+        EmitSideExit(e, JCC_AE, count, address);
+        EmitPageOfEcx(e, offsetof(Machine, pages));
+        const uint8_t load[] = {0x42, 0x8B, 0x04, 0x8A};  // mov eax, [rdx + r9 * 4]
+        EmitBytes(e, load, sizeof(load));
+    } else if (base == H_STR_IR) {
+        // The destination holds the address, stores to the code are left to the interpreter.
+        // Both operands are loaded first, as memory operands go through rdx
+        EmitLoad(e, REG_EAX, src, insn->src);
+        EmitLoad(e, REG_ECX, dst, insn->dst);
+        EmitCompare(e, REG_ECX, VM_MEMORY_WORDS);
+        EmitSideExit(e, JCC_AE, count, address);
+        const uint8_t offset_ecx[] = {0x8D, 0x51, (uint8_t)-VM_CODE_START};  // lea edx, [rcx - 100]
+        EmitBytes(e, offset_ecx, sizeof(offset_ecx));
+        Emit8(e, 0x81);
+        Emit8(e, 0xFA);
+        Emit32(e, jit->code_size);  // cmp edx, code_size
+        EmitSideExit(e, JCC_B, count, address);
+        EmitPageOfEcx(e, offsetof(Machine, owned));
+        EmitOwned(e, count, address);
+        const uint8_t store[] = {0x42, 0x89, 0x04, 0x8A};  // mov [rdx + r9 * 4], eax
+        EmitBytes(e, store, sizeof(store));
+        return EMIT_NEXT;
+    } else if (base == H_DIV_IR || base == H_MOD_IR) {
+        EmitLoad(e, REG_EAX, dst, insn->dst);
+        EmitLoad(e, REG_ECX, src, insn->src);
+        const uint8_t test[] = {0x85, 0xC9};  // test ecx, ecx
+        EmitBytes(e, test, sizeof(test));
+        EmitSideExit(e, JCC_E, count, address);
+        const uint8_t minus_one[] = {0x83, 0xF9, 0xFF};  // cmp ecx, -1
+        EmitBytes(e, minus_one, sizeof(minus_one));
+        EmitSideExit(e, JCC_E, count, address);
+        const uint8_t divide[] = {0x99, 0xF7, 0xF9};  // cdq, idiv ecx
+        EmitBytes(e, divide, sizeof(divide));
+        if (base == H_MOD_IR) {
+            const uint8_t remainder[] = {0x89, 0xD0};  // mov eax, edx
+            EmitBytes(e, remainder, sizeof(remainder));
+        }
+    } else {
+        size_t op = 0;
+        while (arithmetic[op].base != base) op++;
+        EmitLoad(e, REG_EAX, dst, insn->dst);
+        EmitLoad(e, REG_ECX, src, insn->src);
+        EmitBytes(e, arithmetic[op].bytes, arithmetic[op].length);
+    }
+
+    EmitStore(e, dst, insn->dst);
+    return EMIT_NEXT;
+}
+
+static Emitted EmitUnary(Emitter *e, const Jit *jit, const Insn *insn, Handler base, uint32_t count, uint32_t address) {
+    JitKind dst = (JitKind)(insn->handler - base + 1);
+    if (WritesCode(jit, dst, insn->dst)) return EMIT_STOP;
+    EmitWritable(e, dst, insn->dst, count, address);
+
+    const uint8_t clear[] = {0x31, 0xC0};   // xor eax, eax
+    const uint8_t invert[] = {0xF7, 0xD0};  // not eax
+    const uint8_t up[] = {0xFF, 0xC0};      // inc eax
+    const uint8_t down[] = {0xFF, 0xC8};    // dec eax
+
+    if (base == H_CLR_R) {
+        EmitBytes(e, clear, sizeof(clear));
+    } else {
+        EmitLoad(e, REG_EAX, dst, insn->dst);
+        EmitBytes(e, (base == H_NOT_R) ? invert : (base == H_INC_R) ? up : down, 2);
+    }
+    EmitStore(e, dst, insn->dst);
+    return EMIT_NEXT;
+}
+
+// Pushes eax, or value when it is a constant
+static void EmitPush(Emitter *e, const Jit *jit, bool constant, int32_t value, uint32_t count, uint32_t address) {
+    const Program *program = jit->machine->program;
+
+    EmitLoadSp(e);
+    EmitCompare(e, REG_ECX, VM_CODE_START + program->code_size + program->data_size);
+    EmitSideExit(e, JCC_BE, count, address);
+    Emit8(e, 0xFF);
+    Emit8(e, 0xC9);  // dec ecx
+    EmitPageOfEcx(e, offsetof(Machine, owned));
+    EmitOwned(e, count, address);
+    if (constant) {
+        const uint8_t store[] = {0x42, 0xC7, 0x04, 0x8A};  // mov dword [rdx + r9 * 4], imm32
+        EmitBytes(e, store, sizeof(store));
+        Emit32(e, (uint32_t)value);
+    } else {
+        const uint8_t store[] = {0x42, 0x89, 0x04, 0x8A};  // mov [rdx + r9 * 4], eax
+        EmitBytes(e, store, sizeof(store));
+    }
+    EmitStoreSp(e);
+}
+
+// Pops into eax
+static void EmitPop(Emitter *e, uint32_t count, uint32_t address) {
+    EmitLoadSp(e);
+    EmitCompare(e, REG_ECX, VM_MEMORY_WORDS);
+    EmitSideExit(e, JCC_AE, count, address);
+    EmitPageOfEcx(e, offsetof(Machine, pages));
+    const uint8_t load[] = {0x42, 0x8B, 0x04, 0x8A};  // mov eax, [rdx + r9 * 4]
+    EmitBytes(e, load, sizeof(load));
+}
+
+static void EmitPopDone(Emitter *e) {
+    Emit8(e, 0xFF);
+    Emit8(e, 0xC1);  // inc ecx
+    EmitStoreSp(e);
+}
+
+// cmp byte [rdi + zero], 0
+static void EmitTestZero(Emitter *e) {
+    Emit8(e, 0x80);
+    Emit8(e, 0xBF);
+    Emit32(e, (uint32_t)offsetof(Machine, zero));
+    Emit8(e, 0);
+}
+
+// Translates the instruction at index, count instructions into the block
+static Emitted EmitInsn(Emitter *e, const Jit *jit, const Insn *insn, uint32_t index, uint32_t count) {
+    static const Handler binaries[] = {
+        H_MOV_IR, H_ADD_IR, H_SUB_IR, H_AND_IR, H_OR_IR, H_XOR_IR, H_MUL_IR, H_DIV_IR, H_MOD_IR, H_LOD_IR, H_STR_IR,
+    };
+    static const Handler unaries[] = {H_CLR_R, H_NOT_R, H_INC_R, H_DEC_R};
+
+    uint32_t address = index + VM_CODE_START;
+    uint32_t next = address + insn->size;
+    Handler handler = (Handler)insn->handler;
+
+    for (size_t i = 0; i < sizeof(binaries) / sizeof(binaries[0]); i++) {
+        if (handler >= binaries[i] && handler < binaries[i] + 6) {
+            return EmitBinary(e, jit, insn, binaries[i], count, address);
+        }
+    }
+    for (size_t i = 0; i < sizeof(unaries) / sizeof(unaries[0]); i++) {
+        if (handler >= unaries[i] && handler < unaries[i] + 2) {
+            return EmitUnary(e, jit, insn, unaries[i], count, address);
+        }
+    }
+
+    if (handler >= H_CMP_II && handler <= H_CMP_MM) {
+        int offset = handler - H_CMP_II;
+        EmitLoad(e, REG_EAX, (JitKind)(offset % 3), insn->src);
+        EmitLoad(e, REG_ECX, (JitKind)(offset / 3), insn->dst);
+        const uint8_t compare[] = {0x39, 0xC8, 0x0F, 0x94, 0x87};  // cmp eax, ecx; sete [rdi + zero]
+        EmitBytes(e, compare, sizeof(compare));
+        Emit32(e, (uint32_t)offsetof(Machine, zero));
+        return EMIT_NEXT;
+    }
+
+    switch (handler) {
+        case H_NOP:
+            return EMIT_NEXT;
+        case H_JMP:
+            EmitJump(e, count + 1, (uint32_t)insn->dst);
+            return EMIT_END;
+        case H_BNE:
+        case H_BEQ:
+            EmitTestZero(e);
+            EmitBranch(e, (handler == H_BNE) ? JCC_E : JCC_NE, count + 1, (uint32_t)insn->dst);
+            EmitExit(e, count + 1, next);
+            return EMIT_END;
+        case H_JSR:
+            EmitPush(e, jit, true, (int32_t)next, count, address);
+            EmitJump(e, count + 1, (uint32_t)insn->dst);
+            return EMIT_END;
+        case H_RTS: {
+            EmitPop(e, count, address);
+            const uint8_t offset_eax[] = {0x8D, 0x50, (uint8_t)-VM_CODE_START};  // lea edx, [rax - 100]
+            EmitBytes(e, offset_eax, sizeof(offset_eax));
+            Emit8(e, 0x81);
+            Emit8(e, 0xFA);
+            Emit32(e, jit->code_size);  // cmp edx, code_size
+            EmitSideExit(e, JCC_AE, count, address);
+            EmitPopDone(e);
+            EmitBurn(e, count + 1);
+            Emit8(e, 0xC3);
+            return EMIT_END;
+        }
+        case H_PUSH_I:
+            EmitPush(e, jit, true, insn->dst, count, address);
+            return EMIT_NEXT;
+        case H_PUSH_R:
+        case H_PUSH_M:
+            EmitLoad(e, REG_EAX, (handler == H_PUSH_R) ? JIT_R : JIT_M, insn->dst);
+            EmitPush(e, jit, false, 0, count, address);
+            return EMIT_NEXT;
+        case H_POP_R:
+        case H_POP_M: {
+            JitKind dst = (handler == H_POP_R) ? JIT_R : JIT_M;
+            if (WritesCode(jit, dst, insn->dst)) return EMIT_STOP;
+            EmitWritable(e, dst, insn->dst, count, address);
+            EmitPop(e, count, address);
+            EmitPopDone(e);
+            EmitStore(e, dst, insn->dst);
+            return EMIT_NEXT;
+        }
+        default:
+            // `stop`, `int` and illegal instructions always run in the interpreter
+            return EMIT_STOP;
+    }
+}
+
+// Drops every translation, once the buffer is full
+static void FlushJit(Jit *jit) {
+    memset(jit->blocks, 0, jit->code_size * sizeof(JitBlock));
+    jit->used = 0;
+    jit->flushes++;
+    LogDebug("JIT buffer full, dropped every translation\n");
+}
+
+// Translates the block starting at index. Returns 0 upon success, else STATUS_ERROR
+static int Translate(Jit *jit, uint32_t index) {
+    if (JIT_BUFFER_SIZE - jit->used < JIT_BLOCK_RESERVE) FlushJit(jit);
+    if (mprotect(jit->buffer, JIT_BUFFER_SIZE, PROT_READ | PROT_WRITE) != 0) return STATUS_ERROR;
+
+    const Insn *code = jit->machine->code;
+    JitBlock *block = &jit->blocks[index];
+    Emitter e = {jit->buffer + jit->used, index, NULL};
+
+    const uint8_t prologue[] = {0x49, 0x89, 0xF0};  // mov r8, rsi
+    EmitBytes(&e, prologue, sizeof(prologue));
+    e.body = e.at;
+
+    uint32_t at = index, count = 0;
+    Emitted emitted = EMIT_NEXT;
+    while (emitted == EMIT_NEXT && count < JIT_MAX_BLOCK && at < jit->code_size) {
+        emitted = EmitInsn(&e, jit, &code[at], at, count);
+        if (emitted == EMIT_STOP) break;
+        count++;
+        at += code[at].size;
+    }
+    if (emitted != EMIT_END) EmitExit(&e, count, at + VM_CODE_START);
+
+    block->end = (count > 0) ? at + VM_CODE_START : index + code[index].size + VM_CODE_START;
+    block->length = count;
+    if (count == 0) {
+        block->cold = true;
+    } else {
+        union {
+            uint8_t    *bytes;
+            NativeBlock native;
+        } entry = {jit->buffer + jit->used};
+        block->native = entry.native;
+        jit->used = (size_t)(e.at - jit->buffer);
+        jit->translated++;
+        LogDebug("Translated %u instruction(s) at %u into %zu bytes\n", count, index + VM_CODE_START,
+            (size_t)(e.at - entry.bytes));
+    }
+
+    return (mprotect(jit->buffer, JIT_BUFFER_SIZE, PROT_READ | PROT_EXEC) == 0) ? 0 : STATUS_ERROR;
+}
+
+// Drops the translations covering code the program wrote to
+static void Invalidate(Jit *jit) {
+    Machine *machine = jit->machine;
+
+    for (uint32_t i = 0; i < jit->code_size; i++) {
+        JitBlock *block = &jit->blocks[i];
+        if (!block->native && !block->cold) continue;
+        if (i + VM_CODE_START > machine->dirty_high || block->end <= machine->dirty_low) continue;
+
+        if (block->native) jit->invalidated++;
+        memset(block, 0, sizeof(JitBlock));
+    }
+    LogDebug("Code written between %u and %u, translations dropped\n", machine->dirty_low, machine->dirty_high);
+
+    machine->dirty_low = UINT32_MAX;
+    machine->dirty_high = 0;
+}
+
+// Instructions from index up to and including the next control transfer
+static uint64_t InterpretedLength(const Insn *code, uint32_t index, uint32_t code_size) {
+    uint64_t length = 0;
+    while (index < code_size && length < JIT_MAX_BLOCK) {
+        length++;
+        Handler handler = (Handler)code[index].handler;
+        if (handler == H_ILLEGAL || (handler >= H_JMP && handler <= H_INT && handler != H_NOP)) break;
+        index += code[index].size;
+    }
+    return (length > 0) ? length : 1;
+}
+
+Jit *JitCreate(Machine *machine) {
+    if (!machine || !machine->program) return NULL;
+
+    Jit *jit = calloc(1, sizeof(Jit));
+    if (!jit) return NULL;
+    jit->machine = machine;
+    jit->code_size = machine->program->code_size;
+    jit->blocks = calloc((size_t)jit->code_size + 1, sizeof(JitBlock));
+
+    void *buffer = mmap(NULL, JIT_BUFFER_SIZE, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    jit->buffer = (buffer == MAP_FAILED) ? NULL : buffer;
+    if (!jit->blocks || !jit->buffer) {
+        printf("(*) Warning: Failed to set up the JIT, interpreting\n");
+        JitDestroy(jit);
+        return NULL;
+    }
+    return jit;
+}
+
+VmStatus JitRun(Jit *jit, uint64_t budget) {
+    Machine *machine = jit->machine;
+    if (machine->status == VM_BUDGET || machine->status == VM_CHECKPOINT) machine->status = VM_RUNNING;
+    if (machine->status != VM_RUNNING) return machine->status;
+
+    uint64_t fuel = budget ? budget : UINT64_MAX;
+    bool stalled = false;  // A side exit before the block's first instruction, which the interpreter runs
+    while (machine->status == VM_RUNNING) {
+        if (fuel == 0) {
+            machine->status = VM_BUDGET;
+            break;
+        }
+
+        uint32_t index = machine->pc - VM_CODE_START;
+        JitBlock *block = (index < jit->code_size) ? &jit->blocks[index] : NULL;
+        if (block && !block->native && !block->cold && ++block->heat >= JIT_HOT_THRESHOLD) {
+            if (Translate(jit, index) != 0) return VmFault(machine, "Failed to translate the code at %u", machine->pc);
+        }
+
+        if (block && block->native && fuel >= block->length && !stalled) {
+            uint64_t before = fuel;
+            machine->pc = block->native(machine, &fuel);
+            machine->executed += before - fuel;
+            stalled = (before == fuel);
+            continue;
+        }
+        stalled = false;
+
+        // Cold code, or a block the fuel does not cover, runs in the interpreter up to its next jump
+        uint64_t steps = InterpretedLength(machine->code, index, jit->code_size);
+        uint64_t executed = machine->executed;
+        VmRun(machine, (steps < fuel) ? steps : fuel);
+        fuel -= machine->executed - executed;
+        if (machine->status == VM_BUDGET) machine->status = VM_RUNNING;
+        if (machine->dirty_low <= machine->dirty_high) Invalidate(jit);
+    }
+
+    LogVerbose("JIT: %zu block(s) translated into %zu bytes, %zu invalidated, %zu flush(es)\n", jit->translated,
+        jit->used, jit->invalidated, jit->flushes);
+    return machine->status;
+}
+
+void JitDestroy(Jit *jit) {
+    if (!jit) return;
+    if (jit->buffer) munmap(jit->buffer, JIT_BUFFER_SIZE);
+    free(jit->blocks);
+    free(jit);
+}
+
+#else
+
+Jit *JitCreate(Machine *machine) {
+    (void)machine;
+    printf("(*) Warning: The JIT needs an x86-64 host, interpreting\n");
+    return NULL;
+}
+
+VmStatus JitRun(Jit *jit, uint64_t budget) {
+    return VmRun(jit->machine, budget);
+}
+
+void JitDestroy(Jit *jit) {
+    free(jit);
+}
+
+#endif
@@ -0,0 +1,456 @@
+#include <stdarg.h>
+
+#include "../../include/vm.h"
+#include "../../include/profile.h"
+
+// Threaded dispatch with computed gotos where the compiler has them, a switch elsewhere
+#if defined(__GNUC__)
+#define VM_THREADED
+#endif
+
+// Read by every page nothing has written yet, never written itself
+static int32_t zero_page[VM_PAGE_WORDS];
+
+int VmInit(Machine *machine, const Program *program) {
+    if (!machine || !program) return STATUS_ERROR;
+    memset(machine, 0, sizeof(Machine));
+
+    for (uint32_t i = 0; i < VM_PAGES; i++) {
+        machine->pages[i] = (i < program->page_count) ? &program->pages[(size_t)i * VM_PAGE_WORDS] : zero_page;
+    }
+
+    machine->program = program;
+    machine->code = program->code;
+    machine->pc = program->entry;
+    machine->sp = VM_MEMORY_WORDS;
+    machine->status = VM_RUNNING;
+    machine->dirty_low = UINT32_MAX;
+    return 0;
+}
+
+int32_t *VmOwnPage(Machine *machine, uint32_t page) {
+    if (machine->owned[page]) return machine->owned[page];
+
+    int32_t *copy = malloc(VM_PAGE_WORDS * sizeof(int32_t));
+    if (!copy) return NULL;
+    memcpy(copy, machine->pages[page], VM_PAGE_WORDS * sizeof(int32_t));
+    machine->pages[page] = copy;
+    machine->owned[page] = copy;
+    machine->owned_count++;
+    return copy;
+}
+
+int32_t VmLoad(const Machine *machine, uint32_t address) {
+    return machine->pages[address >> VM_PAGE_BITS][address & VM_PAGE_MASK];
+}
+
+int VmStore(Machine *machine, uint32_t address, int32_t value) {
+    int32_t *page = VmOwnPage(machine, address >> VM_PAGE_BITS);
+    if (!page) return STATUS_ERROR;
+    page[address & VM_PAGE_MASK] = value;
+    if (address - VM_CODE_START < machine->program->code_size) return VmCodeWritten(machine, address);
+    return 0;
+}
+
+// Returns a copy of the decoded code, with its trailing sentinels
+static Insn *CopyCode(const Program *program, const Insn *code) {
+    Insn *copy = malloc(((size_t)program->code_size + 3) * sizeof(Insn));
+    if (copy) memcpy(copy, code, ((size_t)program->code_size + 3) * sizeof(Insn));
+    return copy;
+}
+
+// Returns a copy of length bytes of captured output, NULL when there are none
+static char *CopyOutput(const char *output, size_t length) {
+    if (length == 0) return NULL;
+    char *copy = malloc(length + 1);
+    if (copy) memcpy(copy, output, length + 1);
+    return copy;
+}
+
+VmSnapshot *VmTakeSnapshot(Machine *machine) {
+    const Program *program = machine->program;
+    VmSnapshot *snapshot = calloc(1, sizeof(VmSnapshot));
+    if (!snapshot) return NULL;
+
+    snapshot->code = (machine->code != program->code) ? CopyCode(program, machine->code) : NULL;
+    snapshot->output = CopyOutput(machine->output, machine->output_length);
+    if ((machine->code != program->code && !snapshot->code) || (machine->output_length && !snapshot->output)) {
+        free(snapshot->code);
+        free(snapshot);
+        return NULL;
+    }
+    snapshot->output_length = machine->output_length;
+
+    snapshot->program = program;
+    memcpy(snapshot->regs, machine->regs, sizeof(snapshot->regs));
+    snapshot->pc = machine->pc;
+    snapshot->sp = machine->sp;
+    snapshot->zero = machine->zero;
+    snapshot->status = machine->status;
+    snapshot->exit_code = machine->exit_code;
+    snapshot->executed = machine->executed;
+
+    // The machine's pages move into the snapshot, and both share them from now on
+    memcpy(snapshot->pages, machine->pages, sizeof(snapshot->pages));
+    for (uint32_t i = 0; i < VM_PAGES; i++) {
+        if (!machine->owned[i]) continue;
+        snapshot->owned[i / 64] |= 1ull << (i % 64);
+        machine->owned[i] = NULL;
+    }
+    machine->owned_count = 0;
+
+    // The machine's reference to its origin passes to the snapshot, one for the caller and one for the machine
+    snapshot->parent = machine->origin;
+    atomic_init(&snapshot->refs, 2);
+    machine->origin = snapshot;
+
+    LogDebug("Snapshot at %u after %llu instruction(s)\n", snapshot->pc, (unsigned long long)snapshot->executed);
+    return snapshot;
+}
+
+int VmFork(Machine *machine, VmSnapshot *snapshot) {
+    if (!machine || !snapshot) return STATUS_ERROR;
+    memset(machine, 0, sizeof(Machine));
+
+    const Program *program = snapshot->program;
+    machine->code = snapshot->code ? CopyCode(program, snapshot->code) : program->code;
+    machine->output = CopyOutput(snapshot->output, snapshot->output_length);
+    if (!machine->code || (snapshot->output_length && !machine->output)) {
+        if (machine->code != program->code) free(machine->code);
+        free(machine->output);
+        return STATUS_ERROR;
+    }
+    machine->output_length = snapshot->output_length;
+    machine->output_capacity = snapshot->output_length ? snapshot->output_length + 1 : 0;
+
+    machine->program = program;
+    memcpy(machine->regs, snapshot->regs, sizeof(machine->regs));
+    memcpy(machine->pages, snapshot->pages, sizeof(machine->pages));
+    machine->pc = snapshot->pc;
+    machine->sp = snapshot->sp;
+    machine->zero = snapshot->zero;
+    machine->status = snapshot->status;
+    machine->exit_code = snapshot->exit_code;
+    machine->executed = snapshot->executed;
+    machine->dirty_low = UINT32_MAX;
+
+    atomic_fetch_add(&snapshot->refs, 1);
+    machine->origin = snapshot;
+    return 0;
+}
+
+void VmReleaseSnapshot(VmSnapshot *snapshot) {
+    while (snapshot && atomic_fetch_sub(&snapshot->refs, 1) == 1) {
+        for (uint32_t i = 0; i < VM_PAGES; i++) {
+            if (snapshot->owned[i / 64] & (1ull << (i % 64))) free(snapshot->pages[i]);
+        }
+        VmSnapshot *parent = snapshot->parent;
+        free(snapshot->code);
+        free(snapshot->output);
+        free(snapshot);
+        snapshot = parent;
+    }
+}
+
+VmStatus VmFault(Machine *machine, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(machine->fault, sizeof(machine->fault), fmt, args);
+    va_end(args);
+
+    machine->status = VM_FAULT;
+    return VM_FAULT;
+}
+
+// Decoding happens in a private copy, so other machines running the same Program are unaffected
+int VmCodeWritten(Machine *machine, uint32_t address) {
+    const Program *program = machine->program;
+
+    if (machine->code == program->code) {
+        Insn *copy = CopyCode(program, program->code);
+        if (!copy) return STATUS_ERROR;
+        machine->code = copy;
+        LogDebug("Program wrote to its code at %u, decoding a private copy\n", address);
+    }
+
+    if (address < machine->dirty_low) machine->dirty_low = address;
+    if (address > machine->dirty_high) machine->dirty_high = address;
+
+    // An instruction takes at most three words
+    uint32_t first = (address >= VM_CODE_START + 2) ? address - 2 : VM_CODE_START;
+    for (uint32_t at = first; at <= address; at++) {
+        uint32_t index = at - VM_CODE_START;
+        int32_t words[3];
+        size_t available = program->code_size - index;
+        if (available > 3) available = 3;
+        for (size_t i = 0; i < available; i++) words[i] = VmLoad(machine, at + (uint32_t)i);
+        DecodeInsn(program, words, available, at, &machine->code[index]);
+        if (machine->profile) machine->profile->site_parent[index] = UINT32_MAX;  // It may call elsewhere now
+    }
+    return 0;
+}
+
+// Labels as values are a GNU extension, only the dispatch loop is let off -Wpedantic
+#ifdef VM_THREADED
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+VmStatus VmRun(Machine *machine, uint64_t budget) {
+    if (!machine || !machine->program) return VM_FAULT;
+    if (machine->status == VM_BUDGET || machine->status == VM_CHECKPOINT) machine->status = VM_RUNNING;
+    if (machine->status != VM_RUNNING) return machine->status;
+
+    const Program *program = machine->program;
+    const uint32_t code_size = program->code_size;
+    const uint32_t stack_limit = VM_CODE_START + code_size + program->data_size;
+    int32_t *const regs = machine->regs;
+    int32_t *const *const pages = machine->pages;
+    int32_t *const *const owned = machine->owned;
+    Insn *code = machine->code;
+    Profile *const profile = machine->profile;
+    uint32_t sp = machine->sp;
+    bool zero = machine->zero;
+    uint64_t remaining = budget ? budget : UINT64_MAX;
+    uint64_t start = remaining;
+
+    // The first address past the code holds an illegal sentinel, falling through to it faults there
+    if (machine->pc < VM_CODE_START || machine->pc - VM_CODE_START > code_size) {
+        return VmFault(machine, "Entry %u is outside of the code", machine->pc);
+    }
+    const Insn *ip = code + (machine->pc - VM_CODE_START);
+
+// Writes the cached registers back to the machine
+#define PC()     ((uint32_t)(ip - code) + VM_CODE_START)
+#define SYNC()   do { machine->pc = PC(); machine->sp = sp; machine->zero = zero; \
+                      machine->executed += start - remaining; start = remaining; } while (0)
+#define FAULT(...) do { SYNC(); return VmFault(machine, __VA_ARGS__); } while (0)
+
+#ifdef VM_THREADED
+#define VM_LABEL(name) &&L_##name,
+    static void *const labels[H_COUNT] = { VM_HANDLERS(VM_LABEL) };
+#undef VM_LABEL
+#define HANDLER(name) L_##name:
+#define DISPATCH() do { if (remaining == 0) goto out_of_budget; remaining--; goto *labels[ip->handler]; } while (0)
+#else
+#define HANDLER(name) case H_##name:
+#define DISPATCH() do { if (remaining == 0) goto out_of_budget; remaining--; goto dispatch; } while (0)
+#endif
+
+#define NEXT()        do { ip += ip->size; DISPATCH(); } while (0)
+#define JUMP(index)   do { ip = code + (index); DISPATCH(); } while (0)
+
+// Profiling only looks at control transfers, straight-line code runs untouched
+#define EXECUTED()    (machine->executed + (start - remaining))
+#define TAKEN()       do { if (profile) profile->taken[ip - code]++; } while (0)
+
+// Memory goes through the page tables, a store to a page the machine does not own copies it first
+#define LOAD(address) (pages[(address) >> VM_PAGE_BITS][(address) & VM_PAGE_MASK])
+#define WRITABLE(page_, address) do { \
+        page_ = owned[(address) >> VM_PAGE_BITS]; \
+        if (!page_ && !(page_ = VmOwnPage(machine, (address) >> VM_PAGE_BITS))) \
+            FAULT("Out of memory for the page of %u at %u", (address), PC()); \
+    } while (0)
+
+// Stores to memory, re-decoding the code when the program modifies it
+#define STORE(address, value) do { \
+        uint32_t at_ = (uint32_t)(address); \
+        int32_t value_ = (value); \
+        int32_t *page_; \
+        WRITABLE(page_, at_); \
+        page_[at_ & VM_PAGE_MASK] = value_; \
+        if (at_ - VM_CODE_START < code_size) { \
+            size_t index_ = (size_t)(ip - code); \
+            if (VmCodeWritten(machine, at_) != 0) FAULT("Out of memory decoding modified code at %u", at_); \
+            code = machine->code; \
+            ip = code + index_; \
+        } \
+    } while (0)
+
+#define PUSH(value) do { \
+        int32_t value_ = (value); \
+        int32_t *page_; \
+        if (sp <= stack_limit) FAULT("Stack overflow at %u", PC()); \
+        WRITABLE(page_, sp - 1); \
+        page_[--sp & VM_PAGE_MASK] = value_; \
+    } while (0)
+
+#define POP(dst) do { \
+        if (sp >= VM_MEMORY_WORDS) FAULT("Stack underflow at %u", PC()); \
+        (dst) = LOAD(sp); \
+        sp++; \
+    } while (0)
+
+// Operands by kind
+#define SRC_I (ip->src)
+#define SRC_R (regs[ip->src])
+#define SRC_M (LOAD((uint32_t)ip->src))
+#define DST_I (ip->dst)
+#define DST_R (regs[ip->dst])
+#define DST_M (LOAD((uint32_t)ip->dst))
+
+// Wrapping 32-bit arithmetic, without signed overflow
+#define U(x)        ((uint32_t)(x))
+#define WRAP(x)     ((int32_t)(x))
+
+// `d OP= s` for one source kind into a register or memory destination
+#define OP_R(NAME, SK, CHECK, EXPR) HANDLER(NAME) { \
+        int32_t s = SRC_##SK; int32_t d = DST_R; (void)d; \
+        CHECK; DST_R = (EXPR); NEXT(); }
+#define OP_M(NAME, SK, CHECK, EXPR) HANDLER(NAME) { \
+        int32_t s = SRC_##SK; int32_t d = DST_M; (void)d; \
+        CHECK; STORE(ip->dst, (EXPR)); NEXT(); }
+#define BINARY(OP, CHECK, EXPR) \
+    OP_R(OP##_IR, I, CHECK, EXPR) OP_R(OP##_RR, R, CHECK, EXPR) OP_R(OP##_MR, M, CHECK, EXPR) \
+    OP_M(OP##_IM, I, CHECK, EXPR) OP_M(OP##_RM, R, CHECK, EXPR) OP_M(OP##_MM, M, CHECK, EXPR)
+
+// `str`: the destination holds the address the source is stored to
+#define STR_H(NAME, SK, DK) HANDLER(NAME) { \
+        int32_t s = SRC_##SK; int32_t a = DST_##DK; \
+        if (U(a) >= VM_MEMORY_WORDS) FAULT("str to invalid address %d at %u", a, PC()); \
+        STORE(a, s); NEXT(); }
+
+#define CMP_H(NAME, SK, DK) HANDLER(NAME) { zero = (SRC_##SK == DST_##DK); NEXT(); }
+
+#define UNARY(OP, EXPR) \
+    HANDLER(OP##_R) { int32_t d = DST_R; (void)d; DST_R = (EXPR); NEXT(); } \
+    HANDLER(OP##_M) { int32_t d = DST_M; (void)d; STORE(ip->dst, (EXPR)); NEXT(); }
+
+#define NO_CHECK    (void)0
+#define DIV_CHECK   if (s == 0) FAULT("Division by zero at %u", PC())
+#define LOD_CHECK   if (U(s) >= VM_MEMORY_WORDS) FAULT("lod from invalid address %d at %u", s, PC())
+
+    DISPATCH();
+
+#ifndef VM_THREADED
+dispatch:
+    switch (ip->handler) {
+#endif
+
+    HANDLER(ILLEGAL) {
+        FAULT("Illegal instruction 0x%08X at %u", U(LOAD(PC())), PC());
+    }
+
+    BINARY(MOV, NO_CHECK, s)
+    BINARY(ADD, NO_CHECK, WRAP(U(d) + U(s)))
+    BINARY(SUB, NO_CHECK, WRAP(U(d) - U(s)))
+    BINARY(AND, NO_CHECK, d & s)
+    BINARY(OR,  NO_CHECK, d | s)
+    BINARY(XOR, NO_CHECK, d ^ s)
+    BINARY(MUL, NO_CHECK, WRAP(U(d) * U(s)))
+    BINARY(DIV, DIV_CHECK, (s == -1) ? WRAP(0u - U(d)) : d / s)
+    BINARY(MOD, DIV_CHECK, (s == -1) ? 0 : d % s)
+    BINARY(LOD, LOD_CHECK, LOAD(U(s)))
+
+    STR_H(STR_IR, I, R) STR_H(STR_RR, R, R) STR_H(STR_MR, M, R)
+    STR_H(STR_IM, I, M) STR_H(STR_RM, R, M) STR_H(STR_MM, M, M)
+
+    CMP_H(CMP_II, I, I) CMP_H(CMP_RI, R, I) CMP_H(CMP_MI, M, I)
+    CMP_H(CMP_IR, I, R) CMP_H(CMP_RR, R, R) CMP_H(CMP_MR, M, R)
+    CMP_H(CMP_IM, I, M) CMP_H(CMP_RM, R, M) CMP_H(CMP_MM, M, M)
+
+    UNARY(CLR, 0)
+    UNARY(NOT, ~d)
+    UNARY(INC, WRAP(U(d) + 1u))
+    UNARY(DEC, WRAP(U(d) - 1u))
+
+    HANDLER(JMP) {
+        TAKEN();
+        JUMP(ip->dst);
+    }
+    HANDLER(BNE) {
+        if (!zero) {
+            TAKEN();
+            JUMP(ip->dst);
+        }
+        NEXT();
+    }
+    HANDLER(BEQ) {
+        if (zero) {
+            TAKEN();
+            JUMP(ip->dst);
+        }
+        NEXT();
+    }
+    HANDLER(JSR) {
+        PUSH((int32_t)(PC() + ip->size));
+        if (profile) {
+            TAKEN();
+            ProfileCall(profile, EXECUTED(), (uint32_t)(ip - code), (uint32_t)ip->dst);
+        }
+        JUMP(ip->dst);
+    }
+    HANDLER(RTS) {
+        int32_t address = 0;
+        POP(address);
+        if (U(address) - VM_CODE_START >= code_size) FAULT("Return to %d outside of the code at %u", address, PC());
+        if (profile) {
+            profile->returns[U(address) - VM_CODE_START]++;
+            ProfileReturn(profile, EXECUTED());
+        }
+        JUMP(U(address) - VM_CODE_START);
+    }
+    HANDLER(STOP) {
+        SYNC();
+        machine->status = VM_HALTED;
+        return VM_HALTED;
+    }
+    HANDLER(NOP) {
+        NEXT();
+    }
+    HANDLER(INT) {
+        SYNC();
+        VmStatus status = VmInterrupt(machine);
+        if (status == VM_CHECKPOINT) {
+            // Resumes past the `int`
+            ip += ip->size;
+            SYNC();
+        }
+        if (status != VM_RUNNING) return machine->status;
+        NEXT();
+    }
+
+    HANDLER(PUSH_I) { PUSH(DST_I); NEXT(); }
+    HANDLER(PUSH_R) { PUSH(DST_R); NEXT(); }
+    HANDLER(PUSH_M) { PUSH(DST_M); NEXT(); }
+    HANDLER(POP_R)  { POP(DST_R); NEXT(); }
+    HANDLER(POP_M)  { int32_t value = 0; POP(value); STORE(ip->dst, value); NEXT(); }
+
+#ifndef VM_THREADED
+    default:
+        FAULT("Illegal instruction 0x%08X at %u", U(LOAD(PC())), PC());
+    }
+#endif
+
+out_of_budget:
+    SYNC();
+    machine->status = VM_BUDGET;
+    return VM_BUDGET;
+
+#undef PC
+#undef SYNC
+#undef FAULT
+#undef HANDLER
+#undef DISPATCH
+#undef NEXT
+#undef JUMP
+#undef EXECUTED
+#undef TAKEN
+#undef LOAD
+#undef WRITABLE
+#undef STORE
+#undef PUSH
+#undef POP
+}
+#ifdef VM_THREADED
+#pragma GCC diagnostic pop
+#endif
+
+void VmCleanUp(Machine *machine) {
+    if (!machine) return;
+    if (machine->program && machine->code != machine->program->code) free(machine->code);
+    for (uint32_t i = 0; i < VM_PAGES; i++) free(machine->owned[i]);
+    VmReleaseSnapshot(machine->origin);
+    VmCloseFiles(machine);
+    free(machine->output);
+    memset(machine, 0, sizeof(Machine));
+}
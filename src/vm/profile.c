@@ -0,0 +1,303 @@
+#include "../../include/profile.h"
+#include "../../include/io.h"
+
+#define NO_NODE UINT32_MAX
+
+// Adds a code label, ignoring anything outside of the code
+static int AddProfileLabel(Profile *profile, const char *name, size_t length, uint32_t address) {
+    if (address < VM_CODE_START || address - VM_CODE_START >= profile->program->code_size) return 0;
+
+    ProfileLabel *temp = realloc(profile->labels, (profile->label_count + 1) * sizeof(ProfileLabel));
+    if (!temp) return STATUS_ERROR;
+    profile->labels = temp;
+
+    ProfileLabel *label = &profile->labels[profile->label_count];
+    label->name = strndup(name, length);
+    label->address = address;
+    if (!label->name) return STATUS_ERROR;
+    profile->label_count++;
+    return 0;
+}
+
+// Reads the code labels of a .sns file. Returns 0 upon success, STATUS_NO_RESULT if there is none
+static int ReadSymbolFile(Profile *profile, const char *path) {
+    LineReader reader;
+    if (!path || LineReaderOpen(&reader, path) != 0) return STATUS_NO_RESULT;
+
+    int status = 0;
+    char *line = NULL;
+    while (status == 0 && (line = ReadLine(&reader)) != NULL) {
+        TrimNewline(line);
+        char *bar = strchr(line, '|');
+        char *type = strrchr(line, '|');
+        if (!bar || type == bar || strcmp(type, "|CODE") != 0) continue;  // Data labels
+        status = AddProfileLabel(profile, line, (size_t)(bar - line), (uint32_t)strtoul(bar + 1, NULL, 10));
+    }
+    LineReaderClose(&reader);
+    return status;
+}
+
+static int CompareLabels(const void *a, const void *b) {
+    const ProfileLabel *left = a, *right = b;
+    return (left->address > right->address) - (left->address < right->address);
+}
+
+// Returns the frame for a call to function from parent, creating it on its first call
+static uint32_t FindNode(Profile *profile, uint32_t parent, uint32_t function) {
+    if ((profile->node_count + 1) * 2 > profile->table_capacity) {
+        size_t capacity = profile->table_capacity ? profile->table_capacity * 2 : 256;
+        uint32_t *table = calloc(capacity, sizeof(uint32_t));
+        if (!table) return NO_NODE;
+
+        // Rehash the frames, every one of them is in the table
+        for (uint32_t i = 0; i < profile->node_count; i++) {
+            size_t slot = ((size_t)profile->nodes[i].parent * 31 + profile->nodes[i].function) & (capacity - 1);
+            while (table[slot]) slot = (slot + 1) & (capacity - 1);
+            table[slot] = i + 1;
+        }
+        free(profile->node_table);
+        profile->node_table = table;
+        profile->table_capacity = capacity;
+    }
+
+    size_t mask = profile->table_capacity - 1;
+    size_t slot = ((size_t)parent * 31 + function) & mask;
+    for (; profile->node_table[slot]; slot = (slot + 1) & mask) {
+        CallNode *node = &profile->nodes[profile->node_table[slot] - 1];
+        if (node->parent == parent && node->function == function) return profile->node_table[slot] - 1;
+    }
+
+    if (profile->node_count == profile->node_capacity) {
+        size_t capacity = profile->node_capacity ? profile->node_capacity * 2 : 64;
+        CallNode *temp = realloc(profile->nodes, capacity * sizeof(CallNode));
+        if (!temp) return NO_NODE;
+        profile->nodes = temp;
+        profile->node_capacity = capacity;
+    }
+
+    uint32_t index = (uint32_t)profile->node_count++;
+    profile->nodes[index] = (CallNode){function, parent, 0};
+    profile->node_table[slot] = index + 1;
+    return index;
+}
+
+Profile *ProfileCreate(const Program *program, const char *symbol_path) {
+    if (!program) return NULL;
+
+    Profile *profile = calloc(1, sizeof(Profile));
+    if (!profile) return NULL;
+    profile->program = program;
+
+    size_t code_size = (size_t)program->code_size + 1;
+    profile->owner = calloc(code_size, sizeof(uint32_t));
+    profile->taken = calloc(code_size, sizeof(uint64_t));
+    profile->returns = calloc(code_size, sizeof(uint64_t));
+    profile->site_parent = malloc(code_size * sizeof(uint32_t));
+    profile->site_node = calloc(code_size, sizeof(uint32_t));
+    int status = (profile->owner && profile->taken && profile->returns && profile->site_parent && profile->site_node)
+        ? 0 : STATUS_ERROR;
+    if (status == 0) memset(profile->site_parent, 0xFF, code_size * sizeof(uint32_t));  // NO_NODE, no call made yet
+
+    // Without a symbol file, the entries of the image are the only names there are
+    if (status == 0) status = ReadSymbolFile(profile, symbol_path);
+    if (status == STATUS_NO_RESULT) {
+        LogVerbose("No symbol file at %s, labelling the profile with the program's entries\n", symbol_path ? symbol_path : "-");
+        status = 0;
+        for (size_t i = 0; i < program->symbol_count && status == 0; i++) {
+            status = AddProfileLabel(profile, program->symbols[i].name, strlen(program->symbols[i].name), program->symbols[i].address);
+        }
+    }
+
+    qsort(profile->labels, profile->label_count, sizeof(ProfileLabel), CompareLabels);
+    if (status == 0 && (profile->label_count == 0 || profile->labels[0].address != VM_CODE_START)) {
+        status = AddProfileLabel(profile, "[unlabeled]", strlen("[unlabeled]"), VM_CODE_START);
+        qsort(profile->labels, profile->label_count, sizeof(ProfileLabel), CompareLabels);
+    }
+
+    // Every code address belongs to the closest label before it
+    for (uint32_t i = 0, label = 0; status == 0 && i < code_size; i++) {
+        while (label + 1 < profile->label_count && profile->labels[label + 1].address <= i + VM_CODE_START) label++;
+        profile->owner[i] = label;
+    }
+
+    if (status == 0) {
+        uint32_t root = FindNode(profile, NO_NODE, profile->owner[program->entry - VM_CODE_START]);
+        if (root == NO_NODE) status = STATUS_ERROR;
+        profile->stack[profile->depth++] = root;
+    }
+
+    if (status != 0) {
+        ProfileDestroy(profile);
+        return NULL;
+    }
+    LogVerbose("Profiling %s with %zu code label(s)\n", program->path, profile->label_count);
+    return profile;
+}
+
+uint32_t ProfileEnter(Profile *profile, uint32_t site, uint32_t target) {
+    uint32_t parent = profile->stack[profile->depth - 1];
+    uint32_t node = FindNode(profile, parent, profile->owner[target]);
+    if (node == NO_NODE) return NO_NODE;
+    profile->site_parent[site] = parent;
+    profile->site_node[site] = node;
+    return node;
+}
+
+// Whether execution never falls through the instruction
+static bool EndsFlow(Handler handler) {
+    return handler == H_JMP || handler == H_JSR || handler == H_RTS || handler == H_STOP || handler == H_ILLEGAL;
+}
+
+/*
+ * Rebuilds how many times each instruction ran out of the control transfers.
+ * An instruction is reached by falling through from the one before it, by
+ * jumps and returns to it, and once as the entry. Returns the counts by code
+ * index, NULL upon failure
+ */
+static uint64_t *CountInstructions(const Profile *profile, const Machine *machine) {
+    const Insn *code = machine->code;
+    uint32_t code_size = profile->program->code_size;
+    uint64_t *reached = calloc((size_t)code_size + 1, sizeof(uint64_t));
+    if (!reached) return NULL;
+
+    for (uint32_t i = 0; i < code_size; i++) {
+        Handler handler = (Handler)code[i].handler;
+        bool jumps = handler == H_JMP || handler == H_BNE || handler == H_BEQ || handler == H_JSR;
+        if (jumps && profile->taken[i] > 0) reached[code[i].dst] += profile->taken[i];
+        reached[i] += profile->returns[i];
+    }
+    reached[profile->program->entry - VM_CODE_START]++;
+
+    // Only addresses an instruction starts at are walked, along the code's layout
+    uint64_t falling = 0;
+    uint32_t i = 0;
+    while (i < code_size) {
+        Handler handler = (Handler)code[i].handler;
+        uint64_t count = reached[i] + falling;
+        falling = EndsFlow(handler) ? 0 : count - ((count >= profile->taken[i]) ? profile->taken[i] : count);
+        uint32_t next = i + (code[i].size ? code[i].size : 1);
+        for (uint32_t j = i + 1; j < next && j < code_size; j++) reached[j] = 0;  // Operand words
+        reached[i] = count;
+        i = next;
+    }
+
+    // The straight line the run stopped in was counted to its end
+    uint32_t stopped = machine->pc - VM_CODE_START;
+    if (machine->status != VM_BUDGET && stopped < code_size) {
+        // The instruction at pc ran, the ones after it did not
+        stopped = EndsFlow((Handler)code[stopped].handler) ? code_size : stopped + (code[stopped].size ? code[stopped].size : 1);
+    }
+    while (stopped < code_size && reached[stopped] > 0) {
+        Handler handler = (Handler)code[stopped].handler;
+        reached[stopped]--;
+        if (EndsFlow(handler)) break;
+        stopped += code[stopped].size ? code[stopped].size : 1;
+    }
+    return reached;
+}
+
+// Writes the frames from the entry to node, separated by ';'
+static void WriteStack(FILE *output_fd, const Profile *profile, uint32_t node) {
+    if (profile->nodes[node].parent != NO_NODE) {
+        WriteStack(output_fd, profile, profile->nodes[node].parent);
+        fputc(';', output_fd);
+    }
+    fputs(profile->labels[profile->nodes[node].function].name, output_fd);
+}
+
+int ProfileWrite(Profile *profile, const Machine *machine, const char *flat_path, const char *folded_path) {
+    if (!profile || !machine) return STATUS_ERROR;
+    ProfileCharge(profile, machine->executed);
+
+    const Insn *code = machine->code;
+    uint32_t code_size = profile->program->code_size;
+    size_t labels = profile->label_count;
+    uint64_t *reached = CountInstructions(profile, machine);
+    uint64_t *totals = calloc(labels * 5, sizeof(uint64_t));  // Instructions, cycles, branches, taken, calls per label
+    FILE *flat_fd = fopen(flat_path, "w");
+    FILE *folded_fd = fopen(folded_path, "w");
+    int status = (reached && totals && flat_fd && folded_fd) ? 0 : STATUS_ERROR;
+    if (status != 0) printf("(-) Error: Failed to write the profile to %s and %s\n", flat_path, folded_path);
+
+    uint64_t instructions = 0, cycles = 0;
+    for (uint32_t i = 0; status == 0 && i < code_size; i++) {
+        if (reached[i] == 0) continue;
+        uint64_t *label = &totals[profile->owner[i] * 5];
+        Handler handler = (Handler)code[i].handler;
+
+        label[0] += reached[i];
+        label[1] += reached[i] * code[i].size;  // One cycle per word fetched
+        if (handler == H_BNE || handler == H_BEQ) label[2] += reached[i];
+        if (handler == H_BNE || handler == H_BEQ || handler == H_JMP) label[3] += profile->taken[i];
+        if (handler == H_JSR) totals[profile->owner[code[i].dst] * 5 + 4] += profile->taken[i];
+        instructions += reached[i];
+        cycles += reached[i] * code[i].size;
+    }
+
+    if (status == 0) {
+        fprintf(flat_fd, "Flat profile of %s: %llu instruction(s), %llu cycle(s) at one per word fetched\n\n",
+            profile->program->path, (unsigned long long)instructions, (unsigned long long)cycles);
+        fprintf(flat_fd, "%8s %14s %14s %12s %12s %10s  %s\n", "%", "instructions", "cycles", "branches", "taken", "calls", "label");
+        for (size_t i = 0; i < labels; i++) {
+            const uint64_t *label = &totals[i * 5];
+            if (label[0] == 0) continue;
+            fprintf(flat_fd, "%7.2f%% %14llu %14llu %12llu %12llu %10llu  %s\n",
+                instructions ? 100.0 * (double)label[0] / (double)instructions : 0.0, (unsigned long long)label[0],
+                (unsigned long long)label[1], (unsigned long long)label[2], (unsigned long long)label[3],
+                (unsigned long long)label[4], profile->labels[i].name);
+        }
+
+        // Call sites are merged by the labels of the caller and the callee
+        fprintf(flat_fd, "\nCall graph (caller -> callee: calls)\n");
+        for (uint32_t i = 0; i < code_size; i++) {
+            if (code[i].handler != H_JSR || reached[i] == 0 || profile->taken[i] == 0) continue;
+            uint32_t caller = profile->owner[i], callee = profile->owner[code[i].dst];
+
+            bool seen = false;
+            for (uint32_t j = 0; j < i && !seen; j++) {
+                seen = code[j].handler == H_JSR && reached[j] > 0 && profile->taken[j] > 0 &&
+                       profile->owner[j] == caller && profile->owner[code[j].dst] == callee;
+            }
+            if (seen) continue;
+
+            uint64_t calls = 0;
+            for (uint32_t j = i; j < code_size; j++) {
+                if (code[j].handler == H_JSR && reached[j] > 0 && profile->owner[j] == caller && profile->owner[code[j].dst] == callee) {
+                    calls += profile->taken[j];
+                }
+            }
+            fprintf(flat_fd, "  %s -> %s: %llu\n", profile->labels[caller].name, profile->labels[callee].name, (unsigned long long)calls);
+        }
+        if (profile->unmatched > 0) {
+            fprintf(flat_fd, "\n%llu rts without a matching jsr\n", (unsigned long long)profile->unmatched);
+        }
+
+        // One line per frame, the stack from the entry down and the instructions run in it
+        for (uint32_t node = 0; node < profile->node_count; node++) {
+            if (profile->nodes[node].self == 0) continue;
+            WriteStack(folded_fd, profile, node);
+            fprintf(folded_fd, " %llu\n", (unsigned long long)profile->nodes[node].self);
+        }
+        LogInfo("(*) Wrote profile to %s and %s\n", flat_path, folded_path);
+    }
+
+    if (flat_fd) fclose(flat_fd);
+    if (folded_fd) fclose(folded_fd);
+    free(reached);
+    free(totals);
+    return status;
+}
+
+void ProfileDestroy(Profile *profile) {
+    if (!profile) return;
+    for (size_t i = 0; i < profile->label_count; i++) free(profile->labels[i].name);
+    free(profile->labels);
+    free(profile->owner);
+    free(profile->taken);
+    free(profile->returns);
+    free(profile->site_parent);
+    free(profile->site_node);
+    free(profile->nodes);
+    free(profile->node_table);
+    free(profile);
+}
@@ -0,0 +1,259 @@
+#include "../../include/vm.h"
+#include "../../include/io.h"
+#include "../../include/encoder.h"
+
+// Operand kinds, in the order the specialized handlers are laid out
+typedef enum e_kind {
+    KIND_I,
+    KIND_R,
+    KIND_M,
+    KIND_NONE
+} Kind;
+
+// How an instruction's operand kinds select its handler
+typedef enum e_shape {
+    SHAPE_BINARY,   // base + dst(R, M) * 3 + src(I, R, M)
+    SHAPE_COMPARE,  // base + dst(I, R, M) * 3 + src(I, R, M)
+    SHAPE_ADDRESS,  // `lea`, a `mov` of the source's address
+    SHAPE_UNARY,    // base + dst(R, M)
+    SHAPE_PUSH,     // base + dst(I, R, M)
+    SHAPE_JUMP,     // Destination is a code address
+    SHAPE_NONE
+} Shape;
+
+static const struct {
+    const char *name;
+    Handler     base;
+    Shape       shape;
+} shapes[] = {
+    {"mov",  H_MOV_IR,  SHAPE_BINARY},
+    {"cmp",  H_CMP_II,  SHAPE_COMPARE},
+    {"add",  H_ADD_IR,  SHAPE_BINARY},
+    {"sub",  H_SUB_IR,  SHAPE_BINARY},
+    {"lea",  H_MOV_IR,  SHAPE_ADDRESS},
+    {"lod",  H_LOD_IR,  SHAPE_BINARY},
+    {"str",  H_STR_IR,  SHAPE_BINARY},
+    {"clr",  H_CLR_R,   SHAPE_UNARY},
+    {"not",  H_NOT_R,   SHAPE_UNARY},
+    {"inc",  H_INC_R,   SHAPE_UNARY},
+    {"dec",  H_DEC_R,   SHAPE_UNARY},
+    {"jmp",  H_JMP,     SHAPE_JUMP},
+    {"bne",  H_BNE,     SHAPE_JUMP},
+    {"jsr",  H_JSR,     SHAPE_JUMP},
+    {"rts",  H_RTS,     SHAPE_NONE},
+    {"stop", H_STOP,    SHAPE_NONE},
+    {"and",  H_AND_IR,  SHAPE_BINARY},
+    {"or",   H_OR_IR,   SHAPE_BINARY},
+    {"xor",  H_XOR_IR,  SHAPE_BINARY},
+    {"mul",  H_MUL_IR,  SHAPE_BINARY},
+    {"div",  H_DIV_IR,  SHAPE_BINARY},
+    {"mod",  H_MOD_IR,  SHAPE_BINARY},
+    {"beq",  H_BEQ,     SHAPE_JUMP},
+    {"push", H_PUSH_I,  SHAPE_PUSH},
+    {"pop",  H_POP_R,   SHAPE_UNARY},
+    {"nop",  H_NOP,     SHAPE_NONE},
+    {"int",  H_INT,     SHAPE_NONE},
+};
+
+/*
+ * Decodes one operand in the given addressing mode. Immediates and registers
+ * are kept as they are, direct and relative operands become a memory address.
+ * Returns the operand's kind, or KIND_NONE if it's malformed.
+ */
+static Kind DecodeOperand(const Program *program, const int32_t *words, size_t available, uint32_t address,
+                          uint32_t mode, uint32_t reg, size_t *next, int32_t *value) {
+    if (mode == 3) {
+        if (reg >= VM_REGISTERS) return KIND_NONE;
+        *value = (int32_t)reg;
+        return KIND_R;
+    }
+
+    if (*next >= available) return KIND_NONE;  // Operand word past the code
+    uint32_t operand_address = address + (uint32_t)*next;
+    int32_t field = OperandValue(program->width, (uint32_t)words[(*next)++]);
+
+    if (mode == 0) {
+        *value = field;
+        return KIND_I;
+    }
+
+    // Relative operands count from the word after the command, like EncodeRel
+    int64_t target = (mode == 2) ? (int64_t)operand_address + field - 1 : field;
+    if (target < 0 || target >= VM_MEMORY_WORDS) return KIND_NONE;
+    *value = (int32_t)target;
+    return KIND_M;
+}
+
+void DecodeInsn(const Program *program, const int32_t *words, size_t available, uint32_t address, Insn *insn) {
+    memset(insn, 0, sizeof(Insn));
+    insn->handler = H_ILLEGAL;
+    insn->size = 1;
+    if (available == 0) return;
+
+    uint32_t word = (uint32_t)words[0];
+    CommandWord fields;
+    DecodeCommandWord(program->width, word, &fields);
+    if (!(word & A)) return;  // Command words are always absolute
+
+    const Command *comm = NULL;
+    for (size_t i = 0; i < COMMAND_COUNT && !comm; i++) {
+        if (commands[i].ident == S_OF(fields.opcode, fields.funct)) comm = &commands[i];
+    }
+    if (!comm || !ValidOperandModes(comm, &fields)) return;
+
+    size_t next = 1;
+    Kind src = KIND_NONE, dst = KIND_NONE;
+    int32_t src_value = 0, dst_value = 0;
+    if (comm->opcount == 2) {
+        src = DecodeOperand(program, words, available, address, fields.mode[0], fields.reg[0], &next, &src_value);
+        if (src == KIND_NONE) return;
+    }
+    if (comm->opcount >= 1) {
+        dst = DecodeOperand(program, words, available, address, fields.mode[1], fields.reg[1], &next, &dst_value);
+        if (dst == KIND_NONE) return;
+    }
+
+    size_t shape = 0;
+    while (strcmp(shapes[shape].name, comm->name) != 0) shape++;
+
+    int handler = shapes[shape].base;
+    switch (shapes[shape].shape) {
+        case SHAPE_BINARY:
+            if (dst == KIND_I) return;
+            handler += (dst - KIND_R) * 3 + src;
+            break;
+        case SHAPE_COMPARE:
+            handler += dst * 3 + src;
+            break;
+        case SHAPE_ADDRESS:
+            if (src != KIND_M || dst == KIND_I) return;
+            src = KIND_I;  // The address itself is moved
+            handler += (dst - KIND_R) * 3 + src;
+            break;
+        case SHAPE_UNARY:
+            if (dst == KIND_I) return;
+            handler += dst - KIND_R;
+            break;
+        case SHAPE_PUSH:
+            handler += dst;
+            break;
+        case SHAPE_JUMP:
+            // Jumps only land on decoded code, held as its index
+            if (dst != KIND_M || (uint32_t)dst_value < VM_CODE_START || (uint32_t)dst_value - VM_CODE_START >= program->code_size) return;
+            dst_value -= VM_CODE_START;
+            break;
+        case SHAPE_NONE:
+            break;
+    }
+
+    insn->handler = (uint16_t)handler;
+    insn->size = (uint16_t)next;
+    insn->src = src_value;
+    insn->dst = dst_value;
+}
+
+// Number of hex digits of a `0x...` word, telling 24-bit images from 32-bit ones
+static int WordWidth(const char *line) {
+    const char *hex = strstr(line, "0x");
+    if (!hex) return 0;
+    int digits = 0;
+    for (hex += 2; isxdigit((unsigned char)hex[digits]); digits++);
+    return (digits <= 6) ? WORD_SIZE_LEGACY : WORD_SIZE;
+}
+
+int LoadProgram(const char *path, int width, Program *program) {
+    if (!path || !program) return STATUS_ERROR;
+    memset(program, 0, sizeof(Program));
+
+    LineReader reader;
+    if (LineReaderOpen(&reader, path) != 0) {
+        printf("(-) Error: Failed to open image: %s\n", path);
+        return STATUS_ERROR;
+    }
+
+    int status = 0;
+    char *line = ReadLine(&reader);
+    if (!line || sscanf(line, "%u|%u", &program->code_size, &program->data_size) != 2 ||
+        (uint64_t)VM_CODE_START + program->code_size + program->data_size >= VM_MEMORY_WORDS) {
+        printf("(-) Error: %s is not a program image\n", path);
+        status = STATUS_ERROR;
+    }
+
+    size_t words = (size_t)program->code_size + program->data_size;
+    program->path = strdup(path);
+    if (status == 0) {
+        // Laid out as the machine's first pages, which share them until they write to them
+        program->page_count = (uint32_t)((VM_CODE_START + words + 1 + VM_PAGE_MASK) >> VM_PAGE_BITS);
+        program->pages = calloc((size_t)program->page_count * VM_PAGE_WORDS, sizeof(int32_t));
+        if (program->pages) program->image = program->pages + VM_CODE_START;
+        if (!program->path || !program->pages) status = STATUS_ERROR;
+    }
+
+    while (status == 0 && (line = ReadLine(&reader)) != NULL) {
+        TrimNewline(line);
+        unsigned int address = 0, word = 0;
+
+        if (strncmp(line, "E|", 2) == 0) {
+            char *name = line + 2;
+            char *bar = strchr(name, '|');
+            VmSymbol *temp = bar ? realloc(program->symbols, (program->symbol_count + 1) * sizeof(VmSymbol)) : NULL;
+            if (!temp) {
+                status = STATUS_ERROR;
+                break;
+            }
+            program->symbols = temp;
+            temp[program->symbol_count].name = strndup(name, bar - name);
+            temp[program->symbol_count].address = (uint32_t)strtoul(bar + 1, NULL, 10);
+            if (!temp[program->symbol_count].name) status = STATUS_ERROR;
+            program->symbol_count++;
+        } else if (strncmp(line, "X|", 2) == 0 || *line == '\0') {
+            continue;  // Unresolved externs read as address 0
+        } else if (sscanf(line, "%u : %x", &address, &word) == 2 &&
+                   address >= VM_CODE_START && address - VM_CODE_START < words) {
+            if (program->width == 0) program->width = width ? width : WordWidth(line);
+            // Legacy words are sign-extended to the machine's 32 bits
+            if (program->width == WORD_SIZE_LEGACY && (word & 0x800000)) word |= 0xFF000000u;
+            program->image[address - VM_CODE_START] = (int32_t)word;
+        } else {
+            printf("(-) Error: Invalid line in %s at %zu: %s\n", path, reader.line_no, line);
+            status = STATUS_ERROR;
+        }
+    }
+    LineReaderClose(&reader);
+    if (program->width == 0) program->width = width ? width : WORD_SIZE;
+
+    // Every code address is decoded, so any jump target can be dispatched directly.
+    // The trailing entries stay H_ILLEGAL and stop execution running off the code
+    if (status == 0) {
+        program->code = calloc((size_t)program->code_size + 3, sizeof(Insn));
+        if (!program->code) status = STATUS_ERROR;
+    }
+    for (uint32_t i = 0; status == 0 && i < program->code_size; i++) {
+        DecodeInsn(program, &program->image[i], program->code_size - i, VM_CODE_START + i, &program->code[i]);
+    }
+
+    int64_t start = FindProgramSymbol(program, "START");
+    program->entry = (start >= 0) ? (uint32_t)start : VM_CODE_START;
+
+    if (status != 0) CleanUpProgram(program);
+    else LogVerbose("Loaded %s: %d-bit, %u code word(s), %u data word(s), entry at %u\n",
+        path, program->width, program->code_size, program->data_size, program->entry);
+    return status;
+}
+
+int64_t FindProgramSymbol(const Program *program, const char *name) {
+    for (size_t i = 0; i < program->symbol_count; i++) {
+        if (strcmp(program->symbols[i].name, name) == 0) return program->symbols[i].address;
+    }
+    return STATUS_ERROR;
+}
+
+void CleanUpProgram(Program *program) {
+    if (!program) return;
+    for (size_t i = 0; i < program->symbol_count; i++) free(program->symbols[i].name);
+    free(program->symbols);
+    free(program->pages);
+    free(program->code);
+    free(program->path);
+    memset(program, 0, sizeof(Program));
+}
@@ -0,0 +1,274 @@
+#include <time.h>
+
+#include "../../include/vm.h"
+
+#define SYS_EXIT        0
+#define SYS_READ        1
+#define SYS_WRITE       2
+#define SYS_OPEN        3
+#define SYS_CLOSE       4
+#define SYS_CLOCK       5
+#define SYS_PUTS        8
+#define SYS_CHECKPOINT  9
+
+#define FD_STDIN   0
+#define FD_STDOUT  1
+#define FD_STDERR  2
+
+// Appends a character to the machine's captured output
+static int CaptureChar(Machine *machine, char c) {
+    if (machine->output_length + 1 >= machine->output_capacity) {
+        size_t new_capacity = (machine->output_capacity == 0) ? 256 : machine->output_capacity * 2;
+        char *output = realloc(machine->output, new_capacity);
+        if (!output) return STATUS_ERROR;
+        machine->output = output;
+        machine->output_capacity = new_capacity;
+    }
+    machine->output[machine->output_length++] = c;
+    machine->output[machine->output_length] = '\0';
+    return 0;
+}
+
+// Sets up the descriptor table with the standard streams. Returns 0 upon success, else STATUS_ERROR
+static int OpenFiles(Machine *machine) {
+    if (machine->files) return 0;
+
+    VmFile *files = calloc(VM_MAX_FILES, sizeof(VmFile));
+    if (!files) return STATUS_ERROR;
+    files[FD_STDIN].host = stdin;
+    files[FD_STDOUT].host = stdout;
+    files[FD_STDOUT].writable = true;
+    files[FD_STDERR].host = stderr;
+    files[FD_STDERR].writable = true;
+    machine->files = files;
+    return 0;
+}
+
+// Returns the open descriptor fd, or NULL
+static VmFile *FindFile(Machine *machine, int32_t fd) {
+    if (fd < 0 || fd >= VM_MAX_FILES || !machine->files[fd].host) return NULL;
+    return &machine->files[fd];
+}
+
+// Hands the pending writes to the host. Returns 0 upon success, else STATUS_ERROR
+static int FlushFile(VmFile *file) {
+    if (!file->writable || file->length == 0) return 0;
+    size_t written = fwrite(file->buffer, 1, file->length, file->host);
+    int status = (written == file->length) ? 0 : STATUS_ERROR;
+    file->length = 0;
+    return status;
+}
+
+// Buffers one byte for writing. Returns 0 upon success, else STATUS_ERROR
+static int PutByte(Machine *machine, int32_t fd, VmFile *file, char c) {
+    if (machine->capture && (fd == FD_STDOUT || fd == FD_STDERR)) return CaptureChar(machine, c);
+
+    if (!file->buffer && !(file->buffer = malloc(VM_IO_BUFFER))) return STATUS_ERROR;
+    if (file->length == VM_IO_BUFFER && FlushFile(file) != 0) return STATUS_ERROR;
+    file->buffer[file->length++] = c;
+    return 0;
+}
+
+// Reads the next byte of the file into c. Returns 0 upon success, STATUS_NO_RESULT at
+// the end of the file, else STATUS_ERROR
+static int GetByte(Machine *machine, int32_t fd, VmFile *file, int32_t *c) {
+    if (file->position == file->length) {
+        if (machine->capture && fd == FD_STDIN) return STATUS_NO_RESULT;
+        if (!file->buffer && !(file->buffer = malloc(VM_IO_BUFFER))) return STATUS_ERROR;
+
+        // The terminal hands input over a line at a time, files a chunk at a time
+        if (file->host == stdin) {
+            VmFlushFiles(machine);
+            file->length = fgets(file->buffer, VM_IO_BUFFER, stdin) ? strlen(file->buffer) : 0;
+        } else {
+            file->length = fread(file->buffer, 1, VM_IO_BUFFER, file->host);
+        }
+        file->position = 0;
+        if (file->length == 0) return STATUS_NO_RESULT;
+    }
+    *c = (unsigned char)file->buffer[file->position++];
+    return 0;
+}
+
+// Whether count words from address are all in memory
+static bool ValidBuffer(int32_t address, int32_t count) {
+    return address >= 0 && count >= 0 && (uint32_t)address < VM_MEMORY_WORDS &&
+        (uint32_t)count <= VM_MEMORY_WORDS - (uint32_t)address;
+}
+
+// read: r1 descriptor, r2 buffer, r3 words. Stores a byte per word and returns the bytes read, 0 at the end
+static VmStatus Read(Machine *machine, int32_t *result) {
+    int32_t *regs = machine->regs;
+    if (!ValidBuffer(regs[2], regs[3])) return VmFault(machine, "Invalid buffer passed to read at %u", machine->pc);
+
+    VmFile *file = FindFile(machine, regs[1]);
+    if (!file || file->writable) return VM_RUNNING;
+
+    int32_t count = 0;
+    while (count < regs[3]) {
+        int32_t c = 0;
+        int status = GetByte(machine, regs[1], file, &c);
+        if (status == STATUS_NO_RESULT) break;
+        if (status != 0) return VmFault(machine, "Out of memory for the file buffer at %u", machine->pc);
+        if (VmStore(machine, (uint32_t)(regs[2] + count), c) != 0) {
+            return VmFault(machine, "Out of memory for the page of %d at %u", regs[2] + count, machine->pc);
+        }
+        count++;
+    }
+    *result = count;
+    return VM_RUNNING;
+}
+
+// write: r1 descriptor, r2 buffer, r3 words. Writes the low byte of each word and returns the bytes written
+static VmStatus Write(Machine *machine, int32_t *result) {
+    int32_t *regs = machine->regs;
+    if (!ValidBuffer(regs[2], regs[3])) return VmFault(machine, "Invalid buffer passed to write at %u", machine->pc);
+
+    VmFile *file = FindFile(machine, regs[1]);
+    if (!file || !file->writable) return VM_RUNNING;
+
+    for (int32_t i = 0; i < regs[3]; i++) {
+        if (PutByte(machine, regs[1], file, (char)(VmLoad(machine, (uint32_t)(regs[2] + i)) & 0xFF)) != 0) return VM_RUNNING;
+    }
+    *result = regs[3];
+    return VM_RUNNING;
+}
+
+// Writes the NUL-terminated string at r2 to the descriptor in r1
+static VmStatus PutString(Machine *machine) {
+    int32_t *regs = machine->regs;
+    VmFile *file = FindFile(machine, regs[1]);
+    if (!file || !file->writable) return VmFault(machine, "Invalid stream %d passed to int at %u", regs[1], machine->pc);
+
+    uint32_t address = (uint32_t)regs[2];
+    for (; address < VM_MEMORY_WORDS && VmLoad(machine, address) != 0; address++) {
+        if (PutByte(machine, regs[1], file, (char)(VmLoad(machine, address) & 0xFF)) != 0) {
+            return VmFault(machine, "Failed to write the output of int at %u", machine->pc);
+        }
+    }
+    if (address >= VM_MEMORY_WORDS) return VmFault(machine, "Unterminated string passed to int at %u", machine->pc);
+    return VM_RUNNING;
+}
+
+// open: r1 NUL-terminated path, r2 mode (0 read, 1 write, 2 append). Returns the descriptor
+static VmStatus Open(Machine *machine, int32_t *result) {
+    static const char *modes[] = {"rb", "wb", "ab"};
+    int32_t *regs = machine->regs;
+
+    char path[VM_MAX_PATH];
+    size_t length = 0;
+    for (uint32_t address = (uint32_t)regs[1]; ; address++) {
+        if (address >= VM_MEMORY_WORDS || length == VM_MAX_PATH - 1) {
+            return VmFault(machine, "Invalid path passed to open at %u", machine->pc);
+        }
+        path[length] = (char)(VmLoad(machine, address) & 0xFF);
+        if (path[length] == '\0') break;
+        length++;
+    }
+    if (regs[2] < 0 || regs[2] > 2) return VM_RUNNING;
+
+    int32_t fd = FD_STDERR + 1;
+    while (fd < VM_MAX_FILES && machine->files[fd].host) fd++;
+    if (fd == VM_MAX_FILES) return VM_RUNNING;
+
+    FILE *host = fopen(path, modes[regs[2]]);
+    if (!host) return VM_RUNNING;
+
+    VmFile *file = &machine->files[fd];
+    memset(file, 0, sizeof(VmFile));
+    file->host = host;
+    file->writable = (regs[2] != 0);
+    file->owned = true;
+    *result = fd;
+    LogDebug("Program opened %s as %d\n", path, fd);
+    return VM_RUNNING;
+}
+
+// close: r1 descriptor. Returns 0
+static VmStatus Close(Machine *machine, int32_t *result) {
+    VmFile *file = FindFile(machine, machine->regs[1]);
+    if (!file) return VM_RUNNING;
+
+    int status = FlushFile(file);
+    if (file->owned && fclose(file->host) != 0) status = STATUS_ERROR;
+    free(file->buffer);
+    memset(file, 0, sizeof(VmFile));
+    *result = (status == 0) ? 0 : -1;
+    return VM_RUNNING;
+}
+
+// clock: the host's monotonic time in microseconds from an arbitrary start, low half in r0 and high half in r1
+static VmStatus Clock(Machine *machine, int32_t *result) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t micros = (uint64_t)now.tv_sec * 1000000u + (uint64_t)now.tv_nsec / 1000u;
+    *result = (int32_t)(uint32_t)micros;
+    machine->regs[1] = (int32_t)(uint32_t)(micros >> 32);
+    return VM_RUNNING;
+}
+
+VmStatus VmInterrupt(Machine *machine) {
+    int32_t *regs = machine->regs;
+    int32_t result = -1;  // Failed calls return -1 in r0
+    VmStatus status = VM_RUNNING;
+
+    if (regs[0] >= SYS_READ && regs[0] <= SYS_PUTS && OpenFiles(machine) != 0) {
+        return VmFault(machine, "Out of memory for the files at %u", machine->pc);
+    }
+
+    switch (regs[0]) {
+        case SYS_EXIT:
+            machine->exit_code = regs[1];
+            machine->status = VM_HALTED;
+            return VM_HALTED;
+        case SYS_READ:
+            status = Read(machine, &result);
+            break;
+        case SYS_WRITE:
+            status = Write(machine, &result);
+            break;
+        case SYS_OPEN:
+            status = Open(machine, &result);
+            break;
+        case SYS_CLOSE:
+            status = Close(machine, &result);
+            break;
+        case SYS_CLOCK:
+            status = Clock(machine, &result);
+            break;
+        case SYS_PUTS:
+            // r1: descriptor, r2: string address, r0 is left as it is
+            return PutString(machine);
+        case SYS_CHECKPOINT:
+            // Where snapshots are taken, a no-op unless the machine is asked to stop there
+            if (!machine->stop_at_checkpoint) return VM_RUNNING;
+            machine->status = VM_CHECKPOINT;
+            return VM_CHECKPOINT;
+        default:
+            return VmFault(machine, "Unknown syscall %d at %u", regs[0], machine->pc);
+    }
+
+    if (status == VM_RUNNING) regs[0] = result;
+    return status;
+}
+
+void VmFlushFiles(Machine *machine) {
+    if (!machine->files) return;
+    for (int32_t fd = 0; fd < VM_MAX_FILES; fd++) {
+        if (machine->files[fd].host) FlushFile(&machine->files[fd]);
+    }
+    fflush(stdout);
+    fflush(stderr);
+}
+
+void VmCloseFiles(Machine *machine) {
+    if (!machine->files) return;
+    VmFlushFiles(machine);
+    for (int32_t fd = 0; fd < VM_MAX_FILES; fd++) {
+        VmFile *file = &machine->files[fd];
+        if (file->owned) fclose(file->host);
+        free(file->buffer);
+    }
+    free(machine->files);
+    machine->files = NULL;
+}
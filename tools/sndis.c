@@ -0,0 +1,116 @@
+#include "../include/definitions.h"
+#include "../include/disasm.h"
+#include "../include/logger.h"
+
+static void PrintDisasmHelp(void) {
+    printf("Usage: ./sndis [options] program.sno\n");
+    printf("Options:\n");
+    printf("  -v, --verbose        Enable verbose logging\n");
+    printf("  -d, --debug          Enable debug-level logging\n");
+    printf("  -q, --quiet          Suppress all logging\n");
+    printf("  -l  --legacy-24      Read a legacy 24-bit image (detected from the image otherwise)\n");
+    printf("  -y, --symbols <file> Name addresses from a .sns symbol file (default: the program's, if any)\n");
+    printf("  -g, --map <file>     Note source lines from a .snd debug map (default: the program's, if any)\n");
+    printf("  -o, --output <file>  Write the listing to a file instead of stdout\n");
+    printf("      --help           Show this help message\n");
+}
+
+int main(int argc, char **argv) {
+    const char *path = NULL;
+    const char *symbols = NULL;
+    const char *debug_map = NULL;
+    const char *output = NULL;
+    int width = 0;
+
+    for (int i = 1; i < argc; i++) {
+        char *arg = argv[i];
+
+        if (strcmp(arg, "-v") == 0 || strcmp(arg, "--verbose") == 0) {
+            SetLogLevel(LOG_VERBOSE);
+        } else if (strcmp(arg, "-d") == 0 || strcmp(arg, "--debug") == 0) {
+            SetLogLevel(LOG_DEBUG);
+        } else if (strcmp(arg, "-q") == 0 || strcmp(arg, "--quiet") == 0) {
+            SetLogLevel(LOG_QUIET);
+        } else if (strcmp(arg, "-l") == 0 || strcmp(arg, "--legacy-24") == 0) {
+            width = WORD_SIZE_LEGACY;
+        } else if ((strcmp(arg, "-y") == 0 || strcmp(arg, "--symbols") == 0) && (i + 1 < argc)) {
+            symbols = argv[++i];
+        } else if ((strcmp(arg, "-g") == 0 || strcmp(arg, "--map") == 0) && (i + 1 < argc)) {
+            debug_map = argv[++i];
+        } else if ((strcmp(arg, "-o") == 0 || strcmp(arg, "--output") == 0) && (i + 1 < argc)) {
+            output = argv[++i];
+        } else if (strcmp(arg, "--help") == 0) {
+            PrintDisasmHelp();
+            return EXIT_SUCCESS;
+        } else if (arg[0] == '-' || path) {
+            printf("(-) Unknown option: %s\n", arg);
+            PrintDisasmHelp();
+            return EXIT_FAILURE;
+        } else {
+            path = arg;
+        }
+    }
+
+    if (!path) {
+        printf("(-) No program provided.\n");
+        PrintDisasmHelp();
+        return EXIT_FAILURE;
+    }
+
+    Disassembly dis;
+    if (LoadDisassembly(path, width, &dis) != 0) return EXIT_FAILURE;
+
+    // The program's own symbol file is used when there is one, a missing one is no error
+    char symbol_path[MAX_FILENAME_LENGTH + MAX_EXTENSION_LENGTH + 2];
+    if (!symbols) {
+        SiblingPath(path, SYMBOL_FILE_EXTENSION, symbol_path, sizeof(symbol_path));
+        FILE *probe = fopen(symbol_path, "r");
+        if (probe) {
+            fclose(probe);
+            symbols = symbol_path;
+        }
+    }
+    if (symbols && LoadDisassemblySymbols(&dis, symbols) != 0) {
+        CleanUpDisassembly(&dis);
+        return EXIT_FAILURE;
+    }
+
+    // Likewise for the debug map
+    char map_path[MAX_FILENAME_LENGTH + MAX_EXTENSION_LENGTH + 2];
+    if (!debug_map) {
+        SiblingPath(path, DEBUG_MAP_EXTENSION, map_path, sizeof(map_path));
+        FILE *probe = fopen(map_path, "rb");
+        if (probe) {
+            fclose(probe);
+            debug_map = map_path;
+        }
+    }
+    DebugMap map = {0};
+    if (debug_map) {
+        if (LoadDebugMap(debug_map, &map) != 0) {
+            CleanUpDisassembly(&dis);
+            return EXIT_FAILURE;
+        }
+        dis.debug = &map;
+    }
+
+    FILE *file = output ? fopen(output, "w") : stdout;
+    if (!file) {
+        printf("(-) Error: Failed to open output file: %s\n", output);
+        CleanUpDebugMap(&map);
+        CleanUpDisassembly(&dis);
+        return EXIT_FAILURE;
+    }
+
+    BufferedWriter writer;
+    int status = WriterOpen(&writer, file);
+    if (status == 0) status = WriteDisassembly(&dis, &writer);
+    if (WriterClose(&writer) != 0) status = STATUS_ERROR;
+    if (output && fclose(file) != 0) status = STATUS_ERROR;
+    if (status != 0) printf("(-) Error: Failed to write the listing of %s\n", path);
+    else if (output) LogInfo("(*) Disassembled %s into %s\n", path, output);
+
+    CleanUpDebugMap(&map);
+    CleanUpDisassembly(&dis);
+    return (status == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
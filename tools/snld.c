@@ -0,0 +1,113 @@
+#include "../include/definitions.h"
+#include "../include/linker.h"
+#include "../include/archive.h"
+
+#define LINKER_DEFAULT_OUTPUT "out"
+
+static void PrintLinkerHelp(void) {
+    printf("Usage: ./snld [options] object.snl object2.snl ... [library.sna ...]\n");
+    printf("       ./snld --archive library.sna object.snl object2.snl ...\n");
+    printf("Options:\n");
+    printf("  -v, --verbose        Enable verbose logging\n");
+    printf("  -d, --debug          Enable debug-level logging\n");
+    printf("  -q, --quiet          Suppress all logging\n");
+    printf("  -x, --externals      List extern usages no object defines\n");
+    printf("  -o, --output <file>  Specify output file\n");
+    printf("  -a, --archive <file> Bundle the objects into a .sna archive instead of linking\n");
+    printf("      --help           Show this help message\n");
+}
+
+static bool HasExtension(const char *filename, const char *extension) {
+    const char *dot = strrchr(filename, '.');
+    return dot && strcmp(dot, extension) == 0;
+}
+
+int main(int argc, char **argv) {
+    const char *output = LINKER_DEFAULT_OUTPUT;
+    const char *archive = NULL;
+    char **objects = calloc(argc, sizeof(char *));  // Kept for --archive
+    size_t object_count = 0;
+    bool gen_externals = false;
+    Link link = {0};
+    int status = 0;
+
+    for (int i = 1; i < argc && status == 0; i++) {
+        char *arg = argv[i];
+
+        if (strcmp(arg, "-v") == 0 || strcmp(arg, "--verbose") == 0) {
+            SetLogLevel(LOG_VERBOSE);
+        } else if (strcmp(arg, "-d") == 0 || strcmp(arg, "--debug") == 0) {
+            SetLogLevel(LOG_DEBUG);
+        } else if (strcmp(arg, "-q") == 0 || strcmp(arg, "--quiet") == 0) {
+            SetLogLevel(LOG_QUIET);
+        } else if (strcmp(arg, "-x") == 0 || strcmp(arg, "--externals") == 0) {
+            gen_externals = true;
+        } else if ((strcmp(arg, "-o") == 0 || strcmp(arg, "--output") == 0) && (i + 1 < argc)) {
+            output = argv[++i];
+        } else if ((strcmp(arg, "-a") == 0 || strcmp(arg, "--archive") == 0) && (i + 1 < argc)) {
+            archive = argv[++i];
+        } else if (strcmp(arg, "--help") == 0) {
+            PrintLinkerHelp();
+            CleanUpLink(&link);
+            free(objects);
+            return EXIT_SUCCESS;
+        } else if (arg[0] == '-') {
+            printf("(-) Unknown option: %s\n", arg);
+            PrintLinkerHelp();
+            status = STATUS_ERROR;
+        } else if (HasExtension(arg, LINK_ARCHIVE_EXTENSION)) {
+            status = AddArchive(&link, arg);
+        } else if (!HasExtension(arg, LINK_OBJECT_EXTENSION)) {
+            printf("(-) Error: Invalid file extension for '%s'. Only '%s' objects and '%s' archives can be linked.\n",
+                arg, LINK_OBJECT_EXTENSION, LINK_ARCHIVE_EXTENSION);
+            status = STATUS_ERROR;
+        } else if (objects) {
+            objects[object_count++] = arg;
+        } else {
+            status = STATUS_ERROR;
+        }
+    }
+
+    // Objects are read once the options are known, an archive only bundles them
+    if (status == 0 && archive) {
+        if (link.archive_count > 0) {
+            printf("(-) Error: Archives can't be bundled into another archive\n");
+            status = STATUS_ERROR;
+        } else if (object_count == 0) {
+            printf("(-) No input objects provided.\n");
+            status = STATUS_ERROR;
+        } else {
+            status = WriteArchive(archive, objects, object_count);
+        }
+        CleanUpLink(&link);
+        free(objects);
+        return (status == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < object_count && status == 0; i++) status = AddObject(&link, objects[i]);
+    free(objects);
+
+    if (status == 0 && link.count == 0) {
+        printf("(-) No input objects provided.\n");
+        PrintLinkerHelp();
+        status = STATUS_ERROR;
+    }
+
+    // Output is named like the assembler's, `-o prog` writes prog.sno
+    char output_path[MAX_FILENAME_LENGTH + MAX_EXTENSION_LENGTH + 1] = {0};
+    if (status == 0 && (size_t)snprintf(output_path, sizeof(output_path), "%s%s", output, OBJECT_FILE_EXTENSION) >= sizeof(output_path)) {
+        printf("(-) Error: could not build %s output path\n", OBJECT_FILE_EXTENSION);
+        status = STATUS_ERROR;
+    }
+
+    if (status == 0) {
+        int unresolved = LinkObjects(&link);
+        if (unresolved < 0) status = STATUS_ERROR;
+        else status = WriteProgram(&link, output_path, gen_externals);
+
+        if (status == 0) LogInfo("(*) Linked %zu object(s) into %s: %u code word(s), %u data word(s)\n",
+            link.count, output_path, link.code_size, link.data_size);
+    }
+
+    CleanUpLink(&link);
+    return (status == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
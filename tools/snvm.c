@@ -0,0 +1,203 @@
+#include <time.h>
+
+#include "../include/batch.h"
+#include "../include/debugmap.h"
+#include "../include/definitions.h"
+#include "../include/io.h"
+#include "../include/jit.h"
+#include "../include/profile.h"
+
+static void PrintVmHelp(void) {
+    printf("Usage: ./snvm [options] program.sno\n");
+    printf("Options:\n");
+    printf("  -v, --verbose        Enable verbose logging\n");
+    printf("  -d, --debug          Enable debug-level logging\n");
+    printf("  -q, --quiet          Suppress all logging\n");
+    printf("  -l  --legacy-24      Run a legacy 24-bit image (detected from the image otherwise)\n");
+    printf("  -b, --budget <n>     Stop after n instructions\n");
+    printf("  -j, --jit            Translate hot code to native x86-64 code\n");
+    printf("  -p, --profile        Write a flat (.prof) and a folded-stack (.folded) profile of the run,\n");
+    printf("                       labelled from the program's .sns symbol file (SNASM -s)\n");
+    printf("  -r, --registers      Print the registers once the program stops\n");
+    printf("      --batch <file>   Run every image a manifest lists (`path [budget] [rN=value ...]` per line)\n");
+    printf("                       on a thread pool, forking each from its program's checkpoint\n");
+    printf("  -t, --threads <n>    Threads for --batch (default: one per CPU)\n");
+    printf("  -o, --output <file>  Results file for --batch (default: the manifest's name with .results)\n");
+    printf("      --help           Show this help message\n");
+}
+
+// Names the source line of a faulting address from the program's debug map (SNASM -g), if it has one
+static void PrintFaultSource(const char *path, uint32_t address) {
+    char map_path[MAX_FILENAME_LENGTH + MAX_EXTENSION_LENGTH + 2];
+    SiblingPath(path, DEBUG_MAP_EXTENSION, map_path, sizeof(map_path));
+    FILE *probe = fopen(map_path, "rb");
+    if (!probe) return;
+    fclose(probe);
+
+    DebugMap map;
+    DebugLine line;
+    if (LoadDebugMap(map_path, &map) != 0) return;
+    if (FindDebugLine(&map, address, &line) == 0 && line.file) {
+        printf("(-)   at %s:%u", line.file, line.line);
+        if (line.macro) printf(" in %s from %s:%u", line.macro, line.call_file ? line.call_file : "?", line.call_line);
+        printf("\n");
+    }
+    CleanUpDebugMap(&map);
+}
+
+// Runs a manifest of programs and writes their results. Returns the exit status of snvm
+static int RunManifest(const char *manifest, const char *results_path, int width, uint64_t budget,
+    size_t threads, bool use_jit) {
+    Batch batch;
+    if (LoadBatch(manifest, width, budget, &batch) != 0) return EXIT_FAILURE;
+    batch.use_jit = use_jit;
+
+    char default_path[MAX_FILENAME_LENGTH + MAX_EXTENSION_LENGTH + 2];
+    if (!results_path) {
+        SiblingPath(manifest, BATCH_RESULTS_EXTENSION, default_path, sizeof(default_path));
+        results_path = default_path;
+    }
+
+    if (RunBatch(&batch, threads) != 0 || WriteBatchResults(&batch, results_path) != 0) {
+        CleanUpBatch(&batch);
+        return EXIT_FAILURE;
+    }
+
+    uint64_t executed = 0;
+    for (size_t i = 0; i < batch.job_count; i++) executed += batch.jobs[i].executed;
+    size_t failures = CountBatchFailures(&batch);
+
+    LogInfo("(*) Ran %zu job(s), %zu failed, results in %s\n", batch.job_count, failures, results_path);
+    LogVerbose("%zu distinct image(s), %zu forked from a checkpoint, %zu thread(s), %zu steal(s), "
+        "%llu instruction(s) in %.3fs (%.1f MIPS)\n", batch.image_count, batch.forks, batch.thread_count, batch.steals,
+        (unsigned long long)executed, batch.seconds,
+        (batch.seconds > 0) ? (double)executed / batch.seconds / 1e6 : 0.0);
+
+    CleanUpBatch(&batch);
+    return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char **argv) {
+    const char *path = NULL;
+    uint64_t budget = 0;
+    int width = 0;
+    bool show_registers = false;
+    bool use_jit = false;
+    bool use_profile = false;
+    const char *manifest = NULL;
+    const char *results_path = NULL;
+    size_t threads = 0;
+
+    for (int i = 1; i < argc; i++) {
+        char *arg = argv[i];
+
+        if (strcmp(arg, "-v") == 0 || strcmp(arg, "--verbose") == 0) {
+            SetLogLevel(LOG_VERBOSE);
+        } else if (strcmp(arg, "-d") == 0 || strcmp(arg, "--debug") == 0) {
+            SetLogLevel(LOG_DEBUG);
+        } else if (strcmp(arg, "-q") == 0 || strcmp(arg, "--quiet") == 0) {
+            SetLogLevel(LOG_QUIET);
+        } else if (strcmp(arg, "-l") == 0 || strcmp(arg, "--legacy-24") == 0) {
+            width = WORD_SIZE_LEGACY;
+        } else if ((strcmp(arg, "-b") == 0 || strcmp(arg, "--budget") == 0) && (i + 1 < argc)) {
+            budget = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(arg, "-j") == 0 || strcmp(arg, "--jit") == 0) {
+            use_jit = true;
+        } else if (strcmp(arg, "-p") == 0 || strcmp(arg, "--profile") == 0) {
+            use_profile = true;
+        } else if (strcmp(arg, "-r") == 0 || strcmp(arg, "--registers") == 0) {
+            show_registers = true;
+        } else if (strcmp(arg, "--batch") == 0 && (i + 1 < argc)) {
+            manifest = argv[++i];
+        } else if ((strcmp(arg, "-t") == 0 || strcmp(arg, "--threads") == 0) && (i + 1 < argc)) {
+            threads = strtoul(argv[++i], NULL, 10);
+        } else if ((strcmp(arg, "-o") == 0 || strcmp(arg, "--output") == 0) && (i + 1 < argc)) {
+            results_path = argv[++i];
+        } else if (strcmp(arg, "--help") == 0) {
+            PrintVmHelp();
+            return EXIT_SUCCESS;
+        } else if (arg[0] == '-' || path) {
+            printf("(-) Unknown option: %s\n", arg);
+            PrintVmHelp();
+            return EXIT_FAILURE;
+        } else {
+            path = arg;
+        }
+    }
+
+    if (manifest) {
+        if (path) {
+            printf("(-) Unknown option: %s\n", path);
+            PrintVmHelp();
+            return EXIT_FAILURE;
+        }
+        if (use_profile || show_registers) printf("(*) Warning: -p and -r are ignored with --batch\n");
+        return RunManifest(manifest, results_path, width, budget, threads, use_jit);
+    }
+
+    if (!path) {
+        printf("(-) No program provided.\n");
+        PrintVmHelp();
+        return EXIT_FAILURE;
+    }
+
+    Program program;
+    if (LoadProgram(path, width, &program) != 0) return EXIT_FAILURE;
+
+    Machine machine;
+    if (VmInit(&machine, &program) != 0) {
+        printf("(-) Error: Out of memory for the machine\n");
+        CleanUpProgram(&program);
+        return EXIT_FAILURE;
+    }
+
+    // Native code reports no control transfers, a profiled run is interpreted
+    char symbol_path[MAX_FILENAME_LENGTH + MAX_EXTENSION_LENGTH + 2];
+    SiblingPath(path, SYMBOL_FILE_EXTENSION, symbol_path, sizeof(symbol_path));
+    Profile *profile = use_profile ? ProfileCreate(&program, symbol_path) : NULL;
+    if (use_profile && !profile) printf("(*) Warning: Failed to set up the profiler, running without it\n");
+    if (profile && use_jit) printf("(*) Warning: -j is ignored while profiling\n");
+    machine.profile = profile;
+
+    Jit *jit = (use_jit && !profile) ? JitCreate(&machine) : NULL;
+
+    clock_t begin = clock();
+    VmStatus status = jit ? JitRun(jit, budget) : VmRun(&machine, budget);
+    double seconds = (double)(clock() - begin) / CLOCKS_PER_SEC;
+    VmFlushFiles(&machine);
+    fflush(stdout);
+
+    int ret = machine.exit_code;
+    if (status == VM_FAULT) {
+        printf("(-) Runtime error: %s\n", machine.fault);
+        PrintFaultSource(path, machine.pc);
+        ret = EXIT_FAILURE;
+    } else if (status == VM_BUDGET) {
+        printf("(*) Stopped after %llu instruction(s) at %u\n", (unsigned long long)machine.executed, machine.pc);
+        ret = EXIT_FAILURE;
+    }
+
+    LogVerbose("Executed %llu instruction(s) in %.3fs (%.1f MIPS)\n", (unsigned long long)machine.executed,
+        seconds, (seconds > 0) ? (double)machine.executed / seconds / 1e6 : 0.0);
+    LogVerbose("Wrote to %zu of %u memory page(s)\n", machine.owned_count, VM_PAGES);
+
+    if (show_registers) {
+        for (int i = 0; i < VM_REGISTERS; i++) {
+            if (machine.regs[i] != 0) printf("r%-2d = %d\n", i, machine.regs[i]);
+        }
+        printf("pc  = %u\nsp  = %u\n", machine.pc, machine.sp);
+    }
+
+    if (profile) {
+        char flat_path[sizeof(symbol_path) + 8], folded_path[sizeof(symbol_path) + 8];
+        SiblingPath(path, PROFILE_FLAT_EXTENSION, flat_path, sizeof(flat_path));
+        SiblingPath(path, PROFILE_FOLDED_EXTENSION, folded_path, sizeof(folded_path));
+        if (ProfileWrite(profile, &machine, flat_path, folded_path) != 0 && ret == 0) ret = EXIT_FAILURE;
+        ProfileDestroy(profile);
+    }
+
+    JitDestroy(jit);
+    VmCleanUp(&machine);
+    CleanUpProgram(&program);
+    return ret;
+}